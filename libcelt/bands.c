@@ -1054,9 +1054,9 @@ static unsigned quant_band(int encode, const CELTMode *m, int i, celt_norm *X, c
 
          /* Finally do the actual quantization */
          if (encode)
-            cm = alg_quant(X, N, K, spread, B, resynth, ec, gain);
+            cm = alg_quant(X, N, K, spread, B, resynth, &m->cwrs, ec, gain);
          else
-            cm = alg_unquant(X, N, K, spread, B, ec, gain);
+            cm = alg_unquant(X, N, K, spread, B, &m->cwrs, ec, gain);
       } else {
          /* If there's no pulse, fill the band anyway */
          int j;
@@ -41,6 +41,7 @@
 #include "os_support.h"
 #include "mdct.h"
 #include <math.h>
+#include <stddef.h>
 #include "celt.h"
 #include "pitch.h"
 #include "bands.h"
@@ -54,6 +55,11 @@
 #include <stdarg.h>
 #include "plc.h"
 #include "vq.h"
+#include "profile.h"
+
+#if defined(ENABLE_SSE) && !defined(FIXED_DEBUG)
+#include "celt_sse.h"
+#endif
 
 static const unsigned char trim_icdf[11] = {126, 124, 119, 109, 87, 41, 19, 9, 4, 2, 0};
 /* Probs: NONE: 21.875%, LIGHT: 6.25%, NORMAL: 65.625%, AGGRESSIVE: 6.25% */
@@ -64,6 +70,28 @@ static const unsigned char tapset_icdf[3]={2,1,0};
 #define COMBFILTER_MAXPERIOD 1024
 #define COMBFILTER_MINPERIOD 15
 
+#ifdef ENABLE_ALIGNED_STATE
+/* Each array of the state starts on its own cache line, and so does the
+   part that gets updated on every frame */
+#define STATE_ALIGNMENT 64
+#define STATE_ALIGN(size) (((size)+STATE_ALIGNMENT-1)&~(STATE_ALIGNMENT-1))
+#if defined(_MSC_VER)
+#define CACHE_ALIGNED __declspec(align(64))
+#else
+#define CACHE_ALIGNED __attribute__((aligned(STATE_ALIGNMENT)))
+#endif
+#define celt_state_alloc(size) celt_alloc_aligned(size, STATE_ALIGNMENT)
+#define celt_state_free(st) celt_free_aligned(st)
+#else
+#define STATE_ALIGN(size) (size)
+#define CACHE_ALIGNED
+#define celt_state_alloc(size) celt_alloc(size)
+#define celt_state_free(st) celt_free(st)
+#endif
+
+/* Pointer to an array at offset bytes from the start of the state */
+#define STATE_ARRAY(st, offset, type) ((type*)(void*)((char*)(st)+(offset)))
+
 static int resampling_factor(celt_int32 rate)
 {
    int ret;
@@ -90,6 +118,17 @@ static int resampling_factor(celt_int32 rate)
    return ret;
 }
 
+/* One past the last band that starts below the Nyquist rate of a signal
+   resampled by the given factor. The MDCT has nothing but zeros above it,
+   so there is no point coding those bands. */
+static int nyquist_end_band(const CELTMode *m, int resample)
+{
+   int end = m->effEBands;
+   while (end>1 && m->eBands[end-1]*resample >= m->shortMdctSize)
+      end--;
+   return end;
+}
+
 /** Encoder state 
  @brief Encoder state
  */
@@ -110,11 +149,23 @@ struct CELTEncoder {
    int vbr;
    int signalling;
    int constrained_vbr;      /* If zero, VBR can do whatever it likes with the rate */
+   int vbr_lookahead;        /* Frames after the current one in the input */
+   int analysis_level;       /* CELT_ANALYSIS_* level of the last frame */
+#ifdef ENABLE_PROFILING
+   CELTProfileState profile;
+#endif
+#ifdef ENABLE_CPU_BUDGET
+   CELTBudgetState budget;
+#endif
+#ifdef ENABLE_SCRATCH_ARENA
+   char *scratch;            /* Caller's memory during celt_encode_scratch(), or NULL */
+   int scratch_size;
+#endif
 
    /* Everything beyond this point gets cleared on a reset */
 #define ENCODER_RESET_START rng
 
-   celt_uint32 rng;
+   CACHE_ALIGNED celt_uint32 rng;
    int spread_decision;
    int delayedIntra;
    int tonal_average;
@@ -125,6 +176,7 @@ struct CELTEncoder {
    int prefilter_period;
    celt_word16 prefilter_gain;
    int prefilter_tapset;
+   int pitch_hint;           /* Open-loop pitch for the next frame, or 0 */
 #ifdef RESYNTH
    int prefilter_period_old;
    celt_word16 prefilter_gain_old;
@@ -137,39 +189,156 @@ struct CELTEncoder {
    celt_int32 vbr_drift;
    celt_int32 vbr_offset;
    celt_int32 vbr_count;
+   /* VBR look-ahead window: whether the current frame and the next ones
+      are transients */
+   int lookahead_count;
+   int lookahead_frame_size;
+   int lookahead_transient[CELT_MAX_VBR_LOOKAHEAD+1];
+   /* Size of the next frame in bits, as planned by a second pass, or 0 */
+   celt_int32 frame_target;
 
    celt_word32 preemph_memE[2];
    celt_word32 preemph_memD[2];
 
 #ifdef RESYNTH
-   celt_sig syn_mem[2][2*MAX_PERIOD];
+   CACHE_ALIGNED celt_sig syn_mem[2][2*MAX_PERIOD];
 #endif
 
-   celt_sig in_mem[1]; /* Size = channels*mode->overlap */
+   CACHE_ALIGNED celt_sig in_mem[1]; /* Size = channels*mode->overlap */
    /* celt_sig prefilter_mem[],  Size = channels*COMBFILTER_PERIOD */
    /* celt_sig overlap_mem[],  Size = channels*mode->overlap */
-   /* celt_word16 oldEBands[], Size = 2*channels*mode->nbEBands */
+   /* celt_word16 oldEBands[], Size = channels*mode->nbEBands */
+   /* celt_word16 oldLogE[], Size = channels*mode->nbEBands */
+   /* celt_word16 oldLogE2[], Size = channels*mode->nbEBands */
 };
 
+/* Where the arrays after in_mem[] are, in bytes from the start of the state */
+typedef struct {
+   int prefilter_mem;
+   int overlap_mem;
+   int oldBandE;
+   int oldLogE;
+   int oldLogE2;
+   int size;                 /* Of the whole state, without the scratch arena */
+} EncoderLayout;
+
+static void encoder_layout(const CELTMode *mode, int channels, EncoderLayout *l)
+{
+   int bands = channels*mode->nbEBands*sizeof(celt_word16);
+   l->prefilter_mem = STATE_ALIGN(offsetof(struct CELTEncoder, in_mem)
+         + channels*mode->overlap*sizeof(celt_sig));
+   l->overlap_mem = STATE_ALIGN(l->prefilter_mem + channels*COMBFILTER_MAXPERIOD*sizeof(celt_sig));
+   l->oldBandE = STATE_ALIGN(l->overlap_mem + channels*mode->overlap*sizeof(celt_sig));
+   l->oldLogE = STATE_ALIGN(l->oldBandE + bands);
+   l->oldLogE2 = STATE_ALIGN(l->oldLogE + bands);
+   l->size = STATE_ALIGN(l->oldLogE2 + bands);
+}
+
 int celt_encoder_get_size(int channels)
 {
    CELTMode *mode = celt_mode_create(48000, 960, NULL);
    return celt_encoder_get_size_custom(mode, channels);
 }
 
+/* Size of the state without the scratch arena */
+static int encoder_state_size(const CELTMode *mode, int channels)
+{
+   EncoderLayout l;
+   encoder_layout(mode, channels, &l);
+   return l.size;
+}
+
+#define SCRATCH_ALIGN(size) (((size)+15)&~15)
+#ifndef SCRATCH_SCALE
+#define SCRATCH_SCALE 1
+#endif
+
+/* Most an ALLOC(var, n, type) can take from the arena, with its alignment */
+#define SCRATCH_ITEM(n, type) ((int)((n)+1)*(int)sizeof(type))
+
+/* What quant_all_bands() allocates for M short blocks, with the deepest
+   quant_band(): the (de)interleaving or the pulse search and its CWRS row */
+static int bands_scratch_size(const CELTMode *mode, int C, int M)
+{
+   int W = M*(mode->eBands[mode->nbEBands]-mode->eBands[mode->nbEBands-1]);
+   return SCRATCH_ITEM(C*M*mode->eBands[mode->nbEBands], celt_norm)
+         + SCRATCH_ITEM(W, celt_norm)
+         + IMAX(SCRATCH_ITEM(W, celt_norm), SCRATCH_ITEM(W, celt_norm)
+               + SCRATCH_ITEM(W, int) + SCRATCH_ITEM(W, celt_word16))
+         + SCRATCH_ITEM(MAX_PULSES+2, celt_uint32);
+}
+
+/* What compute_mdcts() or compute_inv_mdcts() allocate for a frame of N */
+static int mdct_scratch_size(const CELTMode *mode, int N)
+{
+   return SCRATCH_ITEM(N+mode->overlap, celt_word32) + SCRATCH_ITEM(N, celt_word32)
+         + 2*SCRATCH_ITEM(N, kiss_fft_scalar);
+}
+
+/* Worst case of one celt_encode() call, from its ALLOC()s and those of
+   what it calls at the largest frame size. The other calls on an encoder
+   (celt_encoder_frame_stats() and the like) allocate a subset of this. */
+int celt_encoder_get_scratch_size(const CELTMode *mode, int channels)
+{
+   int size, pitch, analysis, coding;
+   int C = channels;
+   int N = mode->shortMdctSize*mode->nbShortMdcts;
+   int nb = mode->nbEBands;
+
+   /* in[] of the conversion from the other format, then what goes from
+      one stage of the encoder to the next: the pre-emphasised frame, the
+      normalised bands and their energies */
+   size = 2*SCRATCH_ITEM(C*(N+mode->overlap), celt_sig) + SCRATCH_ITEM(C*N, celt_norm)
+         + SCRATCH_ITEM(C*nb, celt_ener) + SCRATCH_ITEM(C*nb, celt_word16);
+
+   /* The prefilter history, the decimated signal and pitch_search() */
+   pitch = SCRATCH_ITEM(C*(N+COMBFILTER_MAXPERIOD), celt_sig)
+         + SCRATCH_ITEM((COMBFILTER_MAXPERIOD+N)>>1, celt_word16)
+         + SCRATCH_ITEM(N>>2, celt_word16)
+         + SCRATCH_ITEM((N+COMBFILTER_MAXPERIOD)>>2, celt_word16)
+         + SCRATCH_ITEM(COMBFILTER_MAXPERIOD>>1, celt_word32);
+
+   /* The spectrum and the MDCTs */
+   analysis = SCRATCH_ITEM(C*N, celt_sig) + mdct_scratch_size(mode, N);
+
+   /* The per-band arrays, with the largest of what is allocated in turn
+      while coding them: tf_analysis(), quant_coarse_energy(),
+      compute_allocation(), quant_all_bands() or the spectrum and the
+      inverse MDCTs to resynthesise */
+   coding = SCRATCH_ITEM(C*nb, celt_word16) + 6*SCRATCH_ITEM(nb, int)
+         + SCRATCH_ITEM(C*nb, unsigned char);
+   coding += IMAX(IMAX(analysis,
+               3*SCRATCH_ITEM(nb, int) + SCRATCH_ITEM(N, celt_norm)),
+         IMAX(IMAX(2*SCRATCH_ITEM(C*nb, celt_word16) + SCRATCH_ITEM(1275, unsigned char),
+               4*SCRATCH_ITEM(nb, int)),
+            bands_scratch_size(mode, C, mode->nbShortMdcts)));
+
+   size += IMAX(pitch, IMAX(analysis, coding));
+   return SCRATCH_SCALE*SCRATCH_ALIGN(size);
+}
+
+#ifdef ENABLE_SCRATCH_ARENA
+/* The caller's scratch memory during celt_encode_scratch(), otherwise the
+   arena at the end of the state */
+#define ENCODER_ARENA(st) ((st)->scratch ? (st)->scratch : \
+      (char*)(st) + SCRATCH_ALIGN(encoder_state_size((st)->mode, (st)->channels)))
+#define ENCODER_ARENA_SIZE(st) ((st)->scratch ? (st)->scratch_size : \
+      celt_encoder_get_scratch_size((st)->mode, (st)->channels))
+#endif /* ENABLE_SCRATCH_ARENA */
+
 int celt_encoder_get_size_custom(const CELTMode *mode, int channels)
 {
-   int size = sizeof(struct CELTEncoder)
-         + (2*channels*mode->overlap-1)*sizeof(celt_sig)
-         + channels*COMBFILTER_MAXPERIOD*sizeof(celt_sig)
-         + 3*channels*mode->nbEBands*sizeof(celt_word16);
+   int size = encoder_state_size(mode, channels);
+#ifdef ENABLE_SCRATCH_ARENA
+   size = SCRATCH_ALIGN(size) + celt_encoder_get_scratch_size(mode, channels);
+#endif
    return size;
 }
 
 CELTEncoder *celt_encoder_create(int sampling_rate, int channels, int *error)
 {
    CELTEncoder *st;
-   st = (CELTEncoder *)celt_alloc(celt_encoder_get_size(channels));
+   st = (CELTEncoder *)celt_state_alloc(celt_encoder_get_size(channels));
    if (st!=NULL && celt_encoder_init(st, sampling_rate, channels, error)==NULL)
    {
       celt_encoder_destroy(st);
@@ -180,7 +349,7 @@ CELTEncoder *celt_encoder_create(int sampling_rate, int channels, int *error)
 
 CELTEncoder *celt_encoder_create_custom(const CELTMode *mode, int channels, int *error)
 {
-   CELTEncoder *st = (CELTEncoder *)celt_alloc(celt_encoder_get_size_custom(mode, channels));
+   CELTEncoder *st = (CELTEncoder *)celt_state_alloc(celt_encoder_get_size_custom(mode, channels));
    if (st!=NULL && celt_encoder_init_custom(st, mode, channels, error)==NULL)
    {
       celt_encoder_destroy(st);
@@ -242,6 +411,10 @@ CELTEncoder *celt_encoder_init_custom(CELTEncoder *st, const CELTMode *mode, int
    st->hf_average = 0;
    st->tapset_decision = 0;
    st->complexity = 5;
+   st->analysis_level = CELT_ANALYSIS_FULL;
+#ifdef ENABLE_CPU_BUDGET
+   celt_budget_init(&st->budget);
+#endif
 
    if (error)
       *error = CELT_OK;
@@ -250,7 +423,7 @@ CELTEncoder *celt_encoder_init_custom(CELTEncoder *st, const CELTMode *mode, int
 
 void celt_encoder_destroy(CELTEncoder *st)
 {
-   celt_free(st);
+   celt_state_free(st);
 }
 
 static inline celt_int16 FLOAT2INT16(float x)
@@ -273,57 +446,114 @@ static inline celt_word16 SIG2WORD16(celt_sig x)
 #endif
 }
 
+/* Applies the pre-emphasis to one channel of the input (with upsampling),
+   updating its memory, and returns whether the output is all zeros. With
+   x_lp, this channel's share of the new half of the signal that
+   pitch_downsample_from() decimates is added there too, in the same loop.
+   That needs the output to follow an even number of samples of history, as
+   it does in the prefilter buffer. */
+static int preemphasis(CELTEncoder * restrict st, const celt_word16 * restrict pcmp,
+      celt_sig * restrict out, celt_word16 * restrict x_lp, int N, int c, int CC)
+{
+   int i;
+   int count = 0;
+   int silence = 1;
+   const celt_word16 coef0 = st->mode->preemph[0];
+   const celt_word16 coef1 = st->mode->preemph[1];
+   const celt_word16 coef2 = st->mode->preemph[2];
+   celt_sig m = st->preemph_memE[c];
+   if (x_lp!=NULL)
+      x_lp += COMBFILTER_MAXPERIOD>>1;
+   for (i=0;i<N;i++)
+   {
+      celt_sig x, tmp;
+
+      x = SCALEIN(*pcmp);
+#ifndef FIXED_POINT
+      if (st->clip)
+         x = MAX32(-65536.f, MIN32(65536.f,x));
+#endif
+      if (++count==st->upsample)
+      {
+         count=0;
+         pcmp+=CC;
+      } else {
+         x = 0;
+      }
+      /* Apply pre-emphasis */
+      tmp = MULT16_16(coef2, x);
+      out[i] = tmp + m;
+      m = MULT16_32_Q15(coef1, out[i]) - MULT16_32_Q15(coef0, tmp);
+      silence = silence && out[i] == 0;
+      /* Each decimated sample also needs the one after it */
+      if (x_lp!=NULL && (i&1))
+      {
+         if (c==0)
+            x_lp[i>>1] = pitch_decimate(out+i-1);
+         else
+            x_lp[i>>1] += pitch_decimate(out+i-1);
+      }
+   }
+   st->preemph_memE[c] = m;
+   return silence;
+}
+
+#ifdef ENABLE_POSTFILTER
+/* Keeps the last COMBFILTER_MAXPERIOD samples of pre-emphasised input */
+static void update_prefilter_mem(celt_sig *mem, const celt_sig *pre, int N)
+{
+   if (N>COMBFILTER_MAXPERIOD)
+   {
+      CELT_MOVE(mem, pre+N, COMBFILTER_MAXPERIOD);
+   } else {
+      CELT_MOVE(mem, mem+N, COMBFILTER_MAXPERIOD-N);
+      CELT_MOVE(mem+COMBFILTER_MAXPERIOD-N, pre+COMBFILTER_MAXPERIOD, N);
+   }
+}
+#endif /* ENABLE_POSTFILTER */
+
 static int transient_analysis(const celt_word32 * restrict in, int len, int C,
                               int overlap)
 {
-   int i;
-   VARDECL(celt_word16, tmp);
+   int i, b;
    celt_word32 mem0=0,mem1=0;
    int is_transient = 0;
    int block;
    int N;
    /* FIXME: Make that smaller */
    celt_word16 bins[50];
-   SAVE_STACK;
-   ALLOC(tmp, len, celt_word16);
 
    block = overlap/2;
    N=len/block;
-   if (C==1)
+   /* Downmix, high-pass filter (1 - 2*z^-1 + z^-2) / (1 - z^-1 + .5*z^-2)
+      and peak of each block, all in one pass over the input. The last
+      partial block isn't needed. */
+   for (b=0,i=0;b<N;b++)
    {
-      for (i=0;i<len;i++)
-         tmp[i] = SHR32(in[i],SIG_SHIFT);
-   } else {
-      for (i=0;i<len;i++)
-         tmp[i] = SHR32(ADD32(in[i],in[i+len]), SIG_SHIFT+1);
-   }
-
-   /* High-pass filter: (1 - 2*z^-1 + z^-2) / (1 - z^-1 + .5*z^-2) */
-   for (i=0;i<len;i++)
-   {
-      celt_word32 x,y;
-      x = tmp[i];
-      y = ADD32(mem0, x);
+      int j;
+      celt_word16 max_abs=0;
+      for (j=0;j<block;j++,i++)
+      {
+         celt_word16 tmp;
+         celt_word32 x,y;
+         if (C==1)
+            tmp = SHR32(in[i],SIG_SHIFT);
+         else
+            tmp = SHR32(ADD32(in[i],in[i+len]), SIG_SHIFT+1);
+         x = tmp;
+         y = ADD32(mem0, x);
 #ifdef FIXED_POINT
-      mem0 = mem1 + y - SHL32(x,1);
-      mem1 = x - SHR32(y,1);
+         mem0 = mem1 + y - SHL32(x,1);
+         mem1 = x - SHR32(y,1);
 #else
-      mem0 = mem1 + y - 2*x;
-      mem1 = x - .5f*y;
+         mem0 = mem1 + y - 2*x;
+         mem1 = x - .5f*y;
 #endif
-      tmp[i] = EXTRACT16(SHR(y,2));
-   }
-   /* First few samples are bad because we don't propagate the memory */
-   for (i=0;i<12;i++)
-      tmp[i] = 0;
-
-   for (i=0;i<N;i++)
-   {
-      int j;
-      celt_word16 max_abs=0;
-      for (j=0;j<block;j++)
-         max_abs = MAX16(max_abs, ABS16(tmp[i*block+j]));
-      bins[i] = max_abs;
+         /* First few samples are bad because we don't propagate the memory */
+         if (i>=12)
+            max_abs = MAX16(max_abs, ABS16(EXTRACT16(SHR(y,2))));
+      }
+      bins[b] = max_abs;
    }
    for (i=0;i<N;i++)
    {
@@ -356,19 +586,19 @@ static int transient_analysis(const celt_word32 * restrict in, int len, int C,
       if (conseq>=7)
          is_transient=1;
    }
-   RESTORE_STACK;
    return is_transient;
 }
 
 /** Apply window and compute the MDCT for all sub-frames and 
-    all channels in a frame */
-static void compute_mdcts(const CELTMode *mode, int shortBlocks, celt_sig * restrict in, celt_sig * restrict out, int _C, int LM)
+    all channels in a frame. Only the first bound bins of each channel
+    are needed. */
+static void compute_mdcts(const CELTMode *mode, int shortBlocks, celt_sig * restrict in, celt_sig * restrict out, int _C, int LM, int bound)
 {
    const int C = CHANNELS(_C);
    if (C==1 && !shortBlocks)
    {
       const int overlap = OVERLAP(mode);
-      clt_mdct_forward(&mode->mdct, in, out, mode->window, overlap, mode->maxLM-LM);
+      clt_mdct_forward(&mode->mdct, in, out, mode->window, overlap, mode->maxLM-LM, bound);
    } else {
       const int overlap = OVERLAP(mode);
       int N = mode->shortMdctSize<<LM;
@@ -387,7 +617,7 @@ static void compute_mdcts(const CELTMode *mode, int shortBlocks, celt_sig * rest
          for (b=0;b<B;b++)
          {
             int j;
-            clt_mdct_forward(&mode->mdct, in+c*(B*N+overlap)+b*N, tmp, mode->window, overlap, shortBlocks ? mode->maxLM : mode->maxLM-LM);
+            clt_mdct_forward(&mode->mdct, in+c*(B*N+overlap)+b*N, tmp, mode->window, overlap, shortBlocks ? mode->maxLM : mode->maxLM-LM, (bound+B-1)/B);
             /* Interleaving the sub-frames */
             for (j=0;j<N;j++)
                out[(j*B+b)+c*N*B] = tmp[j];
@@ -398,10 +628,11 @@ static void compute_mdcts(const CELTMode *mode, int shortBlocks, celt_sig * rest
 }
 
 /** Compute the IMDCT and apply window for all sub-frames and 
-    all channels in a frame */
+    all channels in a frame. The bins of each channel are zero from
+    bound on. */
 static void compute_inv_mdcts(const CELTMode *mode, int shortBlocks, celt_sig *X,
       celt_sig * restrict out_mem[],
-      celt_sig * restrict overlap_mem[], int _C, int LM)
+      celt_sig * restrict overlap_mem[], int _C, int LM, int bound)
 {
    int c;
    const int C = CHANNELS(_C);
@@ -432,7 +663,7 @@ static void compute_inv_mdcts(const CELTMode *mode, int shortBlocks, celt_sig *X
             /* De-interleaving the sub-frames */
             for (j=0;j<N2;j++)
                tmp[j] = X[(j*B+b)+c*N2*B];
-            clt_mdct_backward(&mode->mdct, tmp, x+N2*b, mode->window, overlap, shortBlocks ? mode->maxLM : mode->maxLM-LM);
+            clt_mdct_backward(&mode->mdct, tmp, x+N2*b, mode->window, overlap, shortBlocks ? mode->maxLM : mode->maxLM-LM, (bound+B-1)/B);
          }
 
          for (j=0;j<overlap;j++)
@@ -478,47 +709,68 @@ static void deemphasis(celt_sig *in[], celt_word16 *pcm, int N, int _C, int down
 }
 
 #ifdef ENABLE_POSTFILTER
-static void comb_filter(celt_word32 *y, celt_word32 *x, int T0, int T1, int N,
-      celt_word16 g0, celt_word16 g1, int tapset0, int tapset1,
-      const celt_word16 *window, int overlap)
+#ifndef OVERRIDE_COMB_FILTER
+/* The first overlap samples of the comb filter, where the filter with
+   period T0 and gains g0[] fades into the one with period T1 and gains g1[] */
+static void comb_filter_fade(celt_word32 *y, const celt_word32 *x, int T0, int T1,
+      const celt_word16 *g0, const celt_word16 *g1, const celt_word16 *window, int overlap)
 {
    int i;
-   /* printf ("%d %d %f %f\n", T0, T1, g0, g1); */
-   celt_word16 g00, g01, g02, g10, g11, g12;
-   static const celt_word16 gains[3][3] = {
-         {QCONST16(0.3066406250f, 15), QCONST16(0.2170410156f, 15), QCONST16(0.1296386719f, 15)},
-         {QCONST16(0.4638671875f, 15), QCONST16(0.2680664062f, 15), QCONST16(0.f, 15)},
-         {QCONST16(0.7998046875f, 15), QCONST16(0.1000976562f, 15), QCONST16(0.f, 15)}};
-   g00 = MULT16_16_Q15(g0, gains[tapset0][0]);
-   g01 = MULT16_16_Q15(g0, gains[tapset0][1]);
-   g02 = MULT16_16_Q15(g0, gains[tapset0][2]);
-   g10 = MULT16_16_Q15(g1, gains[tapset1][0]);
-   g11 = MULT16_16_Q15(g1, gains[tapset1][1]);
-   g12 = MULT16_16_Q15(g1, gains[tapset1][2]);
    for (i=0;i<overlap;i++)
    {
       celt_word16 f;
       f = MULT16_16_Q15(window[i],window[i]);
       y[i] = x[i]
-               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g00),x[i-T0])
-               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g01),x[i-T0-1])
-               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g01),x[i-T0+1])
-               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g02),x[i-T0-2])
-               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g02),x[i-T0+2])
-               + MULT16_32_Q15(MULT16_16_Q15(f,g10),x[i-T1])
-               + MULT16_32_Q15(MULT16_16_Q15(f,g11),x[i-T1-1])
-               + MULT16_32_Q15(MULT16_16_Q15(f,g11),x[i-T1+1])
-               + MULT16_32_Q15(MULT16_16_Q15(f,g12),x[i-T1-2])
-               + MULT16_32_Q15(MULT16_16_Q15(f,g12),x[i-T1+2]);
-
-   }
-   for (i=overlap;i<N;i++)
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[0]),x[i-T0])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[1]),x[i-T0-1])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[1]),x[i-T0+1])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[2]),x[i-T0-2])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[2]),x[i-T0+2])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[0]),x[i-T1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[1]),x[i-T1-1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[1]),x[i-T1+1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[2]),x[i-T1-2])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[2]),x[i-T1+2]);
+
+   }
+}
+
+/* The rest of the comb filter, with a constant period and gains */
+static void comb_filter_const(celt_word32 *y, const celt_word32 *x, int T, int N,
+      const celt_word16 *g)
+{
+   int i;
+   for (i=0;i<N;i++)
       y[i] = x[i]
-               + MULT16_32_Q15(g10,x[i-T1])
-               + MULT16_32_Q15(g11,x[i-T1-1])
-               + MULT16_32_Q15(g11,x[i-T1+1])
-               + MULT16_32_Q15(g12,x[i-T1-2])
-               + MULT16_32_Q15(g12,x[i-T1+2]);
+               + MULT16_32_Q15(g[0],x[i-T])
+               + MULT16_32_Q15(g[1],x[i-T-1])
+               + MULT16_32_Q15(g[1],x[i-T+1])
+               + MULT16_32_Q15(g[2],x[i-T-2])
+               + MULT16_32_Q15(g[2],x[i-T+2]);
+}
+#endif /* OVERRIDE_COMB_FILTER */
+
+/* Gains of the taps at the period and at one and two samples from it */
+static const celt_word16 comb_filter_gains[3][3] = {
+      {QCONST16(0.3066406250f, 15), QCONST16(0.2170410156f, 15), QCONST16(0.1296386719f, 15)},
+      {QCONST16(0.4638671875f, 15), QCONST16(0.2680664062f, 15), QCONST16(0.f, 15)},
+      {QCONST16(0.7998046875f, 15), QCONST16(0.1000976562f, 15), QCONST16(0.f, 15)}};
+
+static void comb_filter(celt_word32 *y, celt_word32 *x, int T0, int T1, int N,
+      celt_word16 g0, celt_word16 g1, int tapset0, int tapset1,
+      const celt_word16 *window, int overlap)
+{
+   /* printf ("%d %d %f %f\n", T0, T1, g0, g1); */
+   const celt_word16 (*gains)[3] = comb_filter_gains;
+   celt_word16 gains0[3], gains1[3];
+   gains0[0] = MULT16_16_Q15(g0, gains[tapset0][0]);
+   gains0[1] = MULT16_16_Q15(g0, gains[tapset0][1]);
+   gains0[2] = MULT16_16_Q15(g0, gains[tapset0][2]);
+   gains1[0] = MULT16_16_Q15(g1, gains[tapset1][0]);
+   gains1[1] = MULT16_16_Q15(g1, gains[tapset1][1]);
+   gains1[2] = MULT16_16_Q15(g1, gains[tapset1][2]);
+   comb_filter_fade(y, x, T0, T1, gains0, gains1, window, overlap);
+   comb_filter_const(y+overlap, x+overlap, T1, N-overlap, gains1);
 }
 #endif /* ENABLE_POSTFILTER */
 
@@ -861,67 +1113,281 @@ static int stereo_analysis(const CELTMode *m, const celt_norm *X,
          > MULT16_32_Q15(m->eBands[13]<<(LM+1), sumLR);
 }
 
-#ifdef FIXED_POINT
-CELT_STATIC
-int celt_encode_with_ec(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
+/* Level of a band, relative to its mean (as amp2Log2() gives it), below
+   which it is taken as noise that needs no bits, and above which more
+   level doesn't need more bits */
+#define DEMAND_FLOOR QCONST16(-5.f,DB_SHIFT)
+#define DEMAND_RANGE QCONST16(8.f,DB_SHIFT)
+
+/* Downmixes the MDCTs of a stereo input coded as mono and scales them up
+   (zeroing what's above the input band) when upsampling, as the encoder
+   does before the band energies */
+static void scale_mdcts(const CELTEncoder *st, celt_sig *freq, int N)
 {
-#else
-CELT_STATIC
-int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
+   int c, i;
+   const int CC = CHANNELS(st->channels);
+   const int C = CHANNELS(st->stream_channels);
+   if (CC==2&&C==1)
+   {
+      for (i=0;i<N;i++)
+         freq[i] = ADD32(HALF32(freq[i]), HALF32(freq[N+i]));
+   }
+   if (st->upsample != 1)
+   {
+      c=0; do
+      {
+         for (i=0;i<N/st->upsample;i++)
+            freq[c*N+i] *= st->upsample;
+         for (;i<N;i++)
+            freq[c*N+i] = 0;
+      } while (++c<C);
+   }
+}
+
+/* Rough number of bits a frame needs compared to other frames or streams
+   of the same mode: for each band, its width times its level above the
+   noise floor in steps of 6 dB (up to 48 dB), plus the side information */
+static int band_levels(const CELTEncoder *st, const celt_word16 *bandLogE, int LM, int effEnd)
 {
+   int c, i, demand;
+   const int C = CHANNELS(st->stream_channels);
+   celt_word32 sum = 0;
+   c=0; do {
+      for (i=st->start;i<effEnd;i++)
+      {
+         celt_word16 level = bandLogE[c*st->mode->nbEBands+i] - DEMAND_FLOOR;
+         level = MAX16(0, MIN16(DEMAND_RANGE, level));
+         sum += MULT16_16((st->mode->eBands[i+1]-st->mode->eBands[i])<<LM, level);
+      }
+   } while (++c<C);
+#ifdef FIXED_POINT
+   demand = SHR32(sum, DB_SHIFT);
+#else
+   demand = (int)sum;
 #endif
-   int i, c, N;
-   celt_int32 bits;
-   ec_enc _enc;
-   VARDECL(celt_sig, in);
+   return demand + 40*C+20;
+}
+
+/* Demand of a frame (see band_levels()) and whether it is a transient.
+   in[] is the pre-emphasised frame of each channel after its overlap. */
+static int band_demand(CELTEncoder * restrict st, celt_sig *in, int LM, int *isTransient)
+{
+   int N, M, demand;
+   int effEnd;
+   const int CC = CHANNELS(st->channels);
+   const int C = CHANNELS(st->stream_channels);
    VARDECL(celt_sig, freq);
-   VARDECL(celt_norm, X);
    VARDECL(celt_ener, bandE);
    VARDECL(celt_word16, bandLogE);
-   VARDECL(int, fine_quant);
-   VARDECL(celt_word16, error);
-   VARDECL(int, pulses);
-   VARDECL(int, cap);
-   VARDECL(int, offsets);
-   VARDECL(int, fine_priority);
-   VARDECL(int, tf_res);
-   VARDECL(unsigned char, collapse_masks);
-   celt_sig *_overlap_mem;
+   SAVE_STACK;
+
+   M = 1<<LM;
+   N = M*st->mode->shortMdctSize;
+   effEnd = IMIN(st->end, st->mode->effEBands);
+
+   *isTransient = 0;
+   if (LM>0 && st->complexity > 1)
+      *isTransient = transient_analysis(in, N+st->overlap, CC, st->overlap);
+
+   ALLOC(freq, CC*N, celt_sig);
+   ALLOC(bandE, st->mode->nbEBands*CC, celt_ener);
+   ALLOC(bandLogE, st->mode->nbEBands*CC, celt_word16);
+   compute_mdcts(st->mode, 0, in, freq, CC, LM, N/st->upsample);
+   scale_mdcts(st, freq, N);
+   compute_band_energies(st->mode, freq, bandE, effEnd, C, M);
+   amp2Log2(st->mode, effEnd, st->end, bandE, bandLogE, C);
+   demand = band_levels(st, bandLogE, LM, effEnd);
+   RESTORE_STACK;
+   return demand;
+}
+
+/* Overlap of channel c of the next frame, pre-emphasised, from the input
+   history of the encoder */
+static void history_overlap(CELTEncoder * restrict st, celt_sig *out, int c)
+{
+#ifdef ENABLE_POSTFILTER
+   /* The overlap in in_mem went through the prefilter, the end of its
+      memory didn't */
+   EncoderLayout layout;
+   encoder_layout(st->mode, CHANNELS(st->channels), &layout);
+   CELT_COPY(out, STATE_ARRAY(st, layout.prefilter_mem, celt_sig)
+         +(c+1)*COMBFILTER_MAXPERIOD-st->overlap, st->overlap);
+#else
+   CELT_COPY(out, st->in_mem+c*st->overlap, st->overlap);
+#endif
+}
+
+/* Pre-emphasises a frame of input for band_demand() without changing the
+   state. With history, the overlap is pre-emphasised from the input just
+   before pcm, otherwise it is the encoder's. */
+static void demand_input(CELTEncoder * restrict st, const celt_word16 * pcm, celt_sig *in, int N, int history)
+{
+   int c;
+   const int CC = CHANNELS(st->channels);
+   c=0; do {
+      celt_sig mem = st->preemph_memE[c];
+      if (history)
+      {
+         st->preemph_memE[c] = 0;
+         preemphasis(st, pcm+c-st->overlap/st->upsample*CC, in+c*(N+st->overlap),
+               NULL, N+st->overlap, c, CC);
+      } else {
+         history_overlap(st, in+c*(N+st->overlap), c);
+         preemphasis(st, pcm+c, in+c*(N+st->overlap)+st->overlap, NULL, N, c, CC);
+      }
+      st->preemph_memE[c] = mem;
+   } while (++c<CC);
+}
+
+static int frame_lm(const CELTEncoder *st, int frame_size)
+{
+   int LM;
+   frame_size *= st->upsample;
+   for (LM=0;LM<=st->mode->maxLM;LM++)
+      if (st->mode->shortMdctSize<<LM==frame_size)
+         return LM;
+   return -1;
+}
+
+/* Demand of the next frame as celt_encoder_frame_demand() gives it, with
+   3/4 more on a transient as the VBR gives */
+static int frame_demand(CELTEncoder * restrict st, const celt_word16 * pcm, int frame_size)
+{
+   int LM, demand, isTransient;
+   VARDECL(celt_sig, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   LM = frame_lm(st, frame_size);
+   if (LM<0)
+   {
+      RESTORE_STACK;
+      return CELT_BAD_ARG;
+   }
+   ALLOC(in, CHANNELS(st->channels)*((st->mode->shortMdctSize<<LM)+st->overlap), celt_sig);
+   demand_input(st, pcm, in, st->mode->shortMdctSize<<LM, 0);
+   demand = band_demand(st, in, LM, &isTransient);
+   if (isTransient)
+      demand = 7*demand/4;
+   RESTORE_STACK;
+   return demand;
+}
+
+/* First frame of the VBR look-ahead window that isn't analysed yet, after
+   forgetting the window if the frame size changed */
+static int lookahead_start(CELTEncoder * restrict st, int frame_size)
+{
+   if (frame_size != st->lookahead_frame_size)
+      st->lookahead_count = 0;
+   st->lookahead_frame_size = frame_size;
+   return st->lookahead_count;
+}
+
+/* Finds whether frame j of the look-ahead window, which starts at pcm,
+   will be coded as a transient, as celt_encode() would decide. After the
+   current frame, the input before pcm gives the overlap. */
+static void lookahead_analyse(CELTEncoder * restrict st, const celt_word16 * pcm, int frame_size, int j)
+{
+   int N, LM = frame_lm(st, frame_size);
+   VARDECL(celt_sig, in);
+   SAVE_STACK;
+   st->lookahead_transient[j] = 0;
+   if (LM>0 && st->complexity > 1)
+   {
+      N = st->mode->shortMdctSize<<LM;
+      ALLOC(in, CHANNELS(st->channels)*(N+st->overlap), celt_sig);
+      demand_input(st, pcm, in, N, j>0);
+      st->lookahead_transient[j] = transient_analysis(in, N+st->overlap,
+            CHANNELS(st->channels), st->overlap);
+   }
+   RESTORE_STACK;
+}
+
+static void vbr_lookahead(CELTEncoder * restrict st, const celt_word16 * pcm, int frame_size)
+{
+   int j;
+   for (j=lookahead_start(st, frame_size);j<=st->vbr_lookahead;j++)
+      lookahead_analyse(st, pcm+j*frame_size*CHANNELS(st->channels), frame_size, j);
+   st->lookahead_count = st->vbr_lookahead+1;
+}
+
+/* Scale of the VBR target of the current frame (in Q12) that makes the
+   whole window take its share of the rate, with the 3/4 more each of its
+   transients gets. The target only depends on the transient decisions
+   (and the tf analysis), so the band energies aren't needed. */
+static int lookahead_scale(const CELTEncoder *st)
+{
+   int j;
+   int window = 0;
+   int frames = st->vbr_lookahead+1;
+   for (j=0;j<frames;j++)
+      window += st->lookahead_transient[j] ? 7 : 4;
+   return 4*4096*frames/window;
+}
+
+/* A frame on its way through the encoder: what each stage leaves to the
+   next ones. The stages are split so that celt_encode_batch() can run each
+   of them over several streams before moving on to the next. */
+typedef struct {
+   const celt_word16 *pcm;
+   ec_enc *enc;
+   ec_enc _enc;
+   int LM, M, N;
+   int effEnd;
+   int nbCompressedBytes;
+   int nbFilledBytes;
+   int nbAvailableBytes;
+   int effectiveBytes;
+   celt_int32 vbr_rate;
+   celt_int32 total_bits;
+   int silence;
+   int pitch_index;
+   celt_word16 gain1;
+   int prefilter_tapset;
+   int pf_on;
+   int isTransient;
+   int shortBlocks;
+   celt_sig *in;          /* CC*(N+overlap) at the largest frame size */
+   celt_norm *X;          /* CC*N at the largest frame size */
+   celt_ener *bandE;      /* CC*nbEBands */
+   celt_word16 *bandLogE; /* CC*nbEBands */
+} EncodedFrame;
+
+static void encoded_frame_arrays(EncodedFrame *fr, celt_sig *in, celt_norm *X, celt_ener *bandE, celt_word16 *bandLogE)
+{
+   fr->in = in;
+   fr->X = X;
+   fr->bandE = bandE;
+   fr->bandLogE = bandLogE;
+}
+
+/* Sets up the rate and the range coder, then pre-emphasises the input into
+   in[] through the prefilter, after the pitch search */
+static int encode_frame_start(CELTEncoder * restrict st, EncodedFrame *fr, const celt_word16 * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
+{
+   int c, N;
+   celt_sig *in = fr->in;
+#ifdef ENABLE_POSTFILTER
    celt_sig *prefilter_mem;
-   celt_word16 *oldBandE, *oldLogE, *oldLogE2;
-   int shortBlocks=0;
-   int isTransient=0;
-   int resynth;
+   EncoderLayout layout;
+#endif
    const int CC = CHANNELS(st->channels);
    const int C = CHANNELS(st->stream_channels);
    int LM, M;
-   int tf_select;
    int nbFilledBytes, nbAvailableBytes;
    int effEnd;
-   int codedBands;
-   int tf_sum;
-   int alloc_trim;
    int pitch_index=COMBFILTER_MINPERIOD;
    celt_word16 gain1 = 0;
-   int intensity=0;
-   int dual_stereo=0;
    int effectiveBytes;
    celt_word16 pf_threshold;
-   int dynalloc_logp;
    celt_int32 vbr_rate;
    celt_int32 total_bits;
-   celt_int32 total_boost;
-   celt_int32 balance;
    celt_int32 tell;
    int prefilter_tapset=0;
    int pf_on;
-   int anti_collapse_rsv;
-   int anti_collapse_on=0;
    int silence=0;
-   ALLOC_STACK;
-   SAVE_STACK;
 
-   if (nbCompressedBytes<2 || pcm==NULL)
+   if (nbCompressedBytes<2)
      return CELT_BAD_ARG;
 
    frame_size *= st->upsample;
@@ -932,13 +1398,19 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
       return CELT_BAD_ARG;
    M=1<<LM;
    N = M*st->mode->shortMdctSize;
+   PROFILE_START(&st->profile);
+   BUDGET_FRAME_START(&st->budget);
+#ifdef ENABLE_CPU_BUDGET
+   st->analysis_level = st->budget.level;
+#endif
+
+   if (st->vbr && st->vbr_lookahead>0)
+      vbr_lookahead(st, pcm, frame_size/st->upsample);
 
-   prefilter_mem = st->in_mem+CC*(st->overlap);
-   _overlap_mem = prefilter_mem+CC*COMBFILTER_MAXPERIOD;
-   /*_overlap_mem = st->in_mem+C*(st->overlap);*/
-   oldBandE = (celt_word16*)(st->in_mem+CC*(2*st->overlap+COMBFILTER_MAXPERIOD));
-   oldLogE = oldBandE + CC*st->mode->nbEBands;
-   oldLogE2 = oldLogE + CC*st->mode->nbEBands;
+#ifdef ENABLE_POSTFILTER
+   encoder_layout(st->mode, CC, &layout);
+   prefilter_mem = STATE_ARRAY(st, layout.prefilter_mem, celt_sig);
+#endif
 
    if (enc==NULL)
    {
@@ -951,8 +1423,11 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
 
    if (st->signalling && enc==NULL)
    {
-      int tmp = (st->mode->effEBands-st->end)>>1;
-      st->end = IMAX(1, st->mode->effEBands-tmp);
+      /* The decoder takes the end band from here, so it can be lowered to
+         the input bandwidth whatever rate the decoder runs at. It is
+         rounded up to what can be signalled. */
+      int tmp = (st->mode->effEBands-IMIN(st->end, nyquist_end_band(st->mode, st->upsample)))>>1;
+      st->end = IMAX(1, st->mode->effEBands-2*tmp);
       compressed[0] = tmp<<5;
       compressed[0] |= LM<<3;
       compressed[0] |= (C==2)<<2;
@@ -971,6 +1446,8 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
       if (st->signalling)
          vbr_rate -= 8<<BITRES;
       effectiveBytes = vbr_rate>>(3+BITRES);
+      if (st->frame_target>0)
+         effectiveBytes = IMIN(1275, st->frame_target>>3);
    } else {
       celt_int32 tmp;
       vbr_rate = 0;
@@ -984,8 +1461,8 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
 
    if (enc==NULL)
    {
-      ec_enc_init(&_enc, compressed, nbCompressedBytes);
-      enc = &_enc;
+      ec_enc_init(&fr->_enc, compressed, nbCompressedBytes);
+      enc = &fr->_enc;
    }
 
    if (vbr_rate>0)
@@ -1020,51 +1497,39 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
    if (effEnd > st->mode->effEBands)
       effEnd = st->mode->effEBands;
 
-   ALLOC(in, CC*(N+st->overlap), celt_sig);
-
    /* Find pitch period and gain */
    {
+#ifdef ENABLE_POSTFILTER
       VARDECL(celt_sig, _pre);
+      VARDECL(celt_word16, pitch_buf);
       celt_sig *pre[2];
+      int do_pitch;
+#endif
       SAVE_STACK;
+#ifdef ENABLE_POSTFILTER
       ALLOC(_pre, CC*(N+COMBFILTER_MAXPERIOD), celt_sig);
 
       pre[0] = _pre;
       pre[1] = _pre + (N+COMBFILTER_MAXPERIOD);
+      ALLOC(pitch_buf, (COMBFILTER_MAXPERIOD+N)>>1, celt_word16);
+      do_pitch = nbAvailableBytes>12*C && st->start==0 && !st->disable_pf && st->complexity >= 5
+            && st->analysis_level > CELT_ANALYSIS_NO_PITCH;
+#endif
 
+      PROFILE_LAP(&st->profile, CELT_PROFILE_OTHER);
       silence = 1;
       c=0; do {
-         int count = 0;
-         const celt_word16 * restrict pcmp = pcm+c;
-         celt_sig * restrict inp = in+c*(N+st->overlap)+st->overlap;
-
-         for (i=0;i<N;i++)
-         {
-            celt_sig x, tmp;
-
-            x = SCALEIN(*pcmp);
-#ifndef FIXED_POINT
-            if (st->clip)
-               x = MAX32(-65536.f, MIN32(65536.f,x));
-#endif
-            if (++count==st->upsample)
-            {
-               count=0;
-               pcmp+=CC;
-            } else {
-               x = 0;
-            }
-            /* Apply pre-emphasis */
-            tmp = MULT16_16(st->mode->preemph[2], x);
-            *inp = tmp + st->preemph_memE[c];
-            st->preemph_memE[c] = MULT16_32_Q15(st->mode->preemph[1], *inp)
-                                   - MULT16_32_Q15(st->mode->preemph[0], tmp);
-            silence = silence && *inp == 0;
-            inp++;
-         }
+#ifdef ENABLE_POSTFILTER
+         /* The prefilter writes in[] from pre[] */
          CELT_COPY(pre[c], prefilter_mem+c*COMBFILTER_MAXPERIOD, COMBFILTER_MAXPERIOD);
-         CELT_COPY(pre[c]+COMBFILTER_MAXPERIOD, in+c*(N+st->overlap)+st->overlap, N);
+         silence = preemphasis(st, pcm+c, pre[c]+COMBFILTER_MAXPERIOD,
+               do_pitch ? pitch_buf : NULL, N, c, CC) && silence;
+#else
+         silence = preemphasis(st, pcm+c, in+c*(N+st->overlap)+st->overlap,
+               NULL, N, c, CC) && silence;
+#endif
       } while (++c<CC);
+      PROFILE_LAP(&st->profile, CELT_PROFILE_PREEMPHASIS);
 
       if (tell==1)
          ec_enc_bit_logp(enc, silence, 15);
@@ -1086,15 +1551,21 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
          enc->nbits_total+=tell-ec_tell(enc);
       }
 #ifdef ENABLE_POSTFILTER
-      if (nbAvailableBytes>12*C && st->start==0 && !silence && !st->disable_pf && st->complexity >= 5)
+      if (do_pitch && !silence)
       {
-         VARDECL(celt_word16, pitch_buf);
-         ALLOC(pitch_buf, (COMBFILTER_MAXPERIOD+N)>>1, celt_word16);
-
-         pitch_downsample(pre, pitch_buf, COMBFILTER_MAXPERIOD+N, CC);
-         pitch_search(pitch_buf+(COMBFILTER_MAXPERIOD>>1), pitch_buf, N,
-               COMBFILTER_MAXPERIOD-COMBFILTER_MINPERIOD, &pitch_index);
-         pitch_index = COMBFILTER_MAXPERIOD-pitch_index;
+         BUDGET_STAGE_START(&st->budget);
+         /* The new half was decimated by preemphasis() */
+         pitch_downsample_from(pre, pitch_buf, COMBFILTER_MAXPERIOD+N,
+               COMBFILTER_MAXPERIOD>>1, CC);
+         if (st->pitch_hint>0)
+         {
+            /* celt_encoder_pitch_analysis() already did the search */
+            pitch_index = st->pitch_hint;
+         } else {
+            pitch_search(pitch_buf+(COMBFILTER_MAXPERIOD>>1), pitch_buf, N,
+                  COMBFILTER_MAXPERIOD-COMBFILTER_MINPERIOD, &pitch_index);
+            pitch_index = COMBFILTER_MAXPERIOD-pitch_index;
+         }
 
          gain1 = remove_doubling(pitch_buf, COMBFILTER_MAXPERIOD, COMBFILTER_MINPERIOD,
                N, &pitch_index, st->prefilter_period, st->prefilter_gain);
@@ -1102,9 +1573,11 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
             pitch_index = COMBFILTER_MAXPERIOD-2;
          gain1 = MULT16_16_Q15(QCONST16(.7f,15),gain1);
          prefilter_tapset = st->tapset_decision;
+         BUDGET_STAGE_END(&st->budget, BUDGET_PITCH);
       } else {
          gain1 = 0;
       }
+      st->pitch_hint = 0;
 
       /* Gain threshold for enabling the prefilter/postfilter */
       pf_threshold = QCONST16(.2f,15);
@@ -1182,25 +1655,59 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
          CELT_COPY(st->in_mem+c*(st->overlap), in+c*(N+st->overlap)+N, st->overlap);
 
 #ifdef ENABLE_POSTFILTER
-         if (N>COMBFILTER_MAXPERIOD)
-         {
-            CELT_MOVE(prefilter_mem+c*COMBFILTER_MAXPERIOD, pre[c]+N, COMBFILTER_MAXPERIOD);
-         } else {
-            CELT_MOVE(prefilter_mem+c*COMBFILTER_MAXPERIOD, prefilter_mem+c*COMBFILTER_MAXPERIOD+N, COMBFILTER_MAXPERIOD-N);
-            CELT_MOVE(prefilter_mem+c*COMBFILTER_MAXPERIOD+COMBFILTER_MAXPERIOD-N, pre[c]+COMBFILTER_MAXPERIOD, N);
-         }
+         update_prefilter_mem(prefilter_mem+c*COMBFILTER_MAXPERIOD, pre[c], N);
 #endif /* ENABLE_POSTFILTER */
       } while (++c<CC);
 
       RESTORE_STACK;
    }
+   PROFILE_LAP(&st->profile, CELT_PROFILE_PITCH);
+
+   fr->pcm = pcm;
+   fr->enc = enc;
+   fr->LM = LM;
+   fr->M = M;
+   fr->N = N;
+   fr->effEnd = effEnd;
+   fr->nbCompressedBytes = nbCompressedBytes;
+   fr->nbFilledBytes = nbFilledBytes;
+   fr->nbAvailableBytes = nbAvailableBytes;
+   fr->effectiveBytes = effectiveBytes;
+   fr->vbr_rate = vbr_rate;
+   fr->total_bits = total_bits;
+   fr->silence = silence;
+   fr->pitch_index = pitch_index;
+   fr->gain1 = gain1;
+   fr->prefilter_tapset = prefilter_tapset;
+   fr->pf_on = pf_on;
+   BUDGET_FRAME_PAUSE(&st->budget);
+   return CELT_OK;
+}
 
-#ifdef RESYNTH
-   resynth = 1;
-#else
-   resynth = 0;
-#endif
+/* Decides on short blocks, then computes the MDCTs, the band energies and
+   the normalised bands */
+static void encode_frame_analysis(CELTEncoder * restrict st, EncodedFrame *fr)
+{
+   int i, c;
+   VARDECL(celt_sig, freq);
+   celt_sig *in = fr->in;
+   celt_norm *X = fr->X;
+   celt_ener *bandE = fr->bandE;
+   celt_word16 *bandLogE = fr->bandLogE;
+   ec_enc *enc = fr->enc;
+   const int CC = CHANNELS(st->channels);
+   const int C = CHANNELS(st->stream_channels);
+   const int LM = fr->LM;
+   const int M = fr->M;
+   const int N = fr->N;
+   const int effEnd = fr->effEnd;
+   const celt_int32 total_bits = fr->total_bits;
+   int isTransient;
+   int shortBlocks;
+   SAVE_STACK;
 
+   PROFILE_START(&st->profile);
+   BUDGET_FRAME_RESUME(&st->budget);
    isTransient = 0;
    shortBlocks = 0;
    if (LM>0 && ec_tell(enc)+3<=total_bits)
@@ -1214,12 +1721,11 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
       }
       ec_enc_bit_logp(enc, isTransient, 3);
    }
+   PROFILE_LAP(&st->profile, CELT_PROFILE_TRANSIENT);
 
    ALLOC(freq, CC*N, celt_sig); /**< Interleaved signal MDCTs */
-   ALLOC(bandE,st->mode->nbEBands*CC, celt_ener);
-   ALLOC(bandLogE,st->mode->nbEBands*CC, celt_word16);
    /* Compute MDCTs */
-   compute_mdcts(st->mode, shortBlocks, in, freq, CC, LM);
+   compute_mdcts(st->mode, shortBlocks, in, freq, CC, LM, N/st->upsample);
 
    if (CC==2&&C==1)
    {
@@ -1237,7 +1743,7 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
             freq[c*N+i] = 0;
       } while (++c<C);
    }
-   ALLOC(X, C*N, celt_norm);         /**< Interleaved normalised MDCTs */
+   PROFILE_LAP(&st->profile, CELT_PROFILE_MDCT);
 
    compute_band_energies(st->mode, freq, bandE, effEnd, C, M);
 
@@ -1245,20 +1751,114 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
 
    /* Band normalisation */
    normalise_bands(st->mode, freq, X, bandE, effEnd, C, M);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
+
+   fr->isTransient = isTransient;
+   fr->shortBlocks = shortBlocks;
+   BUDGET_FRAME_PAUSE(&st->budget);
+   RESTORE_STACK;
+}
+
+/* Codes the energies, the allocation and the bands, and updates the state.
+   Returns what celt_encode() returns. */
+static int encode_frame_quant(CELTEncoder * restrict st, EncodedFrame *fr)
+{
+   int i, c;
+   celt_int32 bits;
+   VARDECL(int, fine_quant);
+   VARDECL(celt_word16, error);
+   VARDECL(int, pulses);
+   VARDECL(int, cap);
+   VARDECL(int, offsets);
+   VARDECL(int, fine_priority);
+   VARDECL(int, tf_res);
+   VARDECL(unsigned char, collapse_masks);
+#ifdef RESYNTH
+   celt_sig *_overlap_mem;
+#endif
+   celt_word16 *oldBandE, *oldLogE, *oldLogE2;
+   EncoderLayout layout;
+   celt_norm *X = fr->X;
+   celt_ener *bandE = fr->bandE;
+   celt_word16 *bandLogE = fr->bandLogE;
+   ec_enc *enc = fr->enc;
+   const int shortBlocks = fr->shortBlocks;
+   const int isTransient = fr->isTransient;
+   int resynth;
+   const int CC = CHANNELS(st->channels);
+   const int C = CHANNELS(st->stream_channels);
+   const int LM = fr->LM;
+   const int M = fr->M;
+   const int N = fr->N;
+   const int effEnd = fr->effEnd;
+   int tf_select;
+   const int nbFilledBytes = fr->nbFilledBytes;
+   int nbCompressedBytes = fr->nbCompressedBytes;
+   int nbAvailableBytes = fr->nbAvailableBytes;
+   int codedBands;
+   int tf_sum;
+   int alloc_trim;
+   const int pitch_index = fr->pitch_index;
+   const celt_word16 gain1 = fr->gain1;
+   int intensity=0;
+   int dual_stereo=0;
+   const int effectiveBytes = fr->effectiveBytes;
+   int dynalloc_logp;
+   const celt_int32 vbr_rate = fr->vbr_rate;
+   celt_int32 total_bits = fr->total_bits;
+   celt_int32 total_boost;
+   celt_int32 balance;
+   celt_int32 tell;
+   const int prefilter_tapset = fr->prefilter_tapset;
+   const int pf_on = fr->pf_on;
+   int anti_collapse_rsv;
+   int anti_collapse_on=0;
+   const int silence = fr->silence;
+   SAVE_STACK;
+
+   PROFILE_START(&st->profile);
+   BUDGET_FRAME_RESUME(&st->budget);
+   encoder_layout(st->mode, CC, &layout);
+#ifdef RESYNTH
+   _overlap_mem = STATE_ARRAY(st, layout.overlap_mem, celt_sig);
+#endif
+   oldBandE = STATE_ARRAY(st, layout.oldBandE, celt_word16);
+   oldLogE = STATE_ARRAY(st, layout.oldLogE, celt_word16);
+   oldLogE2 = STATE_ARRAY(st, layout.oldLogE2, celt_word16);
+
+#ifdef RESYNTH
+   resynth = 1;
+#else
+   resynth = 0;
+#endif
 
    ALLOC(tf_res, st->mode->nbEBands, int);
    /* Needs to be before coarse energy quantization because otherwise the energy gets modified */
-   tf_select = tf_analysis(st->mode, bandLogE, oldBandE, effEnd, C, isTransient, tf_res, effectiveBytes, X, N, LM, &tf_sum);
+   if (st->analysis_level > CELT_ANALYSIS_NO_TF)
+   {
+      BUDGET_STAGE_START(&st->budget);
+      tf_select = tf_analysis(st->mode, bandLogE, oldBandE, effEnd, C, isTransient, tf_res, effectiveBytes, X, N, LM, &tf_sum);
+      BUDGET_STAGE_END(&st->budget, BUDGET_TF);
+   } else {
+      /* What tf_analysis() does at low rates */
+      tf_select = 0;
+      tf_sum = 0;
+      for (i=0;i<effEnd;i++)
+         tf_res[i] = isTransient;
+   }
    for (i=effEnd;i<st->end;i++)
       tf_res[i] = tf_res[effEnd-1];
+   PROFILE_LAP(&st->profile, CELT_PROFILE_TF);
 
    ALLOC(error, C*st->mode->nbEBands, celt_word16);
    quant_coarse_energy(st->mode, st->start, st->end, effEnd, bandLogE,
          oldBandE, total_bits, error, enc,
          C, LM, nbAvailableBytes, st->force_intra,
          &st->delayedIntra, st->complexity >= 4);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
 
    tf_encode(st->start, st->end, isTransient, tf_res, LM, tf_select, enc);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_TF);
 
    st->spread_decision = SPREAD_NORMAL;
    if (ec_tell(enc)+4<=total_bits)
@@ -1344,8 +1944,13 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
    alloc_trim = 5;
    if (tell+(6<<BITRES) <= total_bits - total_boost)
    {
-      alloc_trim = alloc_trim_analysis(st->mode, X, bandLogE,
-            st->end, LM, C, N);
+      if (st->analysis_level > CELT_ANALYSIS_NO_TRIM)
+      {
+         BUDGET_STAGE_START(&st->budget);
+         alloc_trim = alloc_trim_analysis(st->mode, X, bandLogE,
+               st->end, LM, C, N);
+         BUDGET_STAGE_END(&st->budget, BUDGET_TRIM);
+      }
       ec_enc_icdf(enc, alloc_trim, trim_icdf, 7);
       tell = ec_tell_frac(enc);
    }
@@ -1359,20 +1964,30 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
      celt_int32 target;
      celt_int32 min_allowed;
 
-     target = vbr_rate + st->vbr_offset - ((40*C+20)<<BITRES);
-
-     /* Shortblocks get a large boost in bitrate, but since they
-        are uncommon long blocks are not greatly affected */
-     if (shortBlocks || tf_sum < -2*(st->end-st->start))
-        target = 7*target/4;
-     else if (tf_sum < -(st->end-st->start))
-        target = 3*target/2;
-     else if (M > 1)
-        target-=(target+14)/28;
-
-     /* The current offset is removed from the target and the space used
-        so far is added*/
-     target=target+tell;
+     if (st->frame_target>0)
+     {
+        /* A second pass planned the whole frame, side information included */
+        target = st->frame_target<<BITRES;
+     } else {
+        target = vbr_rate + st->vbr_offset - ((40*C+20)<<BITRES);
+
+        /* Shortblocks get a large boost in bitrate, but since they
+           are uncommon long blocks are not greatly affected */
+        if (shortBlocks || tf_sum < -2*(st->end-st->start))
+           target = 7*target/4;
+        else if (tf_sum < -(st->end-st->start))
+           target = 3*target/2;
+        else if (M > 1)
+           target-=(target+14)/28;
+
+        /* Transients coming up take some of this frame's bits */
+        if (st->vbr_lookahead>0 && st->lookahead_count>st->vbr_lookahead)
+           target = target*lookahead_scale(st)>>12;
+
+        /* The current offset is removed from the target and the space used
+           so far is added*/
+        target=target+tell;
+     }
 
      /* In VBR mode the frame size must not be reduced so much that it would
          result in the encoder running out of bits.
@@ -1406,9 +2021,13 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
         st->vbr_reservoir += target - vbr_rate;
      /*printf ("%d\n", st->vbr_reservoir);*/
 
-     /* Compute the offset we need to apply in order to reach the target */
-     st->vbr_drift += (celt_int32)MULT16_32_Q15(alpha,delta-st->vbr_offset-st->vbr_drift);
-     st->vbr_offset = -st->vbr_drift;
+     /* Compute the offset we need to apply in order to reach the target,
+        unless the second pass keeps track of it */
+     if (st->frame_target==0)
+     {
+        st->vbr_drift += (celt_int32)MULT16_32_Q15(alpha,delta-st->vbr_offset-st->vbr_drift);
+        st->vbr_offset = -st->vbr_drift;
+     }
      /*printf ("%d\n", st->vbr_drift);*/
 
      if (st->constrained_vbr && st->vbr_reservoir < 0)
@@ -1424,13 +2043,24 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
      /* This moves the raw bits to take into account the new compressed size */
      ec_enc_shrink(enc, nbCompressedBytes);
    }
+   st->frame_target = 0;
+   if (st->lookahead_count>0)
+   {
+      /* The next frame of the window becomes the current one */
+      st->lookahead_count--;
+      CELT_MOVE(st->lookahead_transient, st->lookahead_transient+1, st->lookahead_count);
+   }
    if (C==2)
    {
       int effectiveRate;
 
       /* Always use MS for 2.5 ms frames until we can do a better analysis */
-      if (LM!=0)
+      if (LM!=0 && st->analysis_level > CELT_ANALYSIS_NO_STEREO)
+      {
+         BUDGET_STAGE_START(&st->budget);
          dual_stereo = stereo_analysis(st->mode, X, LM, N);
+         BUDGET_STAGE_END(&st->budget, BUDGET_STEREO);
+      }
 
       /* Account for coarse energy */
       effectiveRate = (8*effectiveBytes - 80)>>LM;
@@ -1467,8 +2097,10 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
          alloc_trim, &intensity, &dual_stereo, bits, &balance, pulses,
          fine_quant, fine_priority, C, LM, enc, 1, st->lastCodedBands);
    st->lastCodedBands = codedBands;
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ALLOCATION);
 
    quant_fine_energy(st->mode, st->start, st->end, oldBandE, error, fine_quant, enc, C);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
 
 #ifdef MEASURE_NORM_MSE
    float X0[3000];
@@ -1486,6 +2118,7 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
    quant_all_bands(1, st->mode, st->start, st->end, X, C==2 ? X+N : NULL, collapse_masks,
          bandE, pulses, shortBlocks, st->spread_decision, dual_stereo, intensity, tf_res, resynth,
          nbCompressedBytes*(8<<BITRES)-anti_collapse_rsv, balance, enc, LM, codedBands, &st->rng);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_BANDS);
 
    if (anti_collapse_rsv > 0)
    {
@@ -1493,6 +2126,7 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
       ec_enc_bits(enc, anti_collapse_on, 1);
    }
    quant_energy_finalise(st->mode, st->start, st->end, oldBandE, error, fine_quant, fine_priority, nbCompressedBytes*8-ec_tell(enc), enc, C);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
 
    if (silence)
    {
@@ -1506,7 +2140,9 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
    {
       celt_sig *out_mem[2];
       celt_sig *overlap_mem[2];
+      VARDECL(celt_sig, freq);
 
+      ALLOC(freq, CC*N, celt_sig);
       log2Amp(st->mode, st->start, st->end, bandE, oldBandE, C);
       if (silence)
       {
@@ -1553,7 +2189,8 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
          overlap_mem[c] = _overlap_mem + c*st->overlap;
       while (++c<CC);
 
-      compute_inv_mdcts(st->mode, shortBlocks, freq, out_mem, overlap_mem, CC, LM);
+      compute_inv_mdcts(st->mode, shortBlocks, freq, out_mem, overlap_mem, CC, LM,
+            M*st->mode->eBands[st->end]);
 
 #ifdef ENABLE_POSTFILTER
       c=0; do {
@@ -1569,7 +2206,7 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
       } while (++c<CC);
 #endif /* ENABLE_POSTFILTER */
 
-      deemphasis(out_mem, (celt_word16*)pcm, N, CC, st->upsample, st->mode->preemph, st->preemph_memD);
+      deemphasis(out_mem, (celt_word16*)fr->pcm, N, CC, st->upsample, st->mode->preemph, st->preemph_memD);
       st->prefilter_period_old = st->prefilter_period;
       st->prefilter_gain_old = st->prefilter_gain;
       st->prefilter_tapset_old = st->prefilter_tapset;
@@ -1624,6 +2261,8 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
    if (st->signalling)
       nbCompressedBytes++;
 
+   PROFILE_END(&st->profile);
+   BUDGET_FRAME_END(&st->budget);
    RESTORE_STACK;
    if (ec_get_error(enc))
       return CELT_CORRUPTED_DATA;
@@ -1631,30 +2270,104 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, i
       return nbCompressedBytes;
 }
 
+#ifdef FIXED_POINT
+CELT_STATIC
+int celt_encode_with_ec(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
+{
+#else
+CELT_STATIC
+int celt_encode_with_ec_float(CELTEncoder * restrict st, const celt_sig * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
+{
+#endif
+   int ret;
+   EncodedFrame fr;
+   VARDECL(celt_sig, in);
+   VARDECL(celt_norm, X);
+   VARDECL(celt_ener, bandE);
+   VARDECL(celt_word16, bandLogE);
+   const int CC = CHANNELS(st->channels);
+   const int N = st->mode->shortMdctSize*st->mode->nbShortMdcts;
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL)
+     return CELT_BAD_ARG;
+
+   ALLOC(in, CC*(N+st->overlap), celt_sig);
+   ALLOC(X, CC*N, celt_norm);         /**< Interleaved normalised MDCTs */
+   ALLOC(bandE,st->mode->nbEBands*CC, celt_ener);
+   ALLOC(bandLogE,st->mode->nbEBands*CC, celt_word16);
+   encoded_frame_arrays(&fr, in, X, bandE, bandLogE);
+
+   ret = encode_frame_start(st, &fr, pcm, frame_size, compressed, nbCompressedBytes, enc);
+   if (ret == CELT_OK)
+   {
+      encode_frame_analysis(st, &fr);
+      ret = encode_frame_quant(st, &fr);
+   }
+   RESTORE_STACK;
+   return ret;
+}
+
+#if !defined(FIXED_POINT) || !defined(DISABLE_FLOAT_API)
+/* Size of in[] for converting a frame from the other format: the VBR
+   look-ahead frames need the overlap before them */
+static int converted_input_size(const CELTEncoder *st, int frame_size)
+{
+   int h = st->vbr && st->vbr_lookahead>0 ? st->overlap/st->upsample : 0;
+   return CHANNELS(st->channels)*(frame_size+h);
+}
+#endif
+
 #ifdef FIXED_POINT
 #ifndef DISABLE_FLOAT_API
+/* Converts the frame at pcm to in[], after converting and analysing the
+   VBR look-ahead frames that follow it */
+static void convert_input(CELTEncoder * restrict st, const float * pcm, int frame_size, celt_int16 *in)
+{
+   int j, k;
+   const int C = CHANNELS(st->channels);
+   const int N = frame_size;
+   if (st->vbr && st->vbr_lookahead>0)
+   {
+      int h = st->overlap/st->upsample;
+      /* The next frames are converted and analysed one at a time, with
+         the input before them for their overlap */
+      for (k=lookahead_start(st, frame_size);k<=st->vbr_lookahead;k++)
+      {
+         int first = k>0 ? h : 0;
+         for (j=0;j<C*(N+first);j++)
+            in[j] = FLOAT2INT16(pcm[(k*N-first)*C+j]);
+         lookahead_analyse(st, in+first*C, frame_size, k);
+      }
+      st->lookahead_count = st->vbr_lookahead+1;
+   }
+
+   for (j=0;j<C*N;j++)
+     in[j] = FLOAT2INT16(pcm[j]);
+}
+
 CELT_STATIC
 int celt_encode_with_ec_float(CELTEncoder * restrict st, const float * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
 {
-   int j, ret, C, N;
+   int ret;
    VARDECL(celt_int16, in);
-   ALLOC_STACK;
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
    SAVE_STACK;
 
    if (pcm==NULL)
       return CELT_BAD_ARG;
 
-   C = CHANNELS(st->channels);
-   N = frame_size;
-   ALLOC(in, C*N, celt_int16);
-
-   for (j=0;j<C*N;j++)
-     in[j] = FLOAT2INT16(pcm[j]);
+   ALLOC(in, converted_input_size(st, frame_size), celt_int16);
+   convert_input(st, pcm, frame_size, in);
 
    ret=celt_encode_with_ec(st,in,frame_size,compressed,nbCompressedBytes, enc);
 #ifdef RESYNTH
-   for (j=0;j<C*N;j++)
-      ((float*)pcm)[j]=in[j]*(1.f/32768.f);
+   {
+      int j;
+      for (j=0;j<CHANNELS(st->channels)*frame_size;j++)
+         ((float*)pcm)[j]=in[j]*(1.f/32768.f);
+   }
 #endif
    RESTORE_STACK;
    return ret;
@@ -1662,28 +2375,53 @@ int celt_encode_with_ec_float(CELTEncoder * restrict st, const float * pcm, int
 }
 #endif /*DISABLE_FLOAT_API*/
 #else
+/* Converts the frame at pcm to in[], after converting and analysing the
+   VBR look-ahead frames that follow it */
+static void convert_input(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, celt_sig *in)
+{
+   int j, k;
+   const int C = CHANNELS(st->channels);
+   const int N = frame_size;
+   if (st->vbr && st->vbr_lookahead>0)
+   {
+      int h = st->overlap/st->upsample;
+      /* The next frames are converted and analysed one at a time, with
+         the input before them for their overlap */
+      for (k=lookahead_start(st, frame_size);k<=st->vbr_lookahead;k++)
+      {
+         int first = k>0 ? h : 0;
+         for (j=0;j<C*(N+first);j++)
+            in[j] = SCALEOUT(pcm[(k*N-first)*C+j]);
+         lookahead_analyse(st, in+first*C, frame_size, k);
+      }
+      st->lookahead_count = st->vbr_lookahead+1;
+   }
+   for (j=0;j<C*N;j++) {
+     in[j] = SCALEOUT(pcm[j]);
+   }
+}
+
 CELT_STATIC
 int celt_encode_with_ec(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, ec_enc *enc)
 {
-   int j, ret, C, N;
+   int ret;
    VARDECL(celt_sig, in);
-   ALLOC_STACK;
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
    SAVE_STACK;
 
    if (pcm==NULL)
       return CELT_BAD_ARG;
 
-   C=CHANNELS(st->channels);
-   N=frame_size;
-   ALLOC(in, C*N, celt_sig);
-   for (j=0;j<C*N;j++) {
-     in[j] = SCALEOUT(pcm[j]);
-   }
+   ALLOC(in, converted_input_size(st, frame_size), celt_sig);
+   convert_input(st, pcm, frame_size, in);
 
    ret = celt_encode_with_ec_float(st,in,frame_size,compressed,nbCompressedBytes, enc);
 #ifdef RESYNTH
-   for (j=0;j<C*N;j++)
-      ((celt_int16*)pcm)[j] = FLOAT2INT16(in[j]);
+   {
+      int j;
+      for (j=0;j<CHANNELS(st->channels)*frame_size;j++)
+         ((celt_int16*)pcm)[j] = FLOAT2INT16(in[j]);
+   }
 #endif
    RESTORE_STACK;
    return ret;
@@ -1702,64 +2440,606 @@ int celt_encode_float(CELTEncoder * restrict st, const float * pcm, int frame_si
 }
 #endif /* DISABLE_FLOAT_API */
 
-int celt_encoder_ctl(CELTEncoder * restrict st, int request, ...)
+int celt_encode_scratch(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, void *scratch, int scratch_size)
 {
-   va_list ap;
-   
-   va_start(ap, request);
-   switch (request)
+#ifdef ENABLE_SCRATCH_ARENA
+   int ret;
+   if (scratch==NULL || scratch_size < celt_encoder_get_scratch_size(st->mode, st->channels))
+      return CELT_BAD_ARG;
+   st->scratch = (char*)scratch;
+   st->scratch_size = scratch_size;
+   ret = celt_encode_with_ec(st, pcm, frame_size, compressed, nbCompressedBytes, NULL);
+   st->scratch = NULL;
+   return ret;
+#else
+   return CELT_UNIMPLEMENTED;
+#endif
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_encode_float_scratch(CELTEncoder * restrict st, const float * pcm, int frame_size, unsigned char *compressed, int nbCompressedBytes, void *scratch, int scratch_size)
+{
+#ifdef ENABLE_SCRATCH_ARENA
+   int ret;
+   if (scratch==NULL || scratch_size < celt_encoder_get_scratch_size(st->mode, st->channels))
+      return CELT_BAD_ARG;
+   st->scratch = (char*)scratch;
+   st->scratch_size = scratch_size;
+   ret = celt_encode_with_ec_float(st, pcm, frame_size, compressed, nbCompressedBytes, NULL);
+   st->scratch = NULL;
+   return ret;
+#else
+   return CELT_UNIMPLEMENTED;
+#endif
+}
+#endif /* DISABLE_FLOAT_API */
+
+/* Checks that nbCompressedBytes fit in the caller's buffer and returns where
+   the packet goes, or NULL */
+static unsigned char *encoder_buffer_payload(const CELTBuffer *buf, int nbCompressedBytes)
+{
+   if (buf==NULL || buf->data==NULL || buf->headroom<0 || buf->tailroom<0)
+      return NULL;
+   if (nbCompressedBytes > buf->size-buf->headroom-buf->tailroom)
+      return NULL;
+   return buf->data+buf->headroom;
+}
+
+/* The range coder writes forward from the start of the packet and the raw
+   bits backward from nbCompressedBytes, then moves them down when VBR
+   shrinks the packet, so the payload always ends up contiguous right after
+   the headroom */
+int celt_encode_buffer(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, CELTBuffer *buf, int nbCompressedBytes)
+{
+   int ret;
+   unsigned char *payload = encoder_buffer_payload(buf, nbCompressedBytes);
+   if (payload==NULL)
+      return CELT_BAD_ARG;
+   ret = celt_encode_with_ec(st, pcm, frame_size, payload, nbCompressedBytes, NULL);
+   if (ret>=0)
    {
-      case CELT_GET_MODE_REQUEST:
-      {
-         const CELTMode ** value = va_arg(ap, const CELTMode**);
-         if (value==0)
-            goto bad_arg;
-         *value=st->mode;
-      }
-      break;
-      case CELT_SET_COMPLEXITY_REQUEST:
-      {
-         int value = va_arg(ap, celt_int32);
-         if (value<0 || value>10)
-            goto bad_arg;
-         st->complexity = value;
-      }
-      break;
-      case CELT_SET_START_BAND_REQUEST:
-      {
-         celt_int32 value = va_arg(ap, celt_int32);
-         if (value<0 || value>=st->mode->nbEBands)
-            goto bad_arg;
-         st->start = value;
-      }
-      break;
-      case CELT_SET_END_BAND_REQUEST:
-      {
-         celt_int32 value = va_arg(ap, celt_int32);
-         if (value<1 || value>st->mode->nbEBands)
-            goto bad_arg;
-         st->end = value;
-      }
-      break;
-      case CELT_SET_PREDICTION_REQUEST:
-      {
-         int value = va_arg(ap, celt_int32);
-         if (value<0 || value>2)
-            goto bad_arg;
-         st->disable_pf = value<=1;
-         st->force_intra = value==0;
-      }
-      break;
-      case CELT_SET_VBR_CONSTRAINT_REQUEST:
-      {
-         celt_int32 value = va_arg(ap, celt_int32);
-         st->constrained_vbr = value;
-      }
-      break;
-      case CELT_SET_VBR_REQUEST:
+      buf->payload = payload;
+      buf->payload_len = ret;
+   }
+   return ret;
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_encode_buffer_float(CELTEncoder * restrict st, const float * pcm, int frame_size, CELTBuffer *buf, int nbCompressedBytes)
+{
+   int ret;
+   unsigned char *payload = encoder_buffer_payload(buf, nbCompressedBytes);
+   if (payload==NULL)
+      return CELT_BAD_ARG;
+   ret = celt_encode_with_ec_float(st, pcm, frame_size, payload, nbCompressedBytes, NULL);
+   if (ret>=0)
+   {
+      buf->payload = payload;
+      buf->payload_len = ret;
+   }
+   return ret;
+}
+#endif /* DISABLE_FLOAT_API */
+
+/* Streams that celt_encode_batch() takes through each stage together. With
+   the scratch arenas, their frames would all have to fit in the arena of
+   the first one, so they are encoded one at a time. The global pseudo-stack
+   only has room for two stereo frames at the largest frame size next to
+   what the stages allocate. With RESYNTH, the resynthesised frame of each
+   stream goes back through the one conversion buffer. */
+#if defined(ENABLE_SCRATCH_ARENA) || defined(RESYNTH)
+#define ENCODE_BATCH 1
+#elif !defined(VAR_ARRAYS) && !defined(USE_ALLOCA)
+#define ENCODE_BATCH 2
+#else
+#define ENCODE_BATCH 4
+#endif
+
+/* Encodes up to ENCODE_BATCH streams, running each stage of the encoder on
+   all of them before the next one, so that the code and the mode tables of
+   a stage are shared by the whole batch. The input comes from pcm16 or from
+   pcm_float, whichever is not NULL. */
+static void encode_batch_stages(CELTEncoder **st, const celt_int16 * const *pcm16, const float * const *pcm_float, int nb_streams, int frame_size, unsigned char **compressed, const int *nbCompressedBytes, int *nbBytes)
+{
+   int i, c, N, CC, in_size;
+   EncodedFrame fr[ENCODE_BATCH];
+   VARDECL(celt_sig, in);
+   VARDECL(celt_norm, X);
+   VARDECL(celt_ener, bandE);
+   VARDECL(celt_word16, bandLogE);
+   VARDECL(celt_word16, converted);
+   const CELTMode *mode = st[0]->mode;
+   const int nb = mode->nbEBands;
+   ALLOC_STATE_STACK(ENCODER_ARENA(st[0]), ENCODER_ARENA_SIZE(st[0]));
+   SAVE_STACK;
+
+   N = mode->shortMdctSize*mode->nbShortMdcts;
+   CC = 0;
+   for (i=0;i<nb_streams;i++)
+      CC += CHANNELS(st[i]->channels);
+   ALLOC(in, CC*(N+st[0]->overlap), celt_sig);
+   ALLOC(X, CC*N, celt_norm);
+   ALLOC(bandE, CC*nb, celt_ener);
+   ALLOC(bandLogE, CC*nb, celt_word16);
+   c = 0;
+   for (i=0;i<nb_streams;i++)
+   {
+      encoded_frame_arrays(&fr[i], in+c*(N+st[0]->overlap), X+c*N, bandE+c*nb, bandLogE+c*nb);
+      c += CHANNELS(st[i]->channels);
+   }
+   /* Input converted from the other format, which the first stage is done
+      with before the next stream needs it */
+   in_size = 1;
+#if defined(FIXED_POINT) && !defined(DISABLE_FLOAT_API)
+   if (pcm_float!=NULL)
+      for (i=0;i<nb_streams;i++)
+         in_size = IMAX(in_size, converted_input_size(st[i], frame_size));
+#elif !defined(FIXED_POINT)
+   if (pcm16!=NULL)
+      for (i=0;i<nb_streams;i++)
+         in_size = IMAX(in_size, converted_input_size(st[i], frame_size));
+#endif
+   ALLOC(converted, in_size, celt_word16);
+
+   for (i=0;i<nb_streams;i++)
+   {
+#ifdef FIXED_POINT
+      const celt_word16 *pcm = pcm16!=NULL ? pcm16[i] : converted;
+#ifndef DISABLE_FLOAT_API
+      if (pcm_float!=NULL)
+         convert_input(st[i], pcm_float[i], frame_size, converted);
+#endif
+#else
+      const celt_word16 *pcm = pcm_float!=NULL ? pcm_float[i] : converted;
+      if (pcm16!=NULL)
+         convert_input(st[i], pcm16[i], frame_size, converted);
+#endif
+      nbBytes[i] = encode_frame_start(st[i], &fr[i], pcm, frame_size,
+            compressed[i], nbCompressedBytes[i], NULL);
+   }
+   for (i=0;i<nb_streams;i++)
+      if (nbBytes[i]==CELT_OK)
+         encode_frame_analysis(st[i], &fr[i]);
+   for (i=0;i<nb_streams;i++)
+      if (nbBytes[i]==CELT_OK)
+         nbBytes[i] = encode_frame_quant(st[i], &fr[i]);
+#ifdef RESYNTH
+   for (i=0;i<CHANNELS(st[0]->channels)*frame_size;i++)
+   {
+#if defined(FIXED_POINT) && !defined(DISABLE_FLOAT_API)
+      if (pcm_float!=NULL)
+         ((float*)pcm_float[0])[i] = converted[i]*(1.f/32768.f);
+#elif !defined(FIXED_POINT)
+      if (pcm16!=NULL)
+         ((celt_int16*)pcm16[0])[i] = FLOAT2INT16(converted[i]);
+#endif
+   }
+#endif
+   RESTORE_STACK;
+}
+
+/* Checks the batch, then encodes it ENCODE_BATCH streams at a time */
+static int encode_batch(CELTEncoder **st, const celt_int16 * const *pcm16, const float * const *pcm_float, int nb_streams, int frame_size, unsigned char **compressed, const int *nbCompressedBytes, int *nbBytes)
+{
+   int i;
+   if (st==NULL || compressed==NULL || nbCompressedBytes==NULL || nbBytes==NULL || nb_streams<0)
+      return CELT_BAD_ARG;
+   for (i=0;i<nb_streams;i++)
+   {
+      if (st[i]==NULL || st[i]->mode!=st[0]->mode || compressed[i]==NULL)
+         return CELT_BAD_ARG;
+      if (pcm16!=NULL ? pcm16[i]==NULL : pcm_float[i]==NULL)
+         return CELT_BAD_ARG;
+   }
+   for (i=0;i<nb_streams;i+=ENCODE_BATCH)
+      encode_batch_stages(st+i, pcm16!=NULL ? pcm16+i : NULL,
+            pcm_float!=NULL ? pcm_float+i : NULL, IMIN(ENCODE_BATCH, nb_streams-i),
+            frame_size, compressed+i, nbCompressedBytes+i, nbBytes+i);
+   return CELT_OK;
+}
+
+int celt_encode_batch(CELTEncoder **st, const celt_int16 * const *pcm, int nb_streams, int frame_size, unsigned char **compressed, const int *nbCompressedBytes, int *nbBytes)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return encode_batch(st, pcm, NULL, nb_streams, frame_size, compressed, nbCompressedBytes, nbBytes);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_encode_batch_float(CELTEncoder **st, const float * const *pcm, int nb_streams, int frame_size, unsigned char **compressed, const int *nbCompressedBytes, int *nbBytes)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return encode_batch(st, NULL, pcm, nb_streams, frame_size, compressed, nbCompressedBytes, nbBytes);
+}
+#endif /* DISABLE_FLOAT_API */
+
+/* Open-loop pitch search of celt_encode_with_ec() on its own. Only the
+   pre-emphasis memory and the pitch history are updated, and both only
+   depend on the input. */
+static int pitch_analysis(CELTEncoder * restrict st, const celt_word16 * pcm, int frame_size, int search)
+{
+#ifdef ENABLE_POSTFILTER
+   int c, N, LM;
+   int pitch_index=0;
+   const int CC = CHANNELS(st->channels);
+   celt_sig *prefilter_mem;
+   celt_sig *pre[2];
+   EncoderLayout layout;
+   VARDECL(celt_sig, _pre);
+   VARDECL(celt_word16, pitch_buf);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   frame_size *= st->upsample;
+   for (LM=0;LM<=st->mode->maxLM;LM++)
+      if (st->mode->shortMdctSize<<LM==frame_size)
+         break;
+   if (LM>st->mode->maxLM)
+   {
+      RESTORE_STACK;
+      return CELT_BAD_ARG;
+   }
+   N = st->mode->shortMdctSize<<LM;
+   encoder_layout(st->mode, CC, &layout);
+   prefilter_mem = STATE_ARRAY(st, layout.prefilter_mem, celt_sig);
+
+   ALLOC(_pre, CC*(N+COMBFILTER_MAXPERIOD), celt_sig);
+   pre[0] = _pre;
+   pre[1] = _pre + (N+COMBFILTER_MAXPERIOD);
+   ALLOC(pitch_buf, (COMBFILTER_MAXPERIOD+N)>>1, celt_word16);
+   c=0; do {
+      CELT_COPY(pre[c], prefilter_mem+c*COMBFILTER_MAXPERIOD, COMBFILTER_MAXPERIOD);
+      preemphasis(st, pcm+c, pre[c]+COMBFILTER_MAXPERIOD, search ? pitch_buf : NULL, N, c, CC);
+   } while (++c<CC);
+
+   if (search)
+   {
+      pitch_downsample_from(pre, pitch_buf, COMBFILTER_MAXPERIOD+N,
+            COMBFILTER_MAXPERIOD>>1, CC);
+      pitch_search(pitch_buf+(COMBFILTER_MAXPERIOD>>1), pitch_buf, N,
+            COMBFILTER_MAXPERIOD-COMBFILTER_MINPERIOD, &pitch_index);
+      pitch_index = COMBFILTER_MAXPERIOD-pitch_index;
+   }
+
+   c=0; do {
+      update_prefilter_mem(prefilter_mem+c*COMBFILTER_MAXPERIOD, pre[c], N);
+   } while (++c<CC);
+   RESTORE_STACK;
+   return pitch_index;
+#else
+   return CELT_UNIMPLEMENTED;
+#endif /* ENABLE_POSTFILTER */
+}
+
+/* Analysis of celt_encode_with_ec() on its own for the first pass of a
+   two-pass encoding, without the pitch search and the prefilter, and
+   without quantising anything. The input history is updated as if the
+   frame had been coded without the prefilter, so st can't code
+   afterwards. */
+static int frame_stats(CELTEncoder * restrict st, const celt_word16 * pcm, int frame_size, CELTFrameStats *stats)
+{
+   int c, N, M, LM;
+   int effEnd;
+   int isTransient=0;
+   int tf_sum=0;
+   const int CC = CHANNELS(st->channels);
+   const int C = CHANNELS(st->stream_channels);
+   VARDECL(celt_sig, in);
+   VARDECL(celt_sig, freq);
+   VARDECL(celt_norm, X);
+   VARDECL(celt_ener, bandE);
+   VARDECL(celt_word16, bandLogE);
+   VARDECL(int, tf_res);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   LM = frame_lm(st, frame_size);
+   if (LM<0)
+   {
+      RESTORE_STACK;
+      return CELT_BAD_ARG;
+   }
+   M = 1<<LM;
+   N = M*st->mode->shortMdctSize;
+   effEnd = IMIN(st->end, st->mode->effEBands);
+
+   ALLOC(in, CC*(N+st->overlap), celt_sig);
+   c=0; do {
+      celt_sig *x = in+c*(N+st->overlap)+st->overlap;
+      history_overlap(st, x-st->overlap, c);
+      preemphasis(st, pcm+c, x, NULL, N, c, CC);
+#ifdef ENABLE_POSTFILTER
+      {
+         EncoderLayout layout;
+         celt_sig *mem;
+         encoder_layout(st->mode, CC, &layout);
+         mem = STATE_ARRAY(st, layout.prefilter_mem, celt_sig)+c*COMBFILTER_MAXPERIOD;
+         if (N>COMBFILTER_MAXPERIOD)
+         {
+            CELT_COPY(mem, x+N-COMBFILTER_MAXPERIOD, COMBFILTER_MAXPERIOD);
+         } else {
+            CELT_MOVE(mem, mem+N, COMBFILTER_MAXPERIOD-N);
+            CELT_COPY(mem+COMBFILTER_MAXPERIOD-N, x, N);
+         }
+      }
+#endif
+      CELT_COPY(st->in_mem+c*st->overlap, x+N-st->overlap, st->overlap);
+   } while (++c<CC);
+
+   if (LM>0 && st->complexity > 1)
+      isTransient = transient_analysis(in, N+st->overlap, CC, st->overlap);
+
+   ALLOC(freq, CC*N, celt_sig);
+   ALLOC(bandE, st->mode->nbEBands*CC, celt_ener);
+   ALLOC(bandLogE, st->mode->nbEBands*CC, celt_word16);
+   compute_mdcts(st->mode, isTransient ? M : 0, in, freq, CC, LM, N/st->upsample);
+   scale_mdcts(st, freq, N);
+   compute_band_energies(st->mode, freq, bandE, effEnd, C, M);
+   amp2Log2(st->mode, effEnd, st->end, bandE, bandLogE, C);
+
+   if (st->analysis_level > CELT_ANALYSIS_NO_TF)
+   {
+      /* At the bitrate, as the VBR would code the frame */
+      celt_int32 den = st->mode->Fs>>BITRES;
+      int bytes = IMIN(1275, ((st->bitrate*frame_size*st->upsample+(den>>1))/den)>>(3+BITRES));
+      ALLOC(X, C*N, celt_norm);
+      ALLOC(tf_res, st->mode->nbEBands, int);
+      normalise_bands(st->mode, freq, X, bandE, effEnd, C, M);
+      tf_analysis(st->mode, bandLogE, NULL, effEnd, C, isTransient, tf_res, bytes, X, N, LM, &tf_sum);
+   }
+   stats->demand = band_levels(st, bandLogE, LM, effEnd);
+   stats->transient = isTransient;
+   stats->tf_sum = tf_sum;
+   stats->bands = st->end-st->start;
+   RESTORE_STACK;
+   return CELT_OK;
+}
+
+#ifdef FIXED_POINT
+int celt_encoder_pitch_analysis(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, int search)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return pitch_analysis(st, pcm, frame_size, search);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_encoder_pitch_analysis_float(CELTEncoder * restrict st, const float * pcm, int frame_size, int search)
+{
+   int j, ret, C;
+   VARDECL(celt_int16, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+
+   C = CHANNELS(st->channels);
+   ALLOC(in, C*frame_size, celt_int16);
+   for (j=0;j<C*frame_size;j++)
+     in[j] = FLOAT2INT16(pcm[j]);
+   ret = pitch_analysis(st, in, frame_size, search);
+   RESTORE_STACK;
+   return ret;
+}
+#endif /* DISABLE_FLOAT_API */
+#else
+int celt_encoder_pitch_analysis(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, int search)
+{
+   int j, ret, C;
+   VARDECL(celt_sig, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+
+   C = CHANNELS(st->channels);
+   ALLOC(in, C*frame_size, celt_sig);
+   for (j=0;j<C*frame_size;j++)
+     in[j] = SCALEOUT(pcm[j]);
+   ret = pitch_analysis(st, in, frame_size, search);
+   RESTORE_STACK;
+   return ret;
+}
+
+int celt_encoder_pitch_analysis_float(CELTEncoder * restrict st, const float * pcm, int frame_size, int search)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return pitch_analysis(st, pcm, frame_size, search);
+}
+#endif /* FIXED_POINT */
+
+#ifdef FIXED_POINT
+int celt_encoder_frame_demand(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return frame_demand(st, pcm, frame_size);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_encoder_frame_demand_float(CELTEncoder * restrict st, const float * pcm, int frame_size)
+{
+   int j, ret, C;
+   VARDECL(celt_int16, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+
+   C = CHANNELS(st->channels);
+   ALLOC(in, C*frame_size, celt_int16);
+   for (j=0;j<C*frame_size;j++)
+     in[j] = FLOAT2INT16(pcm[j]);
+   ret = frame_demand(st, in, frame_size);
+   RESTORE_STACK;
+   return ret;
+}
+#endif /* DISABLE_FLOAT_API */
+#else
+int celt_encoder_frame_demand(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size)
+{
+   int j, ret, C;
+   VARDECL(celt_sig, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+
+   C = CHANNELS(st->channels);
+   ALLOC(in, C*frame_size, celt_sig);
+   for (j=0;j<C*frame_size;j++)
+     in[j] = SCALEOUT(pcm[j]);
+   ret = frame_demand(st, in, frame_size);
+   RESTORE_STACK;
+   return ret;
+}
+
+int celt_encoder_frame_demand_float(CELTEncoder * restrict st, const float * pcm, int frame_size)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return frame_demand(st, pcm, frame_size);
+}
+#endif /* FIXED_POINT */
+
+#ifdef FIXED_POINT
+int celt_encoder_frame_stats(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, CELTFrameStats *stats)
+{
+   if (pcm==NULL || stats==NULL)
+      return CELT_BAD_ARG;
+   return frame_stats(st, pcm, frame_size, stats);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_encoder_frame_stats_float(CELTEncoder * restrict st, const float * pcm, int frame_size, CELTFrameStats *stats)
+{
+   int j, ret, C;
+   VARDECL(celt_int16, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL || stats==NULL)
+      return CELT_BAD_ARG;
+
+   C = CHANNELS(st->channels);
+   ALLOC(in, C*frame_size, celt_int16);
+   for (j=0;j<C*frame_size;j++)
+     in[j] = FLOAT2INT16(pcm[j]);
+   ret = frame_stats(st, in, frame_size, stats);
+   RESTORE_STACK;
+   return ret;
+}
+#endif /* DISABLE_FLOAT_API */
+#else
+int celt_encoder_frame_stats(CELTEncoder * restrict st, const celt_int16 * pcm, int frame_size, CELTFrameStats *stats)
+{
+   int j, ret, C;
+   VARDECL(celt_sig, in);
+   ALLOC_STATE_STACK(ENCODER_ARENA(st), ENCODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL || stats==NULL)
+      return CELT_BAD_ARG;
+
+   C = CHANNELS(st->channels);
+   ALLOC(in, C*frame_size, celt_sig);
+   for (j=0;j<C*frame_size;j++)
+     in[j] = SCALEOUT(pcm[j]);
+   ret = frame_stats(st, in, frame_size, stats);
+   RESTORE_STACK;
+   return ret;
+}
+
+int celt_encoder_frame_stats_float(CELTEncoder * restrict st, const float * pcm, int frame_size, CELTFrameStats *stats)
+{
+   if (pcm==NULL || stats==NULL)
+      return CELT_BAD_ARG;
+   return frame_stats(st, pcm, frame_size, stats);
+}
+#endif /* FIXED_POINT */
+
+int celt_encoder_ctl(CELTEncoder * restrict st, int request, ...)
+{
+   va_list ap;
+   
+   va_start(ap, request);
+   switch (request)
+   {
+      case CELT_GET_MODE_REQUEST:
+      {
+         const CELTMode ** value = va_arg(ap, const CELTMode**);
+         if (value==0)
+            goto bad_arg;
+         *value=st->mode;
+      }
+      break;
+      case CELT_SET_COMPLEXITY_REQUEST:
+      {
+         int value = va_arg(ap, celt_int32);
+         if (value<0 || value>10)
+            goto bad_arg;
+         st->complexity = value;
+      }
+      break;
+      case CELT_SET_START_BAND_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<0 || value>=st->mode->nbEBands)
+            goto bad_arg;
+         st->start = value;
+      }
+      break;
+      case CELT_SET_END_BAND_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<1 || value>st->mode->nbEBands)
+            goto bad_arg;
+         st->end = value;
+      }
+      break;
+      case CELT_SET_PREDICTION_REQUEST:
+      {
+         int value = va_arg(ap, celt_int32);
+         if (value<0 || value>2)
+            goto bad_arg;
+         st->disable_pf = value<=1;
+         st->force_intra = value==0;
+      }
+      break;
+      case CELT_SET_VBR_CONSTRAINT_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         st->constrained_vbr = value;
+      }
+      break;
+      case CELT_SET_VBR_REQUEST:
       {
          celt_int32 value = va_arg(ap, celt_int32);
          st->vbr = value;
+         st->lookahead_count = 0;
+      }
+      break;
+      case CELT_SET_VBR_LOOKAHEAD_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<0 || value>CELT_MAX_VBR_LOOKAHEAD)
+            goto bad_arg;
+         st->vbr_lookahead = value;
+         st->lookahead_count = 0;
+      }
+      break;
+      case CELT_SET_FRAME_TARGET_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<0)
+            goto bad_arg;
+         st->frame_target = value;
       }
       break;
       case CELT_SET_BITRATE_REQUEST:
@@ -1785,10 +3065,18 @@ int celt_encoder_ctl(CELTEncoder * restrict st, int request, ...)
          st->signalling = value;
       }
       break;
+      case CELT_SET_PITCH_HINT_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<0 || value>COMBFILTER_MAXPERIOD)
+            goto bad_arg;
+         st->pitch_hint = value;
+      }
+      break;
       case CELT_RESET_STATE:
       {
          CELT_MEMSET((char*)&st->ENCODER_RESET_START, 0,
-               celt_encoder_get_size_custom(st->mode, st->channels)-
+               encoder_state_size(st->mode, st->channels)-
                ((char*)&st->ENCODER_RESET_START - (char*)st));
          st->vbr_offset = 0;
          st->delayedIntra = 1;
@@ -1796,12 +3084,53 @@ int celt_encoder_ctl(CELTEncoder * restrict st, int request, ...)
          st->tonal_average = QCONST16(1.f,8);
       }
       break;
+      case CELT_GET_PROFILE_REQUEST:
+      {
+         CELTProfile *value = va_arg(ap, CELTProfile*);
+         if (value==NULL)
+            goto bad_arg;
+#ifdef ENABLE_PROFILING
+         *value = st->profile.stats;
+#else
+         goto bad_request;
+#endif
+      }
+      break;
+      case CELT_RESET_PROFILE_REQUEST:
+      {
+#ifdef ENABLE_PROFILING
+         CELT_MEMSET(&st->profile, 0, 1);
+#else
+         goto bad_request;
+#endif
+      }
+      break;
       case CELT_SET_INPUT_CLIPPING_REQUEST:
       {
          celt_int32 value = va_arg(ap, celt_int32);
          st->clip = value;
       }
       break;
+      case CELT_SET_CPU_BUDGET_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<0)
+            goto bad_arg;
+#ifdef ENABLE_CPU_BUDGET
+         celt_budget_set(&st->budget, value);
+#else
+         goto bad_request;
+#endif
+      }
+      break;
+      case CELT_GET_ANALYSIS_LEVEL_REQUEST:
+      {
+         int *value = va_arg(ap, int*);
+         if (value==NULL)
+            goto bad_arg;
+         *value = st->analysis_level;
+      }
+      break;
       default:
          goto bad_request;
    }
@@ -1822,6 +3151,9 @@ bad_request:
 /**********************************************************************/
 #define DECODE_BUFFER_SIZE 2048
 
+/* Largest ratio between the rate of the mode and that of the output */
+#define MAX_SYNTHESIS_FACTOR 6
+
 /** Decoder state 
  @brief Decoder state
  */
@@ -1834,11 +3166,21 @@ struct CELTDecoder {
    int downsample;
    int start, end;
    int signalling;
+   const CELTMode *synth;    /* Mode synthesising at the output rate, or NULL */
+   celt_word16 synth_preemph[4]; /* De-emphasis at the rate of synth */
+   celt_word16 synth_taps[3][MAX_SYNTHESIS_FACTOR][5]; /* Post-filter at that rate */
+#ifdef ENABLE_PROFILING
+   CELTProfileState profile;
+#endif
+#ifdef ENABLE_SCRATCH_ARENA
+   char *scratch;            /* Caller's memory during celt_decode_scratch(), or NULL */
+   int scratch_size;
+#endif
 
    /* Everything beyond this point gets cleared on a reset */
 #define DECODER_RESET_START rng
 
-   celt_uint32 rng;
+   CACHE_ALIGNED celt_uint32 rng;
    int last_pitch_index;
    int loss_count;
    int postfilter_period;
@@ -1850,7 +3192,7 @@ struct CELTDecoder {
 
    celt_sig preemph_memD[2];
    
-   celt_sig _decode_mem[1]; /* Size = channels*(DECODE_BUFFER_SIZE+mode->overlap) */
+   CACHE_ALIGNED celt_sig _decode_mem[1]; /* Size = channels*(DECODE_BUFFER_SIZE+mode->overlap) */
    /* celt_word16 lpc[],  Size = channels*LPC_ORDER */
    /* celt_word16 oldEBands[], Size = channels*mode->nbEBands */
    /* celt_word16 oldLogE[], Size = channels*mode->nbEBands */
@@ -1858,25 +3200,99 @@ struct CELTDecoder {
    /* celt_word16 backgroundLogE[], Size = channels*mode->nbEBands */
 };
 
+/* Where the arrays after _decode_mem[] are, in bytes from the start of the state */
+typedef struct {
+   int lpc;
+   int oldBandE;
+   int oldLogE;
+   int oldLogE2;
+   int backgroundLogE;
+   int size;                 /* Of the whole state, without the scratch arena */
+} DecoderLayout;
+
+static void decoder_layout(const CELTMode *mode, int channels, DecoderLayout *l)
+{
+   int bands = channels*mode->nbEBands*sizeof(celt_word16);
+   l->lpc = STATE_ALIGN(offsetof(struct CELTDecoder, _decode_mem)
+         + channels*(DECODE_BUFFER_SIZE+mode->overlap)*sizeof(celt_sig));
+   l->oldBandE = STATE_ALIGN(l->lpc + channels*LPC_ORDER*sizeof(celt_word16));
+   l->oldLogE = STATE_ALIGN(l->oldBandE + bands);
+   l->oldLogE2 = STATE_ALIGN(l->oldLogE + bands);
+   l->backgroundLogE = STATE_ALIGN(l->oldLogE2 + bands);
+   l->size = STATE_ALIGN(l->backgroundLogE + bands);
+}
+
 int celt_decoder_get_size(int channels)
 {
    const CELTMode *mode = celt_mode_create(48000, 960, NULL);
    return celt_decoder_get_size_custom(mode, channels);
 }
 
+/* Size of the state without the scratch arena */
+static int decoder_state_size(const CELTMode *mode, int channels)
+{
+   DecoderLayout l;
+   decoder_layout(mode, channels, &l);
+   return l.size;
+}
+
+/* Worst case of one celt_decode() call, from its ALLOC()s and those of what
+   it calls at the largest frame size. A synthesis mode for a lower output
+   rate only makes the inverse MDCTs smaller. */
+int celt_decoder_get_scratch_size(const CELTMode *mode, int channels)
+{
+   int size, lost, decoded;
+   int C = channels;
+   int N = mode->shortMdctSize*mode->nbShortMdcts;
+   int nb = mode->nbEBands;
+
+   /* out[] of the conversion to the other format, then the arrays that go
+      from one stage of the decoder to the next */
+   size = SCRATCH_ITEM(C*N, celt_sig) + SCRATCH_ITEM(4*nb, int)
+         + SCRATCH_ITEM(C*N, celt_sig) + SCRATCH_ITEM(C*nb, celt_ener);
+
+   /* Concealment: either the noise, with its own spectrum, or the pitch
+      search and the LPC excitation */
+   lost = IMAX(SCRATCH_ITEM(C*N, celt_sig) + SCRATCH_ITEM(C*N, celt_norm)
+            + SCRATCH_ITEM(C*nb, celt_ener) + mdct_scratch_size(mode, N),
+         SCRATCH_ITEM(MAX_PERIOD>>1, celt_word16)
+            + IMAX(SCRATCH_ITEM(MAX_PERIOD>>3, celt_word16)
+                  + SCRATCH_ITEM(MAX_PERIOD>>2, celt_word16)
+                  + SCRATCH_ITEM(MAX_PERIOD>>1, celt_word32),
+               SCRATCH_ITEM(2*MAX_PERIOD, celt_word32)
+                  + SCRATCH_ITEM(2*MAX_PERIOD, celt_word16)
+                  + SCRATCH_ITEM(MAX_PERIOD, celt_word16)));
+
+   /* A packet: the caps and offsets with compute_allocation(), the
+      normalised bands with quant_all_bands(), or the inverse MDCTs */
+   decoded = IMAX(IMAX(6*SCRATCH_ITEM(nb, int), mdct_scratch_size(mode, N)),
+         SCRATCH_ITEM(C*N, celt_norm) + SCRATCH_ITEM(C*nb, unsigned char)
+            + bands_scratch_size(mode, C, mode->nbShortMdcts));
+
+   size += IMAX(lost, decoded);
+   return SCRATCH_SCALE*SCRATCH_ALIGN(size);
+}
+
+#ifdef ENABLE_SCRATCH_ARENA
+#define DECODER_ARENA(st) ((st)->scratch ? (st)->scratch : \
+      (char*)(st) + SCRATCH_ALIGN(decoder_state_size((st)->mode, (st)->channels)))
+#define DECODER_ARENA_SIZE(st) ((st)->scratch ? (st)->scratch_size : \
+      celt_decoder_get_scratch_size((st)->mode, (st)->channels))
+#endif /* ENABLE_SCRATCH_ARENA */
+
 int celt_decoder_get_size_custom(const CELTMode *mode, int channels)
 {
-   int size = sizeof(struct CELTDecoder)
-            + (channels*(DECODE_BUFFER_SIZE+mode->overlap)-1)*sizeof(celt_sig)
-            + channels*LPC_ORDER*sizeof(celt_word16)
-            + 4*channels*mode->nbEBands*sizeof(celt_word16);
+   int size = decoder_state_size(mode, channels);
+#ifdef ENABLE_SCRATCH_ARENA
+   size = SCRATCH_ALIGN(size) + celt_decoder_get_scratch_size(mode, channels);
+#endif
    return size;
 }
 
 CELTDecoder *celt_decoder_create(int sampling_rate, int channels, int *error)
 {
    CELTDecoder *st;
-   st = (CELTDecoder *)celt_alloc(celt_decoder_get_size(channels));
+   st = (CELTDecoder *)celt_state_alloc(celt_decoder_get_size(channels));
    if (st!=NULL && celt_decoder_init(st, sampling_rate, channels, error)==NULL)
    {
       celt_decoder_destroy(st);
@@ -1887,7 +3303,7 @@ CELTDecoder *celt_decoder_create(int sampling_rate, int channels, int *error)
 
 CELTDecoder *celt_decoder_create_custom(const CELTMode *mode, int channels, int *error)
 {
-   CELTDecoder *st = (CELTDecoder *)celt_alloc(celt_decoder_get_size_custom(mode, channels));
+   CELTDecoder *st = (CELTDecoder *)celt_state_alloc(celt_decoder_get_size_custom(mode, channels));
    if (st!=NULL && celt_decoder_init_custom(st, mode, channels, error)==NULL)
    {
       celt_decoder_destroy(st);
@@ -1945,14 +3361,169 @@ CELTDecoder *celt_decoder_init_custom(CELTDecoder *st, const CELTMode *mode, int
 
 void celt_decoder_destroy(CELTDecoder *st)
 {
-   celt_free(st);
+   celt_state_free(st);
+}
+
+/* Packs the first Ns of the N coefficients of each channel together for a
+   synthesis at a lower rate. The short blocks are interleaved, so these are
+   the low ones of every block. */
+static void keep_synthesised_bins(celt_sig *freq, int N, int Ns, int C)
+{
+   if (C==2)
+      CELT_MOVE(freq+Ns, freq+N, Ns);
+}
+
+#ifdef CUSTOM_MODES
+#ifndef M_PI
+#define M_PI 3.141592653
+#endif
+
+/* De-emphasis for the synthesis at 1/factor of the mode's rate, where the
+   mode's filter can't run. The pole is the mode's one sampled at the lower
+   rate, and the zero and the gain give the same response as the mode's
+   filter at DC and at the new Nyquist rate. */
+static void synthesis_deemphasis(const CELTMode *mode, int factor, celt_word16 *coef)
+{
+   double c0, c1, g, w, dc, ny, p, q, z;
+#ifdef FIXED_POINT
+   c0 = mode->preemph[0]/32768.;
+   c1 = mode->preemph[1]/32768.;
+   g = mode->preemph[3]/8192.;
+#else
+   c0 = mode->preemph[0];
+   c1 = mode->preemph[1];
+   g = mode->preemph[3];
+#endif
+   w = M_PI/factor;
+   dc = g*(1-c1)/(1-c0);
+   ny = g*sqrt((1-2*c1*cos(w)+c1*c1)/(1-2*c0*cos(w)+c0*c0));
+   p = pow(c0, factor);
+   q = ny*(1+p)/(dc*(1-p));
+   z = (q-1)/(q+1);
+   g = dc*(1-p)/(1-z);
+#ifdef FIXED_POINT
+   coef[0] = (celt_word16)floor(.5+32768*p);
+   coef[1] = (celt_word16)floor(.5+32768*z);
+   coef[2] = (celt_word16)floor(.5+(1<<SIG_SHIFT)/g);
+   coef[3] = (celt_word16)floor(.5+8192*g);
+#else
+   coef[0] = p;
+   coef[1] = z;
+   coef[2] = 1/g;
+   coef[3] = g;
+#endif
+}
+
+#ifdef ENABLE_POSTFILTER
+/* Taps of a comb filter at 1/factor of the mode's rate that behaves like
+   comb_filter() with a period of T at the mode's rate, for each tapset and
+   each value of T modulo factor. The filter is centred on the nearest whole
+   delay, (T+factor/2)/factor, and each tap of comb_filter() is spread over
+   the five samples around it by a Lagrange interpolation. */
+static void synthesis_taps(int factor, celt_word16 taps[][MAX_SYNTHESIS_FACTOR][5])
+{
+   int tapset, r, j, m, k;
+   for (tapset=0;tapset<3;tapset++)
+   {
+      for (r=0;r<factor;r++)
+      {
+         double t[5] = {0, 0, 0, 0, 0};
+         for (j=-2;j<=2;j++)
+         {
+            /* Where the tap j samples from the period falls from the centre */
+            double d = (double)(r+j)/factor - (r+(factor>>1))/factor;
+#ifdef FIXED_POINT
+            double g = comb_filter_gains[tapset][abs(j)]/32768.;
+#else
+            double g = comb_filter_gains[tapset][abs(j)];
+#endif
+            for (m=-2;m<=2;m++)
+            {
+               double l = g;
+               for (k=-2;k<=2;k++)
+                  if (k!=m)
+                     l *= (d-k)/(m-k);
+               t[m+2] += l;
+            }
+         }
+         for (m=0;m<5;m++)
+         {
+#ifdef FIXED_POINT
+            taps[tapset][r][m] = (celt_word16)floor(.5+32768*t[m]);
+#else
+            taps[tapset][r][m] = t[m];
+#endif
+         }
+      }
+   }
+}
+
+/* comb_filter() for periods T0 and T1 at factor times the rate of x and y,
+   with the taps from synthesis_taps() */
+static void synthesis_comb_filter(celt_word32 *y, celt_word32 *x, int T0, int T1, int N,
+      celt_word16 g0, celt_word16 g1, int tapset0, int tapset1,
+      const celt_word16 *window, int overlap, int factor,
+      const celt_word16 (*taps)[MAX_SYNTHESIS_FACTOR][5])
+{
+   int i, m;
+   celt_word16 h0[5], h1[5];
+   /* Never below 3, so that the in-place filter only ever reads samples it
+      has already written */
+   int c0 = IMAX(3, (T0+(factor>>1))/factor);
+   int c1 = IMAX(3, (T1+(factor>>1))/factor);
+   for (m=0;m<5;m++)
+   {
+      h0[m] = MULT16_16_Q15(g0, taps[tapset0][T0%factor][m]);
+      h1[m] = MULT16_16_Q15(g1, taps[tapset1][T1%factor][m]);
+   }
+   for (i=0;i<overlap;i++)
+   {
+      celt_word16 f;
+      celt_word32 sum = x[i];
+      f = MULT16_16_Q15(window[i],window[i]);
+      for (m=0;m<5;m++)
+         sum += MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),h0[m]),x[i-c0-m+2])
+              + MULT16_32_Q15(MULT16_16_Q15(f,h1[m]),x[i-c1-m+2]);
+      y[i] = sum;
+   }
+   for (;i<N;i++)
+   {
+      celt_word32 sum = x[i];
+      for (m=0;m<5;m++)
+         sum += MULT16_32_Q15(h1[m],x[i-c1-m+2]);
+      y[i] = sum;
+   }
+}
+#endif /* ENABLE_POSTFILTER */
+#endif /* CUSTOM_MODES */
+
+#ifdef ENABLE_POSTFILTER
+/* comb_filter() on the decoder's output, at the rate it is synthesised at */
+static void decoder_comb_filter(const CELTDecoder *st, celt_word32 *y, celt_word32 *x,
+      int T0, int T1, int N, celt_word16 g0, celt_word16 g1, int tapset0, int tapset1,
+      const celt_word16 *window, int overlap)
+{
+#ifdef CUSTOM_MODES
+   if (st->synth)
+   {
+      synthesis_comb_filter(y, x, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap,
+            st->downsample, (const celt_word16 (*)[MAX_SYNTHESIS_FACTOR][5])st->synth_taps);
+      return;
+   }
+#endif
+   comb_filter(y, x, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
 }
+#endif /* ENABLE_POSTFILTER */
 
 static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict pcm, int N, int LM)
 {
    int c;
    int pitch_index;
-   int overlap = st->mode->overlap;
+   /* N is the size of the coded spectrum, Ns that of the synthesis */
+   const CELTMode *syn = st->synth ? st->synth : st->mode;
+   const int factor = st->synth ? st->downsample : 1;
+   const int Ns = N/factor;
+   int overlap = syn->overlap;
    celt_word16 fade = Q15ONE;
    int i, len;
    const int C = CHANNELS(st->channels);
@@ -1960,9 +3531,9 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
    celt_sig *out_mem[2];
    celt_sig *decode_mem[2];
    celt_sig *overlap_mem[2];
-   celt_word16 *lpc;
    celt_word32 *out_syn[2];
-   celt_word16 *oldBandE, *oldLogE2, *backgroundLogE;
+   celt_word16 *backgroundLogE;
+   DecoderLayout layout;
    int plc=1;
    SAVE_STACK;
    
@@ -1971,16 +3542,17 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
       out_mem[c] = decode_mem[c]+DECODE_BUFFER_SIZE-MAX_PERIOD;
       overlap_mem[c] = decode_mem[c]+DECODE_BUFFER_SIZE;
    } while (++c<C);
-   lpc = (celt_word16*)(st->_decode_mem+(DECODE_BUFFER_SIZE+st->overlap)*C);
-   oldBandE = lpc+C*LPC_ORDER;
-   oldLogE2 = oldBandE + C*st->mode->nbEBands;
-   backgroundLogE = oldLogE2  + C*st->mode->nbEBands;
+   decoder_layout(st->mode, C, &layout);
+   /* The concealment has always taken its noise level from oldLogE2[]
+      rather than backgroundLogE[]. Kept that way so the output does not
+      change. */
+   backgroundLogE = STATE_ARRAY(st, layout.oldLogE2, celt_word16);
 
-   out_syn[0] = out_mem[0]+MAX_PERIOD-N;
+   out_syn[0] = out_mem[0]+MAX_PERIOD-Ns;
    if (C==2)
-      out_syn[1] = out_mem[1]+MAX_PERIOD-N;
+      out_syn[1] = out_mem[1]+MAX_PERIOD-Ns;
 
-   len = N+st->mode->overlap;
+   len = Ns+overlap;
    
    if (st->loss_count >= 5)
    {
@@ -1988,6 +3560,8 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
       VARDECL(celt_norm, X);
       VARDECL(celt_ener, bandE);
       celt_uint32 seed;
+      /* Only the bands that get synthesised */
+      int end = nyquist_end_band(st->mode, factor);
 
       ALLOC(freq, C*N, celt_sig); /**< Interleaved signal MDCTs */
       ALLOC(X, C*N, celt_norm);   /**< Interleaved normalised MDCTs */
@@ -1998,7 +3572,7 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
       seed = st->rng;
       for (c=0;c<C;c++)
       {
-         for (i=0;i<st->mode->effEBands;i++)
+         for (i=0;i<end;i++)
          {
             int j;
             int boffs;
@@ -2015,14 +3589,18 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
       }
       st->rng = seed;
 
-      denormalise_bands(st->mode, X, freq, bandE, st->mode->effEBands, C, 1<<LM);
+      denormalise_bands(st->mode, X, freq, bandE, end, C, 1<<LM);
+      if (factor!=1)
+         keep_synthesised_bins(freq, N, Ns, C);
 
-      compute_inv_mdcts(st->mode, 0, freq, out_syn, overlap_mem, C, LM);
+      compute_inv_mdcts(syn, 0, freq, out_syn, overlap_mem, C, LM,
+            IMIN(st->mode->eBands[end]<<LM, Ns));
       plc = 0;
    } else if (st->loss_count == 0)
    {
-      celt_word16 pitch_buf[MAX_PERIOD>>1];
+      VARDECL(celt_word16, pitch_buf);
       int len2 = len;
+      ALLOC(pitch_buf, MAX_PERIOD>>1, celt_word16);
       /* FIXME: This is a kludge */
       if (len2>MAX_PERIOD>>1)
          len2 = MAX_PERIOD>>1;
@@ -2038,10 +3616,14 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
 
    if (plc)
    {
+      VARDECL(celt_word32, e);
+      VARDECL(celt_word16, exc);
+      celt_word16 *lpc;
+      lpc = STATE_ARRAY(st, layout.lpc, celt_word16);
+      /* FIXME: This is more memory than necessary */
+      ALLOC(e, 2*MAX_PERIOD, celt_word32);
+      ALLOC(exc, 2*MAX_PERIOD, celt_word16);
       c=0; do {
-         /* FIXME: This is more memory than necessary */
-         celt_word32 e[2*MAX_PERIOD];
-         celt_word16 exc[2*MAX_PERIOD];
          celt_word32 ac[LPC_ORDER+1];
          celt_word16 decay = 1;
          celt_word32 S1=0;
@@ -2053,7 +3635,7 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
 
          if (st->loss_count == 0)
          {
-            _celt_autocorr(exc, ac, st->mode->window, st->mode->overlap,
+            _celt_autocorr(exc, ac, syn->window, overlap,
                   LPC_ORDER, MAX_PERIOD);
 
             /* Noise floor -40 dB */
@@ -2098,7 +3680,7 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
          }
 
          /* Copy excitation, taking decay into account */
-         for (i=0;i<len+st->mode->overlap;i++)
+         for (i=0;i<len+overlap;i++)
          {
             celt_word16 tmp;
             if (offset+i >= MAX_PERIOD)
@@ -2112,9 +3694,9 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
          }
          for (i=0;i<LPC_ORDER;i++)
             mem[i] = ROUND16(out_mem[c][MAX_PERIOD-1-i], SIG_SHIFT);
-         for (i=0;i<len+st->mode->overlap;i++)
+         for (i=0;i<len+overlap;i++)
             e[i] = MULT16_32_Q15(fade, e[i]);
-         iir(e, lpc+c*LPC_ORDER, e, len+st->mode->overlap, LPC_ORDER, mem);
+         iir(e, lpc+c*LPC_ORDER, e, len+overlap, LPC_ORDER, mem);
 
          {
             celt_word32 S2=0;
@@ -2143,30 +3725,30 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
 
 #ifdef ENABLE_POSTFILTER
          /* Apply post-filter to the MDCT overlap of the previous frame */
-         comb_filter(out_mem[c]+MAX_PERIOD, out_mem[c]+MAX_PERIOD, st->postfilter_period, st->postfilter_period, st->overlap,
+         decoder_comb_filter(st, out_mem[c]+MAX_PERIOD, out_mem[c]+MAX_PERIOD, st->postfilter_period, st->postfilter_period, overlap,
                st->postfilter_gain, st->postfilter_gain, st->postfilter_tapset, st->postfilter_tapset,
                NULL, 0);
 #endif /* ENABLE_POSTFILTER */
 
-         for (i=0;i<MAX_PERIOD+st->mode->overlap-N;i++)
-            out_mem[c][i] = out_mem[c][N+i];
+         for (i=0;i<MAX_PERIOD+overlap-Ns;i++)
+            out_mem[c][i] = out_mem[c][Ns+i];
 
          /* Apply TDAC to the concealed audio so that it blends with the
          previous and next frames */
          for (i=0;i<overlap/2;i++)
          {
             celt_word32 tmp;
-            tmp = MULT16_32_Q15(st->mode->window[i],           e[N+overlap-1-i]) +
-                  MULT16_32_Q15(st->mode->window[overlap-i-1], e[N+i          ]);
-            out_mem[c][MAX_PERIOD+i] = MULT16_32_Q15(st->mode->window[overlap-i-1], tmp);
-            out_mem[c][MAX_PERIOD+overlap-i-1] = MULT16_32_Q15(st->mode->window[i], tmp);
+            tmp = MULT16_32_Q15(syn->window[i],           e[Ns+overlap-1-i]) +
+                  MULT16_32_Q15(syn->window[overlap-i-1], e[Ns+i          ]);
+            out_mem[c][MAX_PERIOD+i] = MULT16_32_Q15(syn->window[overlap-i-1], tmp);
+            out_mem[c][MAX_PERIOD+overlap-i-1] = MULT16_32_Q15(syn->window[i], tmp);
          }
-         for (i=0;i<N;i++)
-            out_mem[c][MAX_PERIOD-N+i] = e[i];
+         for (i=0;i<Ns;i++)
+            out_mem[c][MAX_PERIOD-Ns+i] = e[i];
 
 #ifdef ENABLE_POSTFILTER
          /* Apply pre-filter to the MDCT overlap for the next frame (post-filter will be applied then) */
-         comb_filter(e, out_mem[c]+MAX_PERIOD, st->postfilter_period, st->postfilter_period, st->overlap,
+         decoder_comb_filter(st, e, out_mem[c]+MAX_PERIOD, st->postfilter_period, st->postfilter_period, overlap,
                -st->postfilter_gain, -st->postfilter_gain, st->postfilter_tapset, st->postfilter_tapset,
                NULL, 0);
 #endif /* ENABLE_POSTFILTER */
@@ -2175,79 +3757,80 @@ static void celt_decode_lost(CELTDecoder * restrict st, celt_word16 * restrict p
       } while (++c<C);
    }
 
-   deemphasis(out_syn, pcm, N, C, st->downsample, st->mode->preemph, st->preemph_memD);
+   deemphasis(out_syn, pcm, Ns, C, st->downsample/factor,
+         st->synth ? st->synth_preemph : st->mode->preemph, st->preemph_memD);
    
    st->loss_count++;
 
    RESTORE_STACK;
 }
 
-#ifdef FIXED_POINT
-CELT_STATIC
-int celt_decode_with_ec(CELTDecoder * restrict st, const unsigned char *data, int len, celt_int16 * restrict pcm, int frame_size, ec_dec *dec)
+/* A frame on its way through the decoder: what each stage leaves to the
+   next ones. The stages are split so that celt_decode_batch() can run each
+   of them over several streams before moving on to the next. */
+typedef struct {
+   ec_dec *dec;
+   ec_dec _dec;
+   int len;
+   int frame_size;        /* At 48 kHz */
+   int lost;
+   int C, LM, M, N;
+   int effEnd;
+   int shortBlocks;
+   int isTransient;
+   int silence;
+   int spread_decision;
+   int intensity;
+   int dual_stereo;
+   int codedBands;
+   int anti_collapse_rsv;
+   celt_int32 balance;
+   int postfilter_pitch;
+   celt_word16 postfilter_gain;
+   int postfilter_tapset;
+   int *tf_res;           /* nbEBands each */
+   int *pulses;
+   int *fine_quant;
+   int *fine_priority;
+   celt_sig *freq;        /* CC*N at the largest frame size */
+   celt_ener *bandE;      /* CC*nbEBands */
+} DecodedFrame;
+
+/* Hands out the arrays of a frame: ints[] holds 4*nbEBands */
+static void decoded_frame_arrays(const CELTMode *mode, DecodedFrame *fr, int *ints, celt_sig *freq, celt_ener *bandE)
 {
-#else
-CELT_STATIC
-int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *data, int len, celt_sig * restrict pcm, int frame_size, ec_dec *dec)
+   fr->tf_res = ints;
+   fr->pulses = ints + mode->nbEBands;
+   fr->fine_quant = ints + 2*mode->nbEBands;
+   fr->fine_priority = ints + 3*mode->nbEBands;
+   fr->freq = freq;
+   fr->bandE = bandE;
+}
+
+/* Reads the header, the coarse energy, the TF resolution, the allocation
+   and the fine energy. A missing packet only marks the frame as lost. */
+static int decode_frame_header(CELTDecoder * restrict st, DecodedFrame *fr, const unsigned char *data, int len, int frame_size, ec_dec *dec)
 {
-#endif
-   int c, i, N;
-   int spread_decision;
+   int i;
    celt_int32 bits;
-   ec_dec _dec;
-   VARDECL(celt_sig, freq);
-   VARDECL(celt_norm, X);
-   VARDECL(celt_ener, bandE);
-   VARDECL(int, fine_quant);
-   VARDECL(int, pulses);
    VARDECL(int, cap);
    VARDECL(int, offsets);
-   VARDECL(int, fine_priority);
-   VARDECL(int, tf_res);
-   VARDECL(unsigned char, collapse_masks);
-   celt_sig *out_mem[2];
-   celt_sig *decode_mem[2];
-   celt_sig *overlap_mem[2];
-   celt_sig *out_syn[2];
-   celt_word16 *lpc;
-   celt_word16 *oldBandE, *oldLogE, *oldLogE2, *backgroundLogE;
-
-   int shortBlocks;
-   int isTransient;
+   celt_word16 *oldBandE;
+   DecoderLayout layout;
    int intra_ener;
    const int CC = CHANNELS(st->channels);
    int LM, M;
-   int effEnd;
-   int codedBands;
    int alloc_trim;
-   int postfilter_pitch;
-   celt_word16 postfilter_gain;
-   int intensity=0;
-   int dual_stereo=0;
    celt_int32 total_bits;
-   celt_int32 balance;
    celt_int32 tell;
    int dynalloc_logp;
-   int postfilter_tapset;
-   int anti_collapse_rsv;
-   int anti_collapse_on=0;
-   int silence;
    int C = CHANNELS(st->stream_channels);
-   ALLOC_STACK;
    SAVE_STACK;
 
    frame_size *= st->downsample;
 
-   c=0; do {
-      decode_mem[c] = st->_decode_mem + c*(DECODE_BUFFER_SIZE+st->overlap);
-      out_mem[c] = decode_mem[c]+DECODE_BUFFER_SIZE-MAX_PERIOD;
-      overlap_mem[c] = decode_mem[c]+DECODE_BUFFER_SIZE;
-   } while (++c<CC);
-   lpc = (celt_word16*)(st->_decode_mem+(DECODE_BUFFER_SIZE+st->overlap)*CC);
-   oldBandE = lpc+CC*LPC_ORDER;
-   oldLogE = oldBandE + CC*st->mode->nbEBands;
-   oldLogE2 = oldLogE + CC*st->mode->nbEBands;
-   backgroundLogE = oldLogE2  + CC*st->mode->nbEBands;
+   decoder_layout(st->mode, CC, &layout);
+   oldBandE = STATE_ARRAY(st, layout.oldBandE, celt_word16);
 
    if (st->signalling && data!=NULL)
    {
@@ -2271,43 +3854,31 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
    }
    M=1<<LM;
 
-   if (len<0 || len>1275 || pcm==NULL)
+   if (len<0 || len>1275)
       return CELT_BAD_ARG;
 
-   N = M*st->mode->shortMdctSize;
-
-   effEnd = st->end;
-   if (effEnd > st->mode->effEBands)
-      effEnd = st->mode->effEBands;
+   fr->len = len;
+   fr->frame_size = frame_size;
+   fr->C = C;
+   fr->LM = LM;
+   fr->M = M;
+   fr->N = M*st->mode->shortMdctSize;
+   PROFILE_START(&st->profile);
 
-   ALLOC(freq, CC*N, celt_sig); /**< Interleaved signal MDCTs */
-   ALLOC(X, CC*N, celt_norm);   /**< Interleaved normalised MDCTs */
-   ALLOC(bandE, st->mode->nbEBands*CC, celt_ener);
-   c=0; do
-      for (i=0;i<M*st->mode->eBands[st->start];i++)
-         X[c*N+i] = 0;
-   while (++c<CC);
-   c=0; do   
-      for (i=M*st->mode->eBands[effEnd];i<N;i++)
-         X[c*N+i] = 0;
-   while (++c<CC);
+   fr->effEnd = st->end;
+   if (fr->effEnd > st->mode->effEBands)
+      fr->effEnd = st->mode->effEBands;
 
-   if (data == NULL || len<=1)
-   {
-      celt_decode_lost(st, pcm, N, LM);
-      RESTORE_STACK;
+   fr->lost = data == NULL || len<=1;
+   if (fr->lost)
       return CELT_OK;
-   }
-   if (len<0) {
-     RESTORE_STACK;
-     return CELT_BAD_ARG;
-   }
 
    if (dec == NULL)
    {
-      ec_dec_init(&_dec,(unsigned char*)data,len);
-      dec = &_dec;
+      ec_dec_init(&fr->_dec,(unsigned char*)data,len);
+      dec = &fr->_dec;
    }
+   fr->dec = dec;
 
    if (C>CC)
    {
@@ -2323,19 +3894,19 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
    tell = ec_tell(dec);
 
    if (tell==1)
-      silence = ec_dec_bit_logp(dec, 15);
+      fr->silence = ec_dec_bit_logp(dec, 15);
    else
-      silence = 0;
-   if (silence)
+      fr->silence = 0;
+   if (fr->silence)
    {
       /* Pretend we've read all the remaining bits */
       tell = len*8;
       dec->nbits_total+=tell-ec_tell(dec);
    }
 
-   postfilter_gain = 0;
-   postfilter_pitch = 0;
-   postfilter_tapset = 0;
+   fr->postfilter_gain = 0;
+   fr->postfilter_pitch = 0;
+   fr->postfilter_tapset = 0;
    if (st->start==0 && tell+16 <= total_bits)
    {
       if(ec_dec_bit_logp(dec, 1))
@@ -2343,11 +3914,11 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
 #ifdef ENABLE_POSTFILTER
          int qg, octave;
          octave = ec_dec_uint(dec, 6);
-         postfilter_pitch = (16<<octave)+ec_dec_bits(dec, 4+octave)-1;
+         fr->postfilter_pitch = (16<<octave)+ec_dec_bits(dec, 4+octave)-1;
          qg = ec_dec_bits(dec, 3);
          if (ec_tell(dec)+2<=total_bits)
-            postfilter_tapset = ec_dec_icdf(dec, tapset_icdf, 2);
-         postfilter_gain = QCONST16(.09375f,15)*(qg+1);
+            fr->postfilter_tapset = ec_dec_icdf(dec, tapset_icdf, 2);
+         fr->postfilter_gain = QCONST16(.09375f,15)*(qg+1);
 #else /* ENABLE_POSTFILTER */
          RESTORE_STACK;
          return CELT_CORRUPTED_DATA;
@@ -2358,35 +3929,35 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
 
    if (LM > 0 && tell+3 <= total_bits)
    {
-      isTransient = ec_dec_bit_logp(dec, 3);
+      fr->isTransient = ec_dec_bit_logp(dec, 3);
       tell = ec_tell(dec);
    }
    else
-      isTransient = 0;
+      fr->isTransient = 0;
 
-   if (isTransient)
-      shortBlocks = M;
+   if (fr->isTransient)
+      fr->shortBlocks = M;
    else
-      shortBlocks = 0;
+      fr->shortBlocks = 0;
 
    /* Decode the global flags (first symbols in the stream) */
    intra_ener = tell+3<=total_bits ? ec_dec_bit_logp(dec, 3) : 0;
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ALLOCATION);
    /* Get band energies */
    unquant_coarse_energy(st->mode, st->start, st->end, oldBandE,
          intra_ener, dec, C, LM);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
 
-   ALLOC(tf_res, st->mode->nbEBands, int);
-   tf_decode(st->start, st->end, isTransient, tf_res, LM, dec);
+   tf_decode(st->start, st->end, fr->isTransient, fr->tf_res, LM, dec);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_TF);
 
    tell = ec_tell(dec);
-   spread_decision = SPREAD_NORMAL;
+   fr->spread_decision = SPREAD_NORMAL;
    if (tell+4 <= total_bits)
-      spread_decision = ec_dec_icdf(dec, spread_icdf, 5);
+      fr->spread_decision = ec_dec_icdf(dec, spread_icdf, 5);
 
-   ALLOC(pulses, st->mode->nbEBands, int);
    ALLOC(cap, st->mode->nbEBands, int);
    ALLOC(offsets, st->mode->nbEBands, int);
-   ALLOC(fine_priority, st->mode->nbEBands, int);
 
    init_caps(st->mode,cap,LM,C);
 
@@ -2421,98 +3992,195 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
          dynalloc_logp = IMAX(2, dynalloc_logp-1);
    }
 
-   ALLOC(fine_quant, st->mode->nbEBands, int);
    alloc_trim = tell+(6<<BITRES) <= total_bits ?
          ec_dec_icdf(dec, trim_icdf, 7) : 5;
 
    bits = ((celt_int32)len*8<<BITRES) - ec_tell_frac(dec) - 1;
-   anti_collapse_rsv = isTransient&&LM>=2&&bits>=(LM+2<<BITRES) ? (1<<BITRES) : 0;
-   bits -= anti_collapse_rsv;
-   codedBands = compute_allocation(st->mode, st->start, st->end, offsets, cap,
-         alloc_trim, &intensity, &dual_stereo, bits, &balance, pulses,
-         fine_quant, fine_priority, C, LM, dec, 0, 0);
-   
-   unquant_fine_energy(st->mode, st->start, st->end, oldBandE, fine_quant, dec, C);
+   fr->anti_collapse_rsv = fr->isTransient&&LM>=2&&bits>=(LM+2<<BITRES) ? (1<<BITRES) : 0;
+   bits -= fr->anti_collapse_rsv;
+   fr->intensity = 0;
+   fr->dual_stereo = 0;
+   fr->codedBands = compute_allocation(st->mode, st->start, st->end, offsets, cap,
+         alloc_trim, &fr->intensity, &fr->dual_stereo, bits, &fr->balance, fr->pulses,
+         fr->fine_quant, fr->fine_priority, C, LM, dec, 0, 0);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ALLOCATION);
+
+   unquant_fine_energy(st->mode, st->start, st->end, oldBandE, fr->fine_quant, dec, C);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
+   RESTORE_STACK;
+   return CELT_OK;
+}
+
+/* Decodes the fixed codebook and the last of the energy, then denormalises
+   the bands into freq[] */
+static void decode_frame_bands(CELTDecoder * restrict st, DecodedFrame *fr)
+{
+   int c, i;
+   VARDECL(celt_norm, X);
+   VARDECL(unsigned char, collapse_masks);
+   celt_word16 *oldBandE, *oldLogE, *oldLogE2;
+   DecoderLayout layout;
+   ec_dec *dec = fr->dec;
+   const int CC = CHANNELS(st->channels);
+   const int C = fr->C;
+   const int LM = fr->LM;
+   const int N = fr->N;
+   int anti_collapse_on=0;
+   SAVE_STACK;
+
+   if (fr->lost)
+      return;
+   PROFILE_START(&st->profile);
+
+   decoder_layout(st->mode, CC, &layout);
+   oldBandE = STATE_ARRAY(st, layout.oldBandE, celt_word16);
+   oldLogE = STATE_ARRAY(st, layout.oldLogE, celt_word16);
+   oldLogE2 = STATE_ARRAY(st, layout.oldLogE2, celt_word16);
+
+   ALLOC(X, CC*N, celt_norm);   /**< Interleaved normalised MDCTs */
+   c=0; do
+      for (i=0;i<fr->M*st->mode->eBands[st->start];i++)
+         X[c*N+i] = 0;
+   while (++c<CC);
+   c=0; do
+      for (i=fr->M*st->mode->eBands[fr->effEnd];i<N;i++)
+         X[c*N+i] = 0;
+   while (++c<CC);
 
    /* Decode fixed codebook */
    ALLOC(collapse_masks, C*st->mode->nbEBands, unsigned char);
    quant_all_bands(0, st->mode, st->start, st->end, X, C==2 ? X+N : NULL, collapse_masks,
-         NULL, pulses, shortBlocks, spread_decision, dual_stereo, intensity, tf_res, 1,
-         len*(8<<BITRES)-anti_collapse_rsv, balance, dec, LM, codedBands, &st->rng);
+         NULL, fr->pulses, fr->shortBlocks, fr->spread_decision, fr->dual_stereo, fr->intensity,
+         fr->tf_res, 1, fr->len*(8<<BITRES)-fr->anti_collapse_rsv, fr->balance, dec, LM,
+         fr->codedBands, &st->rng);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_BANDS);
 
-   if (anti_collapse_rsv > 0)
+   if (fr->anti_collapse_rsv > 0)
    {
       anti_collapse_on = ec_dec_bits(dec, 1);
    }
 
    unquant_energy_finalise(st->mode, st->start, st->end, oldBandE,
-         fine_quant, fine_priority, len*8-ec_tell(dec), dec, C);
+         fr->fine_quant, fr->fine_priority, fr->len*8-ec_tell(dec), dec, C);
 
    if (anti_collapse_on)
       anti_collapse(st->mode, X, collapse_masks, LM, C, CC, N,
-            st->start, st->end, oldBandE, oldLogE, oldLogE2, pulses, st->rng);
+            st->start, st->end, oldBandE, oldLogE, oldLogE2, fr->pulses, st->rng);
 
-   log2Amp(st->mode, st->start, st->end, bandE, oldBandE, C);
+   log2Amp(st->mode, st->start, st->end, fr->bandE, oldBandE, C);
 
-   if (silence)
+   if (fr->silence)
    {
       for (i=0;i<C*st->mode->nbEBands;i++)
       {
-         bandE[i] = 0;
+         fr->bandE[i] = 0;
          oldBandE[i] = -QCONST16(28.f,DB_SHIFT);
       }
    }
+   PROFILE_LAP(&st->profile, CELT_PROFILE_ENERGY);
    /* Synthesis */
-   denormalise_bands(st->mode, X, freq, bandE, effEnd, C, M);
+   denormalise_bands(st->mode, X, fr->freq, fr->bandE, fr->effEnd, C, fr->M);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_MDCT);
+   RESTORE_STACK;
+}
+
+/* Synthesises the frame from freq[], or conceals it, and updates the state.
+   Returns what celt_decode() returns. */
+static int decode_frame_synthesis(CELTDecoder * restrict st, DecodedFrame *fr, celt_word16 * restrict pcm)
+{
+   int c, i;
+   celt_sig *freq = fr->freq;
+   celt_sig *out_mem[2];
+   celt_sig *decode_mem[2];
+   celt_sig *overlap_mem[2];
+   celt_sig *out_syn[2];
+   celt_word16 *oldBandE, *oldLogE, *oldLogE2, *backgroundLogE;
+   DecoderLayout layout;
+   const int CC = CHANNELS(st->channels);
+   const int C = fr->C;
+   const int LM = fr->LM;
+   const int M = fr->M;
+   const int N = fr->N;
+   int bound;
+   const CELTMode *syn;
+   int factor, Ns;
+
+   PROFILE_START(&st->profile);
+   if (fr->lost)
+   {
+      celt_decode_lost(st, pcm, N, LM);
+      PROFILE_END(&st->profile);
+      return CELT_OK;
+   }
 
-   CELT_MOVE(decode_mem[0], decode_mem[0]+N, DECODE_BUFFER_SIZE-N);
+   c=0; do {
+      decode_mem[c] = st->_decode_mem + c*(DECODE_BUFFER_SIZE+st->overlap);
+      out_mem[c] = decode_mem[c]+DECODE_BUFFER_SIZE-MAX_PERIOD;
+      overlap_mem[c] = decode_mem[c]+DECODE_BUFFER_SIZE;
+   } while (++c<CC);
+   decoder_layout(st->mode, CC, &layout);
+   oldBandE = STATE_ARRAY(st, layout.oldBandE, celt_word16);
+   oldLogE = STATE_ARRAY(st, layout.oldLogE, celt_word16);
+   oldLogE2 = STATE_ARRAY(st, layout.oldLogE2, celt_word16);
+   backgroundLogE = STATE_ARRAY(st, layout.backgroundLogE, celt_word16);
+
+   /* With a synthesis mode, only the first Ns coefficients are synthesised,
+      at the output rate */
+   syn = st->synth ? st->synth : st->mode;
+   factor = st->synth ? st->downsample : 1;
+   Ns = N/factor;
+
+   CELT_MOVE(decode_mem[0], decode_mem[0]+Ns, DECODE_BUFFER_SIZE-Ns);
    if (CC==2)
-      CELT_MOVE(decode_mem[1], decode_mem[1]+N, DECODE_BUFFER_SIZE-N);
+      CELT_MOVE(decode_mem[1], decode_mem[1]+Ns, DECODE_BUFFER_SIZE-Ns);
 
    c=0; do
       for (i=0;i<M*st->mode->eBands[st->start];i++)
          freq[c*N+i] = 0;
    while (++c<C);
-   c=0; do {
-      int bound = M*st->mode->eBands[effEnd];
-      if (st->downsample!=1)
-         bound = IMIN(bound, N/st->downsample);
+   bound = M*st->mode->eBands[fr->effEnd];
+   if (st->downsample!=1)
+      bound = IMIN(bound, N/st->downsample);
+   c=0; do
       for (i=bound;i<N;i++)
          freq[c*N+i] = 0;
-   } while (++c<C);
+   while (++c<C);
+   if (factor!=1)
+      keep_synthesised_bins(freq, N, Ns, C);
 
-   out_syn[0] = out_mem[0]+MAX_PERIOD-N;
+   out_syn[0] = out_mem[0]+MAX_PERIOD-Ns;
    if (CC==2)
-      out_syn[1] = out_mem[1]+MAX_PERIOD-N;
+      out_syn[1] = out_mem[1]+MAX_PERIOD-Ns;
 
    if (CC==2&&C==1)
    {
-      for (i=0;i<N;i++)
-         freq[N+i] = freq[i];
+      for (i=0;i<Ns;i++)
+         freq[Ns+i] = freq[i];
    }
 
    /* Compute inverse MDCTs */
-   compute_inv_mdcts(st->mode, shortBlocks, freq, out_syn, overlap_mem, CC, LM);
+   compute_inv_mdcts(syn, fr->shortBlocks, freq, out_syn, overlap_mem, CC, LM, bound);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_MDCT);
 
 #ifdef ENABLE_POSTFILTER
    c=0; do {
       st->postfilter_period=IMAX(st->postfilter_period, COMBFILTER_MINPERIOD);
       st->postfilter_period_old=IMAX(st->postfilter_period_old, COMBFILTER_MINPERIOD);
-      comb_filter(out_syn[c], out_syn[c], st->postfilter_period_old, st->postfilter_period, st->mode->shortMdctSize,
+      decoder_comb_filter(st, out_syn[c], out_syn[c], st->postfilter_period_old, st->postfilter_period, syn->shortMdctSize,
             st->postfilter_gain_old, st->postfilter_gain, st->postfilter_tapset_old, st->postfilter_tapset,
-            st->mode->window, st->overlap);
+            syn->window, syn->overlap);
       if (LM!=0)
-         comb_filter(out_syn[c]+st->mode->shortMdctSize, out_syn[c]+st->mode->shortMdctSize, st->postfilter_period, postfilter_pitch, N-st->mode->shortMdctSize,
-               st->postfilter_gain, postfilter_gain, st->postfilter_tapset, postfilter_tapset,
-               st->mode->window, st->mode->overlap);
+         decoder_comb_filter(st, out_syn[c]+syn->shortMdctSize, out_syn[c]+syn->shortMdctSize, st->postfilter_period, fr->postfilter_pitch, Ns-syn->shortMdctSize,
+               st->postfilter_gain, fr->postfilter_gain, st->postfilter_tapset, fr->postfilter_tapset,
+               syn->window, syn->overlap);
 
    } while (++c<CC);
    st->postfilter_period_old = st->postfilter_period;
    st->postfilter_gain_old = st->postfilter_gain;
    st->postfilter_tapset_old = st->postfilter_tapset;
-   st->postfilter_period = postfilter_pitch;
-   st->postfilter_gain = postfilter_gain;
-   st->postfilter_tapset = postfilter_tapset;
+   st->postfilter_period = fr->postfilter_pitch;
+   st->postfilter_gain = fr->postfilter_gain;
+   st->postfilter_tapset = fr->postfilter_tapset;
    if (LM!=0)
    {
       st->postfilter_period_old = st->postfilter_period;
@@ -2520,6 +4188,7 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
       st->postfilter_tapset_old = st->postfilter_tapset;
    }
 #endif /* ENABLE_POSTFILTER */
+   PROFILE_LAP(&st->profile, CELT_PROFILE_PITCH);
 
    if (CC==2&&C==1) {
       for (i=0;i<st->mode->nbEBands;i++)
@@ -2534,7 +4203,7 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
       for (i=st->end;i<st->mode->nbEBands;i++)
          oldBandE[c*st->mode->nbEBands+i]=0;
    } while (++c<CC);
-   if (!isTransient)
+   if (!fr->isTransient)
    {
       for (i=0;i<CC*st->mode->nbEBands;i++)
          oldLogE2[i] = oldLogE[i];
@@ -2546,15 +4215,54 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
       for (i=0;i<CC*st->mode->nbEBands;i++)
          oldLogE[i] = MIN16(oldLogE[i], oldBandE[i]);
    }
-   st->rng = dec->rng;
+   st->rng = fr->dec->rng;
+   PROFILE_LAP(&st->profile, CELT_PROFILE_OTHER);
 
-   deemphasis(out_syn, pcm, N, CC, st->downsample, st->mode->preemph, st->preemph_memD);
+   deemphasis(out_syn, pcm, Ns, CC, st->downsample/factor,
+         st->synth ? st->synth_preemph : st->mode->preemph, st->preemph_memD);
+   PROFILE_LAP(&st->profile, CELT_PROFILE_PREEMPHASIS);
    st->loss_count = 0;
-   RESTORE_STACK;
-   if (ec_tell(dec) > 8*len || ec_get_error(dec))
+   PROFILE_END(&st->profile);
+   if (ec_tell(fr->dec) > 8*fr->len || ec_get_error(fr->dec))
       return CELT_CORRUPTED_DATA;
    else
-      return frame_size/st->downsample;
+      return fr->frame_size/st->downsample;
+}
+
+#ifdef FIXED_POINT
+CELT_STATIC
+int celt_decode_with_ec(CELTDecoder * restrict st, const unsigned char *data, int len, celt_int16 * restrict pcm, int frame_size, ec_dec *dec)
+{
+#else
+CELT_STATIC
+int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *data, int len, celt_sig * restrict pcm, int frame_size, ec_dec *dec)
+{
+#endif
+   int ret;
+   DecodedFrame fr;
+   VARDECL(int, ints);
+   VARDECL(celt_sig, freq);
+   VARDECL(celt_ener, bandE);
+   const int CC = CHANNELS(st->channels);
+   ALLOC_STATE_STACK(DECODER_ARENA(st), DECODER_ARENA_SIZE(st));
+   SAVE_STACK;
+
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+
+   ALLOC(ints, 4*st->mode->nbEBands, int);
+   ALLOC(freq, CC*st->mode->shortMdctSize*st->mode->nbShortMdcts, celt_sig); /**< Interleaved signal MDCTs */
+   ALLOC(bandE, st->mode->nbEBands*CC, celt_ener);
+   decoded_frame_arrays(st->mode, &fr, ints, freq, bandE);
+
+   ret = decode_frame_header(st, &fr, data, len, frame_size, dec);
+   if (ret == CELT_OK)
+   {
+      decode_frame_bands(st, &fr);
+      ret = decode_frame_synthesis(st, &fr, pcm);
+   }
+   RESTORE_STACK;
+   return ret;
 }
 
 #ifdef FIXED_POINT
@@ -2564,7 +4272,7 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
 {
    int j, ret, C, N;
    VARDECL(celt_int16, out);
-   ALLOC_STACK;
+   ALLOC_STATE_STACK(DECODER_ARENA(st), DECODER_ARENA_SIZE(st));
    SAVE_STACK;
 
    if (pcm==NULL)
@@ -2575,8 +4283,9 @@ int celt_decode_with_ec_float(CELTDecoder * restrict st, const unsigned char *da
    
    ALLOC(out, C*N, celt_int16);
    ret=celt_decode_with_ec(st, data, len, out, frame_size, dec);
-   if (ret>0)
-      for (j=0;j<C*ret;j++)
+   /* Lost packets return CELT_OK, but are concealed all the same */
+   if (ret>=0)
+      for (j=0;j<C*(ret>0 ? ret : N);j++)
          pcm[j]=out[j]*(1.f/32768.f);
      
    RESTORE_STACK;
@@ -2589,7 +4298,7 @@ int celt_decode_with_ec(CELTDecoder * restrict st, const unsigned char *data, in
 {
    int j, ret, C, N;
    VARDECL(celt_sig, out);
-   ALLOC_STACK;
+   ALLOC_STATE_STACK(DECODER_ARENA(st), DECODER_ARENA_SIZE(st));
    SAVE_STACK;
 
    if (pcm==NULL)
@@ -2601,8 +4310,9 @@ int celt_decode_with_ec(CELTDecoder * restrict st, const unsigned char *data, in
 
    ret=celt_decode_with_ec_float(st, data, len, out, frame_size, dec);
 
-   if (ret>0)
-      for (j=0;j<C*ret;j++)
+   /* Lost packets return CELT_OK, but are concealed all the same */
+   if (ret>=0)
+      for (j=0;j<C*(ret>0 ? ret : N);j++)
          pcm[j] = FLOAT2INT16 (out[j]);
    
    RESTORE_STACK;
@@ -2622,6 +4332,212 @@ int celt_decode_float(CELTDecoder * restrict st, const unsigned char *data, int
 }
 #endif /* DISABLE_FLOAT_API */
 
+int celt_decode_scratch(CELTDecoder * restrict st, const unsigned char *data, int len, celt_int16 * restrict pcm, int frame_size, void *scratch, int scratch_size)
+{
+#ifdef ENABLE_SCRATCH_ARENA
+   int ret;
+   if (scratch==NULL || scratch_size < celt_decoder_get_scratch_size(st->mode, st->channels))
+      return CELT_BAD_ARG;
+   st->scratch = (char*)scratch;
+   st->scratch_size = scratch_size;
+   ret = celt_decode_with_ec(st, data, len, pcm, frame_size, NULL);
+   st->scratch = NULL;
+   return ret;
+#else
+   return CELT_UNIMPLEMENTED;
+#endif
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_decode_float_scratch(CELTDecoder * restrict st, const unsigned char *data, int len, float * restrict pcm, int frame_size, void *scratch, int scratch_size)
+{
+#ifdef ENABLE_SCRATCH_ARENA
+   int ret;
+   if (scratch==NULL || scratch_size < celt_decoder_get_scratch_size(st->mode, st->channels))
+      return CELT_BAD_ARG;
+   st->scratch = (char*)scratch;
+   st->scratch_size = scratch_size;
+   ret = celt_decode_with_ec_float(st, data, len, pcm, frame_size, NULL);
+   st->scratch = NULL;
+   return ret;
+#else
+   return CELT_UNIMPLEMENTED;
+#endif
+}
+#endif /* DISABLE_FLOAT_API */
+
+/* Sets up the range decoder over a chain of buffers, past the TOC byte when
+   there is one, which is copied to toc. Returns the total size, or a
+   negative error code. */
+static int decoder_chain_init(CELTDecoder *st, const unsigned char * const *data, const int *len, int nb_segments, ec_dec *dec, unsigned char *toc)
+{
+   int i, total=0;
+   if (data==NULL || len==NULL || nb_segments<0)
+      return CELT_BAD_ARG;
+   for (i=0;i<nb_segments;i++)
+   {
+      if (len[i]<0 || (len[i]>0 && data[i]==NULL))
+         return CELT_BAD_ARG;
+      /* Also keeps the sum from overflowing */
+      if (len[i]>1276-total)
+         return CELT_BAD_ARG;
+      if (total==0 && len[i]>0)
+         *toc = data[i][0];
+      total += len[i];
+   }
+   ec_dec_init_chain(dec, data, len, nb_segments, st->signalling && total>0 ? 1 : 0);
+   return total;
+}
+
+int celt_decode_chain(CELTDecoder * restrict st, const unsigned char * const *data, const int *len, int nb_segments, celt_int16 * restrict pcm, int frame_size)
+{
+   ec_dec dec;
+   unsigned char toc=0;
+   int total = decoder_chain_init(st, data, len, nb_segments, &dec, &toc);
+   if (total<0)
+      return total;
+   /* Only the TOC byte is ever read from data, everything else comes from
+      the range decoder */
+   return celt_decode_with_ec(st, total>0 ? &toc : NULL, total, pcm, frame_size, &dec);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_decode_chain_float(CELTDecoder * restrict st, const unsigned char * const *data, const int *len, int nb_segments, float * restrict pcm, int frame_size)
+{
+   ec_dec dec;
+   unsigned char toc=0;
+   int total = decoder_chain_init(st, data, len, nb_segments, &dec, &toc);
+   if (total<0)
+      return total;
+   return celt_decode_with_ec_float(st, total>0 ? &toc : NULL, total, pcm, frame_size, &dec);
+}
+#endif /* DISABLE_FLOAT_API */
+
+/* Streams that celt_decode_batch() takes through each stage together. With
+   the scratch arenas, their frames would all have to fit in the arena of
+   the first one, so they are decoded one at a time. */
+#ifdef ENABLE_SCRATCH_ARENA
+#define DECODE_BATCH 1
+#else
+#define DECODE_BATCH 4
+#endif
+
+/* Decodes up to DECODE_BATCH streams, running each stage of the decoder on
+   all of them before the next one, so that the code and the mode tables of
+   a stage are shared by the whole batch. The output goes to pcm16 or to
+   pcm_float, whichever is not NULL. */
+static void decode_batch_stages(CELTDecoder **st, const unsigned char * const *data, const int *len, int nb_streams, celt_int16 **pcm16, float **pcm_float, int frame_size, int *nbSamples)
+{
+   int i, j, c, C, N, CC, out_size;
+   DecodedFrame fr[DECODE_BATCH];
+   VARDECL(int, ints);
+   VARDECL(celt_sig, freq);
+   VARDECL(celt_ener, bandE);
+   VARDECL(celt_word16, out);
+   const CELTMode *mode = st[0]->mode;
+   const int nb = mode->nbEBands;
+   ALLOC_STATE_STACK(DECODER_ARENA(st[0]), DECODER_ARENA_SIZE(st[0]));
+   SAVE_STACK;
+
+   N = mode->shortMdctSize*mode->nbShortMdcts;
+   CC = 0;
+   for (i=0;i<nb_streams;i++)
+      CC += CHANNELS(st[i]->channels);
+   ALLOC(ints, nb_streams*4*nb, int);
+   ALLOC(freq, CC*N, celt_sig);
+   ALLOC(bandE, CC*nb, celt_ener);
+   c = 0;
+   for (i=0;i<nb_streams;i++)
+   {
+      decoded_frame_arrays(mode, &fr[i], ints+i*4*nb, freq+c*N, bandE+c*nb);
+      c += CHANNELS(st[i]->channels);
+   }
+   /* Output of the synthesis, when it is converted to the other format */
+#ifdef FIXED_POINT
+   out_size = pcm_float!=NULL ? frame_size : 1;
+#else
+   out_size = pcm16!=NULL ? frame_size : 1;
+#endif
+   C = 1;
+   for (i=0;i<nb_streams;i++)
+      C = IMAX(C, CHANNELS(st[i]->channels));
+   ALLOC(out, C*out_size, celt_word16);
+
+   for (i=0;i<nb_streams;i++)
+      nbSamples[i] = decode_frame_header(st[i], &fr[i], data[i], len[i], frame_size, NULL);
+   for (i=0;i<nb_streams;i++)
+      if (nbSamples[i]==CELT_OK)
+         decode_frame_bands(st[i], &fr[i]);
+   for (i=0;i<nb_streams;i++)
+   {
+      int ret;
+      if (nbSamples[i]!=CELT_OK)
+         continue;
+      CC = CHANNELS(st[i]->channels);
+#ifdef FIXED_POINT
+      if (pcm_float==NULL)
+      {
+         nbSamples[i] = decode_frame_synthesis(st[i], &fr[i], pcm16[i]);
+         continue;
+      }
+      ret = decode_frame_synthesis(st[i], &fr[i], out);
+      /* Lost packets return CELT_OK, but are concealed all the same */
+      if (ret>=0)
+         for (j=0;j<CC*(ret>0 ? ret : frame_size);j++)
+            pcm_float[i][j] = out[j]*(1.f/32768.f);
+#else
+      if (pcm16==NULL)
+      {
+         nbSamples[i] = decode_frame_synthesis(st[i], &fr[i], pcm_float[i]);
+         continue;
+      }
+      ret = decode_frame_synthesis(st[i], &fr[i], out);
+      /* Lost packets return CELT_OK, but are concealed all the same */
+      if (ret>=0)
+         for (j=0;j<CC*(ret>0 ? ret : frame_size);j++)
+            pcm16[i][j] = FLOAT2INT16(out[j]);
+#endif
+      nbSamples[i] = ret;
+   }
+   RESTORE_STACK;
+}
+
+/* Checks the batch, then decodes it DECODE_BATCH streams at a time */
+static int decode_batch(CELTDecoder **st, const unsigned char * const *data, const int *len, int nb_streams, celt_int16 **pcm16, float **pcm_float, int frame_size, int *nbSamples)
+{
+   int i;
+   if (st==NULL || data==NULL || len==NULL || nbSamples==NULL || nb_streams<0 || frame_size<=0)
+      return CELT_BAD_ARG;
+   for (i=0;i<nb_streams;i++)
+   {
+      if (st[i]==NULL || st[i]->mode!=st[0]->mode)
+         return CELT_BAD_ARG;
+      if (pcm16!=NULL ? pcm16[i]==NULL : pcm_float[i]==NULL)
+         return CELT_BAD_ARG;
+   }
+   for (i=0;i<nb_streams;i+=DECODE_BATCH)
+      decode_batch_stages(st+i, data+i, len+i, IMIN(DECODE_BATCH, nb_streams-i),
+            pcm16!=NULL ? pcm16+i : NULL, pcm_float!=NULL ? pcm_float+i : NULL,
+            frame_size, nbSamples+i);
+   return CELT_OK;
+}
+
+int celt_decode_batch(CELTDecoder **st, const unsigned char * const *data, const int *len, int nb_streams, celt_int16 **pcm, int frame_size, int *nbSamples)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return decode_batch(st, data, len, nb_streams, pcm, NULL, frame_size, nbSamples);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_decode_batch_float(CELTDecoder **st, const unsigned char * const *data, const int *len, int nb_streams, float **pcm, int frame_size, int *nbSamples)
+{
+   if (pcm==NULL)
+      return CELT_BAD_ARG;
+   return decode_batch(st, data, len, nb_streams, NULL, pcm, frame_size, nbSamples);
+}
+#endif /* DISABLE_FLOAT_API */
+
 int celt_decoder_ctl(CELTDecoder * restrict st, int request, ...)
 {
    va_list ap;
@@ -2667,13 +4583,63 @@ int celt_decoder_ctl(CELTDecoder * restrict st, int request, ...)
          st->signalling = value;
       }
       break;
+      case CELT_SET_SYNTHESIS_MODE_REQUEST:
+      {
+         const CELTMode *value = va_arg(ap, const CELTMode*);
+#ifdef CUSTOM_MODES
+         const CELTMode *mode = st->mode;
+         int D = st->downsample;
+         /* Same frame and block structure, D times smaller */
+         if (value!=NULL && (D==1 || D>MAX_SYNTHESIS_FACTOR || value->Fs*D!=mode->Fs
+               || value->shortMdctSize*D!=mode->shortMdctSize
+               || value->overlap*D!=mode->overlap
+               || value->maxLM!=mode->maxLM))
+            goto bad_arg;
+         st->synth = value;
+         if (value!=NULL)
+         {
+            synthesis_deemphasis(mode, D, st->synth_preemph);
+#ifdef ENABLE_POSTFILTER
+            synthesis_taps(D, st->synth_taps);
+#endif
+         }
+         CELT_MEMSET((char*)&st->DECODER_RESET_START, 0,
+               decoder_state_size(st->mode, st->channels)-
+               ((char*)&st->DECODER_RESET_START - (char*)st));
+#else
+         (void)value;
+         goto bad_request;
+#endif
+      }
+      break;
       case CELT_RESET_STATE:
       {
          CELT_MEMSET((char*)&st->DECODER_RESET_START, 0,
-               celt_decoder_get_size_custom(st->mode, st->channels)-
+               decoder_state_size(st->mode, st->channels)-
                ((char*)&st->DECODER_RESET_START - (char*)st));
       }
       break;
+      case CELT_GET_PROFILE_REQUEST:
+      {
+         CELTProfile *value = va_arg(ap, CELTProfile*);
+         if (value==NULL)
+            goto bad_arg;
+#ifdef ENABLE_PROFILING
+         *value = st->profile.stats;
+#else
+         goto bad_request;
+#endif
+      }
+      break;
+      case CELT_RESET_PROFILE_REQUEST:
+      {
+#ifdef ENABLE_PROFILING
+         CELT_MEMSET(&st->profile, 0, 1);
+#else
+         goto bad_request;
+#endif
+      }
+      break;
       default:
          goto bad_request;
    }
@@ -50,7 +50,13 @@ extern "C" {
 #endif
 
 #define _celt_check_int(x) (((void)((x) == (celt_int32)0)), (celt_int32)(x))
+#define _celt_check_int_ptr(ptr) ((ptr) + ((ptr) - (int*)(ptr)))
 #define _celt_check_mode_ptr_ptr(ptr) ((ptr) + ((ptr) - (CELTMode**)(ptr)))
+#define _celt_check_profile_ptr(ptr) ((ptr) + ((ptr) - (CELTProfile*)(ptr)))
+#define _celt_check_mode_ptr(ptr) (1 ? (ptr) : (const CELTMode*)0)
+#define _celt_check_thread_pool_ptr(ptr) (1 ? (ptr) : (const CELTThreadPool*)0)
+#define _celt_check_encoder_ptr_ptr(ptr) ((ptr) + ((ptr) - (CELTEncoder**)(ptr)))
+#define _celt_check_decoder_ptr_ptr(ptr) ((ptr) + ((ptr) - (CELTDecoder**)(ptr)))
 
 /* Error codes */
 /** No error */
@@ -116,6 +122,92 @@ extern "C" {
 #define CELT_SET_SIGNALLING_REQUEST    10003
 #define CELT_SET_SIGNALLING(x) CELT_SET_SIGNALLING_REQUEST, _celt_check_int(x)
 
+/** Gives the encoder the open-loop pitch of its next frame, as returned by
+    celt_encoder_pitch_analysis(), so that celt_encode() doesn't have to
+    search for it. Only applies to the next frame; 0 means no hint. */
+#define CELT_SET_PITCH_HINT_REQUEST    10004
+#define CELT_SET_PITCH_HINT(x) CELT_SET_PITCH_HINT_REQUEST, _celt_check_int(x)
+
+/** Get the time spent in each stage since the encoder or decoder was
+    created or since the last CELT_RESET_PROFILE (CELTProfile*). Only
+    available when built with --enable-profiling, otherwise returns
+    CELT_UNIMPLEMENTED */
+#define CELT_GET_PROFILE_REQUEST    10005
+#define CELT_GET_PROFILE(x) CELT_GET_PROFILE_REQUEST, _celt_check_profile_ptr(x)
+
+/** Clear the counters returned by CELT_GET_PROFILE */
+#define CELT_RESET_PROFILE_REQUEST    10006
+#define CELT_RESET_PROFILE       CELT_RESET_PROFILE_REQUEST
+
+/** Sets the time the encoder may spend on a frame, in microseconds (int);
+    0 (the default) means no limit. When the frames take longer, the
+    encoder leaves out its optional analyses, in the order of the
+    CELT_ANALYSIS_* levels below, and puts them back once there is room
+    again, based on how long each of them took so far. Only available when
+    built with --enable-cpu-budget, otherwise returns CELT_UNIMPLEMENTED */
+#define CELT_SET_CPU_BUDGET_REQUEST    10007
+#define CELT_SET_CPU_BUDGET(x) CELT_SET_CPU_BUDGET_REQUEST, _celt_check_int(x)
+
+/** Get the CELT_ANALYSIS_* level the last frame was encoded with (int*) */
+#define CELT_GET_ANALYSIS_LEVEL_REQUEST    10008
+#define CELT_GET_ANALYSIS_LEVEL(x) CELT_GET_ANALYSIS_LEVEL_REQUEST, _celt_check_int_ptr(x)
+
+/** Makes a decoder created for a rate below 48 kHz synthesise directly at
+    that rate with the given mode (const CELTMode*), which must come from
+    celt_mode_create() for the output rate and a frame size that is the
+    decoder's one divided by the same factor (e.g. 16000 and 320 for 960),
+    and must outlive the decoder. Only the coefficients below the output
+    Nyquist rate are inverse-transformed, with the smaller MDCT of that
+    mode, instead of synthesising at 48 kHz and decimating. NULL goes back
+    to the 48 kHz synthesis. Resets the decoder. Only available when built
+    with --enable-custom-modes, otherwise returns CELT_UNIMPLEMENTED */
+#define CELT_SET_SYNTHESIS_MODE_REQUEST    10009
+#define CELT_SET_SYNTHESIS_MODE(x) CELT_SET_SYNTHESIS_MODE_REQUEST, _celt_check_mode_ptr(x)
+
+/** Gives a multistream encoder or decoder a pool of threads to code its
+    streams at the same time (const CELTThreadPool*, copied); NULL codes
+    them one after the other (the default). */
+#define CELT_SET_THREAD_POOL_REQUEST    10010
+#define CELT_SET_THREAD_POOL(x) CELT_SET_THREAD_POOL_REQUEST, _celt_check_thread_pool_ptr(x)
+
+/** Get the encoder of one stream of a multistream encoder (int, CELTEncoder**),
+    for the requests that don't apply to all the streams */
+#define CELT_GET_STREAM_ENCODER_REQUEST    10011
+#define CELT_GET_STREAM_ENCODER(s,x) CELT_GET_STREAM_ENCODER_REQUEST, _celt_check_int(s), _celt_check_encoder_ptr_ptr(x)
+
+/** Get the decoder of one stream of a multistream decoder (int, CELTDecoder**) */
+#define CELT_GET_STREAM_DECODER_REQUEST    10012
+#define CELT_GET_STREAM_DECODER(s,x) CELT_GET_STREAM_DECODER_REQUEST, _celt_check_int(s), _celt_check_decoder_ptr_ptr(x)
+
+/** Shares the bytes and the bitrate of a multistream encoder between its
+    streams by what each of them needs in every frame (see
+    celt_encoder_frame_demand()) instead of by their number of channels
+    (int: 0 or 1, the default is 0). Half is still shared by the number
+    of channels, so that no stream goes without. */
+#define CELT_SET_JOINT_RATE_REQUEST    10013
+#define CELT_SET_JOINT_RATE(x) CELT_SET_JOINT_RATE_REQUEST, _celt_check_int(x)
+
+/** Number of frames of input the VBR looks ahead (int, 0 to
+    CELT_MAX_VBR_LOOKAHEAD, the default is 0). With K frames, the input
+    passed to celt_encode() must be followed by the next K frames, which
+    are only analysed, so that frames coming up with more to code can be
+    given bits ahead of them and the rate doesn't swing as much around
+    the target. The packet is still that of the first frame, and the
+    caller passes the input again, one frame further, on the next call.
+    Only used with VBR. */
+#define CELT_SET_VBR_LOOKAHEAD_REQUEST    10014
+#define CELT_SET_VBR_LOOKAHEAD(x) CELT_SET_VBR_LOOKAHEAD_REQUEST, _celt_check_int(x)
+#define CELT_MAX_VBR_LOOKAHEAD 8
+
+/** Size in bits of the next frame, as planned by the second pass of a
+    two-pass encoding (int). It only applies to that frame: with 0, and on
+    the frames after it, the VBR chooses. The packet comes out within a
+    byte of it unless the frame is silent or can't be coded in so few
+    bytes. The VBR doesn't make up for the difference with the bitrate on
+    later frames, that is left to the caller. Only used with VBR. */
+#define CELT_SET_FRAME_TARGET_REQUEST    10015
+#define CELT_SET_FRAME_TARGET(x) CELT_SET_FRAME_TARGET_REQUEST, _celt_check_int(x)
+
 /** GET the lookahead used in the current mode */
 #define CELT_GET_LOOKAHEAD    1001
 /** GET the sample rate used in the current mode */
@@ -143,6 +235,72 @@ typedef struct CELTDecoder CELTDecoder;
     bad */
 typedef struct CELTMode CELTMode;
 
+/** Several streams, mono or stereo, coded together into one packet, for
+    more than two channels (e.g. 5.1 surround)
+   @brief Multistream encoder state
+ */
+typedef struct CELTMSEncoder CELTMSEncoder;
+
+/** @brief Multistream decoder state */
+typedef struct CELTMSDecoder CELTMSDecoder;
+
+/** Threads of the application that the multistream encoder and decoder
+    can hand their streams to (see CELT_SET_THREAD_POOL) */
+typedef struct {
+   /** Calls job(arg, i) for every i from 0 to nb_jobs-1, in any order and
+       from any threads, and returns once all of them have returned */
+   void (*run)(void *pool, void (*job)(void *arg, int i), void *arg, int nb_jobs);
+   /** Passed back to run() */
+   void *pool;
+} CELTThreadPool;
+
+/* Stages reported by CELT_GET_PROFILE */
+#define CELT_PROFILE_PREEMPHASIS 0 /**< Pre-emphasis, or de-emphasis in the decoder */
+#define CELT_PROFILE_PITCH       1 /**< Pitch search and prefilter, or postfilter */
+#define CELT_PROFILE_TRANSIENT   2 /**< Transient analysis */
+#define CELT_PROFILE_MDCT        3 /**< Forward MDCTs, or synthesis and inverse MDCTs */
+#define CELT_PROFILE_TF          4 /**< Time-frequency resolution analysis and coding */
+#define CELT_PROFILE_ENERGY      5 /**< Band energies and their quantisation */
+#define CELT_PROFILE_ALLOCATION  6 /**< Side information, VBR and bit allocation */
+#define CELT_PROFILE_BANDS       7 /**< Band shape quantisation (PVQ) */
+#define CELT_PROFILE_OTHER       8 /**< Everything else, including loss concealment */
+#define CELT_PROFILE_STAGES      9
+
+/* Levels reported by CELT_GET_ANALYSIS_LEVEL, each one leaving out one
+   more analysis than the one above */
+#define CELT_ANALYSIS_FULL      4 /**< All the analyses the complexity allows */
+#define CELT_ANALYSIS_NO_STEREO 3 /**< No stereo analysis, always mid/side */
+#define CELT_ANALYSIS_NO_TRIM   2 /**< No allocation trim analysis either */
+#define CELT_ANALYSIS_NO_TF     1 /**< No time-frequency resolution analysis either */
+#define CELT_ANALYSIS_NO_PITCH  0 /**< No pitch analysis either, so no prefilter */
+
+/** Time spent in each stage of the encoder or decoder */
+typedef struct {
+   celt_uint32 frames;               /**< Frames processed */
+   double ns[CELT_PROFILE_STAGES];   /**< Nanoseconds spent in each stage */
+} CELTProfile;
+
+/** What the first pass of a two-pass encoding finds out about a frame
+    (see celt_encoder_frame_stats()) */
+typedef struct {
+   int demand;     /**< Bits the band energies call for, as celt_encoder_frame_demand() gives them for a frame that isn't a transient */
+   int transient;  /**< Whether the frame is coded with short blocks */
+   int tf_sum;     /**< Time-frequency resolution analysis summed over the bands, below -bands when the frame is better coded in time */
+   int bands;      /**< Number of bands analysed */
+} CELTFrameStats;
+
+/** A packet buffer owned by the caller, like one entry of an I/O vector,
+    with room kept free before and after the packet for the headers and
+    trailers of the transport (e.g. RTP header, SRTP authentication tag) */
+typedef struct {
+   unsigned char *data;      /**< Start of the buffer */
+   int size;                 /**< Size of the buffer in bytes */
+   int headroom;             /**< Bytes to leave free at the start */
+   int tailroom;             /**< Bytes to leave free at the end */
+   unsigned char *payload;   /**< Set to the start of the packet */
+   int payload_len;          /**< Set to the size of the packet in bytes */
+} CELTBuffer;
+
 
 /** \defgroup codec Encoding and decoding */
 /*  @{ */
@@ -239,6 +397,130 @@ EXPORT int celt_encode_float(CELTEncoder *st, const float *pcm, int frame_size,
  */
 EXPORT int celt_encode(CELTEncoder *st, const celt_int16 *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes);
 
+/** Returns the worst-case size, in bytes, of the temporary memory used by one
+    call to celt_encode() or celt_encode_float() with the given mode and
+    number of channels. Without --enable-scratch-arena, this memory comes
+    from the stack.
+ @param mode Mode of the encoder
+ @param channels Number of channels
+ @return Size in bytes
+ */
+EXPORT int celt_encoder_get_scratch_size(const CELTMode *mode, int channels);
+
+/** Same as celt_encode_float(), except that all the temporary memory of the
+    call is taken from the caller's scratch buffer, so the call uses very
+    little stack and never allocates. Only available with
+    --enable-scratch-arena. The buffer can be reused as soon as the call
+    returns, for instance by another encoder running on the same thread.
+ @param scratch Scratch memory (no alignment required)
+ @param scratch_size Size of scratch in bytes, at least what
+ *                   celt_encoder_get_scratch_size() returns
+ @return Same as celt_encode_float(), or CELT_BAD_ARG if the scratch buffer is
+ *       too small, or CELT_UNIMPLEMENTED without scratch arenas
+ */
+EXPORT int celt_encode_float_scratch(CELTEncoder *st, const float *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes, void *scratch, int scratch_size);
+
+/** Same as celt_encode(), with the temporary memory taken from the caller's
+    scratch buffer (see celt_encode_float_scratch()).
+ */
+EXPORT int celt_encode_scratch(CELTEncoder *st, const celt_int16 *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes, void *scratch, int scratch_size);
+
+/** Same as celt_encode_float(), except that the packet is coded straight
+    into the caller's buffer, after its headroom, so that no copy is needed
+    to put it behind the transport headers. On success, buf->payload and
+    buf->payload_len give where the packet is and its size.
+ @param buf Buffer to code the packet into
+ @param nbCompressedBytes Maximum number of bytes to use for the frame,
+ *          which must fit between the headroom and the tailroom
+ @return Same as celt_encode_float(), or CELT_BAD_ARG if the packet can't fit
+ */
+EXPORT int celt_encode_buffer_float(CELTEncoder *st, const float *pcm, int frame_size, CELTBuffer *buf, int nbCompressedBytes);
+
+/** Same as celt_encode(), with the packet coded straight into the
+    caller's buffer (see celt_encode_buffer_float()).
+ */
+EXPORT int celt_encode_buffer(CELTEncoder *st, const celt_int16 *pcm, int frame_size, CELTBuffer *buf, int nbCompressedBytes);
+
+/** Encodes one frame for each of several independent streams whose encoders
+    share the same mode, with the same result as one celt_encode_float() call
+    per stream. A few streams at a time go through each stage of the encoder
+    (pitch and pre-emphasis, MDCTs and band energies, quantisation) together,
+    so that the mode tables and the code of a stage are used by all of them
+    in a row.
+ @param st Array of nb_streams encoder states, all with the same mode
+ @param pcm Array of nb_streams input buffers (float format), each holding
+ *          as many frames as celt_encode_float() would need
+ @param nb_streams Number of streams
+ @param frame_size Number of samples per channel (same for all streams)
+ @param compressed Array of nb_streams buffers the packets are written to
+ @param nbCompressedBytes Maximum number of bytes for each packet
+ @param nbBytes Returns, for each stream, what celt_encode_float() would
+ *              have returned
+ @return CELT_OK, or CELT_BAD_ARG if the batch itself is invalid (in which
+ *       case no stream was encoded)
+ */
+EXPORT int celt_encode_batch_float(CELTEncoder **st, const float * const *pcm, int nb_streams, int frame_size, unsigned char **compressed, const int *nbCompressedBytes, int *nbBytes);
+
+/** Same as celt_encode_batch_float(), with 16-bit input and the results of
+    celt_encode() in nbBytes.
+ */
+EXPORT int celt_encode_batch(CELTEncoder **st, const celt_int16 * const *pcm, int nb_streams, int frame_size, unsigned char **compressed, const int *nbCompressedBytes, int *nbBytes);
+
+/** Runs the open-loop pitch search that celt_encode() would do on the
+    next frame of input, without coding anything. Only the parts of the
+    state that depend on the input alone are updated, so a second encoder
+    fed with every frame of the same input (with search=0 for the frames it
+    doesn't need to analyse) can do the search ahead of time, e.g. on
+    another thread. The result is passed to the real encoder with
+    CELT_SET_PITCH_HINT() right before it encodes that frame, which gives
+    the same bit-stream as letting it do the search itself.
+ @param st Encoder state used only for the analysis (same mode, channels
+ *         and input clipping as the real encoder)
+ @param pcm PCM audio in signed 16-bit format, exactly as passed to celt_encode()
+ @param frame_size Number of samples per channel
+ @param search If zero, only the input history is updated
+ @return The pitch hint (0 when search is zero), or an error code
+*/
+EXPORT int celt_encoder_pitch_analysis(CELTEncoder *st, const celt_int16 *pcm, int frame_size, int search);
+
+/** Same as celt_encoder_pitch_analysis() for input in float format, exactly
+    as passed to celt_encode_float() */
+EXPORT int celt_encoder_pitch_analysis_float(CELTEncoder *st, const float *pcm, int frame_size, int search);
+
+/** Estimates how many bits the next frame of input needs, compared to the
+    other frames and to the other streams of the same mode, from its band
+    energies and whether it is a transient. This is what the multistream
+    encoder shares its bytes by with CELT_SET_JOINT_RATE. Nothing in the
+    encoder changes, the frame still has to be passed to celt_encode().
+ @param st Encoder state
+ @param pcm Next frame of input, as passed to celt_encode()
+ @param frame_size Number of samples per channel
+ @return Demand, roughly in bits, or an error code
+*/
+EXPORT int celt_encoder_frame_demand(CELTEncoder *st, const celt_int16 *pcm, int frame_size);
+
+/** Same as celt_encoder_frame_demand() for input in float format, exactly
+    as passed to celt_encode_float() */
+EXPORT int celt_encoder_frame_demand_float(CELTEncoder *st, const float *pcm, int frame_size);
+
+/** Analyses the next frame of input for the first pass of a two-pass
+    encoding, as celt_encode() would but without the pitch search and
+    without quantising anything, so at a fraction of the cost. The input
+    history moves on to the next frame: st must be an encoder used only
+    for the analysis, fed with every frame of the input in order.
+ @param st Encoder state used only for the analysis (same mode, channels,
+ *         bitrate and complexity as the encoder of the second pass)
+ @param pcm Next frame of input, as passed to celt_encode()
+ @param frame_size Number of samples per channel
+ @param stats Filled in with what the analysis found
+ @return Error code
+*/
+EXPORT int celt_encoder_frame_stats(CELTEncoder *st, const celt_int16 *pcm, int frame_size, CELTFrameStats *stats);
+
+/** Same as celt_encoder_frame_stats() for input in float format, exactly
+    as passed to celt_encode_float() */
+EXPORT int celt_encoder_frame_stats_float(CELTEncoder *st, const float *pcm, int frame_size, CELTFrameStats *stats);
+
 /** Query and set encoder parameters 
  @param st Encoder state
  @param request Parameter to change or query
@@ -304,6 +586,70 @@ EXPORT int celt_decode_float(CELTDecoder *st, const unsigned char *data, int len
  */
 EXPORT int celt_decode(CELTDecoder *st, const unsigned char *data, int len, celt_int16 *pcm, int frame_size);
 
+/** Returns the worst-case size, in bytes, of the temporary memory used by one
+    call to celt_decode() or celt_decode_float() with the given mode and
+    number of channels, which is reached when concealing a lost packet.
+ @param mode Mode of the decoder
+ @param channels Number of channels
+ @return Size in bytes
+ */
+EXPORT int celt_decoder_get_scratch_size(const CELTMode *mode, int channels);
+
+/** Same as celt_decode_float(), except that all the temporary memory of the
+    call is taken from the caller's scratch buffer. Only available with
+    --enable-scratch-arena.
+ @param scratch Scratch memory (no alignment required)
+ @param scratch_size Size of scratch in bytes, at least what
+ *                   celt_decoder_get_scratch_size() returns
+ @return Same as celt_decode_float(), or CELT_BAD_ARG if the scratch buffer is
+ *       too small, or CELT_UNIMPLEMENTED without scratch arenas
+ */
+EXPORT int celt_decode_float_scratch(CELTDecoder *st, const unsigned char *data, int len, float *pcm, int frame_size, void *scratch, int scratch_size);
+
+/** Same as celt_decode(), with the temporary memory taken from the caller's
+    scratch buffer (see celt_decode_float_scratch()).
+ */
+EXPORT int celt_decode_scratch(CELTDecoder *st, const unsigned char *data, int len, celt_int16 *pcm, int frame_size, void *scratch, int scratch_size);
+
+/** Same as celt_decode_float(), except that the packet is read from a chain
+    of buffers that need not be contiguous (e.g. the fragments of a
+    scatter/gather list), as if they had been copied one after the other.
+ @param data The buffers. Buffers of size 0 are allowed.
+ @param len Size of each buffer in bytes
+ @param nb_segments Number of buffers. With no data at all, a lost packet is
+ *          assumed, as with celt_decode_float().
+ @return Same as celt_decode_float()
+ */
+EXPORT int celt_decode_chain_float(CELTDecoder *st, const unsigned char * const *data, const int *len, int nb_segments, float *pcm, int frame_size);
+
+/** Same as celt_decode(), with the packet read from a chain of buffers
+    (see celt_decode_chain_float()).
+ */
+EXPORT int celt_decode_chain(CELTDecoder *st, const unsigned char * const *data, const int *len, int nb_segments, celt_int16 *pcm, int frame_size);
+
+/** Decodes one frame for each of several independent streams whose decoders
+    share the same mode, with the same result as one celt_decode_float() call
+    per stream. A few streams at a time go through each stage of the decoder
+    (energy and allocation, bands, synthesis) together, so that the mode
+    tables and the code of a stage are used by all of them in a row.
+ @param st Array of nb_streams decoder states, all with the same mode
+ @param data Array of nb_streams packets (NULL entries are treated as lost)
+ @param len Size of each packet in bytes
+ @param nb_streams Number of streams
+ @param pcm Array of nb_streams output buffers (float format)
+ @param frame_size Number of samples per channel (same for all streams)
+ @param nbSamples Returns, for each stream, what celt_decode_float() would
+ *                have returned
+ @return CELT_OK, or CELT_BAD_ARG if the batch itself is invalid (in which
+ *       case no stream was decoded)
+ */
+EXPORT int celt_decode_batch_float(CELTDecoder **st, const unsigned char * const *data, const int *len, int nb_streams, float **pcm, int frame_size, int *nbSamples);
+
+/** Same as celt_decode_batch_float(), with 16-bit output and the results of
+    celt_decode() in nbSamples.
+ */
+EXPORT int celt_decode_batch(CELTDecoder **st, const unsigned char * const *data, const int *len, int nb_streams, celt_int16 **pcm, int frame_size, int *nbSamples);
+
 /** Query and set decoder parameters
    @param st Decoder state
    @param request Parameter to change or query
@@ -312,6 +658,98 @@ EXPORT int celt_decode(CELTDecoder *st, const unsigned char *data, int len, celt
  */
 EXPORT int celt_decoder_ctl(CELTDecoder * st, int request, ...);
 
+/* Multistream */
+
+/** Returns the size of a multistream encoder state.
+ @param mode Mode shared by all the streams
+ @param streams Number of streams
+ @param coupled_streams Number of those streams that are stereo
+ */
+EXPORT int celt_ms_encoder_get_size(const CELTMode *mode, int streams, int coupled_streams);
+
+/** Creates a multistream encoder. The stereo streams come first, then the
+    mono ones. Each stream is coded by its own encoder, and all of them are
+    packed into one packet in which every stream but the last one starts
+    with its size. In-band signalling is disabled for all the streams.
+    Running the streams on a thread pool requires a build with
+    variable-size arrays, alloca() or --enable-scratch-arena.
+ @param mode Mode shared by all the streams, which must outlive the encoder
+ @param channels Number of input channels (1 to 255)
+ @param streams Number of streams (at least 1)
+ @param coupled_streams Number of those streams that are stereo
+ @param mapping For each input channel, the channel of the streams it is
+ *          coded in: 2*s and 2*s+1 for the left and right of stereo stream
+ *          s, then coupled_streams+s for mono stream s. Channels of the
+ *          streams that no input channel maps to are coded as silence.
+ @param error Returned error code (if NULL, no error will be returned)
+ @return A newly created multistream encoder
+ */
+EXPORT CELTMSEncoder *celt_ms_encoder_create(const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error);
+
+/** Same as celt_ms_encoder_create(), in memory of celt_ms_encoder_get_size()
+    bytes allocated by the caller, which must start on a multiple of 64 bytes */
+EXPORT CELTMSEncoder *celt_ms_encoder_init(CELTMSEncoder *st, const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error);
+
+/** Destroys a multistream encoder from celt_ms_encoder_create() */
+EXPORT void celt_ms_encoder_destroy(CELTMSEncoder *st);
+
+/** Encodes one frame of all the channels into a single packet. The bytes
+    are shared between the streams, with 3 for each stereo stream for every
+    2 for a mono one.
+ @param pcm Interleaved PCM of all the channels, as with celt_encode_float()
+ @param maxCompressedBytes Maximum size of the packet, including the sizes
+ *          of the streams
+ @return Size of the packet, or an error code
+ */
+EXPORT int celt_ms_encode_float(CELTMSEncoder *st, const float *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes);
+
+/** Same as celt_ms_encode_float(), with 16-bit PCM */
+EXPORT int celt_ms_encode(CELTMSEncoder *st, const celt_int16 *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes);
+
+/** Query and set multistream encoder parameters. CELT_SET_COMPLEXITY,
+    CELT_SET_PREDICTION, CELT_SET_VBR, CELT_SET_VBR_CONSTRAINT,
+    CELT_SET_INPUT_CLIPPING and CELT_RESET_STATE apply to all the streams,
+    CELT_SET_BITRATE is shared between them like the bytes, and
+    CELT_SET_JOINT_RATE chooses how. The others go
+    to the streams' own encoders (see CELT_GET_STREAM_ENCODER). */
+EXPORT int celt_ms_encoder_ctl(CELTMSEncoder *st, int request, ...);
+
+/** Returns the size of a multistream decoder state */
+EXPORT int celt_ms_decoder_get_size(const CELTMode *mode, int streams, int coupled_streams);
+
+/** Creates a multistream decoder for the packets of celt_ms_encode().
+ @param mode Mode of the encoder, which must outlive the decoder
+ @param channels Number of output channels (1 to 255)
+ @param streams Number of streams of the encoder
+ @param coupled_streams Number of those that are stereo
+ @param mapping For each output channel, the channel of the streams to
+ *          decode into it, numbered as for the encoder, or 255 for silence
+ @param error Returned error code (if NULL, no error will be returned)
+ @return A newly created multistream decoder
+ */
+EXPORT CELTMSDecoder *celt_ms_decoder_create(const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error);
+
+/** Same as celt_ms_decoder_create(), in memory of celt_ms_decoder_get_size()
+    bytes allocated by the caller, which must start on a multiple of 64 bytes */
+EXPORT CELTMSDecoder *celt_ms_decoder_init(CELTMSDecoder *st, const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error);
+
+/** Destroys a multistream decoder from celt_ms_decoder_create() */
+EXPORT void celt_ms_decoder_destroy(CELTMSDecoder *st);
+
+/** Decodes a packet of celt_ms_encode() into all the channels
+ @param data Packet, or NULL for a lost packet
+ @param pcm Interleaved output of all the channels
+ @return Number of decoded samples per channel, or an error code
+ */
+EXPORT int celt_ms_decode_float(CELTMSDecoder *st, const unsigned char *data, int len, float *pcm, int frame_size);
+
+/** Same as celt_ms_decode_float(), with 16-bit PCM */
+EXPORT int celt_ms_decode(CELTMSDecoder *st, const unsigned char *data, int len, celt_int16 *pcm, int frame_size);
+
+/** Query and set multistream decoder parameters. CELT_RESET_STATE applies
+    to all the streams; see also CELT_GET_STREAM_DECODER. */
+EXPORT int celt_ms_decoder_ctl(CELTMSDecoder *st, int request, ...);
+
 
 /** Returns the English string that corresponds to an error code
  * @param error Error code (negative for an error, 0 for success
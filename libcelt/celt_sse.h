@@ -0,0 +1,245 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/**
+   @file celt_sse.h
+   @brief SSE comb filter for the pitch pre-filter and post-filter
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CELT_SSE_H
+#define CELT_SSE_H
+
+/* These compute four outputs at a time, with the same operations in the
+   same order as the C code for each of them, so the result is
+   bit-exact. The post-filter runs in place (y == x), so a block can only
+   be done at once when none of the inputs it reads is one of its own
+   outputs, i.e. when the period is at least 4+2. The shorter periods,
+   and the last few samples, go through the C code. */
+
+#define OVERRIDE_COMB_FILTER
+
+#define COMB_FILTER_MIN_SSE_PERIOD 6
+
+static inline void comb_filter_fade_scalar(celt_word32 *y, const celt_word32 *x, int T0, int T1,
+      const celt_word16 *g0, const celt_word16 *g1, const celt_word16 *window, int i, int overlap)
+{
+   for (;i<overlap;i++)
+   {
+      celt_word16 f;
+      f = MULT16_16_Q15(window[i],window[i]);
+      y[i] = x[i]
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[0]),x[i-T0])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[1]),x[i-T0-1])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[1]),x[i-T0+1])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[2]),x[i-T0-2])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g0[2]),x[i-T0+2])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[0]),x[i-T1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[1]),x[i-T1-1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[1]),x[i-T1+1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[2]),x[i-T1-2])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g1[2]),x[i-T1+2]);
+   }
+}
+
+static inline void comb_filter_const_scalar(celt_word32 *y, const celt_word32 *x, int T, int i, int N,
+      const celt_word16 *g)
+{
+   for (;i<N;i++)
+      y[i] = x[i]
+               + MULT16_32_Q15(g[0],x[i-T])
+               + MULT16_32_Q15(g[1],x[i-T-1])
+               + MULT16_32_Q15(g[1],x[i-T+1])
+               + MULT16_32_Q15(g[2],x[i-T-2])
+               + MULT16_32_Q15(g[2],x[i-T+2]);
+}
+
+#ifdef FIXED_POINT
+
+#include <emmintrin.h>
+
+/* Each 32-bit lane holds a sign-extended 16-bit value. SSE2 has no 32-bit
+   multiply, so these use pmaddwd with a zero in the upper half of one of
+   the operands */
+
+/* Truncates to 16 bits and sign-extends back, like a cast to celt_word16 */
+static inline __m128i sext16x4(__m128i a)
+{
+   return _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+}
+
+/* MULT16_16() of the low 16 bits of each lane */
+static inline __m128i mult16_16x4(__m128i a, __m128i b)
+{
+   return _mm_madd_epi16(_mm_and_si128(a, _mm_set1_epi32(0xffff)), b);
+}
+
+static inline __m128i mult16_16_q15x4(__m128i a, __m128i b)
+{
+   return _mm_srai_epi32(mult16_16x4(a, b), 15);
+}
+
+/* MULT16_32_Q15(a,b) with a already sign-extended from 16 bits. The
+   unsigned low half of b is split into its low 15 bits, which pmaddwd
+   takes as signed, and its top bit, which adds a<<15. */
+static inline __m128i mult16_32_q15x4(__m128i a, __m128i b)
+{
+   __m128i hi, lo, top;
+   hi = mult16_16x4(a, _mm_srai_epi32(b, 16));
+   lo = mult16_16x4(a, _mm_and_si128(b, _mm_set1_epi32(0x7fff)));
+   top = _mm_srai_epi32(_mm_slli_epi32(b, 16), 31);
+   lo = _mm_add_epi32(lo, _mm_and_si128(_mm_slli_epi32(a, 15), top));
+   return _mm_add_epi32(_mm_slli_epi32(hi, 1), _mm_srai_epi32(lo, 15));
+}
+
+#define LOAD4(p) _mm_loadu_si128((const __m128i*)(const void*)(p))
+
+static inline void comb_filter_fade(celt_word32 *y, const celt_word32 *x, int T0, int T1,
+      const celt_word16 *g0, const celt_word16 *g1, const celt_word16 *window, int overlap)
+{
+   int i=0;
+   if (T0 >= COMB_FILTER_MIN_SSE_PERIOD && T1 >= COMB_FILTER_MIN_SSE_PERIOD)
+   {
+      const __m128i one = _mm_set1_epi32(Q15ONE);
+      const __m128i g00 = _mm_set1_epi32(g0[0]), g01 = _mm_set1_epi32(g0[1]), g02 = _mm_set1_epi32(g0[2]);
+      const __m128i g10 = _mm_set1_epi32(g1[0]), g11 = _mm_set1_epi32(g1[1]), g12 = _mm_set1_epi32(g1[2]);
+      for (;i<overlap-3;i+=4)
+      {
+         __m128i w, f, nf, c0, c1, c2, acc;
+         w = _mm_loadl_epi64((const __m128i*)(const void*)(window+i));
+         w = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16);
+         f = mult16_16_q15x4(w, w);
+         nf = _mm_sub_epi32(one, f);
+         acc = LOAD4(x+i);
+         c0 = sext16x4(mult16_16_q15x4(nf, g00));
+         c1 = sext16x4(mult16_16_q15x4(nf, g01));
+         c2 = sext16x4(mult16_16_q15x4(nf, g02));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c0, LOAD4(x+i-T0)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c1, LOAD4(x+i-T0-1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c1, LOAD4(x+i-T0+1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c2, LOAD4(x+i-T0-2)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c2, LOAD4(x+i-T0+2)));
+         c0 = sext16x4(mult16_16_q15x4(f, g10));
+         c1 = sext16x4(mult16_16_q15x4(f, g11));
+         c2 = sext16x4(mult16_16_q15x4(f, g12));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c0, LOAD4(x+i-T1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c1, LOAD4(x+i-T1-1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c1, LOAD4(x+i-T1+1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c2, LOAD4(x+i-T1-2)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(c2, LOAD4(x+i-T1+2)));
+         _mm_storeu_si128((__m128i*)(void*)(y+i), acc);
+      }
+   }
+   comb_filter_fade_scalar(y, x, T0, T1, g0, g1, window, i, overlap);
+}
+
+static inline void comb_filter_const(celt_word32 *y, const celt_word32 *x, int T, int N,
+      const celt_word16 *g)
+{
+   int i=0;
+   if (T >= COMB_FILTER_MIN_SSE_PERIOD)
+   {
+      const __m128i g0 = _mm_set1_epi32(g[0]), g1 = _mm_set1_epi32(g[1]), g2 = _mm_set1_epi32(g[2]);
+      for (;i<N-3;i+=4)
+      {
+         __m128i acc = LOAD4(x+i);
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(g0, LOAD4(x+i-T)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(g1, LOAD4(x+i-T-1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(g1, LOAD4(x+i-T+1)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(g2, LOAD4(x+i-T-2)));
+         acc = _mm_add_epi32(acc, mult16_32_q15x4(g2, LOAD4(x+i-T+2)));
+         _mm_storeu_si128((__m128i*)(void*)(y+i), acc);
+      }
+   }
+   comb_filter_const_scalar(y, x, T, i, N, g);
+}
+
+#undef LOAD4
+
+#else /* FIXED_POINT */
+
+#include <xmmintrin.h>
+
+static inline void comb_filter_fade(celt_word32 *y, const celt_word32 *x, int T0, int T1,
+      const celt_word16 *g0, const celt_word16 *g1, const celt_word16 *window, int overlap)
+{
+   int i=0;
+   if (T0 >= COMB_FILTER_MIN_SSE_PERIOD && T1 >= COMB_FILTER_MIN_SSE_PERIOD)
+   {
+      const __m128 one = _mm_set1_ps(Q15ONE);
+      const __m128 g00 = _mm_set1_ps(g0[0]), g01 = _mm_set1_ps(g0[1]), g02 = _mm_set1_ps(g0[2]);
+      const __m128 g10 = _mm_set1_ps(g1[0]), g11 = _mm_set1_ps(g1[1]), g12 = _mm_set1_ps(g1[2]);
+      for (;i<overlap-3;i+=4)
+      {
+         __m128 w, f, nf, c0, c1, c2, acc;
+         w = _mm_loadu_ps(window+i);
+         f = _mm_mul_ps(w, w);
+         nf = _mm_sub_ps(one, f);
+         acc = _mm_loadu_ps(x+i);
+         c0 = _mm_mul_ps(nf, g00);
+         c1 = _mm_mul_ps(nf, g01);
+         c2 = _mm_mul_ps(nf, g02);
+         acc = _mm_add_ps(acc, _mm_mul_ps(c0, _mm_loadu_ps(x+i-T0)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c1, _mm_loadu_ps(x+i-T0-1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c1, _mm_loadu_ps(x+i-T0+1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c2, _mm_loadu_ps(x+i-T0-2)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c2, _mm_loadu_ps(x+i-T0+2)));
+         c0 = _mm_mul_ps(f, g10);
+         c1 = _mm_mul_ps(f, g11);
+         c2 = _mm_mul_ps(f, g12);
+         acc = _mm_add_ps(acc, _mm_mul_ps(c0, _mm_loadu_ps(x+i-T1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c1, _mm_loadu_ps(x+i-T1-1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c1, _mm_loadu_ps(x+i-T1+1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c2, _mm_loadu_ps(x+i-T1-2)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(c2, _mm_loadu_ps(x+i-T1+2)));
+         _mm_storeu_ps(y+i, acc);
+      }
+   }
+   comb_filter_fade_scalar(y, x, T0, T1, g0, g1, window, i, overlap);
+}
+
+static inline void comb_filter_const(celt_word32 *y, const celt_word32 *x, int T, int N,
+      const celt_word16 *g)
+{
+   int i=0;
+   if (T >= COMB_FILTER_MIN_SSE_PERIOD)
+   {
+      const __m128 g0 = _mm_set1_ps(g[0]), g1 = _mm_set1_ps(g[1]), g2 = _mm_set1_ps(g[2]);
+      for (;i<N-3;i+=4)
+      {
+         __m128 acc = _mm_loadu_ps(x+i);
+         acc = _mm_add_ps(acc, _mm_mul_ps(g0, _mm_loadu_ps(x+i-T)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(g1, _mm_loadu_ps(x+i-T-1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(g1, _mm_loadu_ps(x+i-T+1)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(g2, _mm_loadu_ps(x+i-T-2)));
+         acc = _mm_add_ps(acc, _mm_mul_ps(g2, _mm_loadu_ps(x+i-T+2)));
+         _mm_storeu_ps(y+i, acc);
+      }
+   }
+   comb_filter_const_scalar(y, x, T, i, N, g);
+}
+
+#endif /* FIXED_POINT */
+
+#endif /* CELT_SSE_H */
@@ -539,6 +539,41 @@ static void cwrsi(int _n,int _k,celt_uint32 _i,int *_y,celt_uint32 *_u){
   while(++j<_n);
 }
 
+/*Returns the _i'th combination of _k elements chosen from a set of size _n
+   with associated sign bits, like cwrsi(), but reading the rows of U() from
+   _t instead of computing each one from the previous one.
+  _t: Must cover row _n up to U(_n,_k+1).*/
+static void cwrsi_table(int _n,int _k,celt_uint32 _i,int *_y,
+ const CWRSTable *_t){
+  int j;
+  celt_assert(_n>0);
+  j=0;
+  do{
+    const celt_uint32 *u;
+    celt_uint32        p;
+    int                s;
+    int                yj;
+    u=_t->u+_t->index[_n-j];
+    p=u[_k+1];
+    s=-(_i>=p);
+    _i-=p&s;
+    yj=_k;
+    p=u[_k];
+    while(p>_i)p=u[--_k];
+    _i-=p;
+    yj-=_k;
+    _y[j]=yj+s^s;
+  }
+  while(++j<_n);
+}
+
+/*Returns whether _t has all the rows of U() needed to index _k pulses in
+   _n dimensions.
+  Rows never get longer as _n grows, so it's enough to check the last one.*/
+static inline int cwrs_table_covers(const CWRSTable *_t,int _n,int _k){
+  return _t!=NULL&&_n<=_t->maxN&&_k+2<=_t->index[_n+1]-_t->index[_n];
+}
+
 
 /*Returns the index of the given combination of K elements chosen from a set
    of size 1 with associated sign bits.
@@ -640,6 +675,31 @@ celt_uint32 icwrs(int _n,int _k,celt_uint32 *_nc,const int *_y,
   return i;
 }
 
+/*Returns the index of the given combination of K elements chosen from a set
+   of size _n with associated sign bits, like icwrs(), but reading the rows of
+   U() from _t instead of building them one after the other.
+  _t: Must cover row _n up to U(_n,_k+1).*/
+static celt_uint32 icwrs_table(int _n,int _k,celt_uint32 *_nc,const int *_y,
+ const CWRSTable *_t){
+  const celt_uint32 *u;
+  celt_uint32        i;
+  int                j;
+  int                k;
+  celt_assert(_n>=2);
+  celt_assert(_n<=_t->maxN&&_k+2<=_t->index[_n+1]-_t->index[_n]);
+  i=icwrs1(_y+_n-1,&k);
+  j=_n-2;
+  do{
+    u=_t->u+_t->index[_n-j];
+    i+=u[k];
+    k+=abs(_y[j]);
+    if(_y[j]<0)i+=u[k+1];
+  }
+  while(j-->0);
+  *_nc=u[k]+u[k+1];
+  return i;
+}
+
 #ifdef CUSTOM_MODES
 void get_required_bits(celt_int16 *_bits,int _n,int _maxk,int _frac){
   int k;
@@ -661,9 +721,20 @@ void get_required_bits(celt_int16 *_bits,int _n,int _maxk,int _frac){
     RESTORE_STACK;
   }
 }
+
+/*Computes U(_n,0..._maxk+1) into _u, for building a CWRSTable.*/
+void get_cwrs_urow(celt_uint32 *_u,int _n,int _maxk){
+  int k;
+  celt_assert(_n>0&&_maxk>0);
+  if(_n==1){
+    _u[0]=0;
+    for(k=1;k<=_maxk+1;k++)_u[k]=1;
+  }
+  else ncwrs_urow(_n,_maxk,_u);
+}
 #endif /* CUSTOM_MODES */
 
-void encode_pulses(const int *_y,int _n,int _k,ec_enc *_enc){
+void encode_pulses(const int *_y,int _n,int _k,const CWRSTable *_table,ec_enc *_enc){
   celt_uint32 i;
   if (_k==0)
      return;
@@ -696,15 +767,19 @@ void encode_pulses(const int *_y,int _n,int _k,ec_enc *_enc){
       VARDECL(celt_uint32,u);
       celt_uint32 nc;
       SAVE_STACK;
-      ALLOC(u,_k+2U,celt_uint32);
-      i=icwrs(_n,_k,&nc,_y,u);
+      if(cwrs_table_covers(_table,_n,_k))
+        i=icwrs_table(_n,_k,&nc,_y,_table);
+      else{
+        ALLOC(u,_k+2U,celt_uint32);
+        i=icwrs(_n,_k,&nc,_y,u);
+      }
       ec_enc_uint(_enc,i,nc);
       RESTORE_STACK;
     };
   }
 }
 
-void decode_pulses(int *_y,int _n,int _k,ec_dec *_dec)
+void decode_pulses(int *_y,int _n,int _k,const CWRSTable *_table,ec_dec *_dec)
 {
    if (_k==0) {
       int i;
@@ -727,8 +802,15 @@ void decode_pulses(int *_y,int _n,int _k,ec_dec *_dec)
     {
       VARDECL(celt_uint32,u);
       SAVE_STACK;
-      ALLOC(u,_k+2U,celt_uint32);
-      cwrsi(_n,_k,ec_dec_uint(_dec,ncwrs_urow(_n,_k,u)),_y,u);
+      if(cwrs_table_covers(_table,_n,_k)){
+        const celt_uint32 *un;
+        un=_table->u+_table->index[_n];
+        cwrsi_table(_n,_k,ec_dec_uint(_dec,un[_k]+un[_k+1]),_y,_table);
+      }
+      else{
+        ALLOC(u,_k+2U,celt_uint32);
+        cwrsi(_n,_k,ec_dec_uint(_dec,ncwrs_urow(_n,_k,u)),_y,u);
+      }
       RESTORE_STACK;
     }
   }
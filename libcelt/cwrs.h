@@ -35,12 +35,25 @@
 #include "entenc.h"
 #include "entdec.h"
 
+/** Precomputed rows of U(N,K) for all the band sizes of a mode, so that
+    the codeword indexing doesn't have to rebuild them for every band. Row n
+    holds U(n,0...index[n+1]-index[n]-1), starting at u+index[n]. Rows get
+    shorter as n grows, and an empty row means nothing from there on is
+    covered. */
+typedef struct {
+   int maxN;
+   const celt_int32 *index;
+   const celt_uint32 *u;
+} CWRSTable;
+
 int log2_frac(celt_uint32 val, int frac);
 
 void get_required_bits(celt_int16 *bits, int N, int K, int frac);
 
-void encode_pulses(const int *_y, int N, int K, ec_enc *enc);
+void get_cwrs_urow(celt_uint32 *u, int N, int K);
+
+void encode_pulses(const int *_y, int N, int K, const CWRSTable *table, ec_enc *enc);
 
-void decode_pulses(int *_y, int N, int K, ec_dec *dec);
+void decode_pulses(int *_y, int N, int K, const CWRSTable *table, ec_dec *dec);
 
 #endif /* CWRS_H */
@@ -134,6 +134,20 @@ void dump_modes(FILE *file, CELTMode **modes, int nb_modes)
       fprintf(file, "#endif\n");
       fprintf(file, "\n");
 
+      /* CWRS rows */
+      fprintf(file, "#ifndef DEF_CWRS_TABLE%d\n", mode->Fs/mdctSize);
+      fprintf(file, "#define DEF_CWRS_TABLE%d\n", mode->Fs/mdctSize);
+      fprintf (file, "static const celt_int32 cwrs_index%d[%d] = {\n", mode->Fs/mdctSize, mode->cwrs.maxN+2);
+      for (j=0;j<mode->cwrs.maxN+2;j++)
+         fprintf (file, "%d, ", mode->cwrs.index[j]);
+      fprintf (file, "};\n");
+      fprintf (file, "static const celt_uint32 cwrs_u%d[%d] = {\n", mode->Fs/mdctSize, mode->cwrs.index[mode->cwrs.maxN+1]);
+      for (j=0;j<mode->cwrs.index[mode->cwrs.maxN+1];j++)
+         fprintf (file, "%uU, ", mode->cwrs.u[j]);
+      fprintf (file, "};\n");
+      fprintf(file, "#endif\n");
+      fprintf(file, "\n");
+
       /* FFT twiddles */
       fprintf(file, "#ifndef FFT_TWIDDLES%d_%d\n", mode->Fs, mdctSize);
       fprintf(file, "#define FFT_TWIDDLES%d_%d\n", mode->Fs, mdctSize);
@@ -230,6 +244,8 @@ void dump_modes(FILE *file, CELTMode **modes, int nb_modes)
       fprintf(file, "logN%d,\t/* logN */\n", framerate);
       fprintf(file, "{%d, cache_index%d, cache_bits%d, cache_caps%d},\t/* cache */\n",
             mode->cache.size, mode->Fs/mdctSize, mode->Fs/mdctSize, mode->Fs/mdctSize);
+      fprintf(file, "{%d, cwrs_index%d, cwrs_u%d},\t/* cwrs */\n",
+            mode->cwrs.maxN, mode->Fs/mdctSize, mode->Fs/mdctSize);
       fprintf(file, "};\n");
    }
    fprintf(file, "\n");
@@ -87,6 +87,18 @@ struct ec_ctx{
    int            rem;
    /*Nonzero if an error occurred.*/
    int            error;
+   /*In the decoder, when the input is a chain of buffers rather than buf:
+      the buffers and their sizes (NULL otherwise).*/
+   const unsigned char *const *segs;
+   const int     *seg_lens;
+   /*The buffer the next range coder byte is read from and its position
+      relative to offs.*/
+   int            front_seg;
+   int            front_base;
+   /*The buffer the next raw bits are read from and its position relative
+      to offs.*/
+   int            back_seg;
+   int            back_base;
 };
 
 
@@ -96,13 +96,38 @@
 
 
 
+/*Reads the byte at offs from a chain of buffers, moving on to the buffer
+   that holds it.*/
+static int ec_read_chain_byte(ec_dec *_this){
+  int pos;
+  pos=(int)_this->offs++;
+  while(pos>=_this->front_base+_this->seg_lens[_this->front_seg]){
+    _this->front_base+=_this->seg_lens[_this->front_seg++];
+  }
+  return _this->segs[_this->front_seg][pos-_this->front_base];
+}
+
+/*Reads the byte at storage-end_offs from a chain of buffers, moving back to
+   the buffer that holds it.*/
+static int ec_read_chain_byte_from_end(ec_dec *_this){
+  int pos;
+  pos=(int)(_this->storage-++(_this->end_offs));
+  while(pos<_this->back_base){
+    _this->back_base-=_this->seg_lens[--_this->back_seg];
+  }
+  return _this->segs[_this->back_seg][pos-_this->back_base];
+}
+
 static int ec_read_byte(ec_dec *_this){
-  return _this->offs<_this->storage?_this->buf[_this->offs++]:0;
+  if(_this->offs>=_this->storage)return 0;
+  if(_this->segs!=NULL)return ec_read_chain_byte(_this);
+  return _this->buf[_this->offs++];
 }
 
 static int ec_read_byte_from_end(ec_dec *_this){
-  return _this->end_offs<_this->storage?
-   _this->buf[_this->storage-++(_this->end_offs)]:0;
+  if(_this->end_offs>=_this->storage)return 0;
+  if(_this->segs!=NULL)return ec_read_chain_byte_from_end(_this);
+  return _this->buf[_this->storage-++(_this->end_offs)];
 }
 
 
@@ -125,9 +150,8 @@ static void ec_dec_normalize(ec_dec *_this){
   }
 }
 
-void ec_dec_init(ec_dec *_this,unsigned char *_buf,celt_uint32 _storage){
-  _this->buf=_buf;
-  _this->storage=_storage;
+/*Reads the first bytes of the input, which must have been set up.*/
+static void ec_dec_start(ec_dec *_this){
   _this->end_offs=0;
   _this->end_window=0;
   _this->nend_bits=0;
@@ -144,6 +168,32 @@ void ec_dec_init(ec_dec *_this,unsigned char *_buf,celt_uint32 _storage){
   _this->nbits_total=EC_CODE_BITS+1;
 }
 
+void ec_dec_init(ec_dec *_this,unsigned char *_buf,celt_uint32 _storage){
+  _this->buf=_buf;
+  _this->storage=_storage;
+  _this->segs=NULL;
+  _this->seg_lens=NULL;
+  ec_dec_start(_this);
+}
+
+void ec_dec_init_chain(ec_dec *_this,const unsigned char *const *_segs,
+ const int *_seg_lens,int _nsegs,celt_uint32 _skip){
+  int total;
+  int i;
+  total=0;
+  for(i=0;i<_nsegs;i++)total+=_seg_lens[i];
+  /*The positions are counted from the first byte after the ones skipped.*/
+  _this->segs=_segs;
+  _this->seg_lens=_seg_lens;
+  _this->front_seg=0;
+  _this->front_base=-(int)_skip;
+  _this->back_seg=_nsegs;
+  _this->back_base=total-(int)_skip;
+  _this->buf=NULL;
+  _this->storage=total-_skip;
+  ec_dec_start(_this);
+}
+
 
 unsigned ec_decode(ec_dec *_this,unsigned _ft){
   unsigned s;
@@ -37,6 +37,16 @@
   Return: 0 on success, or a negative value on error.*/
 void ec_dec_init(ec_dec *_this,unsigned char *_buf,celt_uint32 _storage);
 
+/*Initializes the decoder to read from a chain of buffers, as if they had
+   been copied one after the other into a single one.
+  _segs:     The buffers, which need not be contiguous.
+  _seg_lens: The size of each buffer, which may be 0.
+  _nsegs:    The number of buffers.
+  _skip:     The number of bytes at the start of the chain that are not part
+              of the coded data (e.g., a header already parsed).*/
+void ec_dec_init_chain(ec_dec *_this,const unsigned char *const *_segs,
+ const int *_seg_lens,int _nsegs,celt_uint32 _skip);
+
 /*Calculates the cumulative frequency for the next symbol.
   This can then be fed into the probability model to determine what that
    symbol is, and the additional frequency information required to advance to
@@ -128,6 +128,8 @@ void ec_enc_init(ec_enc *_this,unsigned char *_buf,celt_uint32 _size){
   _this->ext=0;
   _this->storage=_size;
   _this->error=0;
+  _this->segs=NULL;
+  _this->seg_lens=NULL;
 }
 
 void ec_encode(ec_enc *_this,unsigned _fl,unsigned _fh,unsigned _ft){
@@ -26,10 +26,16 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "mathops.h"
 #include "stack_alloc.h"
 
+#if defined(ENABLE_SSE) && !defined(FIXED_POINT)
+#include "kiss_fft_sse.h"
+#endif
+
 /* The guts header contains all the multiplication and addition macros that are defined for
    complex numbers.  It also delares the kf_ internal functions.
 */
 
+#ifndef OVERRIDE_KF_BFLY
+
 static void kf_bfly2(
                      kiss_fft_cpx * Fout,
                      const size_t fstride,
@@ -432,6 +438,8 @@ static void ki_bfly5(
 
 #endif
 
+#endif /* OVERRIDE_KF_BFLY */
+
 static void kf_work(
         kiss_fft_cpx * Fout,
         const kiss_fft_cpx * f,
@@ -452,6 +460,9 @@ static void kf_work(
     /* Compensate for longer twiddles table (when sharing) */
     if (st->shift>0)
        fstride <<= st->shift;
+#ifdef OVERRIDE_KF_BFLY
+    kf_bfly_sse(Fout,fstride,st,p,m, N, m2, 0);
+#else
     switch (p) {
         case 2: kf_bfly2(Fout,fstride,st,m, N, m2); break;
         case 4: kf_bfly4(Fout,fstride,st,m, N, m2); break;
@@ -460,6 +471,7 @@ static void kf_work(
         case 5: kf_bfly5(Fout,fstride,st,m, N, m2); break;
 #endif
     }    
+#endif
 }
 
 
@@ -483,6 +495,9 @@ static void ki_work(
    /* Compensate for longer twiddles table (when sharing) */
    if (st->shift>0)
       fstride <<= st->shift;
+#ifdef OVERRIDE_KF_BFLY
+   kf_bfly_sse(Fout,fstride,st,p,m, N, m2, 1);
+#else
    switch (p) {
       case 2: ki_bfly2(Fout,fstride,st,m, N, m2); break;
       case 4: ki_bfly4(Fout,fstride,st,m, N, m2); break;
@@ -491,6 +506,7 @@ static void ki_work(
       case 5: ki_bfly5(Fout,fstride,st,m, N, m2); break;
 #endif
    }    
+#endif
 }
 
 
@@ -0,0 +1,257 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/**
+   @file kiss_fft_sse.h
+   @brief SSE butterflies for the floating-point FFT
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef KISS_FFT_SSE_H
+#define KISS_FFT_SSE_H
+
+#include <xmmintrin.h>
+
+/* Each __m128 holds two complex values {r0, i0, r1, i1} and every
+   butterfly below computes two radix-p butterflies at once. The pairs are
+   taken in the order the scalar code visits them (j first, then i), so a
+   stage with m==1 pairs two sub-transforms and a stage with an odd m
+   still fills both halves of the register. The arithmetic is the same as
+   in kf_bfly*() and ki_bfly*(), operation for operation, which keeps the
+   output bit-exact with the C version. */
+
+#define OVERRIDE_KF_BFLY
+
+/* C_MUL() when sign is {-0,0,-0,0}, C_MULC() when sign is {0,-0,0,-0} */
+static inline __m128 cpx_mul2(__m128 a, __m128 w, __m128 sign)
+{
+   __m128 wr = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2,2,0,0));
+   __m128 wi = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3,3,1,1));
+   __m128 as = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+   return _mm_add_ps(_mm_mul_ps(a, wr), _mm_xor_ps(_mm_mul_ps(as, wi), sign));
+}
+
+/* (x.i, -x.r) when sign is {0,-0,0,-0}, (-x.i, x.r) when sign is {-0,0,-0,0} */
+static inline __m128 cpx_rot2(__m128 x, __m128 sign)
+{
+   return _mm_xor_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(2,3,0,1)), sign);
+}
+
+static inline __m128 cpx_load2(const void *a, const void *b)
+{
+   return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)a), (const __m64*)b);
+}
+
+static inline void cpx_store2(kiss_fft_cpx *a, kiss_fft_cpx *b, __m128 x)
+{
+   _mm_storel_pi((__m64*)a, x);
+   _mm_storeh_pi((__m64*)b, x);
+}
+
+/* Moves (i,j) to the butterfly after (i0,j0), or leaves it on (i0,j0) for
+   the second half of the last pair when the stage has an odd count */
+static inline void bfly_pair(int m, int k, int K, int i0, int j0, int *i1, int *j1)
+{
+   if (k+1==K)
+   {
+      *i1 = i0;
+      *j1 = j0;
+   } else if (j0+1==m) {
+      *i1 = i0+1;
+      *j1 = 0;
+   } else {
+      *i1 = i0;
+      *j1 = j0+1;
+   }
+}
+
+static void kf_bfly2_sse(kiss_fft_cpx *Fout, const size_t fstride,
+      const kiss_fft_state *st, int m, int N, int mm, __m128 sign)
+{
+   const kiss_twiddle_cpx *tw = st->twiddles;
+   int k, K = N*m;
+   int i0=0, j0=0, i1, j1;
+   for (k=0;k<K;k+=2)
+   {
+      kiss_fft_cpx *F0, *F1;
+      __m128 f, t;
+      bfly_pair(m, k, K, i0, j0, &i1, &j1);
+      F0 = Fout + i0*mm + j0;
+      F1 = Fout + i1*mm + j1;
+      t = cpx_mul2(cpx_load2(F0+m, F1+m), cpx_load2(tw+j0*fstride, tw+j1*fstride), sign);
+      f = cpx_load2(F0, F1);
+      cpx_store2(F0+m, F1+m, _mm_sub_ps(f, t));
+      cpx_store2(F0, F1, _mm_add_ps(f, t));
+      i0 = i1;
+      j0 = j1+1;
+      if (j0==m)
+      {
+         i0++;
+         j0 = 0;
+      }
+   }
+}
+
+static void kf_bfly4_sse(kiss_fft_cpx *Fout, const size_t fstride,
+      const kiss_fft_state *st, int m, int N, int mm, __m128 sign)
+{
+   const kiss_twiddle_cpx *tw = st->twiddles;
+   const __m128 rot = _mm_xor_ps(sign, _mm_set1_ps(-0.f));
+   const int m2 = 2*m;
+   const int m3 = 3*m;
+   int k, K = N*m;
+   int i0=0, j0=0, i1, j1;
+   for (k=0;k<K;k+=2)
+   {
+      kiss_fft_cpx *F0, *F1;
+      __m128 f, s0, s1, s2, s3, s4, s5;
+      bfly_pair(m, k, K, i0, j0, &i1, &j1);
+      F0 = Fout + i0*mm + j0;
+      F1 = Fout + i1*mm + j1;
+      s0 = cpx_mul2(cpx_load2(F0+m, F1+m), cpx_load2(tw+j0*fstride, tw+j1*fstride), sign);
+      s1 = cpx_mul2(cpx_load2(F0+m2, F1+m2), cpx_load2(tw+2*j0*fstride, tw+2*j1*fstride), sign);
+      s2 = cpx_mul2(cpx_load2(F0+m3, F1+m3), cpx_load2(tw+3*j0*fstride, tw+3*j1*fstride), sign);
+      f = cpx_load2(F0, F1);
+      s5 = _mm_sub_ps(f, s1);
+      f = _mm_add_ps(f, s1);
+      s3 = _mm_add_ps(s0, s2);
+      s4 = cpx_rot2(_mm_sub_ps(s0, s2), rot);
+      cpx_store2(F0+m2, F1+m2, _mm_sub_ps(f, s3));
+      cpx_store2(F0, F1, _mm_add_ps(f, s3));
+      cpx_store2(F0+m, F1+m, _mm_add_ps(s5, s4));
+      cpx_store2(F0+m3, F1+m3, _mm_sub_ps(s5, s4));
+      i0 = i1;
+      j0 = j1+1;
+      if (j0==m)
+      {
+         i0++;
+         j0 = 0;
+      }
+   }
+}
+
+static void kf_bfly3_sse(kiss_fft_cpx *Fout, const size_t fstride,
+      const kiss_fft_state *st, int m, int N, int mm, __m128 sign)
+{
+   const kiss_twiddle_cpx *tw = st->twiddles;
+   const __m128 rot = _mm_xor_ps(sign, _mm_set1_ps(-0.f));
+   const __m128 epi3 = _mm_set1_ps(st->twiddles[fstride*m].i);
+   const __m128 half = _mm_set1_ps(.5f);
+   const int m2 = 2*m;
+   int k, K = N*m;
+   int i0=0, j0=0, i1, j1;
+   for (k=0;k<K;k+=2)
+   {
+      kiss_fft_cpx *F0, *F1;
+      __m128 f, fm, s0, s1, s2, s3;
+      bfly_pair(m, k, K, i0, j0, &i1, &j1);
+      F0 = Fout + i0*mm + j0;
+      F1 = Fout + i1*mm + j1;
+      s1 = cpx_mul2(cpx_load2(F0+m, F1+m), cpx_load2(tw+j0*fstride, tw+j1*fstride), sign);
+      s2 = cpx_mul2(cpx_load2(F0+m2, F1+m2), cpx_load2(tw+2*j0*fstride, tw+2*j1*fstride), sign);
+      s3 = _mm_add_ps(s1, s2);
+      s0 = _mm_sub_ps(s1, s2);
+      f = cpx_load2(F0, F1);
+      fm = _mm_sub_ps(f, _mm_mul_ps(s3, half));
+      s0 = cpx_rot2(_mm_mul_ps(s0, epi3), rot);
+      cpx_store2(F0, F1, _mm_add_ps(f, s3));
+      cpx_store2(F0+m2, F1+m2, _mm_add_ps(fm, s0));
+      cpx_store2(F0+m, F1+m, _mm_sub_ps(fm, s0));
+      i0 = i1;
+      j0 = j1+1;
+      if (j0==m)
+      {
+         i0++;
+         j0 = 0;
+      }
+   }
+}
+
+static void kf_bfly5_sse(kiss_fft_cpx *Fout, const size_t fstride,
+      const kiss_fft_state *st, int m, int N, int mm, __m128 sign)
+{
+   const kiss_twiddle_cpx *tw = st->twiddles;
+   const __m128 rot = _mm_xor_ps(sign, _mm_set1_ps(-0.f));
+   const __m128 yar = _mm_set1_ps(tw[fstride*m].r);
+   const __m128 yai = _mm_set1_ps(tw[fstride*m].i);
+   const __m128 ybr = _mm_set1_ps(tw[fstride*2*m].r);
+   const __m128 ybi = _mm_set1_ps(tw[fstride*2*m].i);
+   int k, K = N*m;
+   int i0=0, j0=0, i1, j1;
+   for (k=0;k<K;k+=2)
+   {
+      kiss_fft_cpx *F0, *F1;
+      __m128 s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12;
+      bfly_pair(m, k, K, i0, j0, &i1, &j1);
+      F0 = Fout + i0*mm + j0;
+      F1 = Fout + i1*mm + j1;
+      s0 = cpx_load2(F0, F1);
+      s1 = cpx_mul2(cpx_load2(F0+m, F1+m), cpx_load2(tw+j0*fstride, tw+j1*fstride), sign);
+      s2 = cpx_mul2(cpx_load2(F0+2*m, F1+2*m), cpx_load2(tw+2*j0*fstride, tw+2*j1*fstride), sign);
+      s3 = cpx_mul2(cpx_load2(F0+3*m, F1+3*m), cpx_load2(tw+3*j0*fstride, tw+3*j1*fstride), sign);
+      s4 = cpx_mul2(cpx_load2(F0+4*m, F1+4*m), cpx_load2(tw+4*j0*fstride, tw+4*j1*fstride), sign);
+
+      s7 = _mm_add_ps(s1, s4);
+      s10 = _mm_sub_ps(s1, s4);
+      s8 = _mm_add_ps(s2, s3);
+      s9 = _mm_sub_ps(s2, s3);
+
+      cpx_store2(F0, F1, _mm_add_ps(s0, _mm_add_ps(s7, s8)));
+
+      s5 = _mm_add_ps(_mm_add_ps(s0, _mm_mul_ps(s7, yar)), _mm_mul_ps(s8, ybr));
+      s6 = _mm_add_ps(cpx_rot2(_mm_mul_ps(s10, yai), rot), cpx_rot2(_mm_mul_ps(s9, ybi), rot));
+      cpx_store2(F0+m, F1+m, _mm_sub_ps(s5, s6));
+      cpx_store2(F0+4*m, F1+4*m, _mm_add_ps(s5, s6));
+
+      s11 = _mm_add_ps(_mm_add_ps(s0, _mm_mul_ps(s7, ybr)), _mm_mul_ps(s8, yar));
+      s12 = _mm_sub_ps(cpx_rot2(_mm_mul_ps(s9, yai), rot), cpx_rot2(_mm_mul_ps(s10, ybi), rot));
+      cpx_store2(F0+2*m, F1+2*m, _mm_add_ps(s11, s12));
+      cpx_store2(F0+3*m, F1+3*m, _mm_sub_ps(s11, s12));
+      i0 = i1;
+      j0 = j1+1;
+      if (j0==m)
+      {
+         i0++;
+         j0 = 0;
+      }
+   }
+}
+
+/* One FFT stage, forward or inverse. The inverse butterflies only differ
+   by the conjugated twiddles and the direction of the +/-i rotations, both
+   of which are sign flips and therefore exact. */
+static void kf_bfly_sse(kiss_fft_cpx *Fout, const size_t fstride,
+      const kiss_fft_state *st, int p, int m, int N, int mm, int inverse)
+{
+   const __m128 sign = inverse ? _mm_setr_ps(0.f, -0.f, 0.f, -0.f)
+                               : _mm_setr_ps(-0.f, 0.f, -0.f, 0.f);
+   switch (p) {
+      case 2: kf_bfly2_sse(Fout,fstride,st,m, N, mm, sign); break;
+      case 4: kf_bfly4_sse(Fout,fstride,st,m, N, mm, sign); break;
+      case 3: kf_bfly3_sse(Fout,fstride,st,m, N, mm, sign); break;
+      case 5: kf_bfly5_sse(Fout,fstride,st,m, N, mm, sign); break;
+   }
+}
+
+#endif /* KISS_FFT_SSE_H */
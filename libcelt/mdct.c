@@ -57,6 +57,71 @@
 #define M_PI 3.141592653
 #endif
 
+#if defined(ENABLE_SSE) && !defined(FIXED_POINT)
+#include "mdct_sse.h"
+#endif
+
+#ifndef OVERRIDE_MDCT_ROTATIONS
+/* Pre-rotation of one folded input value */
+static inline void pre_rotate(kiss_fft_scalar * restrict yp, kiss_fft_scalar re, kiss_fft_scalar im,
+      kiss_twiddle_scalar c, kiss_twiddle_scalar s, kiss_twiddle_scalar sine)
+{
+   kiss_fft_scalar yr, yi;
+   yr = -S_MUL(re,c)  -  S_MUL(im,s);
+   yi = -S_MUL(im,c)  +  S_MUL(re,s);
+   /* works because the cos is nearly one */
+   yp[0] = yr + S_MUL(yi,sine);
+   yp[1] = yi - S_MUL(yr,sine);
+}
+
+/* Post-rotation of clt_mdct_forward() for the FFT outputs in [start,end) */
+static void forward_post_rotate(const kiss_fft_scalar *f, kiss_fft_scalar * restrict out,
+      const kiss_twiddle_scalar *t, int N4, int shift, kiss_twiddle_scalar sine,
+      int start, int end)
+{
+   /* Temp pointers to make it really clear to the compiler what we're doing */
+   const kiss_fft_scalar * restrict fp = f+2*start;
+   kiss_fft_scalar * restrict yp1 = out+2*start;
+   kiss_fft_scalar * restrict yp2 = out+2*N4-1-2*start;
+   int i;
+   for(i=start;i<end;i++)
+   {
+      kiss_fft_scalar yr, yi;
+      yr = S_MUL(fp[1],t[(N4-i)<<shift]) + S_MUL(fp[0],t[i<<shift]);
+      yi = S_MUL(fp[0],t[(N4-i)<<shift]) - S_MUL(fp[1],t[i<<shift]);
+      /* works because the cos is nearly one */
+      *yp1 = yr - S_MUL(yi,sine);
+      *yp2 = yi + S_MUL(yr,sine);
+      fp += 2;
+      yp1 += 2;
+      yp2 -= 2;
+   }
+}
+
+/* Pre-rotation of clt_mdct_backward() for the input pairs in [start,end) */
+static void backward_pre_rotate(const kiss_fft_scalar *in, kiss_fft_scalar * restrict f2,
+      const kiss_twiddle_scalar *t, int N4, int shift, kiss_twiddle_scalar sine,
+      int start, int end)
+{
+   /* Temp pointers to make it really clear to the compiler what we're doing */
+   const kiss_fft_scalar * restrict xp1 = in+2*start;
+   const kiss_fft_scalar * restrict xp2 = in+2*N4-1-2*start;
+   kiss_fft_scalar * restrict yp = f2+2*start;
+   int i;
+   for(i=start;i<end;i++)
+   {
+      kiss_fft_scalar yr, yi;
+      yr = -S_MUL(*xp2, t[i<<shift]) + S_MUL(*xp1,t[(N4-i)<<shift]);
+      yi =  -S_MUL(*xp2, t[(N4-i)<<shift]) - S_MUL(*xp1,t[i<<shift]);
+      /* works because the cos is nearly one */
+      *yp++ = yr - S_MUL(yi,sine);
+      *yp++ = yi + S_MUL(yr,sine);
+      xp1+=2;
+      xp2-=2;
+   }
+}
+#endif
+
 #ifdef CUSTOM_MODES
 
 void clt_mdct_init(mdct_lookup *l,int N, int maxshift)
@@ -102,9 +167,12 @@ void clt_mdct_clear(mdct_lookup *l)
 
 #endif /* CUSTOM_MODES */
 
-void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * restrict out, const celt_word16 *window, int overlap, int shift)
+void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * restrict out, const celt_word16 *window, int overlap, int shift, int bound)
 {
+#ifndef OVERRIDE_MDCT_ROTATIONS
    int i;
+#endif
+   int lo, hi;
    int N, N2, N4;
    kiss_twiddle_scalar sine;
    VARDECL(kiss_fft_scalar, f);
@@ -122,7 +190,10 @@ void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar
 #endif
 
    /* Consider the input to be composed of four blocks: [a, b, c, d] */
-   /* Window, shuffle, fold */
+#ifdef OVERRIDE_MDCT_ROTATIONS
+   mdct_fold_rotate_sse(in, out, window, overlap, l->trig, N4, shift, sine);
+#else
+   /* Window, shuffle, fold and pre-rotate in a single pass */
    {
       /* Temp pointers to make it really clear to the compiler what we're doing */
       const kiss_fft_scalar * restrict xp1 = in+(overlap>>1);
@@ -130,11 +201,14 @@ void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar
       kiss_fft_scalar * restrict yp = out;
       const celt_word16 * restrict wp1 = window+(overlap>>1);
       const celt_word16 * restrict wp2 = window+(overlap>>1)-1;
+      const kiss_twiddle_scalar *t = &l->trig[0];
       for(i=0;i<(overlap>>2);i++)
       {
          /* Real part arranged as -d-cR, Imag part arranged as -b+aR*/
-         *yp++ = MULT16_32_Q15(*wp2, xp1[N2]) + MULT16_32_Q15(*wp1,*xp2);
-         *yp++ = MULT16_32_Q15(*wp1, *xp1)    - MULT16_32_Q15(*wp2, xp2[-N2]);
+         pre_rotate(yp, MULT16_32_Q15(*wp2, xp1[N2]) + MULT16_32_Q15(*wp1,*xp2),
+                        MULT16_32_Q15(*wp1, *xp1)    - MULT16_32_Q15(*wp2, xp2[-N2]),
+                        t[i<<shift], t[(N4-i)<<shift], sine);
+         yp+=2;
          xp1+=2;
          xp2-=2;
          wp1+=2;
@@ -145,70 +219,49 @@ void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar
       for(;i<N4-(overlap>>2);i++)
       {
          /* Real part arranged as a-bR, Imag part arranged as -c-dR */
-         *yp++ = *xp2;
-         *yp++ = *xp1;
+         pre_rotate(yp, *xp2, *xp1, t[i<<shift], t[(N4-i)<<shift], sine);
+         yp+=2;
          xp1+=2;
          xp2-=2;
       }
       for(;i<N4;i++)
       {
          /* Real part arranged as a-bR, Imag part arranged as -c-dR */
-         *yp++ =  -MULT16_32_Q15(*wp1, xp1[-N2]) + MULT16_32_Q15(*wp2, *xp2);
-         *yp++ = MULT16_32_Q15(*wp2, *xp1)     + MULT16_32_Q15(*wp1, xp2[N2]);
+         pre_rotate(yp, -MULT16_32_Q15(*wp1, xp1[-N2]) + MULT16_32_Q15(*wp2, *xp2),
+                        MULT16_32_Q15(*wp2, *xp1)     + MULT16_32_Q15(*wp1, xp2[N2]),
+                        t[i<<shift], t[(N4-i)<<shift], sine);
+         yp+=2;
          xp1+=2;
          xp2-=2;
          wp1+=2;
          wp2-=2;
       }
    }
-   /* Pre-rotation */
-   {
-      kiss_fft_scalar * restrict yp = out;
-      const kiss_twiddle_scalar *t = &l->trig[0];
-      for(i=0;i<N4;i++)
-      {
-         kiss_fft_scalar re, im, yr, yi;
-         re = yp[0];
-         im = yp[1];
-         yr = -S_MUL(re,t[i<<shift])  -  S_MUL(im,t[(N4-i)<<shift]);
-         yi = -S_MUL(im,t[i<<shift])  +  S_MUL(re,t[(N4-i)<<shift]);
-         /* works because the cos is nearly one */
-         *yp++ = yr + S_MUL(yi,sine);
-         *yp++ = yi - S_MUL(yr,sine);
-      }
-   }
+#endif
 
    /* N/4 complex FFT, down-scales by 4/N */
    kiss_fft(l->kfft[shift], (kiss_fft_cpx *)out, (kiss_fft_cpx *)f);
 
-   /* Post-rotate */
-   {
-      /* Temp pointers to make it really clear to the compiler what we're doing */
-      const kiss_fft_scalar * restrict fp = f;
-      kiss_fft_scalar * restrict yp1 = out;
-      kiss_fft_scalar * restrict yp2 = out+N2-1;
-      const kiss_twiddle_scalar *t = &l->trig[0];
-      /* Temp pointers to make it really clear to the compiler what we're doing */
-      for(i=0;i<N4;i++)
-      {
-         kiss_fft_scalar yr, yi;
-         yr = S_MUL(fp[1],t[(N4-i)<<shift]) + S_MUL(fp[0],t[i<<shift]);
-         yi = S_MUL(fp[0],t[(N4-i)<<shift]) - S_MUL(fp[1],t[i<<shift]);
-         /* works because the cos is nearly one */
-         *yp1 = yr - S_MUL(yi,sine);
-         *yp2 = yi + S_MUL(yr,sine);;
-         fp += 2;
-         yp1 += 2;
-         yp2 -= 2;
-      }
-   }
+   /* Post-rotate. Each FFT output gives a bin from the bottom and one from
+      the top of the spectrum, so the outputs in [lo,hi) only give bins
+      above the bound, and those are set to zero. */
+   lo = IMIN(N4, (bound+1)>>1);
+   hi = IMAX(lo, N4-(bound>>1));
+#ifdef OVERRIDE_MDCT_ROTATIONS
+   mdct_post_rotate_sse(f, out, l->trig, N4, shift, sine, lo, hi);
+#else
+   forward_post_rotate(f, out, l->trig, N4, shift, sine, 0, lo);
+   forward_post_rotate(f, out, l->trig, N4, shift, sine, hi, N4);
+   for (i=lo;i<hi;i++)
+      out[2*i] = out[N2-1-2*i] = 0;
+#endif
    RESTORE_STACK;
 }
 
 
-void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * restrict out, const celt_word16 * restrict window, int overlap, int shift)
+void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * restrict out, const celt_word16 * restrict window, int overlap, int shift, int bound)
 {
-   int i;
+   int i, lo, hi;
    int N, N2, N4;
    kiss_twiddle_scalar sine;
    VARDECL(kiss_fft_scalar, f);
@@ -227,32 +280,33 @@ void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scala
    sine = (kiss_twiddle_scalar)2*M_PI*(.125f)/N;
 #endif
    
-   /* Pre-rotate */
-   {
-      /* Temp pointers to make it really clear to the compiler what we're doing */
-      const kiss_fft_scalar * restrict xp1 = in;
-      const kiss_fft_scalar * restrict xp2 = in+N2-1;
-      kiss_fft_scalar * restrict yp = f2;
-      const kiss_twiddle_scalar *t = &l->trig[0];
-      for(i=0;i<N4;i++) 
-      {
-         kiss_fft_scalar yr, yi;
-         yr = -S_MUL(*xp2, t[i<<shift]) + S_MUL(*xp1,t[(N4-i)<<shift]);
-         yi =  -S_MUL(*xp2, t[(N4-i)<<shift]) - S_MUL(*xp1,t[i<<shift]);
-         /* works because the cos is nearly one */
-         *yp++ = yr - S_MUL(yi,sine);
-         *yp++ = yi + S_MUL(yr,sine);
-         xp1+=2;
-         xp2-=2;
-      }
-   }
+   /* Pre-rotate. Each pair of inputs combines a bin from the bottom of the
+      spectrum with one from the top, so the pairs in [lo,hi) have both
+      bins above the bound and rotate to zeros. */
+   lo = IMIN(N4, (bound+1)>>1);
+   hi = IMAX(lo, N4-(bound>>1));
+#ifdef OVERRIDE_MDCT_ROTATIONS
+   mdct_backward_pre_rotate_sse(in, f2, l->trig, N4, shift, sine, 0, lo);
+   mdct_backward_pre_rotate_sse(in, f2, l->trig, N4, shift, sine, hi, N4);
+#else
+   backward_pre_rotate(in, f2, l->trig, N4, shift, sine, 0, lo);
+   backward_pre_rotate(in, f2, l->trig, N4, shift, sine, hi, N4);
+#endif
+   for (i=2*lo;i<2*hi;i++)
+      f2[i] = 0;
 
    /* Inverse N/4 complex FFT. This one should *not* downscale even in fixed-point */
    kiss_ifft(l->kfft[shift], (kiss_fft_cpx *)f2, (kiss_fft_cpx *)f);
    
-   /* Post-rotate */
+   /* Post-rotate and de-shuffle the components for the middle of the window
+      in a single pass */
+#ifdef OVERRIDE_MDCT_ROTATIONS
+   mdct_backward_post_rotate_sse(f, f2, l->trig, N4, shift, sine);
+#else
    {
-      kiss_fft_scalar * restrict fp = f;
+      const kiss_fft_scalar * restrict fp = f;
+      kiss_fft_scalar * restrict yp1 = f2;
+      kiss_fft_scalar * restrict yp2 = f2+N2-1;
       const kiss_twiddle_scalar *t = &l->trig[0];
 
       for(i=0;i<N4;i++)
@@ -264,23 +318,14 @@ void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scala
          yr = S_MUL(re,t[i<<shift]) - S_MUL(im,t[(N4-i)<<shift]);
          yi = S_MUL(im,t[i<<shift]) + S_MUL(re,t[(N4-i)<<shift]);
          /* works because the cos is nearly one */
-         *fp++ = yr - S_MUL(yi,sine);
-         *fp++ = yi + S_MUL(yr,sine);
-      }
-   }
-   /* De-shuffle the components for the middle of the window only */
-   {
-      const kiss_fft_scalar * restrict fp1 = f;
-      const kiss_fft_scalar * restrict fp2 = f+N2-1;
-      kiss_fft_scalar * restrict yp = f2;
-      for(i = 0; i < N4; i++)
-      {
-         *yp++ =-*fp1;
-         *yp++ = *fp2;
-         fp1 += 2;
-         fp2 -= 2;
+         *yp1 = -(yr - S_MUL(yi,sine));
+         *yp2 = yi + S_MUL(yr,sine);
+         fp += 2;
+         yp1 += 2;
+         yp2 -= 2;
       }
    }
+#endif
    out -= (N2-overlap)>>1;
    /* Mirror on both sides for TDAC */
    {
@@ -55,11 +55,14 @@ typedef struct {
 void clt_mdct_init(mdct_lookup *l,int N, int maxshift);
 void clt_mdct_clear(mdct_lookup *l);
 
-/** Compute a forward MDCT and scale by 4/N */
-void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar *out, const celt_word16 *window, int overlap, int shift);
+/** Compute a forward MDCT and scale by 4/N. Only the outputs below bound
+    are needed (N/2 for all of them): the rotations that only produce
+    higher ones are skipped and those outputs are set to zero. */
+void clt_mdct_forward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar *out, const celt_word16 *window, int overlap, int shift, int bound);
 
 /** Compute a backward MDCT (no scaling) and performs weighted overlap-add 
-    (scales implicitly by 1/2) */
-void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar *out, const celt_word16 * restrict window, int overlap, int shift);
+    (scales implicitly by 1/2). The inputs from bound on must be zero (N/2
+    if none are), and the rotations of those are skipped. */
+void clt_mdct_backward(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar *out, const celt_word16 * restrict window, int overlap, int shift, int bound);
 
 #endif
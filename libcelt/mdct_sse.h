@@ -0,0 +1,291 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/**
+   @file mdct_sse.h
+   @brief SSE folding and rotations for the floating-point MDCT
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MDCT_SSE_H
+#define MDCT_SSE_H
+
+#include <xmmintrin.h>
+
+/* These replace the loops around the FFT in clt_mdct_forward() and
+   clt_mdct_backward(). Four consecutive complex values are handled at
+   once, with the real and imaginary parts de-interleaved into separate
+   registers. Each function computes exactly what the C loop computes, in
+   the same order, so the output is bit-exact with it. */
+
+#define OVERRIDE_MDCT_ROTATIONS
+
+/* {p[0], p[2], p[4], p[6]} */
+static inline __m128 mdct_load_even(const float *p)
+{
+   return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p+3), _MM_SHUFFLE(3,1,2,0));
+}
+
+/* {p[0], p[-2], p[-4], p[-6]} */
+static inline __m128 mdct_load_rev(const float *p)
+{
+   return _mm_shuffle_ps(_mm_loadu_ps(p-3), _mm_loadu_ps(p-6), _MM_SHUFFLE(0,2,1,3));
+}
+
+/* {t[i<<shift], t[(i+1)<<shift], t[(i+2)<<shift], t[(i+3)<<shift]} */
+static inline __m128 mdct_trig(const kiss_twiddle_scalar *t, int i, int shift)
+{
+   if (shift==0)
+      return _mm_loadu_ps(t+i);
+   return _mm_setr_ps(t[i<<shift], t[(i+1)<<shift], t[(i+2)<<shift], t[(i+3)<<shift]);
+}
+
+/* {t[i<<shift], t[(i-1)<<shift], t[(i-2)<<shift], t[(i-3)<<shift]} */
+static inline __m128 mdct_trig_rev(const kiss_twiddle_scalar *t, int i, int shift)
+{
+   if (shift==0)
+   {
+      __m128 x = _mm_loadu_ps(t+i-3);
+      return _mm_shuffle_ps(x, x, _MM_SHUFFLE(0,1,2,3));
+   }
+   return _mm_setr_ps(t[i<<shift], t[(i-1)<<shift], t[(i-2)<<shift], t[(i-3)<<shift]);
+}
+
+static inline __m128 mdct_reverse(__m128 x)
+{
+   return _mm_shuffle_ps(x, x, _MM_SHUFFLE(0,1,2,3));
+}
+
+static inline void mdct_store_cpx(float *p, __m128 re, __m128 im)
+{
+   _mm_storeu_ps(p, _mm_unpacklo_ps(re, im));
+   _mm_storeu_ps(p+4, _mm_unpackhi_ps(re, im));
+}
+
+/* Same as pre_rotate() in mdct.c, for four values */
+static inline void mdct_pre_rotate4(float *yp, __m128 re, __m128 im, __m128 c, __m128 s, __m128 sine)
+{
+   const __m128 neg = _mm_set1_ps(-0.f);
+   __m128 yr, yi;
+   yr = _mm_sub_ps(_mm_xor_ps(_mm_mul_ps(re, c), neg), _mm_mul_ps(im, s));
+   yi = _mm_add_ps(_mm_xor_ps(_mm_mul_ps(im, c), neg), _mm_mul_ps(re, s));
+   mdct_store_cpx(yp, _mm_add_ps(yr, _mm_mul_ps(yi, sine)),
+                      _mm_sub_ps(yi, _mm_mul_ps(yr, sine)));
+}
+
+static inline void mdct_pre_rotate1(float *yp, float re, float im, float c, float s, float sine)
+{
+   float yr, yi;
+   yr = -(re*c) - im*s;
+   yi = -(im*c) + re*s;
+   yp[0] = yr + yi*sine;
+   yp[1] = yi - yr*sine;
+}
+
+/* Window, shuffle, fold and pre-rotate for clt_mdct_forward() */
+static void mdct_fold_rotate_sse(const float *in, float * restrict out,
+      const float *window, int overlap, const kiss_twiddle_scalar *t,
+      int N4, int shift, float sine)
+{
+   const int N2 = N4<<1;
+   const __m128 sine4 = _mm_set1_ps(sine);
+   const float *xp1 = in+(overlap>>1);
+   const float *xp2 = in+N2-1+(overlap>>1);
+   const float *wp1 = window+(overlap>>1);
+   const float *wp2 = window+(overlap>>1)-1;
+   int i, end;
+
+   /* Real part arranged as -d-cR, Imag part arranged as -b+aR*/
+   end = overlap>>2;
+   for(i=0;i+4<=end;i+=4)
+   {
+      __m128 w1 = mdct_load_even(wp1+2*i);
+      __m128 w2 = mdct_load_rev(wp2-2*i);
+      __m128 re = _mm_add_ps(_mm_mul_ps(w2, mdct_load_even(xp1+2*i+N2)),
+                             _mm_mul_ps(w1, mdct_load_rev(xp2-2*i)));
+      __m128 im = _mm_sub_ps(_mm_mul_ps(w1, mdct_load_even(xp1+2*i)),
+                             _mm_mul_ps(w2, mdct_load_rev(xp2-2*i-N2)));
+      mdct_pre_rotate4(out+2*i, re, im, mdct_trig(t, i, shift), mdct_trig_rev(t, N4-i, shift), sine4);
+   }
+   for(;i<end;i++)
+      mdct_pre_rotate1(out+2*i, wp2[-2*i]*xp1[2*i+N2] + wp1[2*i]*xp2[-2*i],
+                                wp1[2*i]*xp1[2*i] - wp2[-2*i]*xp2[-2*i-N2],
+                                t[i<<shift], t[(N4-i)<<shift], sine);
+
+   /* Real part arranged as a-bR, Imag part arranged as -c-dR */
+   end = N4-(overlap>>2);
+   for(;i+4<=end;i+=4)
+      mdct_pre_rotate4(out+2*i, mdct_load_rev(xp2-2*i), mdct_load_even(xp1+2*i),
+                       mdct_trig(t, i, shift), mdct_trig_rev(t, N4-i, shift), sine4);
+   for(;i<end;i++)
+      mdct_pre_rotate1(out+2*i, xp2[-2*i], xp1[2*i], t[i<<shift], t[(N4-i)<<shift], sine);
+
+   /* Real part arranged as a-bR, Imag part arranged as -c-dR */
+   wp1 = window;
+   wp2 = window+overlap-1;
+   for(;i+4<=N4;i+=4)
+   {
+      int n = 2*(i-end);
+      __m128 w1 = mdct_load_even(wp1+n);
+      __m128 w2 = mdct_load_rev(wp2-n);
+      __m128 re = _mm_sub_ps(_mm_mul_ps(w2, mdct_load_rev(xp2-2*i)),
+                             _mm_mul_ps(w1, mdct_load_even(xp1+2*i-N2)));
+      __m128 im = _mm_add_ps(_mm_mul_ps(w2, mdct_load_even(xp1+2*i)),
+                             _mm_mul_ps(w1, mdct_load_rev(xp2-2*i+N2)));
+      mdct_pre_rotate4(out+2*i, re, im, mdct_trig(t, i, shift), mdct_trig_rev(t, N4-i, shift), sine4);
+   }
+   for(;i<N4;i++)
+   {
+      int n = 2*(i-end);
+      mdct_pre_rotate1(out+2*i, -(wp1[n]*xp1[2*i-N2]) + wp2[-n]*xp2[-2*i],
+                                wp2[-n]*xp1[2*i] + wp1[n]*xp2[-2*i+N2],
+                                t[i<<shift], t[(N4-i)<<shift], sine);
+   }
+}
+
+/* The post-rotations turn the i-th input into one value for y[2*i] and
+   one for y[N2-1-2*i], so the back values land in the odd slots of the
+   mirrored block. Doing the blocks that start at i and N4-4-i together
+   gives two contiguous output blocks per pass. */
+static inline void mdct_store_ends(float *y, int N4, int i, __m128 frontA, __m128 backA,
+      __m128 frontB, __m128 backB)
+{
+   mdct_store_cpx(y+2*i, frontA, mdct_reverse(backB));
+   mdct_store_cpx(y+2*(N4-4-i), frontB, mdct_reverse(backA));
+}
+
+/* Post-rotation for clt_mdct_forward(). The outputs in [lo,hi) are set to
+   zero instead, and the blocks from both ends stop once they are past lo,
+   since the top ones have then also covered everything from hi. */
+static void mdct_post_rotate_sse(const float *f, float * restrict out,
+      const kiss_twiddle_scalar *t, int N4, int shift, float sine, int lo, int hi)
+{
+   const int N2 = N4<<1;
+   const __m128 sine4 = _mm_set1_ps(sine);
+   int i, end;
+   for(i=0;2*i+8<=N4 && i<lo;i+=4)
+   {
+      __m128 o1[2], o2[2];
+      int k;
+      for (k=0;k<2;k++)
+      {
+         /* Block A starts at i, block B at N4-4-i */
+         int j = k ? N4-4-i : i;
+         __m128 a = _mm_loadu_ps(f+2*j);
+         __m128 b = _mm_loadu_ps(f+2*j+4);
+         __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+         __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+         __m128 c = mdct_trig(t, j, shift);
+         __m128 s = mdct_trig_rev(t, N4-j, shift);
+         __m128 yr = _mm_add_ps(_mm_mul_ps(im, s), _mm_mul_ps(re, c));
+         __m128 yi = _mm_sub_ps(_mm_mul_ps(re, s), _mm_mul_ps(im, c));
+         o1[k] = _mm_sub_ps(yr, _mm_mul_ps(yi, sine4));
+         o2[k] = _mm_add_ps(yi, _mm_mul_ps(yr, sine4));
+      }
+      mdct_store_ends(out, N4, i, o1[0], o2[0], o1[1], o2[1]);
+   }
+   end = N4-i;
+   for(;i<end;i++)
+   {
+      float yr, yi;
+      if (i>=lo && i<hi)
+      {
+         out[2*i] = out[N2-1-2*i] = 0;
+         continue;
+      }
+      yr = f[2*i+1]*t[(N4-i)<<shift] + f[2*i]*t[i<<shift];
+      yi = f[2*i]*t[(N4-i)<<shift] - f[2*i+1]*t[i<<shift];
+      out[2*i] = yr - yi*sine;
+      out[N2-1-2*i] = yi + yr*sine;
+   }
+}
+
+/* Pre-rotation for clt_mdct_backward(), for the pairs in [start,end) */
+static void mdct_backward_pre_rotate_sse(const float *in, float * restrict f2,
+      const kiss_twiddle_scalar *t, int N4, int shift, float sine, int start, int end)
+{
+   const int N2 = N4<<1;
+   const __m128 sine4 = _mm_set1_ps(sine);
+   int i;
+   for(i=start;i+4<=end;i+=4)
+   {
+      __m128 x1 = mdct_load_even(in+2*i);
+      __m128 x2 = mdct_load_rev(in+N2-1-2*i);
+      __m128 c = mdct_trig(t, i, shift);
+      __m128 s = mdct_trig_rev(t, N4-i, shift);
+      __m128 yr = _mm_sub_ps(_mm_mul_ps(x1, s), _mm_mul_ps(x2, c));
+      __m128 yi = _mm_sub_ps(_mm_xor_ps(_mm_mul_ps(x2, s), _mm_set1_ps(-0.f)), _mm_mul_ps(x1, c));
+      mdct_store_cpx(f2+2*i, _mm_sub_ps(yr, _mm_mul_ps(yi, sine4)),
+                             _mm_add_ps(yi, _mm_mul_ps(yr, sine4)));
+   }
+   for(;i<end;i++)
+   {
+      float yr, yi;
+      yr = -(in[N2-1-2*i]*t[i<<shift]) + in[2*i]*t[(N4-i)<<shift];
+      yi = -(in[N2-1-2*i]*t[(N4-i)<<shift]) - in[2*i]*t[i<<shift];
+      f2[2*i] = yr - yi*sine;
+      f2[2*i+1] = yi + yr*sine;
+   }
+}
+
+/* Post-rotation and de-shuffle for clt_mdct_backward() */
+static void mdct_backward_post_rotate_sse(const float *f, float * restrict f2,
+      const kiss_twiddle_scalar *t, int N4, int shift, float sine)
+{
+   const int N2 = N4<<1;
+   const __m128 sine4 = _mm_set1_ps(sine);
+   const __m128 neg = _mm_set1_ps(-0.f);
+   int i, end;
+   for(i=0;2*i+8<=N4;i+=4)
+   {
+      __m128 o1[2], o2[2];
+      int k;
+      for (k=0;k<2;k++)
+      {
+         int j = k ? N4-4-i : i;
+         __m128 a = _mm_loadu_ps(f+2*j);
+         __m128 b = _mm_loadu_ps(f+2*j+4);
+         __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+         __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+         __m128 c = mdct_trig(t, j, shift);
+         __m128 s = mdct_trig_rev(t, N4-j, shift);
+         __m128 yr = _mm_sub_ps(_mm_mul_ps(re, c), _mm_mul_ps(im, s));
+         __m128 yi = _mm_add_ps(_mm_mul_ps(im, c), _mm_mul_ps(re, s));
+         o1[k] = _mm_xor_ps(_mm_sub_ps(yr, _mm_mul_ps(yi, sine4)), neg);
+         o2[k] = _mm_add_ps(yi, _mm_mul_ps(yr, sine4));
+      }
+      mdct_store_ends(f2, N4, i, o1[0], o2[0], o1[1], o2[1]);
+   }
+   end = N4-i;
+   for(;i<end;i++)
+   {
+      float yr, yi;
+      yr = f[2*i]*t[i<<shift] - f[2*i+1]*t[(N4-i)<<shift];
+      yi = f[2*i+1]*t[i<<shift] + f[2*i]*t[(N4-i)<<shift];
+      f2[2*i] = -(yr - yi*sine);
+      f2[N2-1-2*i] = yi + yr*sine;
+   }
+}
+
+#endif /* MDCT_SSE_H */
@@ -238,6 +238,27 @@ static void compute_allocation_table(CELTMode *mode)
    mode->allocVectors = allocVectors;
 }
 
+#ifdef ENABLE_SCRATCH_ARENA
+/* A mode has no arena of its own, so the one needed to build the pulse
+   cache is only borrowed for the call */
+static int pulse_cache_with_scratch(CELTMode *mode)
+{
+   char *saved_stack = global_stack;
+   char *saved_top = global_stack_top;
+   char *saved_arena = scratch_arena;
+   char *arena = (char*)celt_alloc_scratch(GLOBAL_STACK_SIZE);
+   if (arena==NULL)
+      return CELT_ALLOC_FAIL;
+   ALLOC_STATE_STACK(arena, GLOBAL_STACK_SIZE);
+   compute_pulse_cache(mode, mode->maxLM);
+   global_stack = saved_stack;
+   global_stack_top = saved_top;
+   scratch_arena = saved_arena;
+   celt_free(arena);
+   return CELT_OK;
+}
+#endif /* ENABLE_SCRATCH_ARENA */
+
 #endif /* CUSTOM_MODES */
 
 CELTMode *celt_mode_create(celt_int32 Fs, int frame_size, int *error)
@@ -259,7 +280,7 @@ CELTMode *celt_mode_create(celt_int32 Fs, int frame_size, int *error)
       scanf("%d ", band_allocation+i);
    }
 #endif
-#ifdef CUSTOM_MODES
+#if defined(CUSTOM_MODES) && !defined(ENABLE_SCRATCH_ARENA)
    ALLOC_STACK;
 #if !defined(VAR_ARRAYS) && !defined(USE_ALLOCA)
    if (global_stack==NULL)
@@ -409,7 +430,12 @@ CELTMode *celt_mode_create(celt_int32 Fs, int frame_size, int *error)
       logN[i] = log2_frac(mode->eBands[i+1]-mode->eBands[i], BITRES);
    mode->logN = logN;
 
+#ifdef ENABLE_SCRATCH_ARENA
+   if (pulse_cache_with_scratch(mode)!=CELT_OK)
+      goto failure;
+#else
    compute_pulse_cache(mode, mode->maxLM);
+#endif
 
    clt_mdct_init(&mode->mdct, 2*mode->shortMdctSize*mode->nbShortMdcts, mode->maxLM);
    if ((mode->mdct.trig==NULL)
@@ -456,6 +482,8 @@ void celt_mode_destroy(CELTMode *mode)
    celt_free((celt_int16*)mode->cache.index);
    celt_free((unsigned char*)mode->cache.bits);
    celt_free((unsigned char*)mode->cache.caps);
+   celt_free((celt_int32*)mode->cwrs.index);
+   celt_free((celt_uint32*)mode->cwrs.u);
    clt_mdct_clear(&mode->mdct);
 
    celt_free((CELTMode *)mode);
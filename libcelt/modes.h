@@ -34,6 +34,7 @@
 #include "celt.h"
 #include "arch.h"
 #include "mdct.h"
+#include "cwrs.h"
 #include "entenc.h"
 #include "entdec.h"
 
@@ -91,6 +92,7 @@ struct CELTMode {
    const celt_int16 *logN;
 
    PulseCache cache;
+   CWRSTable cwrs;
 };
 
 #ifndef OPUS_BUILD
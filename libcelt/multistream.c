@@ -0,0 +1,820 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Multistream encoder and decoder: more than two channels are coded as
+   several mono and stereo streams, each with its own encoder or decoder on
+   the same mode. A packet is the packets of all the streams one after the
+   other, each but the last one preceded by its size (one byte below 252,
+   two bytes up to 1275). The bytes and the bitrate are shared between the
+   streams by weights, which are fixed by the type of the stream, or with
+   CELT_SET_JOINT_RATE follow what each stream needs in every frame. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include "celt.h"
+#include "modes.h"
+#include "arch.h"
+#include "os_support.h"
+
+/* Each encoder and decoder starts on its own cache line, which also
+   satisfies the alignment of the states with --enable-aligned-state */
+#define MS_ALIGNMENT 64
+#define MS_ALIGN(size) (((size)+MS_ALIGNMENT-1)&~(MS_ALIGNMENT-1))
+
+/* Share of the bytes and the bitrate of a stereo and a mono stream */
+#define MS_COUPLED_WEIGHT 3
+#define MS_MONO_WEIGHT 2
+
+/* With CELT_SET_JOINT_RATE, the weights add up to about 1 in Q15, of which
+   half is shared as without it and half by celt_encoder_frame_demand() */
+#define MS_JOINT_BASE 16384
+#define MS_JOINT_DEMAND 16384
+#define MS_MAX_DEMAND 65535
+
+#define MS_MAX_CHANNELS 255
+
+#ifdef DISABLE_FLOAT_API
+#define MS_SAMPLE_SIZE ((int)sizeof(celt_int16))
+#else
+#define MS_SAMPLE_SIZE ((int)sizeof(float))
+#endif
+
+typedef struct {
+   void *st;                 /* CELTEncoder or CELTDecoder */
+   void *pcm;                /* Deinterleaved input or output of the stream */
+   int channel[2];           /* Encoder input channel of each stream channel, or -1 */
+   unsigned char *data;      /* Packet of the stream */
+   int bytes;                /* Its maximum size, or its size in the decoder */
+   int ret;                  /* What the stream's encoder or decoder returned */
+   celt_int32 weight;        /* Share of the bytes and the bitrate, or the
+                                demand of the frame before it is turned into one */
+} MSStream;
+
+/* Common part of the encoder and decoder */
+typedef struct {
+   const CELTMode *mode;
+   int channels;
+   int nb_streams;
+   int nb_coupled;
+   unsigned char mapping[MS_MAX_CHANNELS];
+   CELTThreadPool pool;
+   /* Encoder only: sum of the weights of the streams, whether they follow
+      the demands, and the bitrate to share (0 if not set) */
+   celt_int32 weights;
+   int joint;
+   celt_int32 bitrate;
+   /* Arguments of the call being processed */
+   const void *pcm_in;
+   int float_api;
+   int frame_size;
+} MSCommon;
+
+struct CELTMSEncoder {
+   MSCommon ms;
+};
+
+struct CELTMSDecoder {
+   MSCommon ms;
+};
+
+static int stream_channels(const MSCommon *ms, int s)
+{
+   return s < ms->nb_coupled ? 2 : 1;
+}
+
+static MSStream *ms_streams(const MSCommon *ms)
+{
+   return (MSStream*)((char*)ms + MS_ALIGN(sizeof(MSCommon)));
+}
+
+static int ms_pcm_size(const CELTMode *mode, int channels)
+{
+   return MS_ALIGN(channels*(mode->shortMdctSize<<mode->maxLM)*MS_SAMPLE_SIZE);
+}
+
+static int ms_check_layout(const CELTMode *mode, int streams, int coupled_streams)
+{
+   return mode!=NULL && streams>=1 && coupled_streams>=0 && coupled_streams<=streams
+         && streams+coupled_streams<=MS_MAX_CHANNELS;
+}
+
+/* Size of the state, with the stream states of state_size() bytes each */
+static int ms_get_size(const CELTMode *mode, int streams, int coupled_streams,
+      int (*state_size)(const CELTMode *, int))
+{
+   int s, size;
+   if (!ms_check_layout(mode, streams, coupled_streams))
+      return 0;
+   size = MS_ALIGN(sizeof(MSCommon)) + MS_ALIGN(streams*sizeof(MSStream));
+   for (s=0;s<streams;s++)
+   {
+      int C = s < coupled_streams ? 2 : 1;
+      size += MS_ALIGN(state_size(mode, C)) + ms_pcm_size(mode, C);
+   }
+   return size;
+}
+
+/* The weights of the stream types */
+static void ms_static_weights(MSCommon *ms)
+{
+   MSStream *stream = ms_streams(ms);
+   int s;
+   ms->weights = 0;
+   for (s=0;s<ms->nb_streams;s++)
+   {
+      stream[s].weight = s < ms->nb_coupled ? MS_COUPLED_WEIGHT : MS_MONO_WEIGHT;
+      ms->weights += stream[s].weight;
+   }
+}
+
+/* Sets up everything but the stream states, which are returned in
+   streams[s].st */
+static int ms_init(MSCommon *ms, const CELTMode *mode, int channels, int streams,
+      int coupled_streams, const unsigned char *mapping, int (*state_size)(const CELTMode *, int))
+{
+   int s, c;
+   char *ptr;
+   MSStream *stream;
+
+   if (!ms_check_layout(mode, streams, coupled_streams) || channels<1
+         || channels>MS_MAX_CHANNELS || mapping==NULL)
+      return CELT_BAD_ARG;
+   for (c=0;c<channels;c++)
+      if (mapping[c]>=streams+coupled_streams && mapping[c]!=255)
+         return CELT_BAD_ARG;
+
+   CELT_MEMSET((char*)ms, 0, ms_get_size(mode, streams, coupled_streams, state_size));
+   ms->mode = mode;
+   ms->channels = channels;
+   ms->nb_streams = streams;
+   ms->nb_coupled = coupled_streams;
+   CELT_COPY(ms->mapping, mapping, channels);
+
+   stream = ms_streams(ms);
+   ptr = (char*)stream + MS_ALIGN(streams*sizeof(MSStream));
+   for (s=0;s<streams;s++)
+   {
+      int C = stream_channels(ms, s);
+      stream[s].st = ptr;
+      ptr += MS_ALIGN(state_size(mode, C));
+      stream[s].pcm = ptr;
+      ptr += ms_pcm_size(mode, C);
+      /* The first input channel coded in each channel of the stream */
+      stream[s].channel[0] = stream[s].channel[1] = -1;
+      for (c=channels-1;c>=0;c--)
+      {
+         int k = mapping[c];
+         if (s < coupled_streams && k>>1 == s)
+            stream[s].channel[k&1] = c;
+         else if (s >= coupled_streams && k == coupled_streams+s)
+            stream[s].channel[0] = c;
+      }
+   }
+   ms_static_weights(ms);
+   return CELT_OK;
+}
+
+/* Calls job() for all the streams, on the thread pool if there is one */
+static void ms_run(MSCommon *ms, void (*job)(void *, int))
+{
+   int s;
+   if (ms->pool.run!=NULL && ms->nb_streams>1)
+      ms->pool.run(ms->pool.pool, job, ms, ms->nb_streams);
+   else
+      for (s=0;s<ms->nb_streams;s++)
+         job(ms, s);
+}
+
+/* Stream s's share of total, split so that nothing overflows with the
+   weights of CELT_SET_JOINT_RATE */
+static int ms_share(const MSCommon *ms, int s, celt_int32 total)
+{
+   celt_int32 w = ms_streams(ms)[s].weight;
+   return (int)(total/ms->weights*w + total%ms->weights*w/ms->weights);
+}
+
+/* Turns the demands in stream[].weight into weights: half of the total
+   as by the stream types, so that no stream goes without, and half in
+   proportion to the demands */
+static void ms_joint_weights(MSCommon *ms)
+{
+   MSStream *stream = ms_streams(ms);
+   int s;
+   celt_int32 demand = 0;
+   int types = MS_COUPLED_WEIGHT*ms->nb_coupled + MS_MONO_WEIGHT*(ms->nb_streams-ms->nb_coupled);
+
+   for (s=0;s<ms->nb_streams;s++)
+   {
+      stream[s].weight = IMAX(0, IMIN(MS_MAX_DEMAND, stream[s].weight));
+      demand += stream[s].weight;
+   }
+   if (demand==0)
+   {
+      ms_static_weights(ms);
+      return;
+   }
+   ms->weights = 0;
+   for (s=0;s<ms->nb_streams;s++)
+   {
+      int type = s < ms->nb_coupled ? MS_COUPLED_WEIGHT : MS_MONO_WEIGHT;
+      stream[s].weight = MS_JOINT_BASE*type/types + MS_JOINT_DEMAND*stream[s].weight/demand;
+      ms->weights += stream[s].weight;
+   }
+}
+
+static int ms_length_bytes(int len)
+{
+   return len < 252 ? 1 : 2;
+}
+
+static int ms_write_length(unsigned char *data, int len)
+{
+   if (len < 252)
+   {
+      data[0] = len;
+      return 1;
+   }
+   data[0] = 252 + (len&3);
+   data[1] = (len-data[0])>>2;
+   return 2;
+}
+
+static int ms_read_length(const unsigned char *data, int len, int *size)
+{
+   if (len<1)
+      return -1;
+   if (data[0] < 252)
+   {
+      *size = data[0];
+      return 1;
+   }
+   if (len<2)
+      return -1;
+   *size = 4*data[1] + data[0];
+   return 2;
+}
+
+/* Size of a packet with the stream sizes in stream[].bytes */
+static int ms_packet_size(const MSCommon *ms)
+{
+   const MSStream *stream = ms_streams(ms);
+   int s, size = 0;
+   for (s=0;s<ms->nb_streams;s++)
+   {
+      size += stream[s].bytes;
+      if (s<ms->nb_streams-1)
+         size += ms_length_bytes(stream[s].bytes);
+   }
+   return size;
+}
+
+/* Shares maxCompressedBytes between the streams, once the sizes of the
+   streams are taken out, which themselves take one or two bytes depending
+   on the shares. Starting from one byte each, a second pass is enough,
+   except when a share grows past 252 bytes because of the rounding, in
+   which case a few bytes are given back. */
+static void ms_allocate(MSCommon *ms, int maxCompressedBytes)
+{
+   MSStream *stream = ms_streams(ms);
+   int s, pass, budget, left;
+   int last = ms->nb_streams-1;
+
+   for (s=0;s<=last;s++)
+      stream[s].bytes = 0;
+   for (pass=0;pass<2;pass++)
+   {
+      budget = maxCompressedBytes;
+      for (s=0;s<last;s++)
+         budget -= ms_length_bytes(stream[s].bytes);
+      budget = IMAX(budget, 0);
+      left = budget;
+      for (s=0;s<=last;s++)
+      {
+         stream[s].bytes = IMIN(1275, ms_share(ms, s, budget));
+         left -= stream[s].bytes;
+      }
+      /* What the rounding left over goes to the first streams */
+      for (s=0;s<=last && left>0;s++)
+      {
+         if (stream[s].bytes<1275)
+         {
+            stream[s].bytes++;
+            left--;
+         }
+      }
+   }
+   for (s=last;s>=0 && ms_packet_size(ms)>maxCompressedBytes;s--)
+      stream[s].bytes--;
+}
+
+int celt_ms_encoder_get_size(const CELTMode *mode, int streams, int coupled_streams)
+{
+   return ms_get_size(mode, streams, coupled_streams, celt_encoder_get_size_custom);
+}
+
+CELTMSEncoder *celt_ms_encoder_init(CELTMSEncoder *st, const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error)
+{
+   int s, err;
+   MSStream *stream;
+
+   if (st==NULL)
+   {
+      if (error)
+         *error = CELT_ALLOC_FAIL;
+      return NULL;
+   }
+   err = ms_init(&st->ms, mode, channels, streams, coupled_streams, mapping, celt_encoder_get_size_custom);
+   stream = ms_streams(&st->ms);
+   for (s=0;s<streams && err==CELT_OK;s++)
+   {
+      CELTEncoder *enc = celt_encoder_init_custom((CELTEncoder*)stream[s].st, mode,
+            stream_channels(&st->ms, s), &err);
+      /* The decoder knows the mode and the frame size of all the streams */
+      if (enc!=NULL)
+         err = celt_encoder_ctl(enc, CELT_SET_SIGNALLING(0));
+   }
+   if (error)
+      *error = err;
+   return err==CELT_OK ? st : NULL;
+}
+
+CELTMSEncoder *celt_ms_encoder_create(const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error)
+{
+   CELTMSEncoder *st;
+   int size = celt_ms_encoder_get_size(mode, streams, coupled_streams);
+   if (size==0)
+   {
+      if (error)
+         *error = CELT_BAD_ARG;
+      return NULL;
+   }
+   st = (CELTMSEncoder *)celt_alloc_aligned(size, MS_ALIGNMENT);
+   if (st!=NULL && celt_ms_encoder_init(st, mode, channels, streams, coupled_streams, mapping, error)==NULL)
+   {
+      celt_ms_encoder_destroy(st);
+      st = NULL;
+   }
+   return st;
+}
+
+void celt_ms_encoder_destroy(CELTMSEncoder *st)
+{
+   celt_free_aligned(st);
+}
+
+/* Takes the input channels of stream s out of the interleaved input */
+static void ms_deinterleave(MSCommon *ms, int s)
+{
+   MSStream *stream = &ms_streams(ms)[s];
+   int C = stream_channels(ms, s);
+   int N = ms->frame_size;
+   int c, i;
+
+   for (c=0;c<C;c++)
+   {
+      int in = stream->channel[c];
+#ifndef DISABLE_FLOAT_API
+      if (ms->float_api)
+      {
+         const float *pcm = (const float*)ms->pcm_in;
+         float *x = (float*)stream->pcm;
+         for (i=0;i<N;i++)
+            x[i*C+c] = in>=0 ? pcm[i*ms->channels+in] : 0;
+      } else
+#endif
+      {
+         const celt_int16 *pcm = (const celt_int16*)ms->pcm_in;
+         celt_int16 *x = (celt_int16*)stream->pcm;
+         for (i=0;i<N;i++)
+            x[i*C+c] = in>=0 ? pcm[i*ms->channels+in] : 0;
+      }
+   }
+}
+
+/* Encodes the input of stream s once it is deinterleaved */
+static void ms_code_stream(void *arg, int s)
+{
+   MSCommon *ms = (MSCommon*)arg;
+   MSStream *stream = &ms_streams(ms)[s];
+   int N = ms->frame_size;
+#ifndef DISABLE_FLOAT_API
+   if (ms->float_api)
+      stream->ret = celt_encode_float((CELTEncoder*)stream->st, (const float*)stream->pcm,
+            N, stream->data, stream->bytes);
+   else
+#endif
+      stream->ret = celt_encode((CELTEncoder*)stream->st, (const celt_int16*)stream->pcm,
+            N, stream->data, stream->bytes);
+}
+
+static void ms_encode_stream(void *arg, int s)
+{
+   ms_deinterleave((MSCommon*)arg, s);
+   ms_code_stream(arg, s);
+}
+
+/* Deinterleaves the input of stream s and puts its demand in its weight */
+static void ms_analyse_stream(void *arg, int s)
+{
+   MSCommon *ms = (MSCommon*)arg;
+   MSStream *stream = &ms_streams(ms)[s];
+   ms_deinterleave(ms, s);
+#ifndef DISABLE_FLOAT_API
+   if (ms->float_api)
+      stream->weight = celt_encoder_frame_demand_float((CELTEncoder*)stream->st,
+            (const float*)stream->pcm, ms->frame_size);
+   else
+#endif
+      stream->weight = celt_encoder_frame_demand((CELTEncoder*)stream->st,
+            (const celt_int16*)stream->pcm, ms->frame_size);
+}
+
+static int ms_encode(CELTMSEncoder *st, const void *pcm, int float_api, int frame_size, unsigned char *compressed, int maxCompressedBytes)
+{
+   MSCommon *ms = &st->ms;
+   MSStream *stream = ms_streams(ms);
+   int s, offset, len;
+   int last = ms->nb_streams-1;
+   unsigned char *out;
+
+   if (pcm==NULL || compressed==NULL || frame_size<=0
+         || frame_size > ms->mode->shortMdctSize<<ms->mode->maxLM)
+      return CELT_BAD_ARG;
+
+   ms->pcm_in = pcm;
+   ms->float_api = float_api;
+   ms->frame_size = frame_size;
+   if (ms->joint)
+   {
+      ms_run(ms, ms_analyse_stream);
+      ms_joint_weights(ms);
+      for (s=0;s<=last && ms->bitrate>0;s++)
+         celt_encoder_ctl((CELTEncoder*)stream[s].st, CELT_SET_BITRATE(IMAX(501, ms_share(ms, s, ms->bitrate))));
+   }
+   ms_allocate(ms, maxCompressedBytes);
+   offset = 0;
+   for (s=0;s<=last;s++)
+   {
+      if (stream[s].bytes<2)
+         return CELT_BAD_ARG;
+      if (s<last)
+         offset += ms_length_bytes(stream[s].bytes);
+      stream[s].data = compressed+offset;
+      offset += stream[s].bytes;
+   }
+   ms_run(ms, ms->joint ? ms_code_stream : ms_encode_stream);
+
+   /* Packs the streams towards the start of the packet, which only ever
+      moves data down over space already used */
+   out = compressed;
+   for (s=0;s<=last;s++)
+   {
+      len = stream[s].ret;
+      if (len<0)
+         return len;
+      if (s<last)
+         out += ms_write_length(out, len);
+      CELT_MOVE(out, stream[s].data, len);
+      out += len;
+   }
+   return out-compressed;
+}
+
+int celt_ms_encode(CELTMSEncoder *st, const celt_int16 *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes)
+{
+   return ms_encode(st, pcm, 0, frame_size, compressed, maxCompressedBytes);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_ms_encode_float(CELTMSEncoder *st, const float *pcm, int frame_size, unsigned char *compressed, int maxCompressedBytes)
+{
+   return ms_encode(st, pcm, 1, frame_size, compressed, maxCompressedBytes);
+}
+#endif /* DISABLE_FLOAT_API */
+
+int celt_ms_encoder_ctl(CELTMSEncoder *st, int request, ...)
+{
+   MSCommon *ms = &st->ms;
+   MSStream *stream = ms_streams(ms);
+   int s, ret = CELT_OK;
+   va_list ap;
+
+   va_start(ap, request);
+   switch (request)
+   {
+      case CELT_GET_MODE_REQUEST:
+      {
+         const CELTMode ** value = va_arg(ap, const CELTMode**);
+         if (value==0)
+            goto bad_arg;
+         *value=ms->mode;
+      }
+      break;
+      case CELT_SET_COMPLEXITY_REQUEST:
+      case CELT_SET_PREDICTION_REQUEST:
+      case CELT_SET_VBR_CONSTRAINT_REQUEST:
+      case CELT_SET_VBR_REQUEST:
+      case CELT_SET_INPUT_CLIPPING_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         for (s=0;s<ms->nb_streams && ret==CELT_OK;s++)
+            ret = celt_encoder_ctl((CELTEncoder*)stream[s].st, request, value);
+      }
+      break;
+      case CELT_SET_BITRATE_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<=0)
+            goto bad_arg;
+         ms->bitrate = value;
+         for (s=0;s<ms->nb_streams && ret==CELT_OK;s++)
+            ret = celt_encoder_ctl((CELTEncoder*)stream[s].st, CELT_SET_BITRATE(ms_share(ms, s, value)));
+      }
+      break;
+      case CELT_SET_JOINT_RATE_REQUEST:
+      {
+         celt_int32 value = va_arg(ap, celt_int32);
+         if (value<0 || value>1)
+            goto bad_arg;
+         ms->joint = value;
+         ms_static_weights(ms);
+         for (s=0;s<ms->nb_streams && ret==CELT_OK && ms->bitrate>0;s++)
+            ret = celt_encoder_ctl((CELTEncoder*)stream[s].st, CELT_SET_BITRATE(ms_share(ms, s, ms->bitrate)));
+      }
+      break;
+      case CELT_RESET_STATE:
+      {
+         for (s=0;s<ms->nb_streams;s++)
+            celt_encoder_ctl((CELTEncoder*)stream[s].st, CELT_RESET_STATE);
+      }
+      break;
+      case CELT_SET_THREAD_POOL_REQUEST:
+      {
+         const CELTThreadPool *value = va_arg(ap, const CELTThreadPool*);
+         if (value!=NULL && value->run==NULL)
+            goto bad_arg;
+         if (value!=NULL)
+            ms->pool = *value;
+         else
+            ms->pool.run = NULL;
+      }
+      break;
+      case CELT_GET_STREAM_ENCODER_REQUEST:
+      {
+         celt_int32 index = va_arg(ap, celt_int32);
+         CELTEncoder **value = va_arg(ap, CELTEncoder**);
+         if (index<0 || index>=ms->nb_streams || value==NULL)
+            goto bad_arg;
+         *value = (CELTEncoder*)stream[index].st;
+      }
+      break;
+      default:
+         goto bad_request;
+   }
+   va_end(ap);
+   return ret;
+bad_arg:
+   va_end(ap);
+   return CELT_BAD_ARG;
+bad_request:
+   va_end(ap);
+   return CELT_UNIMPLEMENTED;
+}
+
+int celt_ms_decoder_get_size(const CELTMode *mode, int streams, int coupled_streams)
+{
+   return ms_get_size(mode, streams, coupled_streams, celt_decoder_get_size_custom);
+}
+
+CELTMSDecoder *celt_ms_decoder_init(CELTMSDecoder *st, const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error)
+{
+   int s, err;
+   MSStream *stream;
+
+   if (st==NULL)
+   {
+      if (error)
+         *error = CELT_ALLOC_FAIL;
+      return NULL;
+   }
+   err = ms_init(&st->ms, mode, channels, streams, coupled_streams, mapping, celt_decoder_get_size_custom);
+   stream = ms_streams(&st->ms);
+   for (s=0;s<streams && err==CELT_OK;s++)
+   {
+      CELTDecoder *dec = celt_decoder_init_custom((CELTDecoder*)stream[s].st, mode,
+            stream_channels(&st->ms, s), &err);
+      if (dec!=NULL)
+         err = celt_decoder_ctl(dec, CELT_SET_SIGNALLING(0));
+   }
+   if (error)
+      *error = err;
+   return err==CELT_OK ? st : NULL;
+}
+
+CELTMSDecoder *celt_ms_decoder_create(const CELTMode *mode, int channels, int streams, int coupled_streams, const unsigned char *mapping, int *error)
+{
+   CELTMSDecoder *st;
+   int size = celt_ms_decoder_get_size(mode, streams, coupled_streams);
+   if (size==0)
+   {
+      if (error)
+         *error = CELT_BAD_ARG;
+      return NULL;
+   }
+   st = (CELTMSDecoder *)celt_alloc_aligned(size, MS_ALIGNMENT);
+   if (st!=NULL && celt_ms_decoder_init(st, mode, channels, streams, coupled_streams, mapping, error)==NULL)
+   {
+      celt_ms_decoder_destroy(st);
+      st = NULL;
+   }
+   return st;
+}
+
+void celt_ms_decoder_destroy(CELTMSDecoder *st)
+{
+   celt_free_aligned(st);
+}
+
+static void ms_decode_stream(void *arg, int s)
+{
+   MSCommon *ms = (MSCommon*)arg;
+   MSStream *stream = &ms_streams(ms)[s];
+#ifndef DISABLE_FLOAT_API
+   if (ms->float_api)
+      stream->ret = celt_decode_float((CELTDecoder*)stream->st, stream->data, stream->bytes,
+            (float*)stream->pcm, ms->frame_size);
+   else
+#endif
+      stream->ret = celt_decode((CELTDecoder*)stream->st, stream->data, stream->bytes,
+            (celt_int16*)stream->pcm, ms->frame_size);
+}
+
+static int ms_decode(CELTMSDecoder *st, const unsigned char *data, int len, void *pcm, int float_api, int frame_size)
+{
+   MSCommon *ms = &st->ms;
+   MSStream *stream = ms_streams(ms);
+   int s, c, i, N;
+   int last = ms->nb_streams-1;
+
+   if (pcm==NULL || len<0 || frame_size<=0
+         || frame_size > ms->mode->shortMdctSize<<ms->mode->maxLM)
+      return CELT_BAD_ARG;
+
+   for (s=0;s<=last;s++)
+   {
+      if (data==NULL || len==0)
+      {
+         /* Lost packet, for all the streams */
+         stream[s].data = NULL;
+         stream[s].bytes = 0;
+      } else if (s<last) {
+         int size, n = ms_read_length(data, len, &size);
+         if (n<0 || size>len-n)
+            return CELT_CORRUPTED_DATA;
+         stream[s].data = (unsigned char*)data+n;
+         stream[s].bytes = size;
+         data += n+size;
+         len -= n+size;
+      } else {
+         stream[s].data = (unsigned char*)data;
+         stream[s].bytes = len;
+      }
+   }
+
+   ms->float_api = float_api;
+   ms->frame_size = frame_size;
+   ms_run(ms, ms_decode_stream);
+
+   for (s=0;s<=last;s++)
+      if (stream[s].ret<0)
+         return stream[s].ret;
+   /* Concealed frames return CELT_OK, the streams don't resample */
+   N = stream[0].ret>0 ? stream[0].ret : frame_size;
+
+   /* Interleaves the channels of the streams into the output */
+   for (c=0;c<ms->channels;c++)
+   {
+      int k = ms->mapping[c];
+      int C=1, offset=0;
+      const MSStream *from = NULL;
+      if (k < 2*ms->nb_coupled)
+      {
+         from = &stream[k>>1];
+         C = 2;
+         offset = k&1;
+      } else if (k != 255) {
+         from = &stream[k-ms->nb_coupled];
+      }
+#ifndef DISABLE_FLOAT_API
+      if (float_api)
+      {
+         float *y = (float*)pcm;
+         const float *x = from!=NULL ? (const float*)from->pcm : NULL;
+         for (i=0;i<N;i++)
+            y[i*ms->channels+c] = x!=NULL ? x[i*C+offset] : 0;
+      } else
+#endif
+      {
+         celt_int16 *y = (celt_int16*)pcm;
+         const celt_int16 *x = from!=NULL ? (const celt_int16*)from->pcm : NULL;
+         for (i=0;i<N;i++)
+            y[i*ms->channels+c] = x!=NULL ? x[i*C+offset] : 0;
+      }
+   }
+   return N;
+}
+
+int celt_ms_decode(CELTMSDecoder *st, const unsigned char *data, int len, celt_int16 *pcm, int frame_size)
+{
+   return ms_decode(st, data, len, pcm, 0, frame_size);
+}
+
+#ifndef DISABLE_FLOAT_API
+int celt_ms_decode_float(CELTMSDecoder *st, const unsigned char *data, int len, float *pcm, int frame_size)
+{
+   return ms_decode(st, data, len, pcm, 1, frame_size);
+}
+#endif /* DISABLE_FLOAT_API */
+
+int celt_ms_decoder_ctl(CELTMSDecoder *st, int request, ...)
+{
+   MSCommon *ms = &st->ms;
+   MSStream *stream = ms_streams(ms);
+   int s;
+   va_list ap;
+
+   va_start(ap, request);
+   switch (request)
+   {
+      case CELT_GET_MODE_REQUEST:
+      {
+         const CELTMode ** value = va_arg(ap, const CELTMode**);
+         if (value==0)
+            goto bad_arg;
+         *value=ms->mode;
+      }
+      break;
+      case CELT_RESET_STATE:
+      {
+         for (s=0;s<ms->nb_streams;s++)
+            celt_decoder_ctl((CELTDecoder*)stream[s].st, CELT_RESET_STATE);
+      }
+      break;
+      case CELT_SET_THREAD_POOL_REQUEST:
+      {
+         const CELTThreadPool *value = va_arg(ap, const CELTThreadPool*);
+         if (value!=NULL && value->run==NULL)
+            goto bad_arg;
+         if (value!=NULL)
+            ms->pool = *value;
+         else
+            ms->pool.run = NULL;
+      }
+      break;
+      case CELT_GET_STREAM_DECODER_REQUEST:
+      {
+         celt_int32 index = va_arg(ap, celt_int32);
+         CELTDecoder **value = va_arg(ap, CELTDecoder**);
+         if (index<0 || index>=ms->nb_streams || value==NULL)
+            goto bad_arg;
+         *value = (CELTDecoder*)stream[index].st;
+      }
+      break;
+      default:
+         goto bad_request;
+   }
+   va_end(ap);
+   return CELT_OK;
+bad_arg:
+   va_end(ap);
+   return CELT_BAD_ARG;
+bad_request:
+   va_end(ap);
+   return CELT_UNIMPLEMENTED;
+}
@@ -68,6 +68,30 @@ static inline void celt_free (void *ptr)
 }
 #endif
 
+/** Same as celt_alloc(), except that the area starts on a multiple of align bytes
+    (a power of two). It has to be released with celt_free_aligned() */
+#ifndef OVERRIDE_CELT_ALLOC_ALIGNED
+static inline void *celt_alloc_aligned (int size, int align)
+{
+   char *ptr, *base = (char*)celt_alloc(size+align+sizeof(void*));
+   if (base==NULL)
+      return NULL;
+   ptr = base + sizeof(void*);
+   ptr += (align - (long)ptr) & (align - 1);
+   ((void**)ptr)[-1] = base;
+   return ptr;
+}
+#endif
+
+/** CELT wrapper for freeing memory from celt_alloc_aligned() */
+#ifndef OVERRIDE_CELT_FREE_ALIGNED
+static inline void celt_free_aligned (void *ptr)
+{
+   if (ptr!=NULL)
+      celt_free(((void**)ptr)[-1]);
+}
+#endif
+
 /** Same as celt_free(), except that the area is only needed inside a CELT call (might cause problem with wideband though) */
 #ifndef OVERRIDE_CELT_FREE_SCRATCH
 static inline void celt_free_scratch (void *ptr)
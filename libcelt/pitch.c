@@ -99,22 +99,54 @@ static void find_best_pitch(celt_word32 *xcorr, celt_word32 maxcorr, celt_word16
 }
 
 #include "plc.h"
+
+void celt_pitch_xcorr(const celt_word16 *x, const celt_word16 *y, celt_word32 *xcorr,
+      int len, int max_pitch)
+{
+   int i, j;
+   for (i=0;i<max_pitch-3;i+=4)
+   {
+      celt_word32 sum[4]={0,0,0,0};
+      xcorr_kernel(x, y+i, sum, len);
+      xcorr[i] = sum[0];
+      xcorr[i+1] = sum[1];
+      xcorr[i+2] = sum[2];
+      xcorr[i+3] = sum[3];
+   }
+   for (;i<max_pitch;i++)
+   {
+      celt_word32 sum = 0;
+      for (j=0;j<len;j++)
+         sum = MAC16_16(sum, x[j], y[i+j]);
+      xcorr[i] = sum;
+   }
+}
+
 void pitch_downsample(celt_sig * restrict x[], celt_word16 * restrict x_lp,
       int len, int _C)
+{
+   pitch_downsample_from(x, x_lp, len, len>>1, _C);
+}
+
+void pitch_downsample_from(celt_sig * restrict x[], celt_word16 * restrict x_lp,
+      int len, int decimated, int _C)
 {
    int i;
    celt_word32 ac[5];
    celt_word16 tmp=Q15ONE;
    celt_word16 lpc[4], mem[4]={0,0,0,0};
    const int C = CHANNELS(_C);
-   for (i=1;i<len>>1;i++)
-      x_lp[i] = SHR32(HALF32(HALF32(x[0][(2*i-1)]+x[0][(2*i+1)])+x[0][2*i]), SIG_SHIFT+3);
-   x_lp[0] = SHR32(HALF32(HALF32(x[0][1])+x[0][0]), SIG_SHIFT+3);
-   if (C==2)
+   if (decimated>0)
    {
-      for (i=1;i<len>>1;i++)
-         x_lp[i] += SHR32(HALF32(HALF32(x[1][(2*i-1)]+x[1][(2*i+1)])+x[1][2*i]), SIG_SHIFT+3);
-      x_lp[0] += SHR32(HALF32(HALF32(x[1][1])+x[1][0]), SIG_SHIFT+3);
+      for (i=1;i<decimated;i++)
+         x_lp[i] = pitch_decimate(x[0]+2*i);
+      x_lp[0] = SHR32(HALF32(HALF32(x[0][1])+x[0][0]), SIG_SHIFT+3);
+      if (C==2)
+      {
+         for (i=1;i<decimated;i++)
+            x_lp[i] += pitch_decimate(x[1]+2*i);
+         x_lp[0] += SHR32(HALF32(HALF32(x[1][1])+x[1][0]), SIG_SHIFT+3);
+      }
    }
 
    _celt_autocorr(x_lp, ac, NULL, 0,
@@ -195,13 +227,11 @@ void pitch_search(const celt_word16 * restrict x_lp, celt_word16 * restrict y,
 
    /* Coarse search with 4x decimation */
 
+   celt_pitch_xcorr(x_lp4, y_lp4, xcorr, len>>2, max_pitch>>2);
    for (i=0;i<max_pitch>>2;i++)
    {
-      celt_word32 sum = 0;
-      for (j=0;j<len>>2;j++)
-         sum = MAC16_16(sum, x_lp4[j],y_lp4[i+j]);
-      xcorr[i] = MAX32(-1, sum);
-      maxcorr = MAX32(maxcorr, sum);
+      maxcorr = MAX32(maxcorr, xcorr[i]);
+      xcorr[i] = MAX32(-1, xcorr[i]);
    }
    find_best_pitch(xcorr, maxcorr, y_lp4, 0, len>>2, max_pitch>>2, best_pitch);
 
@@ -347,13 +377,13 @@ celt_word16 remove_doubling(celt_word16 *x, int maxperiod, int minperiod,
    else
       pg = SHR32(frac_div32(best_xy,best_yy+1),16);
 
-   for (k=0;k<3;k++)
    {
-      int T1 = T+k-1;
-      xy = 0;
-      for (i=0;i<N;i++)
-         xy = MAC16_16(xy, x[i], x[i-T1]);
-      xcorr[k] = xy;
+      /* Lags T+1, T and T-1 */
+      celt_word32 sum[4]={0,0,0,0};
+      xcorr_kernel(x, x-T-1, sum, N);
+      xcorr[0] = sum[2];
+      xcorr[1] = sum[1];
+      xcorr[2] = sum[0];
    }
    if ((xcorr[2]-xcorr[0]) > MULT16_32_Q15(QCONST16(.7f,15),xcorr[1]-xcorr[0]))
       offset = 1;
@@ -37,12 +37,50 @@
 
 #include "modes.h"
 
+#if defined(ENABLE_SSE) && !defined(FIXED_DEBUG)
+#include "pitch_sse.h"
+#endif
+
+#ifndef OVERRIDE_XCORR_KERNEL
+/* Adds the correlation of x[] with y[], y+1, y+2 and y+3 over len samples to
+   sum[0..3]. Each sum is accumulated in the same order as a plain loop over
+   j, so that the float results don't depend on how this is implemented */
+static inline void xcorr_kernel(const celt_word16 *x, const celt_word16 *y,
+      celt_word32 sum[4], int len)
+{
+   int j;
+   for (j=0;j<len;j++)
+   {
+      sum[0] = MAC16_16(sum[0], x[j], y[j]);
+      sum[1] = MAC16_16(sum[1], x[j], y[j+1]);
+      sum[2] = MAC16_16(sum[2], x[j], y[j+2]);
+      sum[3] = MAC16_16(sum[3], x[j], y[j+3]);
+   }
+}
+#endif
+
+/* One channel's share of the sample of the 2x-decimated signal that
+   pitch_downsample() centres on x[0] */
+static inline celt_word32 pitch_decimate(const celt_sig *x)
+{
+   return SHR32(HALF32(HALF32(x[-1]+x[1])+x[0]), SIG_SHIFT+3);
+}
+
 void pitch_downsample(celt_sig * restrict x[], celt_word16 * restrict x_lp,
       int len, int _C);
 
+/* Same as pitch_downsample(), except that x_lp[decimated] and the samples
+   after it already hold the sum of pitch_decimate() over the channels */
+void pitch_downsample_from(celt_sig * restrict x[], celt_word16 * restrict x_lp,
+      int len, int decimated, int _C);
+
 void pitch_search(const celt_word16 * restrict x_lp, celt_word16 * restrict y,
                   int len, int max_pitch, int *pitch);
 
+/* xcorr[i] = sum of x[j]*y[i+j] over len samples, for i < max_pitch */
+void celt_pitch_xcorr(const celt_word16 *x, const celt_word16 *y, celt_word32 *xcorr,
+      int len, int max_pitch);
+
 celt_word16 remove_doubling(celt_word16 *x, int maxperiod, int minperiod,
       int N, int *T0, int prev_period, celt_word16 prev_gain);
 
@@ -0,0 +1,92 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/**
+   @file pitch_sse.h
+   @brief SSE cross-correlation for the pitch analysis
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PITCH_SSE_H
+#define PITCH_SSE_H
+
+/* Four lags at a time, one per lane. Each lane adds its products in the
+   same order as the C code, so the float results are the same, and the
+   fixed-point sums are exact anyway. */
+
+#define OVERRIDE_XCORR_KERNEL
+
+#ifdef FIXED_POINT
+
+#include <emmintrin.h>
+
+/* pmaddwd does two samples of the four lags at once, from the pairs
+   (y[j+k],y[j+k+1]) and (x[j],x[j+1]) */
+static inline void xcorr_kernel(const celt_word16 *x, const celt_word16 *y,
+      celt_word32 sum[4], int len)
+{
+   int j;
+   __m128i acc = _mm_setzero_si128();
+   for (j=0;j<len-1;j+=2)
+   {
+      __m128i y0, y1, xx;
+      y0 = _mm_loadl_epi64((const __m128i*)(const void*)(y+j));
+      y1 = _mm_loadl_epi64((const __m128i*)(const void*)(y+j+1));
+      xx = _mm_set1_epi32((int)((celt_uint16)x[j] | ((celt_uint32)(celt_uint16)x[j+1]<<16)));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(y0, y1), xx));
+   }
+   {
+      celt_word32 tmp[4];
+      _mm_storeu_si128((__m128i*)(void*)tmp, acc);
+      sum[0] += tmp[0];
+      sum[1] += tmp[1];
+      sum[2] += tmp[2];
+      sum[3] += tmp[3];
+   }
+   for (;j<len;j++)
+   {
+      sum[0] = MAC16_16(sum[0], x[j], y[j]);
+      sum[1] = MAC16_16(sum[1], x[j], y[j+1]);
+      sum[2] = MAC16_16(sum[2], x[j], y[j+2]);
+      sum[3] = MAC16_16(sum[3], x[j], y[j+3]);
+   }
+}
+
+#else /* FIXED_POINT */
+
+#include <xmmintrin.h>
+
+static inline void xcorr_kernel(const celt_word16 *x, const celt_word16 *y,
+      celt_word32 sum[4], int len)
+{
+   int j;
+   __m128 acc = _mm_loadu_ps(sum);
+   for (j=0;j<len;j++)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(x[j]), _mm_loadu_ps(y+j)));
+   _mm_storeu_ps(sum, acc);
+}
+
+#endif /* FIXED_POINT */
+
+#endif /* PITCH_SSE_H */
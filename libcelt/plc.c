@@ -30,6 +30,7 @@
 #endif
 
 #include "plc.h"
+#include "pitch.h"
 #include "stack_alloc.h"
 #include "mathops.h"
 
@@ -149,7 +150,7 @@ void _celt_autocorr(
                   )
 {
    celt_word32 d;
-   int i;
+   int i, k;
    VARDECL(celt_word16, xx);
    SAVE_STACK;
    ALLOC(xx, n, celt_word16);
@@ -174,13 +175,14 @@ void _celt_autocorr(
          xx[i] = VSHR32(xx[i], shift);
    }
 #endif
-   while (lag>=0)
+   /* All lags over the samples they have in common, then the rest of
+      each one in the same order */
+   celt_pitch_xcorr(xx, xx, ac, n-lag, lag+1);
+   for (k=0;k<=lag;k++)
    {
-      for (i = lag, d = 0; i < n; i++) 
-         d += xx[i] * xx[i-lag];
-      ac[lag] = d;
-      /*printf ("%f ", ac[lag]);*/
-      lag--;
+      for (i = k+n-lag, d = ac[k]; i < n; i++)
+         d += xx[i] * xx[i-k];
+      ac[k] = d;
    }
    /*printf ("\n");*/
    ac[0] += 10;
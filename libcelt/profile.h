@@ -0,0 +1,233 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/**
+   @file profile.h
+   @brief Per-stage timing of the encoder and decoder (--enable-profiling)
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "celt.h"
+
+/* The time of a frame is split into stages with a single clock read at
+   each boundary: PROFILE_LAP() charges everything since the previous
+   boundary to the given stage. Without ENABLE_PROFILING all the macros
+   expand to nothing. The same clock times the encoder's optional analyses
+   for ENABLE_CPU_BUDGET (the BUDGET_* macros). */
+
+#if defined(ENABLE_PROFILING) || defined(ENABLE_CPU_BUDGET)
+
+#if defined(WIN32) || defined(_WIN32)
+
+#include <windows.h>
+
+typedef LARGE_INTEGER celt_profile_time;
+
+static inline void celt_profile_now(celt_profile_time *t)
+{
+   QueryPerformanceCounter(t);
+}
+
+static inline double celt_profile_elapsed(const celt_profile_time *from, const celt_profile_time *to)
+{
+   LARGE_INTEGER freq;
+   QueryPerformanceFrequency(&freq);
+   return (to->QuadPart-from->QuadPart)*1e9/freq.QuadPart;
+}
+
+#else
+
+#include <time.h>
+
+typedef struct timespec celt_profile_time;
+
+static inline void celt_profile_now(celt_profile_time *t)
+{
+   clock_gettime(CLOCK_MONOTONIC, t);
+}
+
+static inline double celt_profile_elapsed(const celt_profile_time *from, const celt_profile_time *to)
+{
+   return (to->tv_sec-from->tv_sec)*1e9 + (to->tv_nsec-from->tv_nsec);
+}
+
+#endif
+
+#endif /* ENABLE_PROFILING || ENABLE_CPU_BUDGET */
+
+#ifdef ENABLE_PROFILING
+
+typedef struct {
+   CELTProfile stats;
+   celt_profile_time last;
+} CELTProfileState;
+
+static inline void celt_profile_lap(CELTProfileState *p, int stage)
+{
+   celt_profile_time now;
+   celt_profile_now(&now);
+   p->stats.ns[stage] += celt_profile_elapsed(&p->last, &now);
+   p->last = now;
+}
+
+#define PROFILE_START(p) celt_profile_now(&(p)->last)
+#define PROFILE_LAP(p, stage) celt_profile_lap(p, stage)
+#define PROFILE_END(p) do { celt_profile_lap(p, CELT_PROFILE_OTHER); (p)->stats.frames++; } while (0)
+
+#else /* ENABLE_PROFILING */
+
+#define PROFILE_START(p)
+#define PROFILE_LAP(p, stage)
+#define PROFILE_END(p)
+
+#endif /* ENABLE_PROFILING */
+
+#ifdef ENABLE_CPU_BUDGET
+
+/* The optional analyses, in the order they are put back when there is
+   room. Analysis i runs when the level is above i, so that the levels are
+   the CELT_ANALYSIS_* values. */
+#define BUDGET_PITCH   0
+#define BUDGET_TF      1
+#define BUDGET_TRIM    2
+#define BUDGET_STEREO  3
+#define BUDGET_STAGES  4
+
+typedef struct {
+   double target;                /* ns per frame, 0 for no limit */
+   double base;                  /* Average ns per frame without the analyses */
+   double cost[BUDGET_STAGES];   /* Average ns for each analysis when it runs */
+   double spent;                 /* ns in the analyses in the current frame */
+   double paused;                /* ns of the current frame before it was paused */
+   int level;                    /* Level for the next frame */
+   celt_profile_time frame_start;
+   celt_profile_time stage_start;
+} CELTBudgetState;
+
+static inline void celt_budget_init(CELTBudgetState *b)
+{
+   int i;
+   b->target = 0;
+   b->base = 0;
+   for (i=0;i<BUDGET_STAGES;i++)
+      b->cost[i] = 0;
+   b->level = CELT_ANALYSIS_FULL;
+}
+
+/* A new target keeps what was measured so far, so the level only moves
+   as fast as it would under load */
+static inline void celt_budget_set(CELTBudgetState *b, int target_us)
+{
+   b->target = target_us*1e3;
+   if (b->target == 0)
+      b->level = CELT_ANALYSIS_FULL;
+}
+
+static inline void celt_budget_stage_end(CELTBudgetState *b, int stage)
+{
+   celt_profile_time now;
+   double t;
+   celt_profile_now(&now);
+   t = celt_profile_elapsed(&b->stage_start, &now);
+   b->spent += t;
+   /* An analysis that has never run costs what it took the first time */
+   if (b->cost[stage] == 0)
+      b->cost[stage] = t;
+   else
+      b->cost[stage] += .125*(t-b->cost[stage]);
+}
+
+static inline void celt_budget_frame_pause(CELTBudgetState *b)
+{
+   celt_profile_time now;
+   celt_profile_now(&now);
+   b->paused += celt_profile_elapsed(&b->frame_start, &now);
+}
+
+/* Picks the level of the next frame from the time of this one: the
+   highest level whose expected time fits, but only one level up at a
+   time and with a 10% margin, so that it doesn't keep going up and down */
+static inline void celt_budget_frame_end(CELTBudgetState *b)
+{
+   celt_profile_time now;
+   double base, t;
+   int level;
+   if (b->target == 0)
+      return;
+   celt_profile_now(&now);
+   base = b->paused + celt_profile_elapsed(&b->frame_start, &now) - b->spent;
+   if (b->base == 0)
+      b->base = base;
+   else
+      b->base += .125*(base-b->base);
+
+   /* What the analyses that were left out cost is only known from when
+      they last ran, so it slowly gets forgotten to try them again */
+   for (level=b->level;level<CELT_ANALYSIS_FULL;level++)
+      b->cost[level] *= .98;
+
+   t = b->base;
+   for (level=0;level<CELT_ANALYSIS_FULL;level++)
+   {
+      if (t+b->cost[level] > b->target)
+         break;
+      t += b->cost[level];
+   }
+   if (level > b->level)
+   {
+      /* Only if the next analysis fits with room to spare */
+      t = b->base;
+      for (level=0;level<=b->level;level++)
+         t += b->cost[level];
+      if (t < .9*b->target)
+         b->level++;
+   } else {
+      b->level = level;
+   }
+}
+
+#define BUDGET_FRAME_START(b) do { if ((b)->target) { celt_profile_now(&(b)->frame_start); (b)->spent = (b)->paused = 0; } } while (0)
+/* A batch codes other streams between the stages of a frame, which must
+   not count as the time of the frame */
+#define BUDGET_FRAME_PAUSE(b) do { if ((b)->target) celt_budget_frame_pause(b); } while (0)
+#define BUDGET_FRAME_RESUME(b) do { if ((b)->target) celt_profile_now(&(b)->frame_start); } while (0)
+#define BUDGET_STAGE_START(b) do { if ((b)->target) celt_profile_now(&(b)->stage_start); } while (0)
+#define BUDGET_STAGE_END(b, stage) do { if ((b)->target) celt_budget_stage_end(b, stage); } while (0)
+#define BUDGET_FRAME_END(b) celt_budget_frame_end(b)
+
+#else /* ENABLE_CPU_BUDGET */
+
+#define BUDGET_FRAME_START(b)
+#define BUDGET_FRAME_PAUSE(b)
+#define BUDGET_FRAME_RESUME(b)
+#define BUDGET_STAGE_START(b)
+#define BUDGET_STAGE_END(b, stage)
+#define BUDGET_FRAME_END(b)
+
+#endif /* ENABLE_CPU_BUDGET */
+
+#endif /* PROFILE_H */
@@ -84,6 +84,9 @@ void compute_pulse_cache(CELTMode *m, int LM)
    celt_int16 *cindex;
    unsigned char *bits;
    unsigned char *cap;
+   celt_int32 *uindex;
+   celt_uint32 *u;
+   int row, maxN;
 
    cindex = celt_alloc(sizeof(cache->index[0])*m->nbEBands*(LM+2));
    cache->index = cindex;
@@ -240,6 +243,28 @@ void compute_pulse_cache(CELTMode *m, int LM)
          }
       }
    }
+
+   /* Rows of U() for the codeword indexing of every size in the cache. Row n
+       has to go up to the largest K of any size N>=n, since indexing N
+       dimensions goes through all the rows below N. */
+   maxN = 0;
+   for (i=0;i<nbEntries;i++)
+      maxN = IMAX(maxN, entryN[i]);
+   m->cwrs.maxN = maxN;
+   m->cwrs.index = uindex = celt_alloc(sizeof(m->cwrs.index[0])*(maxN+2));
+   uindex[0] = uindex[1] = 0;
+   for (row=1;row<=maxN;row++)
+   {
+      int K = 0;
+      for (i=0;i<nbEntries;i++)
+         if (entryN[i]>=IMAX(row,2) && entryK[i]>0)
+            K = IMAX(K, get_pulses(entryK[i]));
+      uindex[row+1] = uindex[row] + (K>0 ? K+2 : 0);
+   }
+   m->cwrs.u = u = celt_alloc(sizeof(m->cwrs.u[0])*uindex[maxN+1]);
+   for (row=1;row<=maxN;row++)
+      if (uindex[row+1] > uindex[row])
+         get_cwrs_urow(u+uindex[row], row, uindex[row+1]-uindex[row]-2);
 }
 
 #endif /* CUSTOM_MODES */
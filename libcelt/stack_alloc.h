@@ -82,15 +82,29 @@
  */
 
 
-#if defined(VAR_ARRAYS)
+/**
+ * @def ALLOC_STATE_STACK(arena, size)
+ *
+ * Same as ALLOC_STACK, for a function called on an encoder or decoder. With
+ * ENABLE_SCRATCH_ARENA, this makes the calling thread allocate from the
+ * state's own arena unless it is already doing so (nested calls on the
+ * same state keep allocating above what their caller is using).
+ *
+ * @param arena Scratch area of the state
+ * @param size  Size of the scratch area in bytes
+ */
+
+
+#if defined(VAR_ARRAYS) && !defined(ENABLE_SCRATCH_ARENA)
 
 #define VARDECL(type, var)
 #define ALLOC(var, size, type) type var[size]
 #define SAVE_STACK
 #define RESTORE_STACK
 #define ALLOC_STACK
+#define ALLOC_STATE_STACK(arena, size)
 
-#elif defined(USE_ALLOCA)
+#elif defined(USE_ALLOCA) && !defined(ENABLE_SCRATCH_ARENA)
 
 #define VARDECL(type, var) type *var
 
@@ -103,44 +117,104 @@
 #define SAVE_STACK
 #define RESTORE_STACK
 #define ALLOC_STACK
+#define ALLOC_STATE_STACK(arena, size)
+
+#else
 
+/* With ENABLE_SCRATCH_ARENA, the pseudo-stack pointer is per thread and
+   each encoder and decoder carries its own arena, so that different states
+   can be used from different threads at the same time. Otherwise there is
+   a single stack shared by the whole process. */
+#ifdef ENABLE_SCRATCH_ARENA
+# if defined(_MSC_VER)
+#  define CELT_THREAD_LOCAL __declspec(thread)
+# elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define CELT_THREAD_LOCAL _Thread_local
+# else
+#  define CELT_THREAD_LOCAL __thread
+# endif
 #else
+# define CELT_THREAD_LOCAL
+#endif
 
 #ifdef CELT_C
-char *global_stack=0;
+CELT_THREAD_LOCAL char *global_stack=0;
 #else
-extern char *global_stack;
+extern CELT_THREAD_LOCAL char *global_stack;
 #endif /*CELT_C*/
 
-#ifdef ENABLE_VALGRIND
-
-#include <valgrind/memcheck.h>
+#if defined(ENABLE_VALGRIND) || defined(ENABLE_SCRATCH_ARENA)
+#ifdef CELT_C
+CELT_THREAD_LOCAL char *global_stack_top=0;
+#else
+extern CELT_THREAD_LOCAL char *global_stack_top;
+#endif /*CELT_C*/
+#endif
 
+#ifdef ENABLE_SCRATCH_ARENA
+/* Arena global_stack currently points into */
 #ifdef CELT_C
-char *global_stack_top=0;
+CELT_THREAD_LOCAL char *scratch_arena=0;
 #else
-extern char *global_stack_top;
+extern CELT_THREAD_LOCAL char *scratch_arena;
 #endif /*CELT_C*/
+#endif
+
+#ifdef ENABLE_VALGRIND
+
+#include <valgrind/memcheck.h>
 
 #define ALIGN(stack, size) ((stack) += ((size) - (long)(stack)) & ((size) - 1))
 #define PUSH(stack, size, type) (VALGRIND_MAKE_MEM_NOACCESS(stack, global_stack_top-stack),ALIGN((stack),sizeof(type)/sizeof(char)),VALGRIND_MAKE_MEM_UNDEFINED(stack, ((size)*sizeof(type)/sizeof(char))),(stack)+=(2*(size)*sizeof(type)/sizeof(char)),(type*)((stack)-(2*(size)*sizeof(type)/sizeof(char))))
 #define RESTORE_STACK ((global_stack = _saved_stack),VALGRIND_MAKE_MEM_NOACCESS(global_stack, global_stack_top-global_stack))
 #define ALLOC_STACK ((global_stack = (global_stack==0) ? ((global_stack_top=celt_alloc_scratch(GLOBAL_STACK_SIZE*2)+(GLOBAL_STACK_SIZE*2))-(GLOBAL_STACK_SIZE*2)) : global_stack),VALGRIND_MAKE_MEM_NOACCESS(global_stack, global_stack_top-global_stack))
+/* Everything is pushed twice as big, so the arenas are too */
+#define SCRATCH_SCALE 2
 
 #else 
 
 #define ALIGN(stack, size) ((stack) += ((size) - (long)(stack)) & ((size) - 1))
 #define PUSH(stack, size, type) (ALIGN((stack),sizeof(type)/sizeof(char)),(stack)+=(size)*(sizeof(type)/sizeof(char)),(type*)((stack)-(size)*(sizeof(type)/sizeof(char))))
 #define RESTORE_STACK (global_stack = _saved_stack)
+#ifdef ENABLE_SCRATCH_ARENA
+#define ALLOC_STACK (global_stack = (global_stack==0) ? (global_stack_top=celt_alloc_scratch(GLOBAL_STACK_SIZE)+GLOBAL_STACK_SIZE)-GLOBAL_STACK_SIZE : global_stack)
+#else
 #define ALLOC_STACK (global_stack = (global_stack==0) ? celt_alloc_scratch(GLOBAL_STACK_SIZE) : global_stack)
+#endif
+#define SCRATCH_SCALE 1
 
 #endif /*ENABLE_VALGRIND*/ 
 
 #include "os_support.h"
 #define VARDECL(type, var) type *var
-#define ALLOC(var, size, type) var = PUSH(global_stack, size, type)
 #define SAVE_STACK char *_saved_stack = global_stack;
 
+#ifdef ENABLE_SCRATCH_ARENA
+
+#define ALLOC_STATE_STACK(arena, size) \
+   ((scratch_arena != (arena) || global_stack < (arena) || global_stack > (arena)+(size)) ? \
+      (scratch_arena = (arena), global_stack = (arena), global_stack_top = (arena)+(size)) : global_stack_top)
+
+#ifdef ENABLE_ASSERTIONS
+#include "arch.h"
+static inline char *scratch_check(char *stack)
+{
+   if (global_stack > global_stack_top)
+      celt_fatal("scratch arena overflow");
+   return stack;
+}
+#define ALLOC(var, size, type) var = (type*)scratch_check((char*)PUSH(global_stack, size, type))
+#else
+#define ALLOC(var, size, type) var = PUSH(global_stack, size, type)
+#endif
+
+#else
+
+#define ALLOC_STATE_STACK(arena, size) ALLOC_STACK
+#define ALLOC(var, size, type) var = PUSH(global_stack, size, type)
+
+#endif /*ENABLE_SCRATCH_ARENA*/
+
 #endif /*VAR_ARRAYS*/
 
 
@@ -25,6 +25,14 @@ static const unsigned char cache_caps50[168] = {
 224, 224, 224, 224, 224, 224, 224, 224, 160, 160, 160, 160, 185, 185, 185, 178, 178, 168, 134, 61, 37, 224, 224, 224, 224, 224, 224, 224, 224, 240, 240, 240, 240, 207, 207, 207, 198, 198, 183, 144, 66, 40, 160, 160, 160, 160, 160, 160, 160, 160, 185, 185, 185, 185, 193, 193, 193, 183, 183, 172, 138, 64, 38, 240, 240, 240, 240, 240, 240, 240, 240, 207, 207, 207, 207, 204, 204, 204, 193, 193, 180, 143, 66, 40, 185, 185, 185, 185, 185, 185, 185, 185, 193, 193, 193, 193, 193, 193, 193, 183, 183, 172, 138, 65, 39, 207, 207, 207, 207, 207, 207, 207, 207, 204, 204, 204, 204, 201, 201, 201, 188, 188, 176, 141, 66, 40, 193, 193, 193, 193, 193, 193, 193, 193, 193, 193, 193, 193, 194, 194, 194, 184, 184, 173, 139, 65, 39, 204, 204, 204, 204, 204, 204, 204, 204, 201, 201, 201, 201, 198, 198, 198, 187, 187, 175, 140, 66, 40, };
 #endif
 
+#ifndef DEF_CWRS_TABLE50
+#define DEF_CWRS_TABLE50
+static const celt_int32 cwrs_index50[178] = {
+0, 0, 130, 260, 390, 520, 610, 700, 738, 776, 804, 824, 844, 862, 876, 890, 904, 918, 931, 944, 955, 966, 977, 988, 999, 1010, 1019, 1028, 1037, 1046, 1055, 1064, 1073, 1082, 1091, 1100, 1109, 1118, 1126, 1134, 1142, 1150, 1158, 1166, 1174, 1182, 1190, 1198, 1206, 1214, 1221, 1228, 1235, 1242, 1249, 1256, 1263, 1270, 1277, 1284, 1291, 1298, 1305, 1312, 1319, 1326, 1333, 1340, 1347, 1354, 1361, 1368, 1375, 1382, 1389, 1396, 1403, 1410, 1417, 1424, 1431, 1438, 1445, 1452, 1459, 1466, 1473, 1480, 1487, 1494, 1501, 1508, 1515, 1522, 1529, 1536, 1543, 1550, 1556, 1562, 1568, 1574, 1580, 1586, 1592, 1598, 1604, 1610, 1616, 1622, 1628, 1634, 1640, 1646, 1652, 1658, 1664, 1670, 1676, 1682, 1688, 1694, 1700, 1706, 1712, 1718, 1724, 1730, 1736, 1742, 1748, 1754, 1760, 1766, 1772, 1778, 1784, 1790, 1796, 1802, 1808, 1814, 1820, 1826, 1832, 1838, 1844, 1850, 1856, 1862, 1868, 1874, 1880, 1886, 1892, 1898, 1904, 1910, 1916, 1922, 1928, 1934, 1940, 1946, 1952, 1958, 1964, 1970, 1976, 1982, 1988, 1994, 2000, 2006, 2012, 2018, 2024, 2030, };
+static const celt_uint32 cwrs_u50[2030] = {
+0U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 1U, 0U, 1U, 3U, 5U, 7U, 9U, 11U, 13U, 15U, 17U, 19U, 21U, 23U, 25U, 27U, 29U, 31U, 33U, 35U, 37U, 39U, 41U, 43U, 45U, 47U, 49U, 51U, 53U, 55U, 57U, 59U, 61U, 63U, 65U, 67U, 69U, 71U, 73U, 75U, 77U, 79U, 81U, 83U, 85U, 87U, 89U, 91U, 93U, 95U, 97U, 99U, 101U, 103U, 105U, 107U, 109U, 111U, 113U, 115U, 117U, 119U, 121U, 123U, 125U, 127U, 129U, 131U, 133U, 135U, 137U, 139U, 141U, 143U, 145U, 147U, 149U, 151U, 153U, 155U, 157U, 159U, 161U, 163U, 165U, 167U, 169U, 171U, 173U, 175U, 177U, 179U, 181U, 183U, 185U, 187U, 189U, 191U, 193U, 195U, 197U, 199U, 201U, 203U, 205U, 207U, 209U, 211U, 213U, 215U, 217U, 219U, 221U, 223U, 225U, 227U, 229U, 231U, 233U, 235U, 237U, 239U, 241U, 243U, 245U, 247U, 249U, 251U, 253U, 255U, 257U, 0U, 1U, 5U, 13U, 25U, 41U, 61U, 85U, 113U, 145U, 181U, 221U, 265U, 313U, 365U, 421U, 481U, 545U, 613U, 685U, 761U, 841U, 925U, 1013U, 1105U, 1201U, 1301U, 1405U, 1513U, 1625U, 1741U, 1861U, 1985U, 2113U, 2245U, 2381U, 2521U, 2665U, 2813U, 2965U, 3121U, 3281U, 3445U, 3613U, 3785U, 3961U, 4141U, 4325U, 4513U, 4705U, 4901U, 5101U, 5305U, 5513U, 5725U, 5941U, 6161U, 6385U, 6613U, 6845U, 7081U, 7321U, 7565U, 7813U, 8065U, 8321U, 8581U, 8845U, 9113U, 9385U, 9661U, 9941U, 10225U, 10513U, 10805U, 11101U, 11401U, 11705U, 12013U, 12325U, 12641U, 12961U, 13285U, 13613U, 13945U, 14281U, 14621U, 14965U, 15313U, 15665U, 16021U, 16381U, 16745U, 17113U, 17485U, 17861U, 18241U, 18625U, 19013U, 19405U, 19801U, 20201U, 20605U, 21013U, 21425U, 21841U, 22261U, 22685U, 23113U, 23545U, 23981U, 24421U, 24865U, 25313U, 25765U, 26221U, 26681U, 27145U, 27613U, 28085U, 28561U, 29041U, 29525U, 30013U, 30505U, 31001U, 31501U, 32005U, 32513U, 33025U, 0U, 1U, 7U, 25U, 63U, 129U, 231U, 377U, 575U, 833U, 1159U, 1561U, 2047U, 2625U, 3303U, 4089U, 4991U, 6017U, 7175U, 8473U, 9919U, 11521U, 13287U, 15225U, 17343U, 19649U, 22151U, 24857U, 27775U, 30913U, 34279U, 37881U, 41727U, 45825U, 50183U, 54809U, 59711U, 64897U, 70375U, 76153U, 82239U, 88641U, 95367U, 102425U, 109823U, 117569U, 125671U, 134137U, 142975U, 152193U, 161799U, 171801U, 182207U, 193025U, 204263U, 215929U, 228031U, 240577U, 253575U, 267033U, 280959U, 295361U, 310247U, 325625U, 341503U, 357889U, 374791U, 392217U, 410175U, 428673U, 447719U, 467321U, 487487U, 508225U, 529543U, 551449U, 573951U, 597057U, 620775U, 645113U, 670079U, 695681U, 721927U, 748825U, 776383U, 804609U, 833511U, 863097U, 893375U, 924353U, 956039U, 988441U, 1021567U, 1055425U, 1090023U, 1125369U, 1161471U, 1198337U, 1235975U, 1274393U, 1313599U, 1353601U, 1394407U, 1436025U, 1478463U, 1521729U, 1565831U, 1610777U, 1656575U, 1703233U, 1750759U, 1799161U, 1848447U, 1898625U, 1949703U, 2001689U, 2054591U, 2108417U, 2163175U, 2218873U, 2275519U, 2333121U, 2391687U, 2451225U, 2511743U, 2573249U, 2635751U, 2699257U, 2763775U, 2829313U, 0U, 1U, 9U, 41U, 129U, 321U, 681U, 1289U, 2241U, 3649U, 5641U, 8361U, 11969U, 16641U, 22569U, 29961U, 39041U, 50049U, 63241U, 78889U, 97281U, 118721U, 143529U, 172041U, 204609U, 241601U, 283401U, 330409U, 383041U, 441729U, 506921U, 579081U, 658689U, 746241U, 842249U, 947241U, 1061761U, 1186369U, 1321641U, 1468169U, 1626561U, 1797441U, 1981449U, 2179241U, 2391489U, 2618881U, 2862121U, 3121929U, 3399041U, 3694209U, 4008201U, 4341801U, 4695809U, 5071041U, 5468329U, 5888521U, 6332481U, 6801089U, 7295241U, 7815849U, 8363841U, 8940161U, 9545769U, 10181641U, 10848769U, 11548161U, 12280841U, 13047849U, 13850241U, 14689089U, 15565481U, 16480521U, 17435329U, 18431041U, 19468809U, 20549801U, 21675201U, 22846209U, 24064041U, 25329929U, 26645121U, 28010881U, 29428489U, 30899241U, 32424449U, 34005441U, 35643561U, 37340169U, 39096641U, 40914369U, 0U, 1U, 11U, 61U, 231U, 681U, 1683U, 3653U, 7183U, 13073U, 22363U, 36365U, 56695U, 85305U, 124515U, 177045U, 246047U, 335137U, 448427U, 590557U, 766727U, 982729U, 1244979U, 1560549U, 1937199U, 2383409U, 2908411U, 3522221U, 4235671U, 5060441U, 6009091U, 7095093U, 8332863U, 9737793U, 11326283U, 13115773U, 15124775U, 17372905U, 19880915U, 22670725U, 25765455U, 29189457U, 32968347U, 37129037U, 41699767U, 46710137U, 52191139U, 58175189U, 64696159U, 71789409U, 79491819U, 87841821U, 96879431U, 106646281U, 117185651U, 128542501U, 140763503U, 153897073U, 167993403U, 183104493U, 199284183U, 216588185U, 235074115U, 254801525U, 275831935U, 298228865U, 322057867U, 347386557U, 374284647U, 402823977U, 433078547U, 465124549U, 499040399U, 534906769U, 572806619U, 612825229U, 655050231U, 699571641U, 746481891U, 795875861U, 847850911U, 902506913U, 959946283U, 1020274013U, 1083597703U, 1150027593U, 1219676595U, 1292660325U, 1369097135U, 1449108145U, 0U, 1U, 13U, 85U, 377U, 1289U, 3653U, 8989U, 19825U, 40081U, 75517U, 134245U, 227305U, 369305U, 579125U, 880685U, 1303777U, 1884961U, 2668525U, 3707509U, 5064793U, 6814249U, 9041957U, 11847485U, 15345233U, 19665841U, 24957661U, 31388293U, 39146185U, 48442297U, 59511829U, 72616013U, 88043969U, 106114625U, 127178701U, 151620757U, 179861305U, 212358985U, 0U, 1U, 15U, 113U, 575U, 2241U, 7183U, 19825U, 48639U, 108545U, 224143U, 433905U, 795455U, 1392065U, 2340495U, 3800305U, 5984767U, 9173505U, 13726991U, 20103025U, 28875327U, 40754369U, 56610575U, 77500017U, 104692735U, 139703809U, 184327311U, 240673265U, 311207743U, 398796225U, 506750351U, 638878193U, 799538175U, 993696769U, 1226990095U, 1505789553U, 1837271615U, 2229491905U, 0U, 1U, 17U, 145U, 833U, 3649U, 13073U, 40081U, 108545U, 265729U, 598417U, 1256465U, 2485825U, 4673345U, 8405905U, 14546705U, 24331777U, 39490049U, 62390545U, 96220561U, 145198913U, 214828609U, 312193553U, 446304145U, 628496897U, 872893441U, 1196924561U, 1621925137U, 0U, 1U, 19U, 181U, 1159U, 5641U, 22363U, 75517U, 224143U, 598417U, 1462563U, 3317445U, 7059735U, 14218905U, 27298155U, 50250765U, 89129247U, 152951073U, 254831667U, 413442773U, 0U, 1U, 21U, 221U, 1561U, 8361U, 36365U, 134245U, 433905U, 1256465U, 3317445U, 8097453U, 18474633U, 39753273U, 81270333U, 158819253U, 298199265U, 540279585U, 948062325U, 1616336765U, 0U, 1U, 23U, 265U, 2047U, 11969U, 56695U, 227305U, 795455U, 2485825U, 7059735U, 18474633U, 45046719U, 103274625U, 224298231U, 464387817U, 921406335U, 1759885185U, 0U, 1U, 25U, 313U, 2625U, 16641U, 85305U, 369305U, 1392065U, 4673345U, 14218905U, 39753273U, 103274625U, 251595969U, 0U, 1U, 27U, 365U, 3303U, 22569U, 124515U, 579125U, 2340495U, 8405905U, 27298155U, 81270333U, 224298231U, 579168825U, 0U, 1U, 29U, 421U, 4089U, 29961U, 177045U, 880685U, 3800305U, 14546705U, 50250765U, 158819253U, 464387817U, 1267854873U, 0U, 1U, 31U, 481U, 4991U, 39041U, 246047U, 1303777U, 5984767U, 24331777U, 89129247U, 298199265U, 921406335U, 2653649025U, 0U, 1U, 33U, 545U, 6017U, 50049U, 335137U, 1884961U, 9173505U, 39490049U, 152951073U, 540279585U, 1759885185U, 0U, 1U, 35U, 613U, 7175U, 63241U, 448427U, 2668525U, 13726991U, 62390545U, 254831667U, 948062325U, 3248227095U, 0U, 1U, 37U, 685U, 8473U, 78889U, 590557U, 3707509U, 20103025U, 96220561U, 413442773U, 0U, 1U, 39U, 761U, 9919U, 97281U, 766727U, 5064793U, 28875327U, 145198913U, 654862247U, 0U, 1U, 41U, 841U, 11521U, 118721U, 982729U, 6814249U, 40754369U, 214828609U, 1014889769U, 0U, 1U, 43U, 925U, 13287U, 143529U, 1244979U, 9041957U, 56610575U, 312193553U, 1541911931U, 0U, 1U, 45U, 1013U, 15225U, 172041U, 1560549U, 11847485U, 77500017U, 446304145U, 2300409629U, 0U, 1U, 47U, 1105U, 17343U, 204609U, 1937199U, 15345233U, 104692735U, 628496897U, 3375210671U, 0U, 1U, 49U, 1201U, 19649U, 241601U, 2383409U, 19665841U, 139703809U, 0U, 1U, 51U, 1301U, 22151U, 283401U, 2908411U, 24957661U, 184327311U, 0U, 1U, 53U, 1405U, 24857U, 330409U, 3522221U, 31388293U, 240673265U, 0U, 1U, 55U, 1513U, 27775U, 383041U, 4235671U, 39146185U, 311207743U, 0U, 1U, 57U, 1625U, 30913U, 441729U, 5060441U, 48442297U, 398796225U, 0U, 1U, 59U, 1741U, 34279U, 506921U, 6009091U, 59511829U, 506750351U, 0U, 1U, 61U, 1861U, 37881U, 579081U, 7095093U, 72616013U, 638878193U, 0U, 1U, 63U, 1985U, 41727U, 658689U, 8332863U, 88043969U, 799538175U, 0U, 1U, 65U, 2113U, 45825U, 746241U, 9737793U, 106114625U, 993696769U, 0U, 1U, 67U, 2245U, 50183U, 842249U, 11326283U, 127178701U, 1226990095U, 0U, 1U, 69U, 2381U, 54809U, 947241U, 13115773U, 151620757U, 1505789553U, 0U, 1U, 71U, 2521U, 59711U, 1061761U, 15124775U, 179861305U, 1837271615U, 0U, 1U, 73U, 2665U, 64897U, 1186369U, 17372905U, 212358985U, 0U, 1U, 75U, 2813U, 70375U, 1321641U, 19880915U, 249612805U, 0U, 1U, 77U, 2965U, 76153U, 1468169U, 22670725U, 292164445U, 0U, 1U, 79U, 3121U, 82239U, 1626561U, 25765455U, 340600625U, 0U, 1U, 81U, 3281U, 88641U, 1797441U, 29189457U, 395555537U, 0U, 1U, 83U, 3445U, 95367U, 1981449U, 32968347U, 457713341U, 0U, 1U, 85U, 3613U, 102425U, 2179241U, 37129037U, 527810725U, 0U, 1U, 87U, 3785U, 109823U, 2391489U, 41699767U, 606639529U, 0U, 1U, 89U, 3961U, 117569U, 2618881U, 46710137U, 695049433U, 0U, 1U, 91U, 4141U, 125671U, 2862121U, 52191139U, 793950709U, 0U, 1U, 93U, 4325U, 134137U, 3121929U, 58175189U, 904317037U, 0U, 1U, 95U, 4513U, 142975U, 3399041U, 64696159U, 1027188385U, 0U, 1U, 97U, 4705U, 152193U, 3694209U, 71789409U, 0U, 1U, 99U, 4901U, 161799U, 4008201U, 79491819U, 0U, 1U, 101U, 5101U, 171801U, 4341801U, 87841821U, 0U, 1U, 103U, 5305U, 182207U, 4695809U, 96879431U, 0U, 1U, 105U, 5513U, 193025U, 5071041U, 106646281U, 0U, 1U, 107U, 5725U, 204263U, 5468329U, 117185651U, 0U, 1U, 109U, 5941U, 215929U, 5888521U, 128542501U, 0U, 1U, 111U, 6161U, 228031U, 6332481U, 140763503U, 0U, 1U, 113U, 6385U, 240577U, 6801089U, 153897073U, 0U, 1U, 115U, 6613U, 253575U, 7295241U, 167993403U, 0U, 1U, 117U, 6845U, 267033U, 7815849U, 183104493U, 0U, 1U, 119U, 7081U, 280959U, 8363841U, 199284183U, 0U, 1U, 121U, 7321U, 295361U, 8940161U, 216588185U, 0U, 1U, 123U, 7565U, 310247U, 9545769U, 235074115U, 0U, 1U, 125U, 7813U, 325625U, 10181641U, 254801525U, 0U, 1U, 127U, 8065U, 341503U, 10848769U, 275831935U, 0U, 1U, 129U, 8321U, 357889U, 11548161U, 298228865U, 0U, 1U, 131U, 8581U, 374791U, 12280841U, 322057867U, 0U, 1U, 133U, 8845U, 392217U, 13047849U, 347386557U, 0U, 1U, 135U, 9113U, 410175U, 13850241U, 374284647U, 0U, 1U, 137U, 9385U, 428673U, 14689089U, 402823977U, 0U, 1U, 139U, 9661U, 447719U, 15565481U, 433078547U, 0U, 1U, 141U, 9941U, 467321U, 16480521U, 465124549U, 0U, 1U, 143U, 10225U, 487487U, 17435329U, 499040399U, 0U, 1U, 145U, 10513U, 508225U, 18431041U, 534906769U, 0U, 1U, 147U, 10805U, 529543U, 19468809U, 572806619U, 0U, 1U, 149U, 11101U, 551449U, 20549801U, 612825229U, 0U, 1U, 151U, 11401U, 573951U, 21675201U, 655050231U, 0U, 1U, 153U, 11705U, 597057U, 22846209U, 699571641U, 0U, 1U, 155U, 12013U, 620775U, 24064041U, 746481891U, 0U, 1U, 157U, 12325U, 645113U, 25329929U, 795875861U, 0U, 1U, 159U, 12641U, 670079U, 26645121U, 847850911U, 0U, 1U, 161U, 12961U, 695681U, 28010881U, 902506913U, 0U, 1U, 163U, 13285U, 721927U, 29428489U, 959946283U, 0U, 1U, 165U, 13613U, 748825U, 30899241U, 1020274013U, 0U, 1U, 167U, 13945U, 776383U, 32424449U, 1083597703U, 0U, 1U, 169U, 14281U, 804609U, 34005441U, 1150027593U, 0U, 1U, 171U, 14621U, 833511U, 35643561U, 1219676595U, 0U, 1U, 173U, 14965U, 863097U, 37340169U, 1292660325U, 0U, 1U, 175U, 15313U, 893375U, 39096641U, 1369097135U, 0U, 1U, 177U, 15665U, 924353U, 40914369U, 1449108145U, 0U, 1U, 179U, 16021U, 956039U, 42794761U, 1532817275U, 0U, 1U, 181U, 16381U, 988441U, 44739241U, 1620351277U, 0U, 1U, 183U, 16745U, 1021567U, 46749249U, 1711839767U, 0U, 1U, 185U, 17113U, 1055425U, 48826241U, 1807415257U, 0U, 1U, 187U, 17485U, 1090023U, 50971689U, 1907213187U, 0U, 1U, 189U, 17861U, 1125369U, 53187081U, 2011371957U, 0U, 1U, 191U, 18241U, 1161471U, 55473921U, 2120032959U, 0U, 1U, 193U, 18625U, 1198337U, 57833729U, 0U, 1U, 195U, 19013U, 1235975U, 60268041U, 0U, 1U, 197U, 19405U, 1274393U, 62778409U, 0U, 1U, 199U, 19801U, 1313599U, 65366401U, 0U, 1U, 201U, 20201U, 1353601U, 68033601U, 0U, 1U, 203U, 20605U, 1394407U, 70781609U, 0U, 1U, 205U, 21013U, 1436025U, 73612041U, 0U, 1U, 207U, 21425U, 1478463U, 76526529U, 0U, 1U, 209U, 21841U, 1521729U, 79526721U, 0U, 1U, 211U, 22261U, 1565831U, 82614281U, 0U, 1U, 213U, 22685U, 1610777U, 85790889U, 0U, 1U, 215U, 23113U, 1656575U, 89058241U, 0U, 1U, 217U, 23545U, 1703233U, 92418049U, 0U, 1U, 219U, 23981U, 1750759U, 95872041U, 0U, 1U, 221U, 24421U, 1799161U, 99421961U, 0U, 1U, 223U, 24865U, 1848447U, 103069569U, 0U, 1U, 225U, 25313U, 1898625U, 106816641U, 0U, 1U, 227U, 25765U, 1949703U, 110664969U, 0U, 1U, 229U, 26221U, 2001689U, 114616361U, 0U, 1U, 231U, 26681U, 2054591U, 118672641U, 0U, 1U, 233U, 27145U, 2108417U, 122835649U, 0U, 1U, 235U, 27613U, 2163175U, 127107241U, 0U, 1U, 237U, 28085U, 2218873U, 131489289U, 0U, 1U, 239U, 28561U, 2275519U, 135983681U, 0U, 1U, 241U, 29041U, 2333121U, 140592321U, 0U, 1U, 243U, 29525U, 2391687U, 145317129U, 0U, 1U, 245U, 30013U, 2451225U, 150160041U, 0U, 1U, 247U, 30505U, 2511743U, 155123009U, 0U, 1U, 249U, 31001U, 2573249U, 160208001U, 0U, 1U, 251U, 31501U, 2635751U, 165417001U, 0U, 1U, 253U, 32005U, 2699257U, 170752009U, 0U, 1U, 255U, 32513U, 2763775U, 176215041U, 0U, 1U, 257U, 33025U, 2829313U, 181808129U, 0U, 1U, 259U, 33541U, 2895879U, 187533321U, 0U, 1U, 261U, 34061U, 2963481U, 193392681U, 0U, 1U, 263U, 34585U, 3032127U, 199388289U, 0U, 1U, 265U, 35113U, 3101825U, 205522241U, 0U, 1U, 267U, 35645U, 3172583U, 211796649U, 0U, 1U, 269U, 36181U, 3244409U, 218213641U, 0U, 1U, 271U, 36721U, 3317311U, 224775361U, 0U, 1U, 273U, 37265U, 3391297U, 231483969U, 0U, 1U, 275U, 37813U, 3466375U, 238341641U, 0U, 1U, 277U, 38365U, 3542553U, 245350569U, 0U, 1U, 279U, 38921U, 3619839U, 252512961U, 0U, 1U, 281U, 39481U, 3698241U, 259831041U, 0U, 1U, 283U, 40045U, 3777767U, 267307049U, 0U, 1U, 285U, 40613U, 3858425U, 274943241U, 0U, 1U, 287U, 41185U, 3940223U, 282741889U, 0U, 1U, 289U, 41761U, 4023169U, 290705281U, 0U, 1U, 291U, 42341U, 4107271U, 298835721U, 0U, 1U, 293U, 42925U, 4192537U, 307135529U, 0U, 1U, 295U, 43513U, 4278975U, 315607041U, 0U, 1U, 297U, 44105U, 4366593U, 324252609U, 0U, 1U, 299U, 44701U, 4455399U, 333074601U, 0U, 1U, 301U, 45301U, 4545401U, 342075401U, 0U, 1U, 303U, 45905U, 4636607U, 351257409U, 0U, 1U, 305U, 46513U, 4729025U, 360623041U, 0U, 1U, 307U, 47125U, 4822663U, 370174729U, 0U, 1U, 309U, 47741U, 4917529U, 379914921U, 0U, 1U, 311U, 48361U, 5013631U, 389846081U, 0U, 1U, 313U, 48985U, 5110977U, 399970689U, 0U, 1U, 315U, 49613U, 5209575U, 410291241U, 0U, 1U, 317U, 50245U, 5309433U, 420810249U, 0U, 1U, 319U, 50881U, 5410559U, 431530241U, 0U, 1U, 321U, 51521U, 5512961U, 442453761U, 0U, 1U, 323U, 52165U, 5616647U, 453583369U, 0U, 1U, 325U, 52813U, 5721625U, 464921641U, 0U, 1U, 327U, 53465U, 5827903U, 476471169U, 0U, 1U, 329U, 54121U, 5935489U, 488234561U, 0U, 1U, 331U, 54781U, 6044391U, 500214441U, 0U, 1U, 333U, 55445U, 6154617U, 512413449U, 0U, 1U, 335U, 56113U, 6266175U, 524834241U, 0U, 1U, 337U, 56785U, 6379073U, 537479489U, 0U, 1U, 339U, 57461U, 6493319U, 550351881U, 0U, 1U, 341U, 58141U, 6608921U, 563454121U, 0U, 1U, 343U, 58825U, 6725887U, 576788929U, 0U, 1U, 345U, 59513U, 6844225U, 590359041U, 0U, 1U, 347U, 60205U, 6963943U, 604167209U, 0U, 1U, 349U, 60901U, 7085049U, 618216201U, 0U, 1U, 351U, 61601U, 7207551U, 632508801U, };
+#endif
+
 #ifndef FFT_TWIDDLES48000_960
 #define FFT_TWIDDLES48000_960
 static const kiss_twiddle_cpx fft_twiddles48000_960[480] = {
@@ -125,6 +133,7 @@ window120,	/* window */
 120,	/* shortMdctSize */
 logN400,	/* logN */
 {392, cache_index50, cache_bits50, cache_caps50},	/* cache */
+{176, cwrs_index50, cwrs_u50},	/* cwrs */
 };
 
 /* List of all the available modes */
@@ -42,6 +42,10 @@
 #define M_PI 3.141592653
 #endif
 
+#if defined(ENABLE_SSE) && !defined(FIXED_DEBUG)
+#include "vq_sse.h"
+#endif
+
 static void exp_rotation1(celt_norm *X, int len, int stride, celt_word16 c, celt_word16 s)
 {
    int i;
@@ -171,8 +175,45 @@ static unsigned extract_collapse_mask(int *iy, int N, int B)
    return collapse_mask;
 }
 
+#ifndef OVERRIDE_PULSE_SEARCH
+/** Finds where one more pulse maximises Rxy/sqrt(Ryy), keeping the first
+    position on ties. xy and yy are the correlation and energy of the
+    current pulses, y holds twice the current pulse vector. */
+static int pulse_search(const celt_norm *X, const celt_norm *y, int N,
+      celt_word32 xy, celt_word16 yy, int rshift)
+{
+   int j;
+   int best_id;
+   celt_word32 best_num = -VERY_LARGE16;
+   celt_word16 best_den = 0;
+   best_id = 0;
+   j=0;
+   do {
+      celt_word16 Rxy, Ryy;
+      /* Temporary sums of the new pulse(s) */
+      Rxy = EXTRACT16(SHR32(ADD32(xy, EXTEND32(X[j])),rshift));
+      /* We're multiplying y[j] by two so we don't have to do it here */
+      Ryy = ADD16(yy, y[j]);
+
+      /* Approximate score: we maximise Rxy/sqrt(Ryy) (we're guaranteed that
+         Rxy is positive because the sign is pre-computed) */
+      Rxy = MULT16_16_Q15(Rxy,Rxy);
+      /* The idea is to check for num/den >= best_num/best_den, but that way
+         we can do it without any division */
+      /* OPT: Make sure to use conditional moves here */
+      if (MULT16_16(best_den, Rxy) > MULT16_16(Ryy, best_num))
+      {
+         best_den = Ryy;
+         best_num = Rxy;
+         best_id = j;
+      }
+   } while (++j<N);
+   return best_id;
+}
+#endif
+
 unsigned alg_quant(celt_norm *X, int N, int K, int spread, int B,
-      int resynth, ec_enc *enc, celt_word16 gain)
+      int resynth, const CWRSTable *cwrs, ec_enc *enc, celt_word16 gain)
 {
    VARDECL(celt_norm, y);
    VARDECL(int, iy);
@@ -183,6 +224,7 @@ unsigned alg_quant(celt_norm *X, int N, int K, int spread, int B,
    celt_word32 sum;
    celt_word32 xy;
    celt_word16 yy;
+   int rshift=0;
    unsigned collapse_mask;
    SAVE_STACK;
 
@@ -268,40 +310,14 @@ unsigned alg_quant(celt_norm *X, int N, int K, int spread, int B,
    for (i=0;i<pulsesLeft;i++)
    {
       int best_id;
-      celt_word32 best_num = -VERY_LARGE16;
-      celt_word16 best_den = 0;
-#ifdef FIXED_POINT
-      int rshift;
-#endif
 #ifdef FIXED_POINT
       rshift = 1+celt_ilog2(K-pulsesLeft+i+1);
 #endif
-      best_id = 0;
       /* The squared magnitude term gets added anyway, so we might as well 
          add it outside the loop */
       yy = ADD32(yy, 1);
-      j=0;
-      do {
-         celt_word16 Rxy, Ryy;
-         /* Temporary sums of the new pulse(s) */
-         Rxy = EXTRACT16(SHR32(ADD32(xy, EXTEND32(X[j])),rshift));
-         /* We're multiplying y[j] by two so we don't have to do it here */
-         Ryy = ADD16(yy, y[j]);
-
-         /* Approximate score: we maximise Rxy/sqrt(Ryy) (we're guaranteed that
-            Rxy is positive because the sign is pre-computed) */
-         Rxy = MULT16_16_Q15(Rxy,Rxy);
-         /* The idea is to check for num/den >= best_num/best_den, but that way
-            we can do it without any division */
-         /* OPT: Make sure to use conditional moves here */
-         if (MULT16_16(best_den, Rxy) > MULT16_16(Ryy, best_num))
-         {
-            best_den = Ryy;
-            best_num = Rxy;
-            best_id = j;
-         }
-      } while (++j<N);
-      
+      best_id = pulse_search(X, y, N, xy, yy, rshift);
+
       /* Updating the sums of the new pulse(s) */
       xy = ADD32(xy, EXTEND32(X[best_id]));
       /* We're multiplying y[j] by two so we don't have to do it here */
@@ -320,7 +336,7 @@ unsigned alg_quant(celt_norm *X, int N, int K, int spread, int B,
       if (signx[j] < 0)
          iy[j] = -iy[j];
    } while (++j<N);
-   encode_pulses(iy, N, K, enc);
+   encode_pulses(iy, N, K, cwrs, enc);
    
    if (resynth)
    {
@@ -336,7 +352,7 @@ unsigned alg_quant(celt_norm *X, int N, int K, int spread, int B,
 /** Decode pulse vector and combine the result with the pitch vector to produce
     the final normalised signal in the current band. */
 unsigned alg_unquant(celt_norm *X, int N, int K, int spread, int B,
-      ec_dec *dec, celt_word16 gain)
+      const CWRSTable *cwrs, ec_dec *dec, celt_word16 gain)
 {
    int i;
    celt_word32 Ryy;
@@ -346,7 +362,7 @@ unsigned alg_unquant(celt_norm *X, int N, int K, int spread, int B,
 
    celt_assert2(K!=0, "alg_unquant() needs at least one pulse");
    ALLOC(iy, N, int);
-   decode_pulses(iy, N, K, dec);
+   decode_pulses(iy, N, K, cwrs, dec);
    Ryy = 0;
    i=0;
    do {
@@ -45,22 +45,24 @@
  * @param N Number of samples to encode
  * @param K Number of pulses to use
  * @param p Pitch vector (it is assumed that p+x is a unit vector)
+ * @param cwrs Precomputed CWRS rows of the mode (may be NULL)
  * @param enc Entropy encoder state
  * @ret A mask indicating which blocks in the band received pulses
 */
 unsigned alg_quant(celt_norm *X, int N, int K, int spread, int B,
-      int resynth, ec_enc *enc, celt_word16 gain);
+      int resynth, const CWRSTable *cwrs, ec_enc *enc, celt_word16 gain);
 
 /** Algebraic pulse decoder
  * @param x Decoded normalised spectrum (returned)
  * @param N Number of samples to decode
  * @param K Number of pulses to use
  * @param p Pitch vector (automatically added to x)
+ * @param cwrs Precomputed CWRS rows of the mode (may be NULL)
  * @param dec Entropy decoder state
  * @ret A mask indicating which blocks in the band received pulses
  */
 unsigned alg_unquant(celt_norm *X, int N, int K, int spread, int B,
-      ec_dec *dec, celt_word16 gain);
+      const CWRSTable *cwrs, ec_dec *dec, celt_word16 gain);
 
 void renormalise_vector(celt_norm *X, int N, celt_word16 gain);
 
@@ -0,0 +1,164 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/**
+   @file vq_sse.h
+   @brief SSE pulse search for alg_quant()
+*/
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef VQ_SSE_H
+#define VQ_SSE_H
+
+/* The pulse search scans all N positions, but the running best only
+   changes a handful of times per pulse. These versions score a block of
+   candidates at once against the current best and only go through the
+   candidates one by one, exactly like the C code, when at least one of
+   them beats it. Skipping a block is only done when the C code would not
+   have updated anything in it either, so the result is always the same
+   position. */
+
+#define OVERRIDE_PULSE_SEARCH
+
+static inline void pulse_search_scalar(const celt_norm *X, const celt_norm *y, int j, int end,
+      celt_word32 xy, celt_word16 yy, int rshift, celt_word32 *best_num,
+      celt_word16 *best_den, int *best_id)
+{
+   for (;j<end;j++)
+   {
+      celt_word16 Rxy, Ryy;
+      Rxy = EXTRACT16(SHR32(ADD32(xy, EXTEND32(X[j])),rshift));
+      Ryy = ADD16(yy, y[j]);
+      Rxy = MULT16_16_Q15(Rxy,Rxy);
+      if (MULT16_16(*best_den, Rxy) > MULT16_16(Ryy, *best_num))
+      {
+         *best_den = Ryy;
+         *best_num = Rxy;
+         *best_id = j;
+      }
+   }
+}
+
+#ifdef FIXED_POINT
+
+#include <emmintrin.h>
+
+/* Truncates 2x4 32-bit values to 8 16-bit values, like EXTRACT16() */
+static inline __m128i extract16x8(__m128i lo, __m128i hi)
+{
+   return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16),
+                          _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+}
+
+/* Full 32-bit products of 8 16-bit values, like MULT16_16() */
+static inline void mult16_16x8(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+   __m128i l = _mm_mullo_epi16(a, b);
+   __m128i h = _mm_mulhi_epi16(a, b);
+   *lo = _mm_unpacklo_epi16(l, h);
+   *hi = _mm_unpackhi_epi16(l, h);
+}
+
+/* Eight candidates per pass, with the 32-bit intermediate values of the C
+   code kept exact */
+static int pulse_search(const celt_norm *X, const celt_norm *y, int N,
+      celt_word32 xy, celt_word16 yy, int rshift)
+{
+   int j;
+   int best_id = 0;
+   celt_word32 best_num = -VERY_LARGE16;
+   celt_word16 best_den = 0;
+   const __m128i xy4 = _mm_set1_epi32(xy);
+   const __m128i yy8 = _mm_set1_epi16(yy);
+   const __m128i shift = _mm_cvtsi32_si128(rshift);
+   __m128i num8, den8;
+   /* The first candidate always wins against the initial best, so score it
+      on its own rather than falling back on the whole first block */
+   pulse_search_scalar(X, y, 0, 1, xy, yy, rshift, &best_num, &best_den, &best_id);
+   num8 = _mm_set1_epi16(best_num);
+   den8 = _mm_set1_epi16(best_den);
+   for (j=1;j+8<=N;j+=8)
+   {
+      __m128i x, Rxy, Ryy, lo, hi, lo2, hi2;
+      x = _mm_loadu_si128((const __m128i*)(X+j));
+      /* Rxy = EXTRACT16(SHR32(ADD32(xy, EXTEND32(X[j])),rshift)) */
+      lo = _mm_sra_epi32(_mm_add_epi32(xy4, _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), shift);
+      hi = _mm_sra_epi32(_mm_add_epi32(xy4, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), shift);
+      Rxy = extract16x8(lo, hi);
+      /* Rxy = MULT16_16_Q15(Rxy,Rxy) */
+      mult16_16x8(Rxy, Rxy, &lo, &hi);
+      Rxy = extract16x8(_mm_srai_epi32(lo, 15), _mm_srai_epi32(hi, 15));
+      Ryy = _mm_add_epi16(yy8, _mm_loadu_si128((const __m128i*)(y+j)));
+      /* MULT16_16(best_den, Rxy) > MULT16_16(Ryy, best_num) */
+      mult16_16x8(den8, Rxy, &lo, &hi);
+      mult16_16x8(Ryy, num8, &lo2, &hi2);
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi32(lo, lo2), _mm_cmpgt_epi32(hi, hi2))))
+      {
+         pulse_search_scalar(X, y, j, j+8, xy, yy, rshift, &best_num, &best_den, &best_id);
+         num8 = _mm_set1_epi16(best_num);
+         den8 = _mm_set1_epi16(best_den);
+      }
+   }
+   pulse_search_scalar(X, y, j, N, xy, yy, rshift, &best_num, &best_den, &best_id);
+   return best_id;
+}
+
+#else
+
+#include <xmmintrin.h>
+
+/* Four candidates per pass */
+static int pulse_search(const celt_norm *X, const celt_norm *y, int N,
+      celt_word32 xy, celt_word16 yy, int rshift)
+{
+   int j;
+   int best_id = 0;
+   celt_word32 best_num = -VERY_LARGE16;
+   celt_word16 best_den = 0;
+   const __m128 xy4 = _mm_set1_ps(xy);
+   const __m128 yy4 = _mm_set1_ps(yy);
+   __m128 num4, den4;
+   pulse_search_scalar(X, y, 0, 1, xy, yy, rshift, &best_num, &best_den, &best_id);
+   num4 = _mm_set1_ps(best_num);
+   den4 = _mm_set1_ps(best_den);
+   for (j=1;j+4<=N;j+=4)
+   {
+      __m128 Rxy, Ryy;
+      Rxy = _mm_add_ps(xy4, _mm_loadu_ps(X+j));
+      Rxy = _mm_mul_ps(Rxy, Rxy);
+      Ryy = _mm_add_ps(yy4, _mm_loadu_ps(y+j));
+      if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_mul_ps(den4, Rxy), _mm_mul_ps(Ryy, num4))))
+      {
+         pulse_search_scalar(X, y, j, j+4, xy, yy, rshift, &best_num, &best_den, &best_id);
+         num4 = _mm_set1_ps(best_num);
+         den4 = _mm_set1_ps(best_den);
+      }
+   }
+   pulse_search_scalar(X, y, j, N, xy, yy, rshift, &best_num, &best_den, &best_id);
+   return best_id;
+}
+
+#endif /* FIXED_POINT */
+
+#endif /* VQ_SSE_H */
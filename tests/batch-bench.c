@@ -0,0 +1,254 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Benchmark for coding many streams that share a mode, one celt_encode()
+   or celt_decode() call per stream against celt_encode_batch() or
+   celt_decode_batch() on all of them.
+
+   Encodes every frame of a set of streams once with each method, each on
+   its own set of encoders, then decodes the packets the same way, and
+   reports how many real-time streams one core sustains for each. Run with
+   --help for the options.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_FRAME 960
+#define MAX_PACKET 1275
+
+/* Real-time streams that one core sustains, from the CPU time it took to
+   code frames frames of streams streams */
+static double streams_per_core(clock_t cpu, int streams, int frames, int frame_size)
+{
+   double audio = (double)streams*frames*frame_size/48000;
+   double seconds = (double)cpu/CLOCKS_PER_SEC;
+   return seconds > 0 ? audio/seconds : 0;
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage: batch-bench [options]\n"
+         "  --streams n       number of streams (default 200)\n"
+         "  --frames n        frames coded for each of them (default 50)\n"
+         "  --frame-size n    120, 240, 480 or 960 (default 480)\n"
+         "  --channels n      1 or 2 (default 2)\n"
+         "  --bitrate n       bits per second of each stream (default 64000)\n");
+}
+
+int main(int argc, char **argv)
+{
+   int i, s, f, err;
+   int streams = 200, frames = 50, frame_size = 480, channels = 2, bitrate = 64000;
+   int bytes;
+   clock_t t, seq_cpu = 0, bat_cpu = 0;
+   CELTMode *mode;
+   CELTEncoder **seq_enc, **bat_enc;
+   CELTDecoder **seq, **bat;
+   unsigned char *data;
+   unsigned char *bat_data;
+   unsigned char **bat_packets;
+   const unsigned char **packets;
+   int *lengths;
+   int *max_bytes;
+   int *nb_samples;
+   celt_int16 *pcm;
+   const celt_int16 **ins;
+   celt_int16 *out;
+   celt_int16 **outs;
+
+   for (i=1;i<argc;i++)
+   {
+      const char *arg = argv[i];
+      const char *val = i+1<argc ? argv[i+1] : NULL;
+      if (val == NULL)
+      {
+         usage();
+         return strcmp(arg, "--help")==0 ? 0 : 1;
+      }
+      i++;
+      if (strcmp(arg, "--streams")==0)
+         streams = atoi(val);
+      else if (strcmp(arg, "--frames")==0)
+         frames = atoi(val);
+      else if (strcmp(arg, "--frame-size")==0)
+         frame_size = atoi(val);
+      else if (strcmp(arg, "--channels")==0)
+         channels = atoi(val);
+      else if (strcmp(arg, "--bitrate")==0)
+         bitrate = atoi(val);
+      else {
+         usage();
+         return 1;
+      }
+   }
+   if (streams < 1 || frames < 1 || frame_size < 1 || frame_size > MAX_FRAME
+         || channels < 1 || channels > 2 || bitrate < 1)
+   {
+      usage();
+      return 1;
+   }
+
+   mode = celt_mode_create(48000, MAX_FRAME, &err);
+   if (mode == NULL)
+   {
+      fprintf(stderr, "Error: failed to create a mode: %s\n", celt_strerror(err));
+      return 1;
+   }
+   bytes = (int)((double)bitrate*frame_size/(8*48000));
+   if (bytes > MAX_PACKET)
+      bytes = MAX_PACKET;
+   seq_enc = malloc(streams*sizeof(*seq_enc));
+   bat_enc = malloc(streams*sizeof(*bat_enc));
+   seq = malloc(streams*sizeof(*seq));
+   bat = malloc(streams*sizeof(*bat));
+   data = malloc((size_t)streams*frames*MAX_PACKET);
+   bat_data = malloc((size_t)streams*MAX_PACKET);
+   bat_packets = malloc(streams*sizeof(*bat_packets));
+   packets = malloc(streams*sizeof(*packets));
+   lengths = malloc((size_t)streams*frames*sizeof(int));
+   max_bytes = malloc(streams*sizeof(int));
+   nb_samples = malloc(streams*sizeof(int));
+   pcm = malloc((size_t)streams*frame_size*channels*sizeof(celt_int16));
+   ins = malloc(streams*sizeof(*ins));
+   out = malloc((size_t)streams*frame_size*channels*sizeof(celt_int16));
+   outs = malloc(streams*sizeof(*outs));
+
+   for (s=0;s<streams;s++)
+   {
+      seq_enc[s] = celt_encoder_create_custom(mode, channels, &err);
+      bat_enc[s] = celt_encoder_create_custom(mode, channels, &err);
+      seq[s] = celt_decoder_create_custom(mode, channels, &err);
+      bat[s] = celt_decoder_create_custom(mode, channels, &err);
+      if (seq_enc[s] == NULL || bat_enc[s] == NULL || seq[s] == NULL || bat[s] == NULL)
+      {
+         fprintf(stderr, "Error: could not create stream %d: %s\n", s, celt_strerror(err));
+         return 1;
+      }
+      bat_packets[s] = bat_data + s*MAX_PACKET;
+      max_bytes[s] = bytes;
+      ins[s] = pcm + s*frame_size*channels;
+      outs[s] = out + s*frame_size*channels;
+   }
+
+   for (f=0;f<frames;f++)
+   {
+      /* Every stream gets its own signal */
+      for (s=0;s<streams;s++)
+         for (i=0;i<frame_size*channels;i++)
+            pcm[s*frame_size*channels+i] = (celt_int16)((rand()%8192) - 4096 + (s+1)*((i*(s+3))%101));
+
+      t = clock();
+      for (s=0;s<streams;s++)
+      {
+         lengths[f*streams+s] = celt_encode(seq_enc[s], ins[s], frame_size,
+               data+((size_t)f*streams+s)*MAX_PACKET, bytes);
+         if (lengths[f*streams+s] < 0)
+         {
+            fprintf(stderr, "Error: celt_encode returned %s\n", celt_strerror(lengths[f*streams+s]));
+            return 1;
+         }
+      }
+      seq_cpu += clock() - t;
+
+      t = clock();
+      err = celt_encode_batch(bat_enc, ins, streams, frame_size, bat_packets, max_bytes, nb_samples);
+      bat_cpu += clock() - t;
+      if (err != CELT_OK)
+      {
+         fprintf(stderr, "Error: celt_encode_batch returned %s\n", celt_strerror(err));
+         return 1;
+      }
+   }
+   printf("encode %d streams, %dch, %d samples, %d bytes/frame: "
+         "%.1f streams/core one by one, %.1f streams/core batched\n",
+         streams, channels, frame_size, bytes,
+         streams_per_core(seq_cpu, streams, frames, frame_size),
+         streams_per_core(bat_cpu, streams, frames, frame_size));
+
+   seq_cpu = bat_cpu = 0;
+   for (f=0;f<frames;f++)
+   {
+      for (s=0;s<streams;s++)
+         packets[s] = data+((size_t)f*streams+s)*MAX_PACKET;
+
+      t = clock();
+      for (s=0;s<streams;s++)
+      {
+         if (celt_decode(seq[s], packets[s], lengths[f*streams+s], outs[s], frame_size) < 0)
+         {
+            fprintf(stderr, "Error: celt_decode failed\n");
+            return 1;
+         }
+      }
+      seq_cpu += clock() - t;
+
+      t = clock();
+      err = celt_decode_batch(bat, packets, lengths+f*streams, streams, outs, frame_size, nb_samples);
+      bat_cpu += clock() - t;
+      if (err != CELT_OK)
+      {
+         fprintf(stderr, "Error: celt_decode_batch returned %s\n", celt_strerror(err));
+         return 1;
+      }
+   }
+   printf("decode %d streams, %dch, %d samples, %d bytes/frame: "
+         "%.1f streams/core one by one, %.1f streams/core batched\n",
+         streams, channels, frame_size, bytes,
+         streams_per_core(seq_cpu, streams, frames, frame_size),
+         streams_per_core(bat_cpu, streams, frames, frame_size));
+
+   for (s=0;s<streams;s++)
+   {
+      celt_encoder_destroy(seq_enc[s]);
+      celt_encoder_destroy(bat_enc[s]);
+      celt_decoder_destroy(seq[s]);
+      celt_decoder_destroy(bat[s]);
+   }
+   free(seq_enc);
+   free(bat_enc);
+   free(seq);
+   free(bat);
+   free(data);
+   free(bat_data);
+   free(bat_packets);
+   free(packets);
+   free(lengths);
+   free(max_bytes);
+   free(nb_samples);
+   free(pcm);
+   free(ins);
+   free(out);
+   free(outs);
+   celt_mode_destroy(mode);
+   return 0;
+}
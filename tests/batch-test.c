@@ -0,0 +1,367 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Checks that decoding a batch of streams with celt_decode_batch() and
+   celt_decode_batch_float() gives the same audio and return values as
+   decoding each stream on its own, with mono and stereo decoders in the
+   same batch, lost packets and every output rate. Then does the same for
+   celt_encode_batch() and celt_encode_batch_float() against celt_encode()
+   and celt_encode_float(), with CBR, VBR and VBR look-ahead streams.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NB_STREAMS 7
+#define NB_FRAMES 30
+#define MAX_PACKET 1275
+#define MAX_FRAME 960
+#define LOOKAHEAD 2
+
+static int ret = 0;
+
+/* Stream s is stereo when odd, and loses a packet now and then */
+static int stream_channels(int s)
+{
+   return 1 + (s&1);
+}
+
+static int lost(int s, int f)
+{
+   return (f+3*s)%11==0;
+}
+
+static void test_rate(int rate, int use_float)
+{
+   int s, f, i, err;
+   int frame_size = 960*rate/48000;
+   CELTEncoder *enc[NB_STREAMS];
+   CELTDecoder *seq[NB_STREAMS];
+   CELTDecoder *bat[NB_STREAMS];
+   celt_int16 pcm[MAX_FRAME*2];
+   celt_int16 out[NB_STREAMS][MAX_FRAME*2];
+   celt_int16 ref[MAX_FRAME*2];
+   float out_float[NB_STREAMS][MAX_FRAME*2];
+   float ref_float[MAX_FRAME*2];
+   celt_int16 *outs[NB_STREAMS];
+   float *outs_float[NB_STREAMS];
+   unsigned char data[NB_STREAMS][MAX_PACKET];
+   const unsigned char *packets[NB_STREAMS];
+   int len[NB_STREAMS];
+   int nb_samples[NB_STREAMS];
+
+   for (s=0;s<NB_STREAMS;s++)
+   {
+      enc[s] = celt_encoder_create(rate, stream_channels(s), &err);
+      seq[s] = celt_decoder_create(rate, stream_channels(s), &err);
+      bat[s] = celt_decoder_create(rate, stream_channels(s), &err);
+      if (enc[s]==NULL || seq[s]==NULL || bat[s]==NULL)
+      {
+         fprintf(stderr, "cannot create the %d Hz encoders or decoders\n", rate);
+         exit(1);
+      }
+      celt_encoder_ctl(enc[s], CELT_SET_COMPLEXITY(s%11));
+      outs[s] = out[s];
+      outs_float[s] = out_float[s];
+   }
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      for (s=0;s<NB_STREAMS;s++)
+      {
+         int C = stream_channels(s);
+         for (i=0;i<frame_size*C;i++)
+            pcm[i] = (celt_int16)(3000*sin(2*M_PI*(200+100*s)*(f*frame_size+i/C)/rate) + rand()%2000-1000);
+         len[s] = celt_encode(enc[s], pcm, frame_size, data[s], (30+10*s)*C);
+         packets[s] = lost(s, f) ? NULL : data[s];
+      }
+      if (use_float)
+         err = celt_decode_batch_float(bat, packets, len, NB_STREAMS, outs_float, frame_size, nb_samples);
+      else
+         err = celt_decode_batch(bat, packets, len, NB_STREAMS, outs, frame_size, nb_samples);
+      if (err != CELT_OK)
+      {
+         fprintf(stderr, "celt_decode_batch returned %s\n", celt_strerror(err));
+         exit(1);
+      }
+      for (s=0;s<NB_STREAMS;s++)
+      {
+         int C = stream_channels(s);
+         int mismatch;
+         if (use_float)
+         {
+            err = celt_decode_float(seq[s], packets[s], len[s], ref_float, frame_size);
+            mismatch = memcmp(ref_float, out_float[s], sizeof(float)*frame_size*C);
+         } else {
+            err = celt_decode(seq[s], packets[s], len[s], ref, frame_size);
+            mismatch = memcmp(ref, out[s], sizeof(celt_int16)*frame_size*C);
+         }
+         if (err != nb_samples[s] || mismatch)
+         {
+            fprintf(stderr, "** %d Hz%s: stream %d differs on frame %d (returned %d, not %d) **\n",
+                  rate, use_float ? " float" : "", s, f, nb_samples[s], err);
+            ret = 1;
+         }
+      }
+   }
+   for (s=0;s<NB_STREAMS;s++)
+   {
+      celt_encoder_destroy(enc[s]);
+      celt_decoder_destroy(seq[s]);
+      celt_decoder_destroy(bat[s]);
+   }
+}
+
+/* Sample n of channel c of stream s: a tone with noise that doesn't depend
+   on the order the samples are asked for */
+static float sample(int s, int n, int c, int rate)
+{
+   unsigned h = (unsigned)(n*2+c)*2654435761u + (unsigned)s*40503u;
+   h ^= h>>15;
+   return (float)(3000*sin(2*M_PI*(200+100*s+50*c)*n/rate) + (int)(h%2000) - 1000);
+}
+
+/* Frame f of stream s and the look-ahead frames after it. Filled again for
+   every call, as the encoder may write the resynthesised frame back. */
+static void fill(celt_int16 *pcm, float *pcm_float, int s, int f, int frame_size, int rate)
+{
+   int i;
+   int C = stream_channels(s);
+   for (i=0;i<(1+LOOKAHEAD)*frame_size*C;i++)
+   {
+      pcm_float[i] = sample(s, f*frame_size+i/C, i%C, rate);
+      pcm[i] = (celt_int16)pcm_float[i];
+      pcm_float[i] *= 1.f/32768;
+   }
+}
+
+static void test_encode_rate(int rate, int use_float)
+{
+   int s, f, i, err;
+   int frame_size = 960*rate/48000;
+   CELTEncoder *seq[NB_STREAMS];
+   CELTEncoder *bat[NB_STREAMS];
+   celt_int16 pcm[NB_STREAMS][(1+LOOKAHEAD)*MAX_FRAME*2];
+   float pcm_float[NB_STREAMS][(1+LOOKAHEAD)*MAX_FRAME*2];
+   const celt_int16 *ins[NB_STREAMS];
+   const float *ins_float[NB_STREAMS];
+   unsigned char data[NB_STREAMS][MAX_PACKET];
+   unsigned char ref[MAX_PACKET];
+   unsigned char *packets[NB_STREAMS];
+   int max_bytes[NB_STREAMS];
+   int nb_bytes[NB_STREAMS];
+
+   for (s=0;s<NB_STREAMS;s++)
+   {
+      seq[s] = celt_encoder_create(rate, stream_channels(s), &err);
+      bat[s] = celt_encoder_create(rate, stream_channels(s), &err);
+      if (seq[s]==NULL || bat[s]==NULL)
+      {
+         fprintf(stderr, "cannot create the %d Hz encoders\n", rate);
+         exit(1);
+      }
+      /* Streams 1 to 3 are VBR, and stream 3 looks ahead */
+      for (i=0;i<2;i++)
+      {
+         CELTEncoder *enc = i ? bat[s] : seq[s];
+         celt_encoder_ctl(enc, CELT_SET_COMPLEXITY((3*s)%11));
+         if (s>=1 && s<=3)
+            celt_encoder_ctl(enc, CELT_SET_VBR(1));
+         if (s==3)
+            celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(LOOKAHEAD));
+      }
+      ins[s] = pcm[s];
+      ins_float[s] = pcm_float[s];
+      packets[s] = data[s];
+      max_bytes[s] = (30+10*s)*stream_channels(s);
+   }
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      for (s=0;s<NB_STREAMS;s++)
+         fill(pcm[s], pcm_float[s], s, f, frame_size, rate);
+      if (use_float)
+         err = celt_encode_batch_float(bat, ins_float, NB_STREAMS, frame_size, packets, max_bytes, nb_bytes);
+      else
+         err = celt_encode_batch(bat, ins, NB_STREAMS, frame_size, packets, max_bytes, nb_bytes);
+      if (err != CELT_OK)
+      {
+         fprintf(stderr, "celt_encode_batch returned %s\n", celt_strerror(err));
+         exit(1);
+      }
+      for (s=0;s<NB_STREAMS;s++)
+      {
+         fill(pcm[s], pcm_float[s], s, f, frame_size, rate);
+         if (use_float)
+            err = celt_encode_float(seq[s], pcm_float[s], frame_size, ref, max_bytes[s]);
+         else
+            err = celt_encode(seq[s], pcm[s], frame_size, ref, max_bytes[s]);
+         if (err != nb_bytes[s] || (err>0 && memcmp(ref, data[s], err)))
+         {
+            fprintf(stderr, "** %d Hz%s: packet %d of stream %d differs (returned %d, not %d) **\n",
+                  rate, use_float ? " float" : "", f, s, nb_bytes[s], err);
+            ret = 1;
+         }
+      }
+   }
+   for (s=0;s<NB_STREAMS;s++)
+   {
+      celt_encoder_destroy(seq[s]);
+      celt_encoder_destroy(bat[s]);
+   }
+}
+
+static void test_bad_args(void)
+{
+   int err;
+   int len[2] = {0, 0};
+   int nb_samples[2];
+   celt_int16 out[2][960];
+   celt_int16 *outs[2];
+   const unsigned char *packets[2] = {NULL, NULL};
+   CELTDecoder *dec[2];
+
+   outs[0] = out[0];
+   outs[1] = out[1];
+   dec[0] = celt_decoder_create(48000, 1, &err);
+#ifdef CUSTOM_MODES
+   {
+      /* A batch must refuse decoders that don't share a mode */
+      CELTMode *other = celt_mode_create(44100, 960, &err);
+      dec[1] = celt_decoder_create_custom(other, 1, &err);
+      if (celt_decode_batch(dec, packets, len, 2, outs, 960, nb_samples) != CELT_BAD_ARG)
+      {
+         fprintf(stderr, "** batch accepted decoders with different modes **\n");
+         ret = 1;
+      }
+      celt_decoder_destroy(dec[1]);
+      celt_mode_destroy(other);
+   }
+#endif
+   if (celt_decode_batch(dec, NULL, len, 1, outs, 960, nb_samples) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** batch accepted a NULL packet array **\n");
+      ret = 1;
+   }
+   outs[0] = NULL;
+   if (celt_decode_batch(dec, packets, len, 1, outs, 960, nb_samples) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** batch accepted a NULL output buffer **\n");
+      ret = 1;
+   }
+   outs[0] = out[0];
+   /* A bad frame size only fails its own stream */
+   if (celt_decode_batch(dec, packets, len, 1, outs, 961, nb_samples) != CELT_OK
+         || nb_samples[0] != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** batch didn't report an invalid frame size **\n");
+      ret = 1;
+   }
+   celt_decoder_destroy(dec[0]);
+}
+
+static void test_encode_bad_args(void)
+{
+   int err;
+   int max_bytes[2] = {100, 100};
+   int nb_bytes[2];
+   celt_int16 pcm[2][960];
+   const celt_int16 *ins[2];
+   unsigned char data[2][MAX_PACKET];
+   unsigned char *packets[2];
+   CELTEncoder *enc[2];
+
+   memset(pcm, 0, sizeof(pcm));
+   ins[0] = pcm[0];
+   ins[1] = pcm[1];
+   packets[0] = data[0];
+   packets[1] = data[1];
+   enc[0] = celt_encoder_create(48000, 1, &err);
+#ifdef CUSTOM_MODES
+   {
+      /* A batch must refuse encoders that don't share a mode */
+      CELTMode *other = celt_mode_create(44100, 960, &err);
+      enc[1] = celt_encoder_create_custom(other, 1, &err);
+      if (celt_encode_batch(enc, ins, 2, 960, packets, max_bytes, nb_bytes) != CELT_BAD_ARG)
+      {
+         fprintf(stderr, "** batch accepted encoders with different modes **\n");
+         ret = 1;
+      }
+      celt_encoder_destroy(enc[1]);
+      celt_mode_destroy(other);
+   }
+#endif
+   if (celt_encode_batch(enc, NULL, 1, 960, packets, max_bytes, nb_bytes) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** batch accepted a NULL input array **\n");
+      ret = 1;
+   }
+   packets[0] = NULL;
+   if (celt_encode_batch(enc, ins, 1, 960, packets, max_bytes, nb_bytes) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** batch accepted a NULL packet buffer **\n");
+      ret = 1;
+   }
+   packets[0] = data[0];
+   /* A bad frame size only fails its own stream */
+   if (celt_encode_batch(enc, ins, 1, 961, packets, max_bytes, nb_bytes) != CELT_OK
+         || nb_bytes[0] != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** batch didn't report an invalid frame size **\n");
+      ret = 1;
+   }
+   celt_encoder_destroy(enc[0]);
+}
+
+int main(void)
+{
+   int i;
+   static const int rates[4] = {48000, 24000, 16000, 8000};
+   srand(42);
+   for (i=0;i<4;i++)
+   {
+      test_rate(rates[i], 0);
+#ifndef DISABLE_FLOAT_API
+      test_rate(rates[i], 1);
+#endif
+   }
+   test_bad_args();
+   for (i=0;i<4;i++)
+   {
+      test_encode_rate(rates[i], 0);
+#ifndef DISABLE_FLOAT_API
+      test_encode_rate(rates[i], 1);
+#endif
+   }
+   test_encode_bad_args();
+   return ret;
+}
@@ -0,0 +1,222 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Codes the same audio with celt_encode() and celt_encode_buffer() and
+   decodes it with celt_decode() and with celt_decode_chain() from the
+   packets cut into random pieces, some of them empty. The packets and the
+   decoded audio must be identical, and the room around the packet left
+   untouched. Also checks the buffers that must be refused.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NB_FRAMES 100
+#define MAX_PACKET 1275
+#define HEADROOM 12
+#define TAILROOM 10
+#define MAX_SEGMENTS 16
+#define GUARD 0xA5
+
+static int ret = 0;
+
+/* Cuts a packet into random pieces, with empty ones here and there */
+static int split(unsigned char *packet, int len, const unsigned char **seg, int *seg_len)
+{
+   int n=0, pos=0;
+   while (pos<len && n<MAX_SEGMENTS-1)
+   {
+      int l = rand()%4==0 ? 0 : 1+rand()%(rand()%2 ? 3 : len);
+      if (l>len-pos)
+         l = len-pos;
+      seg[n] = l>0 ? packet+pos : NULL;
+      seg_len[n++] = l;
+      pos += l;
+   }
+   if (pos<len)
+   {
+      seg[n] = packet+pos;
+      seg_len[n++] = len-pos;
+   }
+   return n;
+}
+
+static void test_stream(int channels, int vbr, int signalling, int bytes)
+{
+   int f, i, err;
+   int frame_size = 960;
+   CELTEncoder *enc, *enc2;
+   CELTDecoder *dec, *dec2;
+   celt_int16 pcm[2*960], out[2*960], out2[2*960];
+   unsigned char packet[MAX_PACKET];
+   unsigned char buffer[HEADROOM+MAX_PACKET+TAILROOM];
+   CELTBuffer buf;
+   double y[2] = {0, 0};
+
+   enc = celt_encoder_create(48000, channels, &err);
+   enc2 = celt_encoder_create(48000, channels, &err);
+   dec = celt_decoder_create(48000, channels, &err);
+   dec2 = celt_decoder_create(48000, channels, &err);
+   if (enc==NULL || enc2==NULL || dec==NULL || dec2==NULL)
+   {
+      fprintf(stderr, "cannot create the encoders or decoders\n");
+      exit(1);
+   }
+   celt_encoder_ctl(enc, CELT_SET_VBR(vbr));
+   celt_encoder_ctl(enc2, CELT_SET_VBR(vbr));
+   celt_encoder_ctl(enc, CELT_SET_SIGNALLING(signalling));
+   celt_encoder_ctl(enc2, CELT_SET_SIGNALLING(signalling));
+   celt_decoder_ctl(dec, CELT_SET_SIGNALLING(signalling));
+   celt_decoder_ctl(dec2, CELT_SET_SIGNALLING(signalling));
+
+   buf.data = buffer;
+   buf.size = sizeof(buffer);
+   buf.headroom = HEADROOM;
+   buf.tailroom = TAILROOM;
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      const unsigned char *seg[MAX_SEGMENTS];
+      int seg_len[MAX_SEGMENTS];
+      int len, len2, n;
+
+      /* Low-passed noise and a tone in each channel */
+      for (i=0;i<frame_size*channels;i++)
+      {
+         int c = i%channels;
+         y[c] = .9*y[c] + (rand()%2000 - 1000);
+         pcm[i] = (celt_int16)(2*y[c] + 3000*sin(2*M_PI*(220+110*c)*(f*frame_size+i/channels)/48000));
+      }
+
+      len = celt_encode(enc, pcm, frame_size, packet, bytes);
+      memset(buffer, GUARD, sizeof(buffer));
+      len2 = celt_encode_buffer(enc2, pcm, frame_size, &buf, bytes);
+      if (len2 != len || buf.payload_len != len || buf.payload != buffer+HEADROOM
+            || memcmp(packet, buf.payload, len) != 0)
+      {
+         fprintf(stderr, "** celt_encode_buffer() gave a different packet (frame %d, %d vs %d bytes) **\n", f, len2, len);
+         ret = 1;
+         break;
+      }
+      /* Only the nbCompressedBytes after the headroom may be written */
+      for (i=0;i<(int)sizeof(buffer);i++)
+         if ((i<HEADROOM || i>=HEADROOM+bytes) && buffer[i] != GUARD)
+            break;
+      if (i != (int)sizeof(buffer))
+      {
+         fprintf(stderr, "** celt_encode_buffer() wrote outside the packet (frame %d) **\n", f);
+         ret = 1;
+         break;
+      }
+
+      /* Every tenth packet is lost, which a chain with no data signals */
+      n = f%10==9 ? 0 : split(buf.payload, len, seg, seg_len);
+      err = celt_decode(dec, n>0 ? packet : NULL, len, out, frame_size);
+      if (celt_decode_chain(dec2, seg, seg_len, n, out2, frame_size) != err
+            || memcmp(out, out2, sizeof(celt_int16)*frame_size*channels) != 0)
+      {
+         fprintf(stderr, "** celt_decode_chain() gave different audio (frame %d, %d pieces) **\n", f, n);
+         ret = 1;
+         break;
+      }
+   }
+
+   celt_encoder_destroy(enc);
+   celt_encoder_destroy(enc2);
+   celt_decoder_destroy(dec);
+   celt_decoder_destroy(dec2);
+}
+
+static void test_bad_args(void)
+{
+   int err;
+   celt_int16 pcm[960];
+   unsigned char buffer[100];
+   const unsigned char *seg[2];
+   int seg_len[2];
+   CELTBuffer buf;
+   CELTEncoder *enc = celt_encoder_create(48000, 1, &err);
+   CELTDecoder *dec = celt_decoder_create(48000, 1, &err);
+   if (enc==NULL || dec==NULL)
+   {
+      fprintf(stderr, "cannot create the encoder or decoder\n");
+      exit(1);
+   }
+   memset(pcm, 0, sizeof(pcm));
+
+   buf.data = buffer;
+   buf.size = sizeof(buffer);
+   buf.headroom = 20;
+   buf.tailroom = 20;
+   if (celt_encode_buffer(enc, pcm, 960, &buf, 61) != CELT_BAD_ARG
+         || celt_encode_buffer(enc, pcm, 960, NULL, 60) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** celt_encode_buffer() accepted a packet that can't fit **\n");
+      ret = 1;
+   }
+   buf.tailroom = -1;
+   if (celt_encode_buffer(enc, pcm, 960, &buf, 60) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** celt_encode_buffer() accepted a negative tailroom **\n");
+      ret = 1;
+   }
+
+   seg[0] = buffer;
+   seg[1] = NULL;
+   seg_len[0] = 10;
+   seg_len[1] = -1;
+   if (celt_decode_chain(dec, seg, seg_len, 2, pcm, 960) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** celt_decode_chain() accepted a negative size **\n");
+      ret = 1;
+   }
+   seg_len[1] = 5;
+   if (celt_decode_chain(dec, seg, seg_len, 2, pcm, 960) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** celt_decode_chain() accepted a NULL piece **\n");
+      ret = 1;
+   }
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec);
+}
+
+int main(void)
+{
+   srand(42);
+   test_stream(1, 0, 1, 100);
+   test_stream(2, 0, 1, 160);
+   test_stream(1, 1, 1, 200);
+   test_stream(2, 1, 1, 300);
+   test_stream(1, 0, 0, 60);
+   test_stream(2, 1, 0, 1275);
+   test_bad_args();
+   return ret;
+}
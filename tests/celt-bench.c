@@ -0,0 +1,496 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Encoder and decoder throughput benchmark.
+
+   Runs a set of reference signals (or a raw input file) through every
+   combination of sampling rate, frame size, channel count, CBR/VBR and
+   complexity, and reports for each one the frames per second, the
+   percentiles of the time per frame, and the peak stack use of the
+   encoder and decoder. With --csv, the same numbers are written in a
+   form that can be compared between releases. Run with --help for the
+   options that restrict the sweep.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.141592653
+#endif
+
+#define MAX_FRAME 960
+#define MAX_PACKET 1275
+/* Deepest stack use that can be measured */
+#define STACK_PROBE (256*1024)
+#define STACK_PATTERN 0xA5
+
+enum { SPEECH, MUSIC, NOISE, SILENCE, TRANSIENTS, FILE_INPUT, NB_SIGNALS };
+
+static const char *signal_names[NB_SIGNALS] = {
+   "speech", "music", "noise", "silence", "transients", "file"
+};
+
+/* The rates below 48 kHz other than 44.1 kHz go through the resampling
+   of the standard mode rather than through a custom mode */
+static const int rates[] = {48000, 44100, 24000, 16000, 12000, 8000};
+/* At 48 kHz, scaled down at the lower rates of the standard mode */
+static const int frame_sizes[] = {120, 240, 480, 960};
+
+typedef struct {
+   double frames_per_s;
+   double p50, p90, p99, max;   /* Microseconds per frame */
+   int stack;                   /* Bytes, -1 if unknown */
+} Stats;
+
+static double now_us(void)
+{
+#if defined(WIN32) || defined(_WIN32)
+   LARGE_INTEGER t, f;
+   QueryPerformanceCounter(&t);
+   QueryPerformanceFrequency(&f);
+   return t.QuadPart*1e6/f.QuadPart;
+#else
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec*1e6 + t.tv_nsec*1e-3;
+#endif
+}
+
+/* Stack use is measured by filling the stack below the caller with a
+   pattern and, after the call, looking for the deepest byte that was
+   overwritten */
+static size_t stack_bottom;
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void paint_stack(void)
+{
+   volatile unsigned char buf[STACK_PROBE];
+   int i;
+   for (i=0;i<STACK_PROBE;i++)
+      buf[i] = STACK_PATTERN;
+   stack_bottom = (size_t)buf;
+}
+
+static int stack_used(void)
+{
+   int i;
+   volatile unsigned char *buf = (volatile unsigned char*)stack_bottom;
+   for (i=0;i<STACK_PROBE;i++)
+      if (buf[i] != STACK_PATTERN)
+         break;
+   return STACK_PROBE-i;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+   double x = *(const double*)a, y = *(const double*)b;
+   return x<y ? -1 : x>y;
+}
+
+static void compute_stats(Stats *s, double *t, int n)
+{
+   int i;
+   double total = 0;
+   for (i=0;i<n;i++)
+      total += t[i];
+   qsort(t, n, sizeof(double), compare_double);
+   s->frames_per_s = total>0 ? 1e6*n/total : 0;
+   s->p50 = t[n/2];
+   s->p90 = t[(int)(.9*(n-1))];
+   s->p99 = t[(int)(.99*(n-1))];
+   s->max = t[n-1];
+}
+
+static double frand(void)
+{
+   return (rand()%20001-10000)/10000.;
+}
+
+/* Fills len stereo samples with one of the reference signals */
+static void generate_signal(int type, celt_int16 *pcm, int len, int rate)
+{
+   int i, c;
+   double phase = 0, f0 = 120, env = 0;
+   double y1[2] = {0, 0}, y2[2] = {0, 0};
+   srand(type+1);
+   for (i=0;i<len;i++)
+   {
+      double t = i/(double)rate;
+      double x[2] = {0, 0};
+      switch (type)
+      {
+      case SPEECH:
+         /* Pulse train with a moving pitch through a resonance, with a
+            syllable-rate envelope and pauses */
+         f0 = 100+40*sin(2*M_PI*.7*t)+20*sin(2*M_PI*3.1*t);
+         phase += f0/rate;
+         x[0] = phase >= 1 ? 1 : 0;
+         if (phase >= 1)
+            phase -= 1;
+         x[0] += .02*frand();
+         env = fmod(t, 1.5) < 1.1 ? .5+.5*sin(2*M_PI*4*t) : 0;
+         for (c=0;c<2;c++)
+         {
+            double r = .995, w = 2*M_PI*(700+300*sin(2*M_PI*.5*t+c))/rate;
+            double y = x[0] + 2*r*cos(w)*y1[c] - r*r*y2[c];
+            y2[c] = y1[c];
+            y1[c] = y;
+            x[c] = .01*env*y;
+         }
+         break;
+      case MUSIC:
+         {
+            /* A chord progression with a few harmonics per note, slightly
+               different between the channels */
+            static const double roots[4] = {220, 174.6, 261.6, 196};
+            static const double ratios[3] = {1, 1.26, 1.5};
+            double root = roots[(int)(t*2)%4];
+            int n, h;
+            for (n=0;n<3;n++)
+               for (h=1;h<=5;h++)
+               {
+                  double f = root*ratios[n]*h;
+                  if (f < rate/2)
+                  {
+                     x[0] += .06/h*sin(2*M_PI*f*t);
+                     x[1] += .06/h*sin(2*M_PI*f*t+.3*n);
+                  }
+               }
+            env = exp(-3*fmod(t, .5));
+            x[0] *= .3+.7*env;
+            x[1] *= .3+.7*env;
+         }
+         break;
+      case NOISE:
+         x[0] = .25*frand();
+         x[1] = .25*frand();
+         break;
+      case TRANSIENTS:
+         /* Decaying noise bursts every 150 ms over a quiet background */
+         env = exp(-fmod(t, .15)*200);
+         x[0] = .8*env*frand() + .003*frand();
+         x[1] = .8*env*frand() + .003*frand();
+         break;
+      default:
+         break;
+      }
+      for (c=0;c<2;c++)
+      {
+         double v = 32767*x[c];
+         pcm[2*i+c] = (celt_int16)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+      }
+   }
+}
+
+/* Encodes and decodes the signal once for timing, and once more for the
+   stack use, with the custom mode, or with the standard mode at the given
+   rate if there is none. Returns the average packet size, or -1 on error. */
+static double run_config(const CELTMode *mode, const celt_int16 *signal, int len,
+      int frame_size, int channels, int vbr, int complexity, int rate,
+      Stats *enc_stats, Stats *dec_stats)
+{
+   int f, i, pass, nb_frames = len/frame_size;
+   int bytes = 64000*channels*frame_size/(8*rate);
+   long total_bytes = 0;
+   double *enc_t, *dec_t;
+   celt_int16 pcm[MAX_FRAME*2], out[MAX_FRAME*2];
+   unsigned char data[MAX_PACKET];
+
+   if (nb_frames < 1)
+      return -1;
+   enc_t = malloc(nb_frames*sizeof(double));
+   dec_t = malloc(nb_frames*sizeof(double));
+   enc_stats->stack = dec_stats->stack = 0;
+   for (pass=0;pass<2;pass++)
+   {
+      int err;
+      CELTEncoder *enc;
+      CELTDecoder *dec;
+      if (mode)
+      {
+         enc = celt_encoder_create_custom(mode, channels, &err);
+         dec = celt_decoder_create_custom(mode, channels, &err);
+      } else {
+         enc = celt_encoder_create(rate, channels, &err);
+         dec = celt_decoder_create(rate, channels, &err);
+      }
+      if (enc == NULL || dec == NULL)
+         return -1;
+      celt_encoder_ctl(enc, CELT_SET_COMPLEXITY(complexity));
+      if (vbr)
+      {
+         celt_encoder_ctl(enc, CELT_SET_VBR(1));
+         celt_encoder_ctl(enc, CELT_SET_BITRATE(64000*channels));
+         bytes = MAX_PACKET;
+      }
+      for (f=0;f<nb_frames;f++)
+      {
+         int nb;
+         double t0, t1, t2;
+         for (i=0;i<frame_size;i++)
+         {
+            pcm[channels*i] = signal[2*(f*frame_size+i)];
+            if (channels == 2)
+               pcm[2*i+1] = signal[2*(f*frame_size+i)+1];
+         }
+         if (pass == 0)
+         {
+            t0 = now_us();
+            nb = celt_encode(enc, pcm, frame_size, data, bytes);
+            t1 = now_us();
+            if (nb < 0 || celt_decode(dec, data, nb, out, frame_size) < 0)
+               return -1;
+            t2 = now_us();
+            enc_t[f] = t1-t0;
+            dec_t[f] = t2-t1;
+            total_bytes += nb;
+         } else {
+            int used;
+            paint_stack();
+            nb = celt_encode(enc, pcm, frame_size, data, bytes);
+            used = stack_used();
+            if (used > enc_stats->stack)
+               enc_stats->stack = used;
+            paint_stack();
+            celt_decode(dec, data, nb, out, frame_size);
+            used = stack_used();
+            if (used > dec_stats->stack)
+               dec_stats->stack = used;
+         }
+      }
+      celt_encoder_destroy(enc);
+      celt_decoder_destroy(dec);
+   }
+   compute_stats(enc_stats, enc_t, nb_frames);
+   compute_stats(dec_stats, dec_t, nb_frames);
+   free(enc_t);
+   free(dec_t);
+   return total_bytes/(double)nb_frames;
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage: celt-bench [options]\n"
+         "  --seconds x       length of each reference signal (default 2)\n"
+         "  --input file      also run a raw 16-bit stereo file (native endian)\n"
+         "  --signal name     only this signal (speech, music, noise, silence,\n"
+         "                    transients or file)\n"
+         "  --rate n          only this sampling rate (48000, 44100, 24000,\n"
+         "                    16000, 12000 or 8000)\n"
+         "  --frame-size n    only this frame size (120, 240, 480 or 960, in\n"
+         "                    48 kHz samples below 44.1 kHz)\n"
+         "  --channels n      only mono (1) or stereo (2)\n"
+         "  --cbr, --vbr      only CBR or only VBR\n"
+         "  --complexity n    only this complexity (0-10)\n"
+         "  --quick           only complexities 0, 5 and 10\n"
+         "  --csv file        write the results as CSV\n");
+}
+
+int main(int argc, char **argv)
+{
+   int i, r, s;
+   double seconds = 2;
+   const char *input = NULL, *csv_name = NULL;
+   int only_signal = -1, only_rate = 0, only_frame = 0, only_channels = 0;
+   int only_vbr = -1, only_complexity = -1, quick = 0;
+   FILE *csv = NULL;
+   celt_int16 *signal;
+
+   for (i=1;i<argc;i++)
+   {
+      const char *arg = argv[i];
+      const char *val = i+1<argc ? argv[i+1] : NULL;
+      if (strcmp(arg, "--cbr")==0)
+         only_vbr = 0;
+      else if (strcmp(arg, "--vbr")==0)
+         only_vbr = 1;
+      else if (strcmp(arg, "--quick")==0)
+         quick = 1;
+      else if (val == NULL)
+      {
+         usage();
+         return strcmp(arg, "--help")==0 ? 0 : 1;
+      } else {
+         i++;
+         if (strcmp(arg, "--seconds")==0)
+            seconds = atof(val);
+         else if (strcmp(arg, "--input")==0)
+            input = val;
+         else if (strcmp(arg, "--rate")==0)
+            only_rate = atoi(val);
+         else if (strcmp(arg, "--frame-size")==0)
+            only_frame = atoi(val);
+         else if (strcmp(arg, "--channels")==0)
+            only_channels = atoi(val);
+         else if (strcmp(arg, "--complexity")==0)
+            only_complexity = atoi(val);
+         else if (strcmp(arg, "--csv")==0)
+            csv_name = val;
+         else if (strcmp(arg, "--signal")==0)
+         {
+            for (only_signal=0;only_signal<NB_SIGNALS;only_signal++)
+               if (strcmp(val, signal_names[only_signal])==0)
+                  break;
+            if (only_signal == NB_SIGNALS)
+            {
+               usage();
+               return 1;
+            }
+         } else {
+            usage();
+            return 1;
+         }
+      }
+   }
+
+   if (csv_name)
+   {
+      csv = fopen(csv_name, "w");
+      if (!csv)
+      {
+         perror(csv_name);
+         return 1;
+      }
+      fprintf(csv, "signal,rate,frame_size,channels,vbr,complexity,bytes_per_frame,"
+            "enc_frames_per_s,enc_us_p50,enc_us_p90,enc_us_p99,enc_us_max,enc_stack_bytes,"
+            "dec_frames_per_s,dec_us_p50,dec_us_p90,dec_us_p99,dec_us_max,dec_stack_bytes\n");
+   }
+   printf("%-10s %5s %4s %2s %3s %4s %6s | %8s %7s %7s %7s %7s | %8s %7s %7s %7s %7s\n",
+         "signal", "rate", "size", "ch", "vbr", "comp", "bytes",
+         "enc fr/s", "p50 us", "p99 us", "max us", "stack",
+         "dec fr/s", "p50 us", "p99 us", "max us", "stack");
+
+   for (r=0;r<(int)(sizeof(rates)/sizeof(rates[0]));r++)
+   {
+      int rate = rates[r];
+      int len = 0, err, resample = 1;
+      CELTMode *mode = NULL;
+      if (only_rate && only_rate != rate)
+         continue;
+      if (rate < 44100)
+      {
+         resample = 48000/rate;
+      } else {
+         /* Every frame size is a sub-multiple of the 960-sample mode */
+         mode = celt_mode_create(rate, MAX_FRAME, &err);
+         if (mode == NULL)
+         {
+            fprintf(stderr, "Skipping %d Hz: %s\n", rate, celt_strerror(err));
+            continue;
+         }
+      }
+      for (s=0;s<NB_SIGNALS;s++)
+      {
+         int fs, ch, vbr, comp;
+         if (only_signal >= 0 && only_signal != s)
+            continue;
+         if (s == FILE_INPUT)
+         {
+            FILE *fin;
+            if (!input)
+               continue;
+            fin = fopen(input, "rb");
+            if (!fin)
+            {
+               perror(input);
+               return 1;
+            }
+            fseek(fin, 0, SEEK_END);
+            len = ftell(fin)/(2*sizeof(celt_int16));
+            fseek(fin, 0, SEEK_SET);
+            signal = malloc(2*len*sizeof(celt_int16));
+            len = fread(signal, 2*sizeof(celt_int16), len, fin);
+            fclose(fin);
+         } else {
+            len = (int)(seconds*rate);
+            signal = malloc(2*len*sizeof(celt_int16));
+            generate_signal(s, signal, len, rate);
+         }
+         for (fs=0;fs<(int)(sizeof(frame_sizes)/sizeof(frame_sizes[0]));fs++)
+         {
+            int frame_size = frame_sizes[fs]/resample;
+            if (only_frame && only_frame != frame_sizes[fs])
+               continue;
+            for (ch=1;ch<=2;ch++)
+            {
+               if (only_channels && only_channels != ch)
+                  continue;
+               for (vbr=0;vbr<=1;vbr++)
+               {
+                  if (only_vbr >= 0 && only_vbr != vbr)
+                     continue;
+                  for (comp=0;comp<=10;comp++)
+                  {
+                     Stats enc, dec;
+                     double bytes;
+                     if (only_complexity >= 0 && only_complexity != comp)
+                        continue;
+                     if (quick && comp%5 != 0)
+                        continue;
+                     bytes = run_config(mode, signal, len, frame_size, ch, vbr, comp, rate, &enc, &dec);
+                     if (bytes < 0)
+                     {
+                        fprintf(stderr, "Error in %s, %d Hz, %d samples, %d channel(s), %s, complexity %d\n",
+                              signal_names[s], rate, frame_size, ch, vbr ? "VBR" : "CBR", comp);
+                        return 1;
+                     }
+                     printf("%-10s %5d %4d %2d %3s %4d %6.1f | %8.0f %7.1f %7.1f %7.1f %7d | %8.0f %7.1f %7.1f %7.1f %7d\n",
+                           signal_names[s], rate, frame_size, ch, vbr ? "yes" : "no", comp, bytes,
+                           enc.frames_per_s, enc.p50, enc.p99, enc.max, enc.stack,
+                           dec.frames_per_s, dec.p50, dec.p99, dec.max, dec.stack);
+                     if (csv)
+                        fprintf(csv, "%s,%d,%d,%d,%d,%d,%.2f,%.1f,%.2f,%.2f,%.2f,%.2f,%d,%.1f,%.2f,%.2f,%.2f,%.2f,%d\n",
+                              signal_names[s], rate, frame_size, ch, vbr, comp, bytes,
+                              enc.frames_per_s, enc.p50, enc.p90, enc.p99, enc.max, enc.stack,
+                              dec.frames_per_s, dec.p50, dec.p90, dec.p99, dec.max, dec.stack);
+                  }
+               }
+            }
+         }
+         free(signal);
+      }
+      if (mode)
+         celt_mode_destroy(mode);
+   }
+   if (csv)
+      fclose(csv);
+   return 0;
+}
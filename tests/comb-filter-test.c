@@ -0,0 +1,236 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Checks comb_filter(), which can be replaced by an optimised version
+   (e.g. with --enable-sse), against a copy of the original C code. Every
+   pair of tapsets is tried, with the same and with different periods on
+   each side of the cross-fade, in place (as the post-filter runs) and
+   out of place (as the pre-filter runs). The output must be bit-exact.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CELT_C
+#include "../libcelt/stack_alloc.h"
+#include "../libcelt/entenc.c"
+#include "../libcelt/entdec.c"
+#include "../libcelt/entcode.c"
+#include "../libcelt/cwrs.c"
+#include "../libcelt/mathops.c"
+#include "../libcelt/kiss_fft.c"
+#include "../libcelt/mdct.c"
+#include "../libcelt/rate.c"
+#include "../libcelt/vq.c"
+#include "../libcelt/laplace.c"
+#include "../libcelt/quant_bands.c"
+#include "../libcelt/bands.c"
+#include "../libcelt/pitch.c"
+#include "../libcelt/plc.c"
+#include "../libcelt/modes.c"
+#include "../libcelt/celt.c"
+
+#ifdef FIXED_DEBUG
+long long celt_mips=0;
+#endif
+
+#ifdef ENABLE_POSTFILTER
+
+#define MAX_N 960
+#define HISTORY (COMBFILTER_MAXPERIOD+2)
+#define NB_RUNS 200
+
+int ret = 0;
+
+/* comb_filter() as it was before it could be overridden */
+static void ref_comb_filter(celt_word32 *y, celt_word32 *x, int T0, int T1, int N,
+      celt_word16 g0, celt_word16 g1, int tapset0, int tapset1,
+      const celt_word16 *window, int overlap)
+{
+   int i;
+   celt_word16 g00, g01, g02, g10, g11, g12;
+   static const celt_word16 gains[3][3] = {
+         {QCONST16(0.3066406250f, 15), QCONST16(0.2170410156f, 15), QCONST16(0.1296386719f, 15)},
+         {QCONST16(0.4638671875f, 15), QCONST16(0.2680664062f, 15), QCONST16(0.f, 15)},
+         {QCONST16(0.7998046875f, 15), QCONST16(0.1000976562f, 15), QCONST16(0.f, 15)}};
+   g00 = MULT16_16_Q15(g0, gains[tapset0][0]);
+   g01 = MULT16_16_Q15(g0, gains[tapset0][1]);
+   g02 = MULT16_16_Q15(g0, gains[tapset0][2]);
+   g10 = MULT16_16_Q15(g1, gains[tapset1][0]);
+   g11 = MULT16_16_Q15(g1, gains[tapset1][1]);
+   g12 = MULT16_16_Q15(g1, gains[tapset1][2]);
+   for (i=0;i<overlap;i++)
+   {
+      celt_word16 f;
+      f = MULT16_16_Q15(window[i],window[i]);
+      y[i] = x[i]
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g00),x[i-T0])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g01),x[i-T0-1])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g01),x[i-T0+1])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g02),x[i-T0-2])
+               + MULT16_32_Q15(MULT16_16_Q15((Q15ONE-f),g02),x[i-T0+2])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g10),x[i-T1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g11),x[i-T1-1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g11),x[i-T1+1])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g12),x[i-T1-2])
+               + MULT16_32_Q15(MULT16_16_Q15(f,g12),x[i-T1+2]);
+
+   }
+   for (i=overlap;i<N;i++)
+      y[i] = x[i]
+               + MULT16_32_Q15(g10,x[i-T1])
+               + MULT16_32_Q15(g11,x[i-T1-1])
+               + MULT16_32_Q15(g11,x[i-T1+1])
+               + MULT16_32_Q15(g12,x[i-T1-2])
+               + MULT16_32_Q15(g12,x[i-T1+2]);
+}
+
+static celt_sig random_sig(void)
+{
+#ifdef FIXED_POINT
+   /* Full-scale signals, with the odd value far outside */
+   celt_sig x = (celt_sig)((rand()%65536 - 32768)<<SIG_SHIFT);
+   if (rand()%64==0)
+      x *= 8;
+   return x;
+#else
+   return (celt_sig)(rand()%65536 - 32768);
+#endif
+}
+
+static int random_period(void)
+{
+   return COMBFILTER_MINPERIOD + rand()%(COMBFILTER_MAXPERIOD-2-COMBFILTER_MINPERIOD);
+}
+
+static celt_word16 random_gain(void)
+{
+   /* Up to the largest gain that can be coded, either sign since the
+      pre-filter uses negative gains */
+   celt_word16 g = (celt_word16)(QCONST16(.75f,15)*(rand()%1024)/1024);
+   return rand()&1 ? -g : g;
+}
+
+/* Filters the same random signal with both versions, in place or not,
+   and compares everything they wrote */
+static void test_case(int T0, int T1, int N, int tapset0, int tapset1,
+      const celt_word16 *window, int overlap, int in_place, clock_t *t_ref, clock_t *t_new)
+{
+   static celt_sig x[HISTORY+MAX_N+2], x2[HISTORY+MAX_N+2];
+   static celt_sig y[MAX_N], y2[MAX_N];
+   int i, r;
+   celt_word16 g0 = random_gain(), g1 = random_gain();
+   clock_t t0;
+
+   for (i=0;i<HISTORY+N+2;i++)
+      x[i] = x2[i] = random_sig();
+   for (i=0;i<N;i++)
+      y[i] = y2[i] = random_sig();
+   if (in_place)
+   {
+      ref_comb_filter(x+HISTORY, x+HISTORY, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
+      comb_filter(x2+HISTORY, x2+HISTORY, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
+   } else {
+      ref_comb_filter(y, x+HISTORY, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
+      comb_filter(y2, x2+HISTORY, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
+   }
+   if (memcmp(x, x2, sizeof(x)) != 0 || memcmp(y, y2, sizeof(y)) != 0)
+   {
+      fprintf(stderr, "** comb_filter() mismatch: T0=%d T1=%d N=%d tapsets %d/%d overlap %d%s **\n",
+            T0, T1, N, tapset0, tapset1, overlap, in_place ? " in place" : "");
+      ret = 1;
+      return;
+   }
+
+   /* Time the out-of-place version, which doesn't change its input */
+   t0 = clock();
+   for (r=0;r<NB_RUNS;r++)
+      ref_comb_filter(y, x+HISTORY, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
+   *t_ref += clock()-t0;
+   t0 = clock();
+   for (r=0;r<NB_RUNS;r++)
+      comb_filter(y2, x2+HISTORY, T0, T1, N, g0, g1, tapset0, tapset1, window, overlap);
+   *t_new += clock()-t0;
+}
+
+int main(void)
+{
+   const CELTMode *m = static_mode_list[0];
+   static const int sizes[] = {120, 240, 480, 960, 121, 7};
+   int s, t0, t1, k, in_place;
+   int cases = 0;
+   clock_t t_ref=0, t_new=0;
+
+   srand(42);
+   for (s=0;s<(int)(sizeof(sizes)/sizeof(sizes[0]));s++)
+   {
+      int N = sizes[s];
+      for (t0=0;t0<3;t0++)
+      {
+         for (t1=0;t1<3;t1++)
+         {
+            for (in_place=0;in_place<2;in_place++)
+            {
+               for (k=0;k<8;k++)
+               {
+                  int T0 = random_period();
+                  int T1 = k&1 ? T0 : random_period();
+                  int overlap = N >= m->overlap ? m->overlap : 0;
+                  /* Also the shortest periods, which the post-filter
+                     clamps to but which can only partly be vectorised */
+                  if (k==2)
+                     T0 = T1 = COMBFILTER_MINPERIOD;
+                  else if (k==4)
+                     T1 = COMBFILTER_MINPERIOD;
+                  /* With the cross-fade, and without like the pre-filter
+                     on the part before the overlap */
+                  test_case(T0, T1, N, t0, t1, m->window, overlap, in_place, &t_ref, &t_new);
+                  test_case(T1, T1, N, t1, t1, NULL, 0, in_place, &t_ref, &t_new);
+                  cases += 2;
+               }
+            }
+         }
+      }
+   }
+   printf("%d cases, %.2f ms reference, %.2f ms comb_filter()\n",
+         cases, 1e3*t_ref/CLOCKS_PER_SEC, 1e3*t_new/CLOCKS_PER_SEC);
+   return ret;
+}
+
+#else /* ENABLE_POSTFILTER */
+
+int main(void)
+{
+   printf("Built without the post-filter, test skipped\n");
+   return 77;
+}
+
+#endif /* ENABLE_POSTFILTER */
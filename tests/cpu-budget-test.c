@@ -0,0 +1,164 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   This test checks CELT_SET_CPU_BUDGET and CELT_GET_ANALYSIS_LEVEL. A
+   budget no frame can meet must take the encoder down to the lowest level,
+   a generous one must bring it back up, one level per frame, and every
+   frame must still decode. Without --enable-cpu-budget the budget must be
+   refused and the level must stay at CELT_ANALYSIS_FULL.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_SIZE 960
+#define CHANNELS 2
+
+static int ret = 0;
+
+/* Codes n frames and returns the level of the last one, printing them all */
+static int encode_frames(CELTEncoder *enc, CELTDecoder *dec, int n, const char *name)
+{
+   int f, i, level = -1;
+   celt_int16 pcm[FRAME_SIZE*CHANNELS];
+   unsigned char data[1275];
+
+   printf("%-12s", name);
+   for (f=0;f<n;f++)
+   {
+      int len;
+      /* A harmonic signal, so that the pitch analysis finds something */
+      for (i=0;i<FRAME_SIZE*CHANNELS;i++)
+         pcm[i] = (celt_int16)(((i/CHANNELS)%240<120 ? 3000 : -3000) + (rand()%801) - 400);
+      len = celt_encode(enc, pcm, FRAME_SIZE, data, 160);
+      if (len < 0 || celt_decode(dec, data, len, pcm, FRAME_SIZE) < 0)
+      {
+         fprintf(stderr, "** %s: encoding or decoding failed **\n", name);
+         ret = 1;
+         return -1;
+      }
+      if (celt_encoder_ctl(enc, CELT_GET_ANALYSIS_LEVEL(&level)) != CELT_OK
+            || level < CELT_ANALYSIS_NO_PITCH || level > CELT_ANALYSIS_FULL)
+      {
+         fprintf(stderr, "** %s: bad analysis level %d **\n", name, level);
+         ret = 1;
+         return -1;
+      }
+      printf(" %d", level);
+   }
+   printf("\n");
+   return level;
+}
+
+int main(void)
+{
+   int err, level;
+   CELTMode *mode;
+   CELTEncoder *enc;
+   CELTDecoder *dec;
+
+   mode = celt_mode_create(48000, FRAME_SIZE, &err);
+   enc = celt_encoder_create_custom(mode, CHANNELS, &err);
+   dec = celt_decoder_create_custom(mode, CHANNELS, &err);
+   if (enc == NULL || dec == NULL)
+   {
+      fprintf(stderr, "Error: failed to create an encoder and a decoder\n");
+      return 1;
+   }
+   celt_encoder_ctl(enc, CELT_SET_COMPLEXITY(10));
+   srand(42);
+
+   if (celt_encoder_ctl(enc, CELT_GET_ANALYSIS_LEVEL(&level)) != CELT_OK || level != CELT_ANALYSIS_FULL)
+   {
+      fprintf(stderr, "** a new encoder is not at CELT_ANALYSIS_FULL **\n");
+      ret = 1;
+   }
+   if (celt_encoder_ctl(enc, CELT_SET_CPU_BUDGET(-1)) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** a negative budget was accepted **\n");
+      ret = 1;
+   }
+
+   if (encode_frames(enc, dec, 5, "no budget") != CELT_ANALYSIS_FULL)
+   {
+      fprintf(stderr, "** the level changed without a budget **\n");
+      ret = 1;
+   }
+
+   err = celt_encoder_ctl(enc, CELT_SET_CPU_BUDGET(1));
+#ifdef ENABLE_CPU_BUDGET
+   if (err != CELT_OK)
+   {
+      fprintf(stderr, "** CELT_SET_CPU_BUDGET returned %s **\n", celt_strerror(err));
+      ret = 1;
+   }
+   /* No frame takes 1 us, so everything that can go goes */
+   if (encode_frames(enc, dec, 10, "1 us") != CELT_ANALYSIS_NO_PITCH)
+   {
+      fprintf(stderr, "** the analyses were not left out for an impossible budget **\n");
+      ret = 1;
+   }
+   /* Every frame takes far less than a second, so they all come back, one
+      per frame */
+   celt_encoder_ctl(enc, CELT_SET_CPU_BUDGET(1000000));
+   if (encode_frames(enc, dec, 3, "1 s") == CELT_ANALYSIS_FULL
+         || encode_frames(enc, dec, 5, "1 s") != CELT_ANALYSIS_FULL)
+   {
+      fprintf(stderr, "** the analyses did not come back one at a time **\n");
+      ret = 1;
+   }
+   /* Removing the budget restores everything at once */
+   celt_encoder_ctl(enc, CELT_SET_CPU_BUDGET(1));
+   encode_frames(enc, dec, 3, "1 us");
+   celt_encoder_ctl(enc, CELT_SET_CPU_BUDGET(0));
+   if (encode_frames(enc, dec, 1, "no budget") != CELT_ANALYSIS_FULL)
+   {
+      fprintf(stderr, "** the analyses did not come back without a budget **\n");
+      ret = 1;
+   }
+#else
+   if (err != CELT_UNIMPLEMENTED)
+   {
+      fprintf(stderr, "** CELT_SET_CPU_BUDGET returned %s without --enable-cpu-budget **\n", celt_strerror(err));
+      ret = 1;
+   }
+   if (encode_frames(enc, dec, 5, "refused") != CELT_ANALYSIS_FULL)
+   {
+      fprintf(stderr, "** the level changed without a budget **\n");
+      ret = 1;
+   }
+#endif
+
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec);
+   celt_mode_destroy(mode);
+   return ret;
+}
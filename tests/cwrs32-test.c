@@ -3,7 +3,9 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define CELT_C 
 #include "../libcelt/stack_alloc.h"
@@ -22,6 +24,105 @@ static const int kmax[15]={
      22,   18,   16,   15,   13
 };
 
+#define NB_BENCH (2000)
+
+/*Band sizes and pulse counts in the range the codec actually uses, each
+   with the largest K for which V(N,K) still fits in 32 bits.*/
+static const int bench_n[10]={  6,  8, 12, 16, 24, 32, 48, 64, 96,176};
+static const int bench_k[10]={ 48, 24, 16, 12,  9,  7,  6,  5,  5,  4};
+
+/*Checks the table-driven indexing against the row recurrences on random
+   pulse vectors and reports the time taken by each.*/
+static int bench_table(void){
+  CWRSTable    t;
+  celt_int32   index[178];
+  celt_uint32 *u;
+  int          y[176];
+  int          n;
+  int          b;
+  t.maxN=176;
+  index[0]=index[1]=0;
+  for(n=1;n<=t.maxN;n++){
+    int k;
+    k=0;
+    for(b=0;b<10;b++)if(bench_n[b]>=n&&bench_k[b]>k)k=bench_k[b];
+    index[n+1]=index[n]+k+2;
+  }
+  u=(celt_uint32 *)malloc(index[t.maxN+1]*sizeof(*u));
+  for(n=1;n<=t.maxN;n++){
+    celt_uint32 *row;
+    int          k;
+    row=u+index[n];
+    k=index[n+1]-index[n]-2;
+    if(n==1){
+      row[0]=0;
+      while(k+1>0)row[k--+1]=1;
+    }
+    else ncwrs_urow(n,k,row);
+  }
+  t.index=index;
+  t.u=u;
+  for(b=0;b<10;b++){
+    static int  yv[NB_BENCH][176];
+    celt_uint32 iref[NB_BENCH];
+    celt_uint32 itab[NB_BENCH];
+    celt_uint32 uu[KMAX+2U];
+    clock_t     t_enc;
+    clock_t     t_dec;
+    clock_t     t_tenc;
+    clock_t     t_tdec;
+    clock_t     t0;
+    celt_uint32 nc;
+    celt_uint32 v;
+    int         k;
+    int         j;
+    n=bench_n[b];
+    k=bench_k[b];
+    srand(n);
+    for(j=0;j<NB_BENCH;j++){
+      int p;
+      memset(yv[j],0,n*sizeof(yv[j][0]));
+      for(p=0;p<k;p++){
+        int pos;
+        pos=rand()%n;
+        if(yv[j][pos]==0)yv[j][pos]=rand()&1?1:-1;
+        else yv[j][pos]+=yv[j][pos]>0?1:-1;
+      }
+    }
+    t0=clock();
+    for(j=0;j<NB_BENCH;j++)iref[j]=icwrs(n,k,&nc,yv[j],uu);
+    t_enc=clock()-t0;
+    t0=clock();
+    for(j=0;j<NB_BENCH;j++)itab[j]=icwrs_table(n,k,&v,yv[j],&t);
+    t_tenc=clock()-t0;
+    if(v!=nc||memcmp(iref,itab,sizeof(iref))!=0){
+      fprintf(stderr,"Table index mismatch for N=%i, K=%i.\n",n,k);
+      return 19;
+    }
+    t0=clock();
+    for(j=0;j<NB_BENCH;j++){
+      ncwrs_urow(n,k,uu);
+      cwrsi(n,k,iref[j],yv[j],uu);
+    }
+    t_dec=clock()-t0;
+    t0=clock();
+    for(j=0;j<NB_BENCH;j++)cwrsi_table(n,k,iref[j],y,&t);
+    t_tdec=clock()-t0;
+    for(j=0;j<NB_BENCH;j++){
+      cwrsi_table(n,k,iref[j],y,&t);
+      if(memcmp(y,yv[j],n*sizeof(*y))!=0){
+        fprintf(stderr,"Table pulse vector mismatch for N=%i, K=%i.\n",n,k);
+        return 20;
+      }
+    }
+    printf("N=%3i, K=%2i: index %4.0f ns recurrence, %4.0f ns table; "
+     "decode %4.0f ns recurrence, %4.0f ns table\n",n,k,
+     1e9*t_enc/CLOCKS_PER_SEC/NB_BENCH,1e9*t_tenc/CLOCKS_PER_SEC/NB_BENCH,
+     1e9*t_dec/CLOCKS_PER_SEC/NB_BENCH,1e9*t_tdec/CLOCKS_PER_SEC/NB_BENCH);
+  }
+  free(u);
+  return 0;
+}
 
 int main(int _argc,char **_argv){
   int n;
@@ -172,5 +273,5 @@ int main(int _argc,char **_argv){
     }
     while(k<kmax[n]);
   }
-  return 0;
+  return bench_table();
 }
@@ -9,6 +9,7 @@
 #endif
 
 #include <stdio.h>
+#include <time.h>
 #include "kiss_fft.h"
 
 #define CELT_C 
@@ -113,6 +114,37 @@ void test1d(int nfft,int isinverse)
     free(cfg);
 }
 
+/* Reports the average time of a forward and an inverse transform */
+void bench1d(int nfft)
+{
+    size_t buflen = sizeof(kiss_fft_cpx)*nfft;
+    kiss_fft_cpx  * in = (kiss_fft_cpx*)malloc(buflen);
+    kiss_fft_cpx  * out= (kiss_fft_cpx*)malloc(buflen);
+    kiss_fft_state *cfg = kiss_fft_alloc(nfft,0,0);
+    int k, iter;
+    int niter = 2000000/nfft;
+    clock_t fwd, inv;
+
+    for (k=0;k<nfft;++k) {
+        in[k].r = (rand() % 32767) - 16384;
+        in[k].i = (rand() % 32767) - 16384;
+    }
+    fwd = clock();
+    for (iter=0;iter<niter;iter++)
+       kiss_fft(cfg,in,out);
+    fwd = clock()-fwd;
+    inv = clock();
+    for (iter=0;iter<niter;iter++)
+       kiss_ifft(cfg,in,out);
+    inv = clock()-inv;
+    printf("nfft=%d: %.0f ns forward, %.0f ns inverse\n", nfft,
+          1e9*fwd/CLOCKS_PER_SEC/niter, 1e9*inv/CLOCKS_PER_SEC/niter);
+
+    free(in);
+    free(out);
+    free(cfg);
+}
+
 int main(int argc,char ** argv)
 {
     ALLOC_STACK;
@@ -136,6 +168,17 @@ int main(int argc,char ** argv)
         test1d(50,1);
         test1d(120,0);
         test1d(120,1);
+        /* Sizes used by the MDCTs of the static modes */
+        test1d(60,0);
+        test1d(60,1);
+        test1d(240,0);
+        test1d(240,1);
+        test1d(480,0);
+        test1d(480,1);
+        bench1d(60);
+        bench1d(120);
+        bench1d(240);
+        bench1d(480);
 #endif
     }
     return ret;
@@ -0,0 +1,131 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Checks that a lost packet gives a whole concealed frame at every output
+   rate, through the 16-bit and the float API: two decoders get the same
+   packets into output buffers filled with two different markers, and no
+   sample of a concealed frame may still hold its marker in both.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define NB_FRAMES 40
+#define MAX_PACKET 1275
+#define MAX_FRAME 960
+
+static int ret = 0;
+
+/* Packets 10 to 16 are lost: the pitch-based concealment, then the noise */
+static int lost(int f)
+{
+   return f>=10 && f<17;
+}
+
+static void test_rate(int rate, int channels, int use_float)
+{
+   int f, i, err;
+   int frame_size = 960*rate/48000;
+   int unwritten = 0;
+   CELTEncoder *enc;
+   CELTDecoder *dec[2];
+   celt_int16 pcm[MAX_FRAME*2];
+   celt_int16 out[2][MAX_FRAME*2];
+   float out_float[2][MAX_FRAME*2];
+   unsigned char data[MAX_PACKET];
+
+   enc = celt_encoder_create(rate, channels, &err);
+   dec[0] = celt_decoder_create(rate, channels, &err);
+   dec[1] = celt_decoder_create(rate, channels, &err);
+   if (enc==NULL || dec[0]==NULL || dec[1]==NULL)
+   {
+      fprintf(stderr, "cannot create the %d Hz encoder or decoders\n", rate);
+      exit(1);
+   }
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      int j, len;
+      for (i=0;i<frame_size*channels;i++)
+         pcm[i] = (celt_int16)(4000*sin(2*M_PI*300*(f*frame_size+i/channels)/rate) + rand()%1000-500);
+      len = celt_encode(enc, pcm, frame_size, data, 40*channels);
+      for (j=0;j<2;j++)
+      {
+         const unsigned char *packet = lost(f) ? NULL : data;
+         for (i=0;i<frame_size*channels;i++)
+         {
+            out[j][i] = j ? -12345 : 12345;
+            out_float[j][i] = j ? -1e10f : 1e10f;
+         }
+         if (use_float)
+            err = celt_decode_float(dec[j], packet, len, out_float[j], frame_size);
+         else
+            err = celt_decode(dec[j], packet, len, out[j], frame_size);
+         if (err != (packet==NULL ? CELT_OK : frame_size))
+         {
+            fprintf(stderr, "** frame %d at %d Hz: celt_decode returned %d **\n", f, rate, err);
+            ret = 1;
+         }
+      }
+      for (i=0;i<frame_size*channels;i++)
+      {
+         if (use_float ? out_float[0][i]==1e10f && out_float[1][i]==-1e10f
+               : out[0][i]==12345 && out[1][i]==-12345)
+            unwritten++;
+      }
+   }
+   if (unwritten > 0)
+   {
+      fprintf(stderr, "** %d Hz %dch%s: %d samples not written **\n",
+            rate, channels, use_float ? " float" : "", unwritten);
+      ret = 1;
+   }
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec[0]);
+   celt_decoder_destroy(dec[1]);
+}
+
+int main(void)
+{
+   int i;
+   static const int rates[4] = {48000, 24000, 16000, 8000};
+   srand(42);
+   for (i=0;i<4;i++)
+   {
+      test_rate(rates[i], 1, 0);
+      test_rate(rates[i], 2, 0);
+#ifndef DISABLE_FLOAT_API
+      test_rate(rates[i], 1, 1);
+      test_rate(rates[i], 2, 1);
+#endif
+   }
+   return ret;
+}
@@ -9,6 +9,8 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "mdct.h"
 #define CELT_C 
 #include "../libcelt/stack_alloc.h"
@@ -124,10 +126,10 @@ void test1d(int nfft,int isinverse)
     {
        for (k=0;k<nfft;++k)
           out[k] = 0;
-       clt_mdct_backward(&cfg,in,out, window, nfft/2, 0);
+       clt_mdct_backward(&cfg,in,out, window, nfft/2, 0, nfft/2);
        check_inv(in,out,nfft,isinverse);
     } else {
-       clt_mdct_forward(&cfg,in,out,window, nfft/2, 0);
+       clt_mdct_forward(&cfg,in,out,window, nfft/2, 0, nfft/2);
        check(in,out,nfft,isinverse);
     }
     /*for (k=0;k<nfft;++k) printf("%d %d ", out[k].r, out[k].i);printf("\n");*/
@@ -138,6 +140,111 @@ void test1d(int nfft,int isinverse)
     clt_mdct_clear(&cfg);
 }
 
+/* The transforms with a bound must give the same bins below the bound
+   (forward), or the same output when the bins above it are zero
+   (backward), as the full ones */
+void test_bound(int nfft, int overlap)
+{
+    static const int bounds[] = {0, 1, 2, 3, 7, 8, 12, 13};
+    mdct_lookup cfg;
+    kiss_fft_scalar  * in = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar)*nfft);
+    kiss_fft_scalar  * in2 = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar)*nfft);
+    kiss_fft_scalar  * out = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar)*nfft);
+    kiss_fft_scalar  * out2 = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar)*nfft);
+    celt_word16  * window= (celt_word16*)malloc(sizeof(celt_word16)*overlap);
+    int k, b;
+
+    clt_mdct_init(&cfg, nfft, 0);
+    for (k=0;k<overlap;++k)
+        window[k] = Q15ONE;
+    /* A few small bounds, and fractions of the spectrum like those of the
+       rates below 48 kHz */
+    for (b=0;b<(int)(sizeof(bounds)/sizeof(bounds[0]))+6;b++)
+    {
+        int bound = b<(int)(sizeof(bounds)/sizeof(bounds[0])) ? bounds[b] :
+              (nfft/2)/(b-(int)(sizeof(bounds)/sizeof(bounds[0]))+1);
+        for (k=0;k<nfft;++k)
+            in[k] = in2[k] = (rand() % 32768) - 16384;
+        clt_mdct_forward(&cfg, in, out, window, overlap, 0, nfft/2);
+        clt_mdct_forward(&cfg, in2, out2, window, overlap, 0, bound);
+        if (memcmp(out, out2, bound*sizeof(kiss_fft_scalar)) != 0)
+        {
+            printf("** forward MDCT mismatch for nfft=%d, bound=%d **\n", nfft, bound);
+            ret = 1;
+        }
+        for (k=0;k<nfft/2;++k)
+            in[k] = k<bound ? ((rand() % 32768) - 16384)/nfft : 0;
+        for (k=0;k<nfft;++k)
+            out[k] = out2[k] = 0;
+        clt_mdct_backward(&cfg, in, out, window, overlap, 0, nfft/2);
+        clt_mdct_backward(&cfg, in, out2, window, overlap, 0, bound);
+        for (k=0;k<nfft;++k)
+        {
+            /* Zeros of either sign */
+            if (out[k] != out2[k])
+            {
+                printf("** backward MDCT mismatch for nfft=%d, bound=%d **\n", nfft, bound);
+                ret = 1;
+                break;
+            }
+        }
+    }
+
+    free(in);
+    free(in2);
+    free(out);
+    free(out2);
+    free(window);
+    clt_mdct_clear(&cfg);
+}
+
+/* Reports the cost of one forward and one backward MDCT for every shift of
+   the static mode's lookup (N=1920, 120-sample overlap), over the whole
+   spectrum and over the first sixth of it as with 8 kHz input */
+void bench(void)
+{
+    int N = 1920;
+    int overlap = 120;
+    mdct_lookup cfg;
+    kiss_fft_scalar  * in = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar)*N*3);
+    kiss_fft_scalar  * out= (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar)*N*3);
+    celt_word16  * window= (celt_word16*)malloc(sizeof(celt_word16)*overlap);
+    int k, shift, iter;
+
+    clt_mdct_init(&cfg, N, 3);
+    for (k=0;k<3*N;++k) {
+        in[k] = (rand() % 32768) - 16384;
+        out[k] = 0;
+    }
+    for (k=0;k<overlap;++k)
+        window[k] = Q15ONE;
+    for (shift=0;shift<=3;shift++)
+    {
+        int niter = 200000>>(3-shift);
+        int b;
+        for (b=1;b<=6;b+=5)
+        {
+            int bound = (N>>shift>>1)/b;
+            clock_t fwd, inv;
+            fwd = clock();
+            for (iter=0;iter<niter;iter++)
+                clt_mdct_forward(&cfg, in, out, window, overlap, shift, bound);
+            fwd = clock()-fwd;
+            inv = clock();
+            for (iter=0;iter<niter;iter++)
+                clt_mdct_backward(&cfg, in, out+N, window, overlap, shift, bound);
+            inv = clock()-inv;
+            printf("LM=%d shift=%d N=%d bound=%d: %.0f ns forward, %.0f ns backward\n", 3-shift,
+                  shift, N>>shift, bound, 1e9*fwd/CLOCKS_PER_SEC/niter, 1e9*inv/CLOCKS_PER_SEC/niter);
+        }
+    }
+
+    free(in);
+    free(out);
+    free(window);
+    clt_mdct_clear(&cfg);
+}
+
 int main(int argc,char ** argv)
 {
     ALLOC_STACK;
@@ -154,6 +261,7 @@ int main(int argc,char ** argv)
         test1d(256,1);
         test1d(512,0);
         test1d(512,1);
+        test_bound(256, 64);
 #ifndef RADIX_TWO_ONLY
         test1d(40,0);
         test1d(40,1);
@@ -163,6 +271,13 @@ int main(int argc,char ** argv)
         test1d(240,1);
         test1d(480,0);
         test1d(480,1);
+        test1d(960,0);
+        test1d(960,1);
+        test1d(1920,0);
+        test1d(1920,1);
+        test_bound(240, 120);
+        test_bound(1920, 120);
+        bench();
 #endif
     }
     return ret;
@@ -0,0 +1,410 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Codes 5.1 audio with the multistream encoder and decoder. Each channel
+   carries its own tone, which must come out of the channel it went in
+   with most of its level. The packets and the output must be the same
+   whether the streams run one after the other, in reverse order through
+   a thread pool or on real threads. With CELT_SET_JOINT_RATE, channels
+   with more to code must get more of the same packets and come out with a
+   better SNR, without the other ones losing more than they gain. Also
+   checks lost and damaged packets, silent output channels and the
+   arguments that must be refused.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Running the streams on threads needs a stack per thread */
+#if defined(HAVE_PTHREAD) && (defined(VAR_ARRAYS) || defined(USE_ALLOCA) || defined(ENABLE_SCRATCH_ARENA))
+#define USE_THREADS
+#include <pthread.h>
+#endif
+
+#define CHANNELS 6
+#define STREAMS 4
+#define COUPLED 2
+#define FRAME_SIZE 960
+#define NB_FRAMES 60
+#define MAX_PACKET (STREAMS*1277)
+
+/* L, C, R, surround L and R, LFE: the fronts and the surrounds are
+   stereo streams, the centre and the LFE mono streams */
+static const unsigned char mapping[CHANNELS] = {0, 4, 1, 2, 3, 5};
+static const double freqs[CHANNELS] = {300, 500, 700, 1100, 1300, 70};
+
+static int ret = 0;
+
+/* Runs the jobs backwards, one after the other */
+static void reverse_run(void *pool, void (*job)(void *arg, int i), void *arg, int nb_jobs)
+{
+   int i;
+   (*(int*)pool)++;
+   for (i=nb_jobs-1;i>=0;i--)
+      job(arg, i);
+}
+
+#ifdef USE_THREADS
+typedef struct {
+   void (*job)(void *arg, int i);
+   void *arg;
+   int i;
+} Job;
+
+static void *job_thread(void *arg)
+{
+   Job *j = (Job*)arg;
+   j->job(j->arg, j->i);
+   return NULL;
+}
+
+/* Runs every job but the first one on its own thread */
+static void thread_run(void *pool, void (*job)(void *arg, int i), void *arg, int nb_jobs)
+{
+   pthread_t threads[STREAMS];
+   Job jobs[STREAMS];
+   int i;
+   (*(int*)pool)++;
+   for (i=1;i<nb_jobs;i++)
+   {
+      jobs[i].job = job;
+      jobs[i].arg = arg;
+      jobs[i].i = i;
+      if (pthread_create(&threads[i], NULL, job_thread, &jobs[i]) != 0)
+      {
+         fprintf(stderr, "cannot create a thread\n");
+         exit(1);
+      }
+   }
+   job(arg, 0);
+   for (i=1;i<nb_jobs;i++)
+      pthread_join(threads[i], NULL);
+}
+#endif
+
+/* Level of the tone at freq in x (one channel of interleaved audio) */
+static double tone_level(const celt_int16 *x, int channels, int len, double freq)
+{
+   double re=0, im=0;
+   int i;
+   for (i=0;i<len;i++)
+   {
+      re += x[i*channels]*cos(2*M_PI*freq*i/48000);
+      im += x[i*channels]*sin(2*M_PI*freq*i/48000);
+   }
+   return (re*re + im*im)/((double)len*len);
+}
+
+/* Codes the same audio with the given pool (or none) and returns the
+   packets and the output */
+static void code(const CELTMode *mode, const celt_int16 *pcm, const CELTThreadPool *pool, int vbr,
+      int joint, int bytes, unsigned char *packets, int *lens, celt_int16 *out)
+{
+   int f, err, len;
+   CELTMSEncoder *enc = celt_ms_encoder_create(mode, CHANNELS, STREAMS, COUPLED, mapping, &err);
+   CELTMSDecoder *dec = celt_ms_decoder_create(mode, CHANNELS, STREAMS, COUPLED, mapping, &err);
+   if (enc==NULL || dec==NULL)
+   {
+      fprintf(stderr, "cannot create the multistream encoder or decoder: %s\n", celt_strerror(err));
+      exit(1);
+   }
+   if (celt_ms_encoder_ctl(enc, CELT_SET_THREAD_POOL(pool)) != CELT_OK
+         || celt_ms_decoder_ctl(dec, CELT_SET_THREAD_POOL(pool)) != CELT_OK
+         || celt_ms_encoder_ctl(enc, CELT_SET_VBR(vbr)) != CELT_OK
+         || celt_ms_encoder_ctl(enc, CELT_SET_COMPLEXITY(8)) != CELT_OK
+         || celt_ms_encoder_ctl(enc, CELT_SET_JOINT_RATE(joint)) != CELT_OK
+         || (vbr && celt_ms_encoder_ctl(enc, CELT_SET_BITRATE(320000)) != CELT_OK))
+   {
+      fprintf(stderr, "** celt_ms_encoder_ctl() failed **\n");
+      ret = 1;
+   }
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      int offset = f*FRAME_SIZE*CHANNELS;
+      len = celt_ms_encode(enc, pcm+offset, FRAME_SIZE, packets+f*MAX_PACKET, bytes);
+      if (len<0 || len>bytes || (!vbr && len<bytes-STREAMS))
+      {
+         fprintf(stderr, "** celt_ms_encode() returned %d for %d bytes **\n", len, bytes);
+         ret = 1;
+         len = 0;
+      }
+      lens[f] = len;
+      /* Every tenth packet is lost */
+      err = celt_ms_decode(dec, f%10==9 ? NULL : packets+f*MAX_PACKET, len, out+offset, FRAME_SIZE);
+      if (err != FRAME_SIZE)
+      {
+         fprintf(stderr, "** celt_ms_decode() returned %d **\n", err);
+         ret = 1;
+      }
+   }
+   celt_ms_encoder_destroy(enc);
+   celt_ms_decoder_destroy(dec);
+}
+
+static void test_coding(const CELTMode *mode, const celt_int16 *pcm, int vbr, int joint, int bytes)
+{
+   static unsigned char packets[2][NB_FRAMES*MAX_PACKET];
+   static int lens[2][NB_FRAMES];
+   static celt_int16 out[2][NB_FRAMES*FRAME_SIZE*CHANNELS];
+   int c, k, f, total=0, runs=0;
+   CELTThreadPool pool;
+   /* Leaves out the start and the lost packets */
+   int start = 20*FRAME_SIZE*CHANNELS;
+   int len = 9*FRAME_SIZE;
+
+   code(mode, pcm, NULL, vbr, joint, bytes, packets[0], lens[0], out[0]);
+   for (f=0;f<NB_FRAMES;f++)
+      total += lens[0][f];
+   for (c=0;c<CHANNELS;c++)
+   {
+      double own = tone_level(out[0]+start+c, CHANNELS, len, freqs[c]);
+      double in = tone_level(pcm+start+c, CHANNELS, len, freqs[c]);
+      if (own < .5*in)
+      {
+         fprintf(stderr, "** channel %d lost its tone (%.1f dB) **\n", c, 10*log10(own/in));
+         ret = 1;
+      }
+      for (k=0;k<CHANNELS;k++)
+      {
+         if (k!=c && tone_level(out[0]+start+c, CHANNELS, len, freqs[k]) > .01*in)
+         {
+            fprintf(stderr, "** the tone of channel %d came out of channel %d **\n", k, c);
+            ret = 1;
+         }
+      }
+   }
+   printf("%s%s, %d bytes max: %.1f bytes per packet\n", vbr ? "VBR" : "CBR",
+         joint ? " joint" : "", bytes, (double)total/NB_FRAMES);
+
+   pool.run = reverse_run;
+   pool.pool = &runs;
+   code(mode, pcm, &pool, vbr, joint, bytes, packets[1], lens[1], out[1]);
+   if (memcmp(lens[0], lens[1], sizeof(lens[0])) != 0 || memcmp(packets[0], packets[1], sizeof(packets[0])) != 0
+         || memcmp(out[0], out[1], sizeof(out[0])) != 0 || runs != (2+joint)*NB_FRAMES)
+   {
+      fprintf(stderr, "** different result with the streams in reverse order **\n");
+      ret = 1;
+   }
+#ifdef USE_THREADS
+   runs = 0;
+   pool.run = thread_run;
+   code(mode, pcm, &pool, vbr, joint, bytes, packets[1], lens[1], out[1]);
+   if (memcmp(lens[0], lens[1], sizeof(lens[0])) != 0 || memcmp(packets[0], packets[1], sizeof(packets[0])) != 0
+         || memcmp(out[0], out[1], sizeof(out[0])) != 0 || runs != (2+joint)*NB_FRAMES)
+   {
+      fprintf(stderr, "** different result with the streams on threads **\n");
+      ret = 1;
+   }
+#endif
+}
+
+/* Error of each channel after coding with and without CELT_SET_JOINT_RATE,
+   for music on the fronts (with noise on the left and right), a quiet room
+   on the surrounds and nothing on the LFE. The total error and the worst
+   SNR of the fronts must be no worse, and the quiet channels must stay
+   quiet. */
+static void test_joint(const CELTMode *mode)
+{
+   static celt_int16 pcm[NB_FRAMES*FRAME_SIZE*CHANNELS];
+   static unsigned char packets[NB_FRAMES*MAX_PACKET];
+   static celt_int16 out[2][NB_FRAMES*FRAME_SIZE*CHANNELS];
+   int lens[2][NB_FRAMES];
+   double snr[2][CHANNELS], error[2][CHANNELS], total[2] = {0, 0};
+   double sum[2] = {0, 0}, worst[2] = {100, 100};
+   int i, c, k, f, h;
+   celt_int32 delay;
+   int bytes = 300;
+
+   for (i=0;i<NB_FRAMES*FRAME_SIZE;i++)
+   {
+      for (c=0;c<CHANNELS;c++)
+      {
+         double x = 0;
+         if (mapping[c] == 4 || mapping[c] < 2)
+            for (h=1;h<=10;h++)
+               x += 3000./h*sin(2*M_PI*h*freqs[c]*i/48000);
+         if (mapping[c] < 2)
+            x += rand()%1000 - 500;
+         else if (mapping[c] < 4)
+            x += rand()%5 - 2;
+         pcm[i*CHANNELS+c] = (celt_int16)x;
+      }
+   }
+   celt_mode_info(mode, CELT_GET_LOOKAHEAD, &delay);
+   for (k=0;k<2;k++)
+   {
+      code(mode, pcm, NULL, 0, k, bytes, packets, lens[k], out[k]);
+      for (f=0;f<NB_FRAMES;f++)
+         total[k] += lens[k][f];
+      for (c=0;c<CHANNELS;c++)
+      {
+         double sig=0, noise=0;
+         /* Only the frames that were all received */
+         for (f=20;f<NB_FRAMES;f++)
+         {
+            if (f%10==9 || f%10==0)
+               continue;
+            for (i=0;i<FRAME_SIZE;i++)
+            {
+               int n = (f*FRAME_SIZE+i)*CHANNELS+c;
+               double d = out[k][n] - pcm[n-delay*CHANNELS];
+               sig += (double)pcm[n-delay*CHANNELS]*pcm[n-delay*CHANNELS];
+               noise += d*d;
+            }
+         }
+         snr[k][c] = sig>0 ? 10*log10(sig/(noise+1)) : 0;
+         error[k][c] = noise/(NB_FRAMES*FRAME_SIZE);
+      }
+   }
+   for (k=0;k<2;k++)
+   {
+      for (c=0;c<CHANNELS;c++)
+      {
+         sum[k] += error[k][c];
+         if (mapping[c] < 2 || mapping[c] == 4)
+            worst[k] = snr[k][c] < worst[k] ? snr[k][c] : worst[k];
+      }
+   }
+   printf("joint rate, %d bytes: %.1f and %.1f bytes per packet, SNR", bytes, total[0]/NB_FRAMES, total[1]/NB_FRAMES);
+   for (c=0;c<CHANNELS;c++)
+      printf(" %.1f/%.1f", snr[0][c], snr[1][c]);
+   printf(" dB, total error %+.1f dB\n", 10*log10(sum[1]/sum[0]));
+   if (total[1] < total[0]-STREAMS || total[1] > total[0]+STREAMS)
+   {
+      fprintf(stderr, "** CELT_SET_JOINT_RATE changed the size of the packets **\n");
+      ret = 1;
+   }
+   if (sum[1] > .8*sum[0] || worst[1] < worst[0])
+   {
+      fprintf(stderr, "** CELT_SET_JOINT_RATE didn't reduce the error (%.1f dB, worst SNR %.1f dB instead of %.1f dB) **\n",
+            10*log10(sum[1]/sum[0]), worst[1], worst[0]);
+      ret = 1;
+   }
+   for (c=0;c<CHANNELS;c++)
+   {
+      if (mapping[c] >= 2 && mapping[c] != 4 && error[1][c] > 16)
+      {
+         fprintf(stderr, "** channel %d is no longer quiet with CELT_SET_JOINT_RATE **\n", c);
+         ret = 1;
+      }
+   }
+}
+
+/* Damaged packets, silent channels and bad arguments */
+static void test_errors(const CELTMode *mode, const celt_int16 *pcm)
+{
+   static const unsigned char front[3] = {0, 1, 255};
+   static const unsigned char bad_mapping[CHANNELS] = {0, 4, 1, 2, 3, 6};
+   unsigned char packet[MAX_PACKET];
+   celt_int16 out[FRAME_SIZE*CHANNELS];
+   int i, len, err;
+   CELTMSEncoder *enc = celt_ms_encoder_create(mode, CHANNELS, STREAMS, COUPLED, mapping, &err);
+   CELTMSDecoder *dec = celt_ms_decoder_create(mode, 3, STREAMS, COUPLED, front, &err);
+   CELTEncoder *stream;
+
+   if (enc==NULL || dec==NULL)
+   {
+      fprintf(stderr, "cannot create the multistream encoder or decoder\n");
+      exit(1);
+   }
+   len = celt_ms_encode(enc, pcm, FRAME_SIZE, packet, 300);
+   /* Only the front left and right, and a silent third channel */
+   if (celt_ms_decode(dec, packet, len, out, FRAME_SIZE) != FRAME_SIZE)
+   {
+      fprintf(stderr, "** cannot decode only some of the channels **\n");
+      ret = 1;
+   }
+   for (i=0;i<FRAME_SIZE;i++)
+      if (out[3*i+2] != 0)
+         break;
+   if (i != FRAME_SIZE)
+   {
+      fprintf(stderr, "** an unmapped channel isn't silent **\n");
+      ret = 1;
+   }
+   /* Cut in the middle of the sizes of the streams */
+   if (celt_ms_decode(dec, packet, 1+packet[0]+1, out, FRAME_SIZE) != CELT_CORRUPTED_DATA)
+   {
+      fprintf(stderr, "** a truncated packet was accepted **\n");
+      ret = 1;
+   }
+
+   if (celt_ms_encode(enc, pcm, FRAME_SIZE, packet, 10) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** celt_ms_encode() accepted too few bytes for the streams **\n");
+      ret = 1;
+   }
+   if (celt_ms_encoder_ctl(enc, CELT_GET_STREAM_ENCODER(3, &stream)) != CELT_OK || stream==NULL
+         || celt_encoder_ctl(stream, CELT_SET_COMPLEXITY(2)) != CELT_OK
+         || celt_ms_encoder_ctl(enc, CELT_GET_STREAM_ENCODER(4, &stream)) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** CELT_GET_STREAM_ENCODER failed **\n");
+      ret = 1;
+   }
+   celt_ms_encoder_destroy(enc);
+   celt_ms_decoder_destroy(dec);
+
+   if (celt_ms_encoder_create(mode, CHANNELS, STREAMS, COUPLED, bad_mapping, &err) != NULL || err != CELT_BAD_ARG
+         || celt_ms_encoder_create(mode, CHANNELS, 2, 3, mapping, &err) != NULL || err != CELT_BAD_ARG
+         || celt_ms_decoder_create(mode, 0, STREAMS, COUPLED, mapping, &err) != NULL || err != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** a bad layout was accepted **\n");
+      ret = 1;
+   }
+}
+
+int main(void)
+{
+   static celt_int16 pcm[NB_FRAMES*FRAME_SIZE*CHANNELS];
+   CELTMode *mode;
+   int i, c, err;
+
+   mode = celt_mode_create(48000, FRAME_SIZE, &err);
+   if (mode==NULL)
+   {
+      fprintf(stderr, "cannot create the mode\n");
+      return 1;
+   }
+   srand(42);
+   for (i=0;i<NB_FRAMES*FRAME_SIZE;i++)
+      for (c=0;c<CHANNELS;c++)
+         pcm[i*CHANNELS+c] = (celt_int16)(4000*sin(2*M_PI*freqs[c]*i/48000) + rand()%200 - 100);
+
+   test_coding(mode, pcm, 0, 0, 600);
+   test_coding(mode, pcm, 1, 0, 1000);
+   test_coding(mode, pcm, 0, 1, 600);
+   test_coding(mode, pcm, 1, 1, 1000);
+   test_joint(mode);
+   test_errors(mode, pcm);
+   celt_mode_destroy(mode);
+   return ret;
+}
@@ -0,0 +1,184 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   This test encodes the same pitched signal once with a plain encoder and
+   once with the pitch search done ahead of time by separate analysis
+   encoders (one for the even frames and one for the odd frames, like two
+   worker threads would), and checks that both give the same bit-stream.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NB_FRAMES 100
+#define MAX_PACKET 1275
+
+#ifndef M_PI
+#define M_PI 3.141592653
+#endif
+
+static int ret = 0;
+
+/* A harmonic signal with a slowly moving fundamental, some noise and a
+   short silence, so that the prefilter turns on and off */
+static void gen_frame(celt_int16 *pcm, int frame_size, int channels, int frame, double *phase)
+{
+   int i, c, h;
+   double f0 = 100+60*sin(2*M_PI*frame/40.);
+   for (i=0;i<frame_size;i++)
+   {
+      double x = 0;
+      for (h=1;h<=6;h++)
+         x += sin(h**phase)/h;
+      *phase += 2*M_PI*f0/48000;
+      for (c=0;c<channels;c++)
+      {
+         int s = (int)(6000*x) + (rand()%401) - 200;
+         if (frame%25 == 12)
+            s = 0;
+         pcm[i*channels+c] = (celt_int16)(c ? s/2 : s);
+      }
+   }
+}
+
+static void test_hints(int frame_size, int channels, int vbr)
+{
+   int f, err, bytes;
+   CELTMode *mode;
+   CELTEncoder *ref, *enc, *analysis[2];
+   celt_int16 pcm[960*2];
+   unsigned char ref_data[MAX_PACKET];
+   unsigned char data[MAX_PACKET];
+   double phase = 0;
+   int hinted = 0;
+
+   mode = celt_mode_create(48000, frame_size, &err);
+   if (mode == NULL || err)
+   {
+      fprintf(stderr, "Error: failed to create a mode: %s\n", celt_strerror(err));
+      exit(1);
+   }
+   ref = celt_encoder_create_custom(mode, channels, &err);
+   enc = celt_encoder_create_custom(mode, channels, &err);
+   analysis[0] = celt_encoder_create_custom(mode, channels, &err);
+   analysis[1] = celt_encoder_create_custom(mode, channels, &err);
+   celt_encoder_ctl(ref, CELT_SET_COMPLEXITY(10));
+   celt_encoder_ctl(enc, CELT_SET_COMPLEXITY(10));
+   if (vbr)
+   {
+      celt_encoder_ctl(ref, CELT_SET_VBR(1));
+      celt_encoder_ctl(enc, CELT_SET_VBR(1));
+      celt_encoder_ctl(ref, CELT_SET_BITRATE(64000*channels));
+      celt_encoder_ctl(enc, CELT_SET_BITRATE(64000*channels));
+   }
+   bytes = (vbr ? 1275 : 80*channels) * frame_size/960;
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      int a, hint=0, ref_bytes, nb_bytes;
+      gen_frame(pcm, frame_size, channels, f, &phase);
+      /* Both analysers see every frame, but each only searches its own */
+      for (a=0;a<2;a++)
+      {
+         int r = celt_encoder_pitch_analysis(analysis[a], pcm, frame_size, f%2==a);
+         if (r < 0)
+         {
+            fprintf(stderr, "celt_encoder_pitch_analysis returned %s\n", celt_strerror(r));
+            ret = 1;
+            r = 0;
+         }
+         if (f%2==a)
+            hint = r;
+      }
+      if (hint > 0)
+         hinted++;
+      if (celt_encoder_ctl(enc, CELT_SET_PITCH_HINT(hint)) != CELT_OK)
+      {
+         fprintf(stderr, "** CELT_SET_PITCH_HINT(%d) was refused **\n", hint);
+         ret = 1;
+      }
+      ref_bytes = celt_encode(ref, pcm, frame_size, ref_data, bytes);
+      nb_bytes = celt_encode(enc, pcm, frame_size, data, bytes);
+      if (ref_bytes<0 || nb_bytes!=ref_bytes || memcmp(data, ref_data, nb_bytes)!=0)
+      {
+         fprintf(stderr, "** bit-stream mismatch with pitch hints at frame %d (%d samples, %d channels, %s) **\n",
+               f, frame_size, channels, vbr ? "VBR" : "CBR");
+         ret = 1;
+         break;
+      }
+   }
+   printf("%d samples, %d channels, %s: %d of %d frames used a pitch hint\n",
+         frame_size, channels, vbr ? "VBR" : "CBR", hinted, NB_FRAMES);
+   if (hinted == 0)
+   {
+      fprintf(stderr, "** the pitch analysis never found a pitch **\n");
+      ret = 1;
+   }
+
+   celt_encoder_destroy(ref);
+   celt_encoder_destroy(enc);
+   celt_encoder_destroy(analysis[0]);
+   celt_encoder_destroy(analysis[1]);
+   celt_mode_destroy(mode);
+}
+
+int main(void)
+{
+   int frame_size, err;
+   celt_int16 zeros[960] = {0};
+   CELTEncoder *enc;
+
+   /* The pitch search belongs to the post-filter */
+   enc = celt_encoder_create(48000, 1, &err);
+   if (enc == NULL)
+   {
+      fprintf(stderr, "Error: failed to create an encoder: %s\n", celt_strerror(err));
+      return 1;
+   }
+   err = celt_encoder_pitch_analysis(enc, zeros, 960, 1);
+   celt_encoder_destroy(enc);
+   if (err == CELT_UNIMPLEMENTED)
+   {
+      printf("Built without the post-filter, test skipped\n");
+      return 77;
+   }
+
+   srand(42);
+   for (frame_size=960;frame_size>=240;frame_size>>=1)
+   {
+      test_hints(frame_size, 1, 0);
+      test_hints(frame_size, 2, 0);
+      test_hints(frame_size, 1, 1);
+      test_hints(frame_size, 2, 1);
+   }
+   return ret;
+}
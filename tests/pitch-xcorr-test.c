@@ -0,0 +1,182 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Checks celt_pitch_xcorr() and _celt_autocorr(), which use a kernel that
+   can be replaced by an optimised version (e.g. with --enable-sse),
+   against plain loops like the ones they replaced. The results must be
+   bit-exact, in float as well, for all the lengths and lag counts the
+   pitch search and the concealment use, and for odd ones.
+
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CELT_C
+#include "../libcelt/stack_alloc.h"
+#include "../libcelt/mathops.c"
+#include "../libcelt/pitch.c"
+#include "../libcelt/plc.c"
+
+#ifdef FIXED_DEBUG
+long long celt_mips=0;
+#endif
+
+#define MAX_LEN 1024
+#define MAX_LAGS 1024
+#define NB_RUNS 20
+
+int ret = 0;
+
+static void ref_xcorr(const celt_word16 *x, const celt_word16 *y, celt_word32 *xcorr,
+      int len, int max_pitch)
+{
+   int i, j;
+   for (i=0;i<max_pitch;i++)
+   {
+      celt_word32 sum = 0;
+      for (j=0;j<len;j++)
+         sum = MAC16_16(sum, x[j],y[i+j]);
+      xcorr[i] = sum;
+   }
+}
+
+/* _celt_autocorr() as it was, without the window */
+static void ref_autocorr(const celt_word16 *x, celt_word32 *ac, int lag, int n)
+{
+   celt_word32 d;
+   int i;
+   celt_word16 xx[MAX_LEN];
+   for (i=0;i<n;i++)
+      xx[i] = x[i];
+#ifdef FIXED_POINT
+   {
+      celt_word32 ac0=0;
+      int shift;
+      for(i=0;i<n;i++)
+         ac0 += SHR32(MULT16_16(xx[i],xx[i]),8);
+      ac0 += 1+n;
+
+      shift = celt_ilog2(ac0)-30+9;
+      shift = (shift+1)/2;
+      for(i=0;i<n;i++)
+         xx[i] = VSHR32(xx[i], shift);
+   }
+#endif
+   while (lag>=0)
+   {
+      for (i = lag, d = 0; i < n; i++)
+         d += xx[i] * xx[i-lag];
+      ac[lag] = d;
+      lag--;
+   }
+   ac[0] += 10;
+}
+
+static void random_signal(celt_word16 *x, int len)
+{
+   int i;
+   for (i=0;i<len;i++)
+   {
+#ifdef FIXED_POINT
+      /* Small enough that no sum can overflow, as in the pitch search,
+         which scales its input down first */
+      x[i] = (celt_word16)(rand()%2048 - 1024);
+#else
+      x[i] = (celt_word16)(rand()%65536 - 32768)*(1.f/32768);
+#endif
+   }
+}
+
+static void test_xcorr(int len, int max_pitch, clock_t *t_ref, clock_t *t_new)
+{
+   static celt_word16 x[MAX_LEN], y[MAX_LEN+MAX_LAGS];
+   static celt_word32 xcorr[MAX_LAGS], xcorr2[MAX_LAGS];
+   int r;
+   clock_t t0;
+
+   random_signal(x, len);
+   random_signal(y, len+max_pitch);
+   ref_xcorr(x, y, xcorr, len, max_pitch);
+   celt_pitch_xcorr(x, y, xcorr2, len, max_pitch);
+   if (memcmp(xcorr, xcorr2, max_pitch*sizeof(celt_word32)) != 0)
+   {
+      fprintf(stderr, "** celt_pitch_xcorr() mismatch for len=%d, max_pitch=%d **\n", len, max_pitch);
+      ret = 1;
+      return;
+   }
+   t0 = clock();
+   for (r=0;r<NB_RUNS;r++)
+      ref_xcorr(x, y, xcorr, len, max_pitch);
+   *t_ref += clock()-t0;
+   t0 = clock();
+   for (r=0;r<NB_RUNS;r++)
+      celt_pitch_xcorr(x, y, xcorr2, len, max_pitch);
+   *t_new += clock()-t0;
+}
+
+static void test_autocorr(int lag, int n)
+{
+   static celt_word16 x[MAX_LEN];
+   celt_word32 ac[MAX_LAGS], ac2[MAX_LAGS];
+   random_signal(x, n);
+   ref_autocorr(x, ac, lag, n);
+   _celt_autocorr(x, ac2, NULL, 0, lag, n);
+   if (memcmp(ac, ac2, (lag+1)*sizeof(celt_word32)) != 0)
+   {
+      fprintf(stderr, "** _celt_autocorr() mismatch for lag=%d, n=%d **\n", lag, n);
+      ret = 1;
+   }
+}
+
+int main(void)
+{
+   /* The coarse and fine pitch search sizes for 2.5 to 20 ms frames, and
+      a few odd ones */
+   static const int lens[] = {30, 60, 120, 240, 480, 7, 33, 1};
+   static const int lags[] = {252, 504, 250, 1, 3, 5, 17};
+   static const int ac_lags[] = {4, 24, 0, 1, 3};
+   static const int ac_lens[] = {1024, 480, 240, 60, 29};
+   int i, j;
+   clock_t t_ref=0, t_new=0;
+   ALLOC_STACK;
+
+   srand(42);
+   for (i=0;i<(int)(sizeof(lens)/sizeof(lens[0]));i++)
+      for (j=0;j<(int)(sizeof(lags)/sizeof(lags[0]));j++)
+         test_xcorr(lens[i], lags[j], &t_ref, &t_new);
+   for (i=0;i<(int)(sizeof(ac_lags)/sizeof(ac_lags[0]));i++)
+      for (j=0;j<(int)(sizeof(ac_lens)/sizeof(ac_lens[0]));j++)
+         test_autocorr(ac_lags[i], ac_lens[j]);
+   printf("%.2f ms reference, %.2f ms celt_pitch_xcorr()\n",
+         1e3*t_ref/CLOCKS_PER_SEC, 1e3*t_new/CLOCKS_PER_SEC);
+   return ret;
+}
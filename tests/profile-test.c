@@ -0,0 +1,165 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   This test checks CELT_GET_PROFILE and CELT_RESET_PROFILE on an encoder
+   and a decoder. Without --enable-profiling both requests must say they
+   are not implemented.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_FRAMES 50
+#define FRAME_SIZE 960
+#define CHANNELS 2
+
+static int ret = 0;
+
+#ifdef ENABLE_PROFILING
+static const char *stage_names[CELT_PROFILE_STAGES] = {
+   "pre/de-emphasis", "pitch/prefilter", "transient", "MDCT", "tf",
+   "energy", "allocation", "bands", "other"
+};
+
+/* Checks a profile after NB_FRAMES frames and prints it */
+static void check_profile(const char *name, int err, const CELTProfile *p)
+{
+   int i;
+   double total = 0;
+   if (err != CELT_OK)
+   {
+      fprintf(stderr, "** %s: CELT_GET_PROFILE returned %s **\n", name, celt_strerror(err));
+      ret = 1;
+      return;
+   }
+   if (p->frames != NB_FRAMES)
+   {
+      fprintf(stderr, "** %s: %d frames counted instead of %d **\n", name, p->frames, NB_FRAMES);
+      ret = 1;
+   }
+   for (i=0;i<CELT_PROFILE_STAGES;i++)
+   {
+      if (p->ns[i] < 0)
+      {
+         fprintf(stderr, "** %s: negative time for %s **\n", name, stage_names[i]);
+         ret = 1;
+      }
+      total += p->ns[i];
+   }
+   if (total <= 0)
+   {
+      fprintf(stderr, "** %s: no time was measured **\n", name);
+      ret = 1;
+   }
+   printf("%s, %.1f us per frame:", name, total/1000/NB_FRAMES);
+   for (i=0;i<CELT_PROFILE_STAGES;i++)
+      printf(" %s %.1f%%", stage_names[i], 100*p->ns[i]/total);
+   printf("\n");
+}
+#endif
+
+int main(void)
+{
+   int err;
+   CELTMode *mode;
+   CELTEncoder *enc;
+   CELTDecoder *dec;
+   CELTProfile profile;
+#ifdef ENABLE_PROFILING
+   int f, i;
+   celt_int16 pcm[FRAME_SIZE*CHANNELS];
+   unsigned char data[1275];
+#endif
+
+   mode = celt_mode_create(48000, FRAME_SIZE, &err);
+   enc = celt_encoder_create_custom(mode, CHANNELS, &err);
+   dec = celt_decoder_create_custom(mode, CHANNELS, &err);
+   if (enc == NULL || dec == NULL)
+   {
+      fprintf(stderr, "Error: failed to create an encoder and a decoder\n");
+      return 1;
+   }
+
+#ifdef ENABLE_PROFILING
+   celt_encoder_ctl(enc, CELT_SET_COMPLEXITY(10));
+
+   srand(42);
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      int len;
+      for (i=0;i<FRAME_SIZE*CHANNELS;i++)
+         pcm[i] = (rand()%8001) - 4000;
+      len = celt_encode(enc, pcm, FRAME_SIZE, data, 160);
+      if (len < 0 || celt_decode(dec, data, len, pcm, FRAME_SIZE) < 0)
+      {
+         fprintf(stderr, "Error: encoding or decoding failed\n");
+         return 1;
+      }
+   }
+
+   memset(&profile, 0, sizeof(profile));
+   err = celt_encoder_ctl(enc, CELT_GET_PROFILE(&profile));
+   check_profile("encoder", err, &profile);
+   memset(&profile, 0, sizeof(profile));
+   err = celt_decoder_ctl(dec, CELT_GET_PROFILE(&profile));
+   check_profile("decoder", err, &profile);
+
+   /* After a reset, the counters start from zero again */
+   err = celt_encoder_ctl(enc, CELT_RESET_PROFILE);
+   if (err == CELT_OK)
+      err = celt_decoder_ctl(dec, CELT_RESET_PROFILE);
+   if (err == CELT_OK)
+      err = celt_encoder_ctl(enc, CELT_GET_PROFILE(&profile));
+   if (err != CELT_OK || profile.frames != 0 || profile.ns[CELT_PROFILE_BANDS] != 0)
+   {
+      fprintf(stderr, "** CELT_RESET_PROFILE did not clear the counters **\n");
+      ret = 1;
+   }
+#else
+   /* Without --enable-profiling, every request must say so */
+   if (celt_encoder_ctl(enc, CELT_GET_PROFILE(&profile)) != CELT_UNIMPLEMENTED
+         || celt_decoder_ctl(dec, CELT_GET_PROFILE(&profile)) != CELT_UNIMPLEMENTED
+         || celt_encoder_ctl(enc, CELT_RESET_PROFILE) != CELT_UNIMPLEMENTED
+         || celt_decoder_ctl(dec, CELT_RESET_PROFILE) != CELT_UNIMPLEMENTED)
+   {
+      fprintf(stderr, "** the profile requests were accepted without profiling **\n");
+      ret = 1;
+   } else {
+      printf("Built without profiling, test skipped\n");
+      ret = 77;
+   }
+#endif
+
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec);
+   celt_mode_destroy(mode);
+   return ret;
+}
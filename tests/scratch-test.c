@@ -0,0 +1,265 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   This test checks celt_encode_scratch() and celt_decode_scratch(): with
+   a caller-supplied scratch buffer of celt_*_get_scratch_size() bytes,
+   they must give exactly the same packets and output as celt_encode() and
+   celt_decode(), reject smaller buffers, and run on a 16 kB stack. Also
+   checks that the most the codec uses of these buffers, at the largest
+   frame size and with everything that allocates turned on, stays within
+   them. Without --enable-scratch-arena, they must say they are not
+   implemented.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ENABLE_SCRATCH_ARENA) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#include <limits.h>
+#define SMALL_STACK 16384
+#endif
+
+#define NB_FRAMES 100
+#define FRAME_SIZE 480
+#define CHANNELS 2
+#define MAX_PACKET 1275
+#define GUARD 4096
+#define FILL 0xa5
+
+static int ret = 0;
+
+#ifdef ENABLE_SCRATCH_ARENA
+/* Codes the same signal with and without scratch buffers, and checks that
+   the packets and output are the same */
+static void *compare_streams(void *arg)
+{
+   const CELTMode *mode = (const CELTMode*)arg;
+   int f, i, err;
+   int enc_size, dec_size;
+   int len, len_s, out_len, out_len_s;
+   CELTEncoder *enc, *enc_s;
+   CELTDecoder *dec, *dec_s;
+   char *enc_scratch, *dec_scratch;
+   unsigned char packet[MAX_PACKET], packet_s[MAX_PACKET];
+   static celt_int16 pcm[FRAME_SIZE*CHANNELS], out[FRAME_SIZE*CHANNELS], out_s[FRAME_SIZE*CHANNELS];
+
+   enc = celt_encoder_create_custom(mode, CHANNELS, &err);
+   enc_s = celt_encoder_create_custom(mode, CHANNELS, &err);
+   dec = celt_decoder_create_custom(mode, CHANNELS, &err);
+   dec_s = celt_decoder_create_custom(mode, CHANNELS, &err);
+   enc_size = celt_encoder_get_scratch_size(mode, CHANNELS);
+   dec_size = celt_decoder_get_scratch_size(mode, CHANNELS);
+   enc_scratch = malloc(enc_size+8);
+   dec_scratch = malloc(dec_size);
+   celt_encoder_ctl(enc, CELT_SET_VBR(1));
+   celt_encoder_ctl(enc_s, CELT_SET_VBR(1));
+   celt_encoder_ctl(enc, CELT_SET_BITRATE(128000));
+   celt_encoder_ctl(enc_s, CELT_SET_BITRATE(128000));
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      for (i=0;i<FRAME_SIZE*CHANNELS;i++)
+         pcm[i] = (rand()%8192) - 4096 + 6000*((i/(50+f%7))&1);
+
+      len = celt_encode(enc, pcm, FRAME_SIZE, packet, MAX_PACKET);
+      /* The scratch buffer does not need to be aligned */
+      len_s = celt_encode_scratch(enc_s, pcm, FRAME_SIZE, packet_s, MAX_PACKET, enc_scratch+(f&7), enc_size);
+      if (len <= 0 || len_s != len || memcmp(packet, packet_s, len) != 0)
+      {
+         fprintf(stderr, "** frame %d: packets differ (%d and %d bytes) **\n", f, len, len_s);
+         ret = 1;
+         break;
+      }
+
+      /* Lose a packet now and then, since concealment uses the most memory */
+      out_len = celt_decode(dec, f%11==3 ? NULL : packet, len, out, FRAME_SIZE);
+      out_len_s = celt_decode_scratch(dec_s, f%11==3 ? NULL : packet, len, out_s, FRAME_SIZE, dec_scratch, dec_size);
+      if (out_len != (f%11==3 ? CELT_OK : FRAME_SIZE) || out_len_s != out_len || memcmp(out, out_s, sizeof(out)) != 0)
+      {
+         fprintf(stderr, "** frame %d: decoded output differs **\n", f);
+         ret = 1;
+         break;
+      }
+   }
+   if (celt_decode_scratch(dec_s, packet, len, out_s, FRAME_SIZE, dec_scratch, dec_size-1) != CELT_BAD_ARG
+         || celt_encode_scratch(enc_s, pcm, FRAME_SIZE, packet_s, MAX_PACKET, NULL, enc_size) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** a missing or small scratch buffer was accepted **\n");
+      ret = 1;
+   }
+
+   free(enc_scratch);
+   free(dec_scratch);
+   celt_encoder_destroy(enc);
+   celt_encoder_destroy(enc_s);
+   celt_decoder_destroy(dec);
+   celt_decoder_destroy(dec_s);
+   return NULL;
+}
+
+/* Bytes of a buffer filled with FILL that were written */
+static int used(const unsigned char *buf, int size)
+{
+   while (size>0 && buf[size-1]==FILL)
+      size--;
+   return size;
+}
+
+/* Codes 20 ms stereo frames at complexity 10 with the VBR look-ahead,
+   transients and runs of lost packets, on buffers of the advertised sizes
+   followed by a guard, and checks that nothing was written to the guard */
+static void high_water(const CELTMode *mode)
+{
+   int f, i, err, len;
+   int enc_size, dec_size, enc_used, dec_used;
+   int frame_size = 960;
+   CELTEncoder *enc;
+   CELTDecoder *dec;
+   unsigned char *enc_scratch, *dec_scratch;
+   unsigned char packet[MAX_PACKET];
+   static celt_int16 pcm[(1+CELT_MAX_VBR_LOOKAHEAD)*960*CHANNELS], out[960*CHANNELS];
+
+   enc = celt_encoder_create_custom(mode, CHANNELS, &err);
+   dec = celt_decoder_create_custom(mode, CHANNELS, &err);
+   enc_size = celt_encoder_get_scratch_size(mode, CHANNELS);
+   dec_size = celt_decoder_get_scratch_size(mode, CHANNELS);
+   enc_scratch = malloc(enc_size+GUARD);
+   dec_scratch = malloc(dec_size+GUARD);
+   memset(enc_scratch, FILL, enc_size+GUARD);
+   memset(dec_scratch, FILL, dec_size+GUARD);
+   celt_encoder_ctl(enc, CELT_SET_COMPLEXITY(10));
+   celt_encoder_ctl(enc, CELT_SET_VBR(1));
+   celt_encoder_ctl(enc, CELT_SET_BITRATE(256000));
+   celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(CELT_MAX_VBR_LOOKAHEAD));
+
+   for (i=0;i<(int)(sizeof(pcm)/sizeof(pcm[0]));i++)
+      pcm[i] = (rand()%8192) - 4096;
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      /* The look-ahead moves by a frame, the new one has a click every
+         other frame */
+      memmove(pcm, pcm+frame_size*CHANNELS, CELT_MAX_VBR_LOOKAHEAD*frame_size*CHANNELS*sizeof(pcm[0]));
+      for (i=CELT_MAX_VBR_LOOKAHEAD*frame_size*CHANNELS;i<(1+CELT_MAX_VBR_LOOKAHEAD)*frame_size*CHANNELS;i++)
+         pcm[i] = (rand()%8192) - 4096 + 6000*((i/(50+f%7))&1)
+               + ((f&1) && i%(frame_size*CHANNELS) < 40 ? 20000 : 0);
+      len = celt_encode_scratch(enc, pcm, frame_size, packet, MAX_PACKET, enc_scratch, enc_size);
+      /* Runs of 6 lost packets go from the pitch-based concealment to the
+         noise */
+      if (len <= 0 || celt_decode_scratch(dec, f%20 >= 14 ? NULL : packet, len, out, frame_size, dec_scratch, dec_size) < 0)
+      {
+         fprintf(stderr, "** frame %d: coding on the scratch buffers failed **\n", f);
+         ret = 1;
+         break;
+      }
+   }
+
+   enc_used = used(enc_scratch, enc_size+GUARD);
+   dec_used = used(dec_scratch, dec_size+GUARD);
+   printf("most used of the scratch buffers: %d of %d bytes to encode, %d of %d bytes to decode\n",
+         enc_used, enc_size, dec_used, dec_size);
+   if (enc_used > enc_size || dec_used > dec_size)
+   {
+      fprintf(stderr, "** the codec used more than the scratch size **\n");
+      ret = 1;
+   }
+
+   free(enc_scratch);
+   free(dec_scratch);
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec);
+}
+#endif
+
+int main(void)
+{
+   int err;
+   CELTMode *mode;
+   mode = celt_mode_create(48000, 960, &err);
+   if (mode == NULL)
+   {
+      fprintf(stderr, "Error: failed to create a mode: %s\n", celt_strerror(err));
+      return 1;
+   }
+   if (celt_encoder_get_scratch_size(mode, 1) <= 0
+         || celt_encoder_get_scratch_size(mode, 2) <= celt_encoder_get_scratch_size(mode, 1)
+         || celt_decoder_get_scratch_size(mode, 2) <= celt_decoder_get_scratch_size(mode, 1))
+   {
+      fprintf(stderr, "** unexpected scratch sizes **\n");
+      ret = 1;
+   }
+   printf("scratch sizes for 48 kHz stereo: %d bytes to encode, %d bytes to decode\n",
+         celt_encoder_get_scratch_size(mode, 2), celt_decoder_get_scratch_size(mode, 2));
+
+#ifdef ENABLE_SCRATCH_ARENA
+   compare_streams(mode);
+   high_water(mode);
+#ifdef HAVE_PTHREAD
+   {
+      /* Same again on a thread with a small stack */
+      pthread_t thread;
+      pthread_attr_t attr;
+      size_t stack = SMALL_STACK < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : SMALL_STACK;
+      pthread_attr_init(&attr);
+      if (pthread_attr_setstacksize(&attr, stack) != 0
+            || pthread_create(&thread, &attr, compare_streams, mode) != 0)
+      {
+         fprintf(stderr, "Error: could not create a thread with a %d-byte stack\n", (int)stack);
+         return 1;
+      }
+      pthread_join(thread, NULL);
+      pthread_attr_destroy(&attr);
+      printf("encoded and decoded on a %d-byte stack\n", (int)stack);
+   }
+#endif
+#else
+   {
+      CELTEncoder *enc = celt_encoder_create_custom(mode, 1, &err);
+      CELTDecoder *dec = celt_decoder_create_custom(mode, 1, &err);
+      celt_int16 pcm[FRAME_SIZE] = {0};
+      unsigned char packet[MAX_PACKET];
+      char scratch[16];
+      if (celt_encode_scratch(enc, pcm, FRAME_SIZE, packet, 100, scratch, sizeof(scratch)) != CELT_UNIMPLEMENTED
+            || celt_decode_scratch(dec, NULL, 0, pcm, FRAME_SIZE, scratch, sizeof(scratch)) != CELT_UNIMPLEMENTED)
+      {
+         fprintf(stderr, "** scratch buffers accepted without --enable-scratch-arena **\n");
+         ret = 1;
+      } else if (ret == 0) {
+         printf("Built without the scratch arena, test skipped\n");
+         ret = 77;
+      }
+      celt_encoder_destroy(enc);
+      celt_decoder_destroy(dec);
+   }
+#endif
+   celt_mode_destroy(mode);
+   return ret;
+}
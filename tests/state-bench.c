@@ -0,0 +1,305 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Benchmark for many encoders and decoders running side by side.
+
+   Creates a few thousand encoder and decoder states, far more than fit in
+   the caches, and codes one frame on each of them in turn, the way a
+   server handling many streams would. It reports the time per frame and,
+   where the hardware counters can be read (Linux perf events), the cache
+   misses per frame. The layout of the states is chosen when building, so
+   to see what --enable-aligned-state changes, run this from a build with
+   and without it and compare. Run with --help for the options.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define MAX_FRAME 960
+#define MAX_PACKET 1275
+
+static double now_us(void)
+{
+#if defined(WIN32) || defined(_WIN32)
+   LARGE_INTEGER t, f;
+   QueryPerformanceCounter(&t);
+   QueryPerformanceFrequency(&f);
+   return t.QuadPart*1e6/f.QuadPart;
+#else
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec*1e6 + t.tv_nsec*1e-3;
+#endif
+}
+
+/* Cache miss counters, or -1 where they can't be read */
+enum { LLC_MISSES, L1D_MISSES, NB_COUNTERS };
+static const char *counter_names[NB_COUNTERS] = { "LLC misses", "L1D misses" };
+#ifdef HAVE_LINUX_PERF_EVENT_H
+static int counters[NB_COUNTERS] = { -1, -1 };
+#endif
+
+static void open_counters(void)
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+   int i;
+   struct perf_event_attr attr;
+   for (i=0;i<NB_COUNTERS;i++)
+   {
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      if (i == LLC_MISSES)
+      {
+         attr.type = PERF_TYPE_HARDWARE;
+         attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      } else {
+         attr.type = PERF_TYPE_HW_CACHE;
+         attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ<<8)
+               | (PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+      }
+      counters[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+   }
+#endif
+}
+
+static void start_counters(void)
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+   int i;
+   for (i=0;i<NB_COUNTERS;i++)
+   {
+      if (counters[i] < 0)
+         continue;
+      ioctl(counters[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters[i], PERF_EVENT_IOC_ENABLE, 0);
+   }
+#endif
+}
+
+/* Stops the counters and returns their values, -1 for the missing ones */
+static void stop_counters(double *values)
+{
+   int i;
+   for (i=0;i<NB_COUNTERS;i++)
+   {
+      values[i] = -1;
+#ifdef HAVE_LINUX_PERF_EVENT_H
+      if (counters[i] >= 0)
+      {
+         long long count;
+         ioctl(counters[i], PERF_EVENT_IOC_DISABLE, 0);
+         if (read(counters[i], &count, sizeof(count)) == sizeof(count))
+            values[i] = count;
+      }
+#endif
+   }
+}
+
+static void print_result(const char *what, double us, double *misses, int frames)
+{
+   int i;
+   printf("%-8s %9.2f us/frame", what, us/frames);
+   for (i=0;i<NB_COUNTERS;i++)
+   {
+      if (misses[i] >= 0)
+         printf("  %9.1f %s/frame", misses[i]/frames, counter_names[i]);
+      else
+         printf("  %9s %s/frame", "n/a", counter_names[i]);
+   }
+   printf("\n");
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage: state-bench [options]\n"
+         "  --instances n     number of encoders and of decoders (default 2000)\n"
+         "  --rounds n        frames coded by each of them (default 20)\n"
+         "  --frame-size n    120, 240, 480 or 960 (default 120)\n"
+         "  --channels n      1 or 2 (default 2)\n"
+         "  --complexity n    0-10 (default 5)\n");
+}
+
+int main(int argc, char **argv)
+{
+   int i, s, r, err;
+   int instances = 2000, rounds = 20, frame_size = 120, channels = 2, complexity = 5;
+   int enc_size, dec_size, aligned;
+   int bytes;
+   double t, enc_us = 0, dec_us = 0;
+   double enc_misses[NB_COUNTERS], dec_misses[NB_COUNTERS], values[NB_COUNTERS];
+   CELTMode *mode;
+   CELTEncoder **enc;
+   CELTDecoder **dec;
+   unsigned char *packets;
+   int *lengths;
+   celt_int16 pcm[MAX_FRAME*2], out[MAX_FRAME*2];
+
+   for (i=1;i<argc;i++)
+   {
+      const char *arg = argv[i];
+      const char *val = i+1<argc ? argv[i+1] : NULL;
+      if (val == NULL)
+      {
+         usage();
+         return strcmp(arg, "--help")==0 ? 0 : 1;
+      }
+      i++;
+      if (strcmp(arg, "--instances")==0)
+         instances = atoi(val);
+      else if (strcmp(arg, "--rounds")==0)
+         rounds = atoi(val);
+      else if (strcmp(arg, "--frame-size")==0)
+         frame_size = atoi(val);
+      else if (strcmp(arg, "--channels")==0)
+         channels = atoi(val);
+      else if (strcmp(arg, "--complexity")==0)
+         complexity = atoi(val);
+      else {
+         usage();
+         return 1;
+      }
+   }
+   if (instances < 1 || rounds < 1 || frame_size < 1 || frame_size > MAX_FRAME
+         || channels < 1 || channels > 2)
+   {
+      usage();
+      return 1;
+   }
+
+   mode = celt_mode_create(48000, MAX_FRAME, &err);
+   if (mode == NULL)
+   {
+      fprintf(stderr, "Error: failed to create a mode: %s\n", celt_strerror(err));
+      return 1;
+   }
+   bytes = 64000*channels*frame_size/(8*48000);
+   enc = malloc(instances*sizeof(*enc));
+   dec = malloc(instances*sizeof(*dec));
+   packets = malloc(instances*MAX_PACKET);
+   lengths = malloc(instances*sizeof(int));
+   aligned = 0;
+   for (s=0;s<instances;s++)
+   {
+      enc[s] = celt_encoder_create_custom(mode, channels, &err);
+      dec[s] = celt_decoder_create_custom(mode, channels, &err);
+      if (enc[s] == NULL || dec[s] == NULL)
+      {
+         fprintf(stderr, "Error: could not create instance %d: %s\n", s, celt_strerror(err));
+         return 1;
+      }
+      celt_encoder_ctl(enc[s], CELT_SET_COMPLEXITY(complexity));
+      aligned += ((size_t)enc[s]&63)==0 && ((size_t)dec[s]&63)==0;
+   }
+   enc_size = celt_encoder_get_size_custom(mode, channels);
+   dec_size = celt_decoder_get_size_custom(mode, channels);
+   printf("%d encoders of %d bytes and %d decoders of %d bytes (%.1f MB), "
+         "%d of each on a 64-byte boundary\n", instances, enc_size, instances, dec_size,
+         (double)instances*(enc_size+dec_size)/(1<<20), aligned);
+
+   for (i=0;i<frame_size*channels;i++)
+      pcm[i] = (celt_int16)((rand()%8192) - 4096 + 3000*((i/37)&1));
+
+   open_counters();
+   memset(enc_misses, 0, sizeof(enc_misses));
+   memset(dec_misses, 0, sizeof(dec_misses));
+   /* The first round only brings the code and the tables into the caches */
+   for (r=-1;r<rounds;r++)
+   {
+      start_counters();
+      t = now_us();
+      for (s=0;s<instances;s++)
+      {
+         lengths[s] = celt_encode(enc[s], pcm, frame_size, packets+s*MAX_PACKET, bytes);
+         if (lengths[s] < 0)
+         {
+            fprintf(stderr, "Error: celt_encode returned %s\n", celt_strerror(lengths[s]));
+            return 1;
+         }
+      }
+      t = now_us() - t;
+      stop_counters(values);
+      if (r >= 0)
+      {
+         enc_us += t;
+         for (i=0;i<NB_COUNTERS;i++)
+            enc_misses[i] = values[i] < 0 ? -1 : enc_misses[i]+values[i];
+      }
+
+      start_counters();
+      t = now_us();
+      for (s=0;s<instances;s++)
+      {
+         if (celt_decode(dec[s], packets+s*MAX_PACKET, lengths[s], out, frame_size) < 0)
+         {
+            fprintf(stderr, "Error: celt_decode failed\n");
+            return 1;
+         }
+      }
+      t = now_us() - t;
+      stop_counters(values);
+      if (r >= 0)
+      {
+         dec_us += t;
+         for (i=0;i<NB_COUNTERS;i++)
+            dec_misses[i] = values[i] < 0 ? -1 : dec_misses[i]+values[i];
+      }
+   }
+   print_result("encode", enc_us, enc_misses, instances*rounds);
+   print_result("decode", dec_us, dec_misses, instances*rounds);
+
+   for (s=0;s<instances;s++)
+   {
+      celt_encoder_destroy(enc[s]);
+      celt_decoder_destroy(dec[s]);
+   }
+   free(enc);
+   free(dec);
+   free(packets);
+   free(lengths);
+   celt_mode_destroy(mode);
+   return 0;
+}
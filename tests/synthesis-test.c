@@ -0,0 +1,217 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Decodes the same streams at 24, 16 and 8 kHz with the 48 kHz synthesis
+   followed by the decimation, and with CELT_SET_SYNTHESIS_MODE, which
+   synthesises directly at the output rate. Both must give nearly the same
+   audio, with or without lost packets. Also checks the arguments the
+   request must refuse and that going back to the 48 kHz synthesis gives
+   the same output as a new decoder.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define NB_FRAMES 200
+#define MAX_PACKET 1275
+
+#ifdef CUSTOM_MODES
+
+static int ret = 0;
+
+/* Lost packets: a few single ones, and a burst long enough for the
+   concealment to switch to noise */
+static int lost(int f)
+{
+   return f%23==7 || (f>=120 && f<128);
+}
+
+static void test_rate(int rate, int channels, int bytes)
+{
+   int f, i, err;
+   int frame_size = 960*rate/48000;
+   int total = NB_FRAMES*frame_size*channels;
+   CELTEncoder *enc;
+   CELTDecoder *dec, *direct;
+   CELTMode *mode;
+   celt_int16 *pcm, *out, *out2;
+   unsigned char data[MAX_PACKET];
+   double e1=0, e2=0, err2=0, snr, gain;
+   clock_t t_dec=0, t_direct=0, t0;
+   double y[2] = {0, 0};
+
+   enc = celt_encoder_create(rate, channels, &err);
+   dec = celt_decoder_create(rate, channels, &err);
+   direct = celt_decoder_create(rate, channels, &err);
+   mode = celt_mode_create(rate, frame_size, &err);
+   if (enc==NULL || dec==NULL || direct==NULL || mode==NULL)
+   {
+      fprintf(stderr, "cannot create the %d Hz encoder, decoders or mode\n", rate);
+      exit(1);
+   }
+   err = celt_decoder_ctl(direct, CELT_SET_SYNTHESIS_MODE(mode));
+   if (err != CELT_OK)
+   {
+      fprintf(stderr, "** CELT_SET_SYNTHESIS_MODE at %d Hz returned %s **\n", rate, celt_strerror(err));
+      ret = 1;
+      return;
+   }
+
+   pcm = (celt_int16*)malloc(sizeof(celt_int16)*total);
+   out = (celt_int16*)malloc(sizeof(celt_int16)*total);
+   out2 = (celt_int16*)malloc(sizeof(celt_int16)*total);
+   /* Low-passed noise and a tone in each channel */
+   for (i=0;i<total;i++)
+   {
+      int c = i%channels;
+      y[c] = .9*y[c] + (rand()%2000 - 1000);
+      pcm[i] = (celt_int16)(2*y[c] + 3000*sin(2*M_PI*(220+110*c)*(i/channels)/rate));
+   }
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      int offset = f*frame_size*channels;
+      int len = celt_encode(enc, pcm+offset, frame_size, data, bytes);
+      const unsigned char *packet = lost(f) ? NULL : data;
+      t0 = clock();
+      celt_decode(dec, packet, len, out+offset, frame_size);
+      t_dec += clock()-t0;
+      t0 = clock();
+      err = celt_decode(direct, packet, len, out2+offset, frame_size);
+      t_direct += clock()-t0;
+      if (err != (packet==NULL ? CELT_OK : frame_size))
+      {
+         fprintf(stderr, "** celt_decode at %d Hz returned %d **\n", rate, err);
+         ret = 1;
+      }
+   }
+
+   /* The two only differ by a fraction of a sample in time and a fraction
+      of a dB in level, so they can be compared directly */
+   for (i=10*frame_size*channels;i<total;i++)
+   {
+      double a = out[i], b = out2[i];
+      e1 += a*a;
+      e2 += b*b;
+      err2 += (a-b)*(a-b);
+   }
+   snr = 10*log10(e1/(err2+1));
+   gain = 10*log10((e2+1)/(e1+1));
+   printf("%5d Hz %dch: %.1f dB SNR, %+.2f dB, %.1f us per frame decimated, %.1f us direct\n",
+         rate, channels, snr, gain, 1e6*t_dec/CLOCKS_PER_SEC/NB_FRAMES,
+         1e6*t_direct/CLOCKS_PER_SEC/NB_FRAMES);
+   if (snr < 6 || gain < -1 || gain > 1)
+   {
+      fprintf(stderr, "** direct synthesis at %d Hz too far from the decimated one **\n", rate);
+      ret = 1;
+   }
+
+   /* Back to the 48 kHz synthesis, which resets the decoder */
+   celt_encoder_ctl(enc, CELT_RESET_STATE);
+   celt_decoder_ctl(dec, CELT_RESET_STATE);
+   err = celt_decoder_ctl(direct, CELT_SET_SYNTHESIS_MODE(NULL));
+   for (f=0;f<20 && err==CELT_OK;f++)
+   {
+      int offset = f*frame_size*channels;
+      int len = celt_encode(enc, pcm+offset, frame_size, data, bytes);
+      celt_decode(dec, data, len, out, frame_size);
+      celt_decode(direct, data, len, out2, frame_size);
+      if (memcmp(out, out2, sizeof(celt_int16)*frame_size*channels) != 0)
+         err = CELT_INTERNAL_ERROR;
+   }
+   if (err != CELT_OK)
+   {
+      fprintf(stderr, "** no longer the 48 kHz synthesis at %d Hz after CELT_SET_SYNTHESIS_MODE(NULL) **\n", rate);
+      ret = 1;
+   }
+
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec);
+   celt_decoder_destroy(direct);
+   celt_mode_destroy(mode);
+   free(pcm);
+   free(out);
+   free(out2);
+}
+
+/* Modes that don't match the decoder must be refused */
+static void test_bad_mode(int rate, int mode_rate, int mode_frame_size)
+{
+   int err;
+   CELTDecoder *dec = celt_decoder_create(rate, 1, &err);
+   CELTMode *mode = celt_mode_create(mode_rate, mode_frame_size, &err);
+   if (dec==NULL || mode==NULL)
+   {
+      fprintf(stderr, "cannot create the decoder or the %d Hz mode\n", mode_rate);
+      exit(1);
+   }
+   err = celt_decoder_ctl(dec, CELT_SET_SYNTHESIS_MODE(mode));
+   if (err != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** CELT_SET_SYNTHESIS_MODE accepted a %d Hz, %d sample mode for a %d Hz decoder **\n",
+            mode_rate, mode_frame_size, rate);
+      ret = 1;
+   }
+   celt_decoder_destroy(dec);
+   celt_mode_destroy(mode);
+}
+
+int main(void)
+{
+   srand(42);
+   test_rate(24000, 1, 60);
+   test_rate(24000, 2, 100);
+   test_rate(16000, 1, 50);
+   test_rate(16000, 2, 80);
+   test_rate(8000, 1, 40);
+   test_rate(8000, 2, 60);
+
+   /* Not a 48 kHz mode divided by the factor */
+   test_bad_mode(16000, 16000, 160);
+   test_bad_mode(16000, 8000, 160);
+   /* No rate to synthesise at */
+   test_bad_mode(48000, 48000, 960);
+   /* The overlap of the 12 kHz mode isn't a quarter of the 48 kHz one */
+   test_bad_mode(12000, 12000, 240);
+   return ret;
+}
+
+#else /* CUSTOM_MODES */
+
+int main(void)
+{
+   printf("Built without custom modes, test skipped\n");
+   return 77;
+}
+
+#endif /* CUSTOM_MODES */
@@ -0,0 +1,226 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Stress test for using encoders and decoders from several threads at the
+   same time. Each thread codes its own stream, with a mix of modes, frame
+   sizes, channel counts and rates, and the packets and decoded output must
+   be identical to what the same stream gives when coded alone. With
+   --enable-scratch-arena and neither C99 variable-size arrays nor alloca,
+   this checks that the per-state arenas are really kept apart.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The shared pseudo-stack used without variable-size arrays or alloca is
+   only safe with threads when each state has its own arena */
+#if defined(HAVE_PTHREAD) && (defined(VAR_ARRAYS) || defined(USE_ALLOCA) || defined(ENABLE_SCRATCH_ARENA))
+
+#include <pthread.h>
+
+#define NB_THREADS 24
+#define NB_FRAMES 200
+#define MAX_PACKET 1275
+
+typedef struct {
+   int rate;                 /* Of the mode */
+   int mode_size;
+   int frame_size;
+   int channels;
+   int vbr;
+   int complexity;
+   CELTMode *mode;
+} StreamConfig;
+
+static const StreamConfig configs[] = {
+   {48000, 960, 960, 2, 1, 10, NULL},
+   {48000, 960, 120, 1, 0, 5, NULL},
+   {48000, 960, 480, 2, 0, 0, NULL},
+   {48000, 960, 240, 1, 1, 8, NULL},
+   {44100, 512, 512, 2, 1, 10, NULL},
+   {32000, 320, 160, 1, 0, 3, NULL},
+};
+#define NB_CONFIGS ((int)(sizeof(configs)/sizeof(configs[0])))
+
+typedef struct {
+   StreamConfig config;
+   int seed;
+   unsigned long checksum;
+   int error;
+} Stream;
+
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int started;
+
+static unsigned long hash(unsigned long h, const unsigned char *data, int len)
+{
+   int i;
+   for (i=0;i<len;i++)
+      h = h*31 + data[i];
+   return h;
+}
+
+/* Codes a whole stream and returns a checksum of its packets and output */
+static void code_stream(Stream *s)
+{
+   const StreamConfig *c = &s->config;
+   int f, i, err, len, bytes;
+   unsigned long h = 0;
+   unsigned int seed = s->seed;
+   celt_int16 pcm[960*2], out[960*2];
+   unsigned char packet[MAX_PACKET];
+   CELTEncoder *enc;
+   CELTDecoder *dec;
+
+   enc = celt_encoder_create_custom(c->mode, c->channels, &err);
+   dec = celt_decoder_create_custom(c->mode, c->channels, &err);
+   if (enc == NULL || dec == NULL)
+   {
+      s->error = 1;
+      return;
+   }
+   celt_encoder_ctl(enc, CELT_SET_COMPLEXITY(c->complexity));
+   bytes = 96000*c->channels*c->frame_size/(8*c->rate);
+   if (c->vbr)
+   {
+      celt_encoder_ctl(enc, CELT_SET_VBR(1));
+      celt_encoder_ctl(enc, CELT_SET_BITRATE(96000*c->channels));
+      bytes = MAX_PACKET;
+   }
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      for (i=0;i<c->frame_size*c->channels;i++)
+      {
+         seed = seed*1103515245 + 12345;
+         pcm[i] = (celt_int16)((seed>>16)%8192 - 4096 + 3000*((i/(37+f%5))&1));
+      }
+      len = celt_encode(enc, pcm, c->frame_size, packet, bytes);
+      if (len <= 0)
+      {
+         s->error = 1;
+         break;
+      }
+      h = hash(h, packet, len);
+      /* Lose a packet now and then to exercise the concealment */
+      if (celt_decode(dec, f%13==7 ? NULL : packet, len, out, c->frame_size) < 0)
+      {
+         s->error = 1;
+         break;
+      }
+      h = hash(h, (unsigned char*)out, c->frame_size*c->channels*sizeof(celt_int16));
+   }
+   celt_encoder_destroy(enc);
+   celt_decoder_destroy(dec);
+   s->checksum = h;
+}
+
+static void *stream_thread(void *arg)
+{
+   Stream *s = (Stream*)arg;
+   pthread_mutex_lock(&start_lock);
+   while (!started)
+      pthread_cond_wait(&start_cond, &start_lock);
+   pthread_mutex_unlock(&start_lock);
+   code_stream(s);
+   return NULL;
+}
+
+int main(void)
+{
+   int i, err, ret = 0;
+   StreamConfig config[NB_CONFIGS];
+   Stream ref[NB_CONFIGS];
+   Stream streams[NB_THREADS];
+   pthread_t threads[NB_THREADS];
+
+   for (i=0;i<NB_CONFIGS;i++)
+   {
+      config[i] = configs[i];
+      config[i].mode = celt_mode_create(config[i].rate, config[i].mode_size, &err);
+      if (config[i].mode == NULL)
+      {
+         /* Without custom modes, only use the 48 kHz streams */
+         config[i] = configs[0];
+         config[i].mode = celt_mode_create(config[i].rate, config[i].mode_size, &err);
+      }
+      memset(&ref[i], 0, sizeof(Stream));
+      ref[i].config = config[i];
+      ref[i].seed = i;
+      code_stream(&ref[i]);
+      if (ref[i].error)
+      {
+         fprintf(stderr, "Error: stream %d failed on its own\n", i);
+         return 1;
+      }
+   }
+
+   for (i=0;i<NB_THREADS;i++)
+   {
+      memset(&streams[i], 0, sizeof(Stream));
+      streams[i].config = config[i%NB_CONFIGS];
+      streams[i].seed = i%NB_CONFIGS;
+      if (pthread_create(&threads[i], NULL, stream_thread, &streams[i]) != 0)
+      {
+         fprintf(stderr, "Error: could not create thread %d\n", i);
+         return 1;
+      }
+   }
+   pthread_mutex_lock(&start_lock);
+   started = 1;
+   pthread_cond_broadcast(&start_cond);
+   pthread_mutex_unlock(&start_lock);
+
+   for (i=0;i<NB_THREADS;i++)
+   {
+      pthread_join(threads[i], NULL);
+      if (streams[i].error || streams[i].checksum != ref[i%NB_CONFIGS].checksum)
+      {
+         fprintf(stderr, "** thread %d (%d Hz, %d samples, %d channel(s)) differs from the same stream coded alone **\n",
+               i, streams[i].config.rate, streams[i].config.frame_size, streams[i].config.channels);
+         ret = 1;
+      }
+   }
+   printf("%d threads, %d streams of %d frames each\n", NB_THREADS, NB_CONFIGS, NB_FRAMES);
+   for (i=0;i<NB_CONFIGS;i++)
+      celt_mode_destroy(config[i].mode);
+   return ret;
+}
+
+#else
+
+int main(void)
+{
+   printf("No thread support or no thread-safe scratch memory, test skipped\n");
+   return 77;
+}
+
+#endif
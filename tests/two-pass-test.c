@@ -0,0 +1,231 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Checks the two calls a two-pass encoding is made of: what
+   celt_encoder_frame_stats() finds on tones, clicks, noise and silence
+   (the same through the 16-bit and the float API), and that with
+   CELT_SET_FRAME_TARGET the packets come out at the size asked for,
+   while a target of 0 leaves them as the VBR makes them.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define CHANNELS 2
+#define FRAME_SIZE 960
+#define SECTION 25
+#define NB_FRAMES (4*SECTION)
+#define BITRATE 96000
+#define MAX_PACKET 1275
+
+static int ret = 0;
+
+/* Sections of a tone, clicks every 100 ms, noise and silence */
+static void generate(celt_int16 *pcm)
+{
+   int i, c;
+   srand(1);
+   for (i=0;i<NB_FRAMES*FRAME_SIZE;i++)
+   {
+      int section = i/(SECTION*FRAME_SIZE);
+      for (c=0;c<CHANNELS;c++)
+      {
+         double x = 0;
+         if (section==0)
+            x = 5000*sin(.03*i+c);
+         else if (section==1)
+            x = i%4800 < 20 ? rand()%30000-15000 : 0;
+         else if (section==2)
+            x = rand()%16000-8000;
+         pcm[i*CHANNELS+c] = (celt_int16)x;
+      }
+   }
+}
+
+static CELTEncoder *encoder(void)
+{
+   int err;
+   CELTEncoder *enc = celt_encoder_create(48000, CHANNELS, &err);
+   if (enc==NULL)
+   {
+      fprintf(stderr, "cannot create the encoder: %s\n", celt_strerror(err));
+      exit(1);
+   }
+   celt_encoder_ctl(enc, CELT_SET_VBR(1));
+   celt_encoder_ctl(enc, CELT_SET_VBR_CONSTRAINT(0));
+   celt_encoder_ctl(enc, CELT_SET_BITRATE(BITRATE));
+   return enc;
+}
+
+static void test_stats(const celt_int16 *pcm)
+{
+   static float x[FRAME_SIZE*CHANNELS];
+   CELTEncoder *enc = encoder();
+   CELTEncoder *enc_float = encoder();
+   int f, i;
+   int transients[4] = {0, 0, 0, 0};
+   double demand[4] = {0, 0, 0, 0};
+
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      CELTFrameStats stats, stats_float;
+      const celt_int16 *in = pcm+f*FRAME_SIZE*CHANNELS;
+      for (i=0;i<FRAME_SIZE*CHANNELS;i++)
+         x[i] = in[i]*(1.f/32768);
+      if (celt_encoder_frame_stats(enc, in, FRAME_SIZE, &stats) != CELT_OK
+            || celt_encoder_frame_stats_float(enc_float, x, FRAME_SIZE, &stats_float) != CELT_OK)
+      {
+         fprintf(stderr, "** celt_encoder_frame_stats() failed **\n");
+         exit(1);
+      }
+      if (memcmp(&stats, &stats_float, sizeof(stats))!=0)
+      {
+         fprintf(stderr, "** frame %d: different stats through the float API **\n", f);
+         ret = 1;
+      }
+      /* The first frame of a section still overlaps the one before */
+      if (f%SECTION > 0)
+      {
+         transients[f/SECTION] += stats.transient;
+         demand[f/SECTION] += stats.demand/(double)(SECTION-1);
+      }
+      if (f/SECTION==3 && f%SECTION > 0 && stats.demand != 40*CHANNELS+20)
+      {
+         fprintf(stderr, "** frame %d: demand of %d on silence **\n", f, stats.demand);
+         ret = 1;
+      }
+   }
+   printf("demand of the tone %.0f, the clicks %.0f, the noise %.0f, the silence %.0f\n",
+         demand[0], demand[1], demand[2], demand[3]);
+   printf("transients in the tone %d, the clicks %d, the noise %d\n",
+         transients[0], transients[1], transients[2]);
+   if (transients[0] != 0 || transients[1] < 2 || demand[2] <= demand[0])
+   {
+      fprintf(stderr, "** the stats don't tell the sections apart **\n");
+      ret = 1;
+   }
+   if (celt_encoder_frame_stats(enc, pcm, FRAME_SIZE+1, NULL) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** celt_encoder_frame_stats() took a bad frame size **\n");
+      ret = 1;
+   }
+   celt_encoder_destroy(enc);
+   celt_encoder_destroy(enc_float);
+}
+
+static int silent(const celt_int16 *pcm)
+{
+   int i;
+   for (i=0;i<FRAME_SIZE*CHANNELS;i++)
+      if (pcm[i]!=0)
+         return 0;
+   return 1;
+}
+
+/* Target of frame f in bits, or 0 */
+static int target(int f, int planned)
+{
+   if (!planned)
+      return 0;
+   return 8*(60 + (f*37)%300);
+}
+
+static void encode(const celt_int16 *pcm, int set, int planned, unsigned char *packets, int *lens)
+{
+   int f;
+   CELTEncoder *enc = encoder();
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      if (set && celt_encoder_ctl(enc, CELT_SET_FRAME_TARGET(target(f, planned))) != CELT_OK)
+      {
+         fprintf(stderr, "** CELT_SET_FRAME_TARGET failed **\n");
+         exit(1);
+      }
+      lens[f] = celt_encode(enc, pcm+f*FRAME_SIZE*CHANNELS, FRAME_SIZE, packets+f*MAX_PACKET, MAX_PACKET);
+      if (lens[f]<0)
+      {
+         fprintf(stderr, "** celt_encode() failed: %s **\n", celt_strerror(lens[f]));
+         exit(1);
+      }
+   }
+   if (celt_encoder_ctl(enc, CELT_SET_FRAME_TARGET(-1)) != CELT_BAD_ARG)
+   {
+      fprintf(stderr, "** CELT_SET_FRAME_TARGET took a negative size **\n");
+      ret = 1;
+   }
+   celt_encoder_destroy(enc);
+}
+
+static void test_targets(const celt_int16 *pcm)
+{
+   static unsigned char packets[2][NB_FRAMES*MAX_PACKET];
+   static int lens[2][NB_FRAMES];
+   int f, missed=0, frames=0;
+
+   encode(pcm, 0, 0, packets[0], lens[0]);
+   encode(pcm, 1, 0, packets[1], lens[1]);
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      if (lens[0][f]!=lens[1][f] || memcmp(packets[0]+f*MAX_PACKET, packets[1]+f*MAX_PACKET, lens[0][f])!=0)
+      {
+         fprintf(stderr, "** frame %d: CELT_SET_FRAME_TARGET(0) changed the packet **\n", f);
+         ret = 1;
+         break;
+      }
+   }
+
+   /* Silent frames take as little as they can whatever the target */
+   encode(pcm, 1, 1, packets[1], lens[1]);
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      if (silent(pcm+f*FRAME_SIZE*CHANNELS))
+         continue;
+      frames++;
+      if (abs(lens[1][f]-target(f, 1)/8) > 1)
+         missed++;
+   }
+   printf("%d frames out of %d missed their target\n", missed, frames);
+   if (missed > 0)
+   {
+      fprintf(stderr, "** the packets don't come out at the size asked for **\n");
+      ret = 1;
+   }
+}
+
+int main(void)
+{
+   static celt_int16 pcm[NB_FRAMES*FRAME_SIZE*CHANNELS];
+   generate(pcm);
+   test_stats(pcm);
+   test_targets(pcm);
+   return ret;
+}
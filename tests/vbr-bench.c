@@ -0,0 +1,298 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   VBR look-ahead benchmark.
+
+   Encodes a program made of speech, music, transients, noise and silence
+   (or a raw input file) in VBR with every look-ahead length, constrained
+   and unconstrained, and reports how closely the rate follows the target:
+   the error of the average rate, how far the bytes sent so far stray from
+   what the target allows (what a sender's buffer has to absorb), and the
+   spread of the rate over one-second windows. The time per frame gives
+   the cost of the look-ahead analysis. Run with --help for the options.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.141592653
+#endif
+
+#define RATE 48000
+#define MAX_PACKET 1275
+
+static const int lookaheads[] = {0, 1, 2, 4, 8};
+
+static double now_us(void)
+{
+#if defined(WIN32) || defined(_WIN32)
+   LARGE_INTEGER t, f;
+   QueryPerformanceCounter(&t);
+   QueryPerformanceFrequency(&f);
+   return t.QuadPart*1e6/f.QuadPart;
+#else
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec*1e6 + t.tv_nsec*1e-3;
+#endif
+}
+
+static double frand(void)
+{
+   return (rand()%20001-10000)/10000.;
+}
+
+/* Fills len stereo samples with two-second sections of speech, music,
+   transients, noise and silence */
+static void generate_program(celt_int16 *pcm, int len)
+{
+   int i, c;
+   double phase = 0;
+   double y1[2] = {0, 0}, y2[2] = {0, 0};
+   srand(1);
+   for (i=0;i<len;i++)
+   {
+      double t = i/(double)RATE;
+      double x[2] = {0, 0};
+      double env;
+      switch ((int)(t/2)%5)
+      {
+      case 0:
+         /* Pulse train with a moving pitch through a resonance, with a
+            syllable-rate envelope and pauses */
+         phase += (100+40*sin(2*M_PI*.7*t))/RATE;
+         x[0] = phase >= 1 ? 1 : 0;
+         if (phase >= 1)
+            phase -= 1;
+         env = fmod(t, 1.5) < 1.1 ? .5+.5*sin(2*M_PI*4*t) : 0;
+         for (c=0;c<2;c++)
+         {
+            double r = .995, w = 2*M_PI*(700+300*sin(2*M_PI*.5*t+c))/RATE;
+            double y = x[0] + .02*frand() + 2*r*cos(w)*y1[c] - r*r*y2[c];
+            y2[c] = y1[c];
+            y1[c] = y;
+            x[c] = .01*env*y;
+         }
+         break;
+      case 1:
+         {
+            /* A chord with a few harmonics per note */
+            static const double ratios[3] = {1, 1.26, 1.5};
+            int n, h;
+            for (n=0;n<3;n++)
+               for (h=1;h<=5;h++)
+               {
+                  x[0] += .06/h*sin(2*M_PI*220*ratios[n]*h*t);
+                  x[1] += .06/h*sin(2*M_PI*220*ratios[n]*h*t+.3*n);
+               }
+            env = exp(-3*fmod(t, .5));
+            x[0] *= .3+.7*env;
+            x[1] *= .3+.7*env;
+         }
+         break;
+      case 2:
+         /* Decaying noise bursts every 150 ms over a quiet background */
+         env = exp(-fmod(t, .15)*200);
+         x[0] = .8*env*frand() + .003*frand();
+         x[1] = .8*env*frand() + .003*frand();
+         break;
+      case 3:
+         x[0] = .25*frand();
+         x[1] = .25*frand();
+         break;
+      default:
+         break;
+      }
+      for (c=0;c<2;c++)
+      {
+         double v = 32767*x[c];
+         pcm[2*i+c] = (celt_int16)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+      }
+   }
+}
+
+/* Encodes the whole signal with K frames of look-ahead and prints how the
+   rate followed the target */
+static int run(const celt_int16 *signal, int nb_frames, int frame_size, int channels,
+      int bitrate, int constrained, int K, double *t_ref)
+{
+   int f, i, err;
+   int window = RATE/frame_size;
+   double budget = bitrate*(double)frame_size/RATE/8;
+   double total = 0, drift = 0, drift_max = 0, drift2 = 0;
+   double sum = 0, win2 = 0, t = 0;
+   int nb_windows = 0;
+   unsigned char data[MAX_PACKET];
+   /* The current frame followed by the next K */
+   celt_int16 *pcm = malloc(sizeof(celt_int16)*channels*frame_size*(K+1));
+   CELTEncoder *enc = celt_encoder_create(RATE, channels, &err);
+
+   if (enc == NULL || pcm == NULL)
+      return 1;
+   celt_encoder_ctl(enc, CELT_SET_VBR(1));
+   celt_encoder_ctl(enc, CELT_SET_VBR_CONSTRAINT(constrained));
+   celt_encoder_ctl(enc, CELT_SET_BITRATE(bitrate));
+   if (celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(K)) != CELT_OK)
+   {
+      fprintf(stderr, "CELT_SET_VBR_LOOKAHEAD(%d) failed\n", K);
+      return 1;
+   }
+   for (f=0;f<nb_frames;f++)
+   {
+      int nb;
+      double t0;
+      /* Past the end, the look-ahead sees silence */
+      for (i=0;i<frame_size*(K+1);i++)
+      {
+         int n = f*frame_size+i;
+         pcm[channels*i] = n < nb_frames*frame_size ? signal[2*n] : 0;
+         if (channels == 2)
+            pcm[2*i+1] = n < nb_frames*frame_size ? signal[2*n+1] : 0;
+      }
+      t0 = now_us();
+      nb = celt_encode(enc, pcm, frame_size, data, MAX_PACKET);
+      t += now_us()-t0;
+      if (nb < 0)
+      {
+         fprintf(stderr, "celt_encode() failed: %s\n", celt_strerror(nb));
+         return 1;
+      }
+      total += nb;
+      drift += nb-budget;
+      drift2 += drift*drift;
+      if (fabs(drift) > drift_max)
+         drift_max = fabs(drift);
+      sum += nb;
+      if ((f+1)%window == 0)
+      {
+         double r = sum/(window*budget)-1;
+         win2 += r*r;
+         nb_windows++;
+         sum = 0;
+      }
+   }
+   if (K == 0)
+      *t_ref = t;
+   printf("%-13s %2d | %8.1f %+7.2f%% | %8.0f %8.0f | %7.1f%% | %7.1f %+6.1f%%\n",
+         constrained ? "constrained" : "unconstrained", K,
+         total*8*RATE/((double)nb_frames*frame_size)/1000, 100*(total/(nb_frames*budget)-1),
+         sqrt(drift2/nb_frames), drift_max,
+         nb_windows ? 100*sqrt(win2/nb_windows) : 0,
+         t/nb_frames, *t_ref > 0 ? 100*(t/ *t_ref-1) : 0);
+   celt_encoder_destroy(enc);
+   free(pcm);
+   return 0;
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage: vbr-bench [options]\n"
+         "  --seconds x       length of the program (default 20)\n"
+         "  --input file      a raw 16-bit stereo file at 48 kHz (native\n"
+         "                    endian) instead of the program\n"
+         "  --bitrate n       target in bits per second (default 64000 per\n"
+         "                    channel)\n"
+         "  --frame-size n    120, 240, 480 or 960 (default 960)\n"
+         "  --channels n      mono (1) or stereo (2, the default)\n");
+}
+
+int main(int argc, char **argv)
+{
+   int i, k, c;
+   double seconds = 20;
+   const char *input = NULL;
+   int bitrate = 0, frame_size = 960, channels = 2, len;
+   celt_int16 *signal;
+
+   for (i=1;i+1<argc;i+=2)
+   {
+      if (strcmp(argv[i], "--seconds")==0)
+         seconds = atof(argv[i+1]);
+      else if (strcmp(argv[i], "--input")==0)
+         input = argv[i+1];
+      else if (strcmp(argv[i], "--bitrate")==0)
+         bitrate = atoi(argv[i+1]);
+      else if (strcmp(argv[i], "--frame-size")==0)
+         frame_size = atoi(argv[i+1]);
+      else if (strcmp(argv[i], "--channels")==0)
+         channels = atoi(argv[i+1]);
+      else
+         break;
+   }
+   if (i<argc || seconds<=0 || channels<1 || channels>2 || frame_size<=0 || frame_size>960)
+   {
+      usage();
+      return i<argc && strcmp(argv[i], "--help")==0 ? 0 : 1;
+   }
+   if (bitrate == 0)
+      bitrate = 64000*channels;
+
+   if (input)
+   {
+      FILE *file = fopen(input, "rb");
+      if (!file)
+      {
+         perror(input);
+         return 1;
+      }
+      fseek(file, 0, SEEK_END);
+      len = ftell(file)/4;
+      fseek(file, 0, SEEK_SET);
+      signal = malloc(sizeof(celt_int16)*2*(len+1));
+      len = fread(signal, 4, len, file);
+      fclose(file);
+   } else {
+      len = (int)(seconds*RATE);
+      signal = malloc(sizeof(celt_int16)*2*len);
+      generate_program(signal, len);
+   }
+
+   printf("%d kb/s, %d samples, %d channel(s), %.1f s\n", bitrate/1000, frame_size, channels, len/(double)RATE);
+   printf("%-13s %2s | %8s %8s | %8s %8s | %8s | %7s %7s\n",
+         "vbr", "K", "kb/s", "error", "drift", "max", "1 s", "us/fr", "cost");
+   for (c=1;c>=0;c--)
+   {
+      double t_ref = 0;
+      for (k=0;k<(int)(sizeof(lookaheads)/sizeof(lookaheads[0]));k++)
+         if (run(signal, len/frame_size, frame_size, channels, bitrate, c, lookaheads[k], &t_ref))
+            return 1;
+   }
+   free(signal);
+   return 0;
+}
@@ -0,0 +1,193 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   Checks CELT_SET_VBR_LOOKAHEAD: without look-ahead the packets must be
+   the same as before, with it they must be the same through the 16-bit
+   and the float API (which analyse the next frames in different formats),
+   and unconstrained VBR must stray less from the target, without moving
+   the average, over a signal where runs of transients alternate with
+   steady tones. Also checks the values the request must refuse.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "celt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define CHANNELS 2
+#define FRAME_SIZE 960
+#define NB_FRAMES 400
+#define BITRATE 128000
+#define MAX_PACKET 1275
+#define K 2
+
+static int ret = 0;
+
+/* Half-second runs of tones, clicks every 5 ms and noise, with enough
+   silence at the end for the look-ahead */
+static void generate(celt_int16 *pcm, int len)
+{
+   int i, c;
+   double y = 0;
+   srand(1);
+   for (i=0;i<len;i++)
+   {
+      int run = (i/24000)%4;
+      for (c=0;c<CHANNELS;c++)
+      {
+         double x = 0;
+         if (i >= NB_FRAMES*FRAME_SIZE)
+            x = 0;
+         else if (run==0)
+            x = 3000*sin(.05*i+c);
+         else if (run==1)
+            x = i%240 < 10 ? rand()%30000-15000 : 100*sin(.2*i);
+         else if (run==2)
+            x = y = .5*y + rand()%20000-10000;
+         else
+            x = 2000*sin(.03*i) + 1000*sin(.11*i+c) + rand()%400-200;
+         pcm[i*CHANNELS+c] = (celt_int16)x;
+      }
+   }
+}
+
+/* Encodes the signal, with the look-ahead through the given API, and
+   returns the RMS distance in bytes of the
+   bytes sent so far from what the target allows */
+static double encode(const celt_int16 *pcm, int lookahead, int constrained, int use_float,
+      unsigned char *packets, int *lens)
+{
+   static float x[(K+1)*FRAME_SIZE*CHANNELS];
+   int f, i, err;
+   double drift=0, drift2=0, budget = BITRATE*FRAME_SIZE/48000./8;
+   CELTEncoder *enc = celt_encoder_create(48000, CHANNELS, &err);
+
+   if (enc==NULL)
+   {
+      fprintf(stderr, "cannot create the encoder: %s\n", celt_strerror(err));
+      exit(1);
+   }
+   celt_encoder_ctl(enc, CELT_SET_VBR(1));
+   celt_encoder_ctl(enc, CELT_SET_VBR_CONSTRAINT(constrained));
+   celt_encoder_ctl(enc, CELT_SET_BITRATE(BITRATE));
+   if (lookahead>=0 && celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(lookahead)) != CELT_OK)
+   {
+      fprintf(stderr, "** CELT_SET_VBR_LOOKAHEAD(%d) failed **\n", lookahead);
+      ret = 1;
+   }
+   for (f=0;f<NB_FRAMES;f++)
+   {
+      const celt_int16 *in = pcm+f*FRAME_SIZE*CHANNELS;
+      if (use_float)
+      {
+         for (i=0;i<(K+1)*FRAME_SIZE*CHANNELS;i++)
+            x[i] = in[i]*(1.f/32768);
+         lens[f] = celt_encode_float(enc, x, FRAME_SIZE, packets+f*MAX_PACKET, MAX_PACKET);
+      } else {
+         lens[f] = celt_encode(enc, in, FRAME_SIZE, packets+f*MAX_PACKET, MAX_PACKET);
+      }
+      if (lens[f]<0)
+      {
+         fprintf(stderr, "** celt_encode() failed: %s **\n", celt_strerror(lens[f]));
+         exit(1);
+      }
+      drift += lens[f]-budget;
+      drift2 += drift*drift;
+   }
+   celt_encoder_destroy(enc);
+   return sqrt(drift2/NB_FRAMES);
+}
+
+static int same(const unsigned char *a, const int *alen, const unsigned char *b, const int *blen)
+{
+   int f;
+   for (f=0;f<NB_FRAMES;f++)
+      if (alen[f]!=blen[f] || memcmp(a+f*MAX_PACKET, b+f*MAX_PACKET, alen[f])!=0)
+         return 0;
+   return 1;
+}
+
+int main(void)
+{
+   static celt_int16 pcm[(NB_FRAMES+K)*FRAME_SIZE*CHANNELS];
+   static unsigned char packets[2][NB_FRAMES*MAX_PACKET];
+   static int lens[2][NB_FRAMES];
+   double drift0, drift, total[2];
+   int i, f, err;
+   CELTEncoder *enc;
+
+   generate(pcm, (NB_FRAMES+K)*FRAME_SIZE);
+
+   /* No look-ahead is the same as never asking for it */
+   encode(pcm, -1, 1, 0, packets[0], lens[0]);
+   encode(pcm, 0, 1, 0, packets[1], lens[1]);
+   if (!same(packets[0], lens[0], packets[1], lens[1]))
+   {
+      fprintf(stderr, "** CELT_SET_VBR_LOOKAHEAD(0) changed the packets **\n");
+      ret = 1;
+   }
+
+   encode(pcm, K, 1, 0, packets[0], lens[0]);
+   encode(pcm, K, 1, 1, packets[1], lens[1]);
+   if (!same(packets[0], lens[0], packets[1], lens[1]))
+   {
+      fprintf(stderr, "** different packets with the look-ahead through the float API **\n");
+      ret = 1;
+   }
+
+   drift0 = encode(pcm, 0, 0, 0, packets[0], lens[0]);
+   drift = encode(pcm, K, 0, 0, packets[1], lens[1]);
+   printf("unconstrained VBR at %d kb/s: %.0f bytes from the target without look-ahead, %.0f with %d frames\n",
+         BITRATE/1000, drift0, drift, K);
+   if (drift > .75*drift0)
+   {
+      fprintf(stderr, "** the look-ahead didn't keep the rate closer to the target **\n");
+      ret = 1;
+   }
+   for (i=0;i<2;i++)
+      for (f=0,total[i]=0;f<NB_FRAMES;f++)
+         total[i] += lens[i][f];
+   if (fabs(total[1]/total[0]-1) > .02)
+   {
+      fprintf(stderr, "** the look-ahead moved the average rate by %.1f%% **\n", 100*(total[1]/total[0]-1));
+      ret = 1;
+   }
+
+   enc = celt_encoder_create(48000, CHANNELS, &err);
+   if (enc==NULL || celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(-1)) != CELT_BAD_ARG
+         || celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(CELT_MAX_VBR_LOOKAHEAD+1)) != CELT_BAD_ARG
+         || celt_encoder_ctl(enc, CELT_SET_VBR_LOOKAHEAD(CELT_MAX_VBR_LOOKAHEAD)) != CELT_OK)
+   {
+      fprintf(stderr, "** CELT_SET_VBR_LOOKAHEAD accepted a bad length or refused a good one **\n");
+      ret = 1;
+   }
+   celt_encoder_destroy(enc);
+   return ret;
+}
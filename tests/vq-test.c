@@ -0,0 +1,227 @@
+/* Copyright (c) 2011 Xiph.Org Foundation */
+/*
+   This test runs the greedy pulse placement of alg_quant() with the
+   pulse_search() built into the library and with a copy of the original
+   C loop. It checks that both give the same pulse vector for the (N,K)
+   pairs of the static mode's pulse cache, and reports the time each
+   one takes.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CELT_C
+#include "../libcelt/stack_alloc.h"
+#include "../libcelt/entenc.c"
+#include "../libcelt/entdec.c"
+#include "../libcelt/entcode.c"
+#include "../libcelt/cwrs.c"
+#include "../libcelt/mathops.c"
+#include "../libcelt/kiss_fft.c"
+#include "../libcelt/mdct.c"
+#include "../libcelt/rate.c"
+#include "../libcelt/vq.c"
+#include "../libcelt/modes.c"
+
+#define MAX_N 176
+#define NB_VECTORS 200
+
+#ifdef FIXED_DEBUG
+long long celt_mips=0;
+#endif
+int ret = 0;
+
+/* The search loop as it was before pulse_search() could be overridden */
+static int ref_search(const celt_norm *X, const celt_norm *y, int N,
+      celt_word32 xy, celt_word16 yy, int rshift)
+{
+   int j;
+   int best_id = 0;
+   celt_word32 best_num = -VERY_LARGE16;
+   celt_word16 best_den = 0;
+   j=0;
+   do {
+      celt_word16 Rxy, Ryy;
+      Rxy = EXTRACT16(SHR32(ADD32(xy, EXTEND32(X[j])),rshift));
+      Ryy = ADD16(yy, y[j]);
+      Rxy = MULT16_16_Q15(Rxy,Rxy);
+      if (MULT16_16(best_den, Rxy) > MULT16_16(Ryy, best_num))
+      {
+         best_den = Ryy;
+         best_num = Rxy;
+         best_id = j;
+      }
+   } while (++j<N);
+   return best_id;
+}
+
+typedef int (*search_func)(const celt_norm *, const celt_norm *, int, celt_word32, celt_word16, int);
+
+/* The pulse placement of alg_quant() on an already rotated, positive X */
+static void place_pulses(const celt_norm *X, int N, int K, int *iy, search_func search)
+{
+   celt_norm y[MAX_N];
+   celt_word32 xy = 0;
+   celt_word16 yy = 0;
+   int rshift = 0;
+   int i, j;
+   int pulsesLeft = K;
+
+   for (j=0;j<N;j++)
+   {
+      iy[j] = 0;
+      y[j] = 0;
+   }
+   if (K > (N>>1))
+   {
+      celt_word32 sum = 0;
+      celt_word16 rcp;
+      for (j=0;j<N;j++)
+         sum += X[j];
+      rcp = EXTRACT16(MULT16_32_Q16(K-1, celt_rcp(sum)));
+      for (j=0;j<N;j++)
+      {
+#ifdef FIXED_POINT
+         iy[j] = MULT16_16_Q15(X[j],rcp);
+#else
+         iy[j] = (int)floor(rcp*X[j]);
+#endif
+         y[j] = iy[j];
+         yy = MAC16_16(yy, y[j],y[j]);
+         xy = MAC16_16(xy, X[j],y[j]);
+         y[j] *= 2;
+         pulsesLeft -= iy[j];
+      }
+   }
+   for (i=0;i<pulsesLeft;i++)
+   {
+      int best_id;
+#ifdef FIXED_POINT
+      rshift = 1+celt_ilog2(K-pulsesLeft+i+1);
+#endif
+      yy = ADD32(yy, 1);
+      best_id = search(X, y, N, xy, yy, rshift);
+      xy = ADD32(xy, EXTEND32(X[best_id]));
+      yy = ADD16(yy, y[best_id]);
+      y[best_id] += 2;
+      iy[best_id]++;
+   }
+}
+
+/* A unit-norm vector with all-positive components, shaped like a band
+   after exp_rotation() with a few dominant bins */
+static void random_band(celt_norm *X, int N)
+{
+   int j;
+   float x[MAX_N];
+   float E = 0;
+   for (j=0;j<N;j++)
+   {
+      x[j] = (float)(rand()%1000+1);
+      if (rand()%8==0)
+         x[j] *= 10;
+      E += x[j]*x[j];
+   }
+   E = 1.f/sqrt(E);
+   for (j=0;j<N;j++)
+   {
+#ifdef FIXED_POINT
+      X[j] = (celt_norm)floor(.5+16384*x[j]*E);
+      if (X[j]==0)
+         X[j] = 1;
+#else
+      X[j] = x[j]*E;
+#endif
+   }
+}
+
+static void test_pair(int N, int K, clock_t *t_ref, clock_t *t_new)
+{
+   int v;
+   static celt_norm X[NB_VECTORS][MAX_N];
+   int iy_ref[MAX_N], iy_new[MAX_N];
+   clock_t t0;
+
+   for (v=0;v<NB_VECTORS;v++)
+      random_band(X[v], N);
+   for (v=0;v<NB_VECTORS;v++)
+   {
+      place_pulses(X[v], N, K, iy_ref, ref_search);
+      place_pulses(X[v], N, K, iy_new, pulse_search);
+      if (memcmp(iy_ref, iy_new, N*sizeof(int))!=0)
+      {
+         fprintf(stderr, "** pulse_search() mismatch for N=%d, K=%d **\n", N, K);
+         ret = 1;
+         return;
+      }
+   }
+   t0 = clock();
+   for (v=0;v<NB_VECTORS;v++)
+      place_pulses(X[v], N, K, iy_ref, ref_search);
+   *t_ref += clock()-t0;
+   t0 = clock();
+   for (v=0;v<NB_VECTORS;v++)
+      place_pulses(X[v], N, K, iy_new, pulse_search);
+   *t_new += clock()-t0;
+}
+
+int main(void)
+{
+   const CELTMode *m = static_mode_list[0];
+   int LM, b;
+   ALLOC_STACK;
+
+   srand(42);
+   for (LM=0;LM<=m->maxLM;LM++)
+   {
+      clock_t t_ref=0, t_new=0;
+      int pairs=0;
+      for (b=0;b<m->nbEBands;b++)
+      {
+         int N = (m->eBands[b+1]-m->eBands[b])<<LM;
+         const unsigned char *cache;
+         int q;
+         if (m->cache.index[LM*m->nbEBands+b] < 0)
+            continue;
+         cache = m->cache.bits + m->cache.index[LM*m->nbEBands+b];
+         /* Every pseudo-pulse count the allocator can pick for this band */
+         for (q=1;q<=cache[0];q++)
+         {
+            test_pair(N, get_pulses(q), &t_ref, &t_new);
+            pairs++;
+         }
+      }
+      printf("LM=%d: %d (N,K) pairs, %.2f ms reference, %.2f ms pulse_search()\n",
+            LM, pairs, 1e3*t_ref/CLOCKS_PER_SEC, 1e3*t_new/CLOCKS_PER_SEC);
+   }
+   return ret;
+}
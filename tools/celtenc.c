@@ -64,6 +64,11 @@
 #endif
 
 #include "skeleton.h"
+#include "segments.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 
 void comment_init(char **comments, int* length, char *vendor_string);
@@ -151,6 +156,331 @@ static int read_samples(FILE *fin,int frame_size, int bits, int channels, int ls
    return nb_read;
 }
 
+#ifdef HAVE_PTHREAD
+
+/* With --threads, the input is read a few frames ahead of the encoder and
+   the open-loop pitch search of each frame is done on one of the worker
+   threads (round-robin). Every worker goes through every frame to keep its
+   pre-emphasis and pitch history exact, but only searches its own frames.
+   The encoder gets the result through CELT_SET_PITCH_HINT(), so the output
+   is the same as with a single thread. */
+typedef struct LookaheadWorker LookaheadWorker;
+
+typedef struct {
+   int nb_threads;
+   int depth;                /* Frames of input buffered ahead */
+   int frame_size;
+   int channels;
+   short *pcm;
+   int *nb_samples;
+   int *hint;
+   int nb_read;              /* Frames read so far */
+   int nb_taken;             /* Frames handed to the encoder */
+   int eof;
+   int *nb_analysed;         /* Frames each worker went through */
+   CELTEncoder **analysis;
+   pthread_t *threads;
+   LookaheadWorker *workers;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+
+   FILE *fin;
+   int fmt;
+   int lsb;
+   char *first_bytes;
+   celt_int32 *size;
+} Lookahead;
+
+struct LookaheadWorker {
+   Lookahead *la;
+   int id;
+};
+
+static void *lookahead_worker(void *arg)
+{
+   LookaheadWorker *w = (LookaheadWorker*)arg;
+   Lookahead *la = w->la;
+   int f = 0;
+   while (1)
+   {
+      int own, hint;
+      pthread_mutex_lock(&la->lock);
+      while (f>=la->nb_read && !la->eof)
+         pthread_cond_wait(&la->cond, &la->lock);
+      if (f>=la->nb_read)
+      {
+         pthread_mutex_unlock(&la->lock);
+         break;
+      }
+      pthread_mutex_unlock(&la->lock);
+
+      own = f%la->nb_threads==w->id;
+      hint = celt_encoder_pitch_analysis(la->analysis[w->id],
+            la->pcm+(f%la->depth)*la->frame_size*la->channels, la->frame_size, own);
+
+      pthread_mutex_lock(&la->lock);
+      if (own)
+         la->hint[f%la->depth] = IMAX(hint, 0);
+      la->nb_analysed[w->id] = ++f;
+      pthread_cond_broadcast(&la->cond);
+      pthread_mutex_unlock(&la->lock);
+   }
+   return NULL;
+}
+
+static int lookahead_init(Lookahead *la, int nb_threads,
+      CELTMode *mode, int frame_size, int channels, FILE *fin, int fmt, int lsb,
+      char *first_bytes, celt_int32 *size)
+{
+   int i;
+   la->nb_threads = nb_threads;
+   la->depth = 4*nb_threads;
+   la->frame_size = frame_size;
+   la->channels = channels;
+   la->pcm = malloc(la->depth*frame_size*channels*sizeof(short));
+   la->nb_samples = malloc(la->depth*sizeof(int));
+   la->hint = malloc(la->depth*sizeof(int));
+   la->nb_analysed = calloc(nb_threads, sizeof(int));
+   la->analysis = malloc(nb_threads*sizeof(CELTEncoder*));
+   la->threads = malloc(nb_threads*sizeof(pthread_t));
+   la->workers = malloc(nb_threads*sizeof(LookaheadWorker));
+   la->nb_read = la->nb_taken = la->eof = 0;
+   la->fin = fin;
+   la->fmt = fmt;
+   la->lsb = lsb;
+   la->first_bytes = first_bytes;
+   la->size = size;
+   pthread_mutex_init(&la->lock, NULL);
+   pthread_cond_init(&la->cond, NULL);
+   for (i=0;i<nb_threads;i++)
+   {
+      la->analysis[i] = celt_encoder_create_custom(mode, channels, NULL);
+      if (la->analysis[i]==NULL)
+         return -1;
+   }
+   for (i=0;i<nb_threads;i++)
+   {
+      la->workers[i].la = la;
+      la->workers[i].id = i;
+      if (pthread_create(&la->threads[i], NULL, lookahead_worker, &la->workers[i]))
+      {
+         fprintf (stderr, "Failed to start worker thread %d\n", i);
+         exit(1);
+      }
+   }
+   return 0;
+}
+
+/* Equivalent of read_samples() that also returns the pitch hint of the frame */
+static int lookahead_read(Lookahead *la, short *input, int *hint)
+{
+   int i, f, slot, nb_samples;
+   int frame_len = la->frame_size*la->channels;
+   pthread_mutex_lock(&la->lock);
+   /* Keep the ring full, without overwriting a frame someone still needs */
+   while (!la->eof)
+   {
+      int oldest = la->nb_taken;
+      for (i=0;i<la->nb_threads;i++)
+         oldest = IMIN(oldest, la->nb_analysed[i]);
+      if (la->nb_read-oldest >= la->depth)
+         break;
+      pthread_mutex_unlock(&la->lock);
+      slot = la->nb_read%la->depth;
+      nb_samples = read_samples(la->fin, la->frame_size, la->fmt, la->channels, la->lsb,
+            la->pcm+slot*frame_len, la->first_bytes, la->size);
+      la->first_bytes = NULL;
+      pthread_mutex_lock(&la->lock);
+      if (nb_samples==0)
+         la->eof = 1;
+      else {
+         la->nb_samples[slot] = nb_samples;
+         la->nb_read++;
+      }
+      pthread_cond_broadcast(&la->cond);
+   }
+   f = la->nb_taken;
+   if (f>=la->nb_read)
+   {
+      pthread_mutex_unlock(&la->lock);
+      return 0;
+   }
+   while (la->nb_analysed[f%la->nb_threads]<=f)
+      pthread_cond_wait(&la->cond, &la->lock);
+   slot = f%la->depth;
+   memcpy(input, la->pcm+slot*frame_len, frame_len*sizeof(short));
+   *hint = la->hint[slot];
+   nb_samples = la->nb_samples[slot];
+   la->nb_taken++;
+   pthread_mutex_unlock(&la->lock);
+   return nb_samples;
+}
+
+static void lookahead_destroy(Lookahead *la)
+{
+   int i;
+   pthread_mutex_lock(&la->lock);
+   la->eof = 1;
+   pthread_cond_broadcast(&la->cond);
+   pthread_mutex_unlock(&la->lock);
+   for (i=0;i<la->nb_threads;i++)
+      pthread_join(la->threads[i], NULL);
+   for (i=0;i<la->nb_threads;i++)
+      celt_encoder_destroy(la->analysis[i]);
+   pthread_mutex_destroy(&la->lock);
+   pthread_cond_destroy(&la->cond);
+   free(la->pcm);
+   free(la->nb_samples);
+   free(la->hint);
+   free(la->nb_analysed);
+   free(la->analysis);
+   free(la->threads);
+   free(la->workers);
+}
+
+#endif /* HAVE_PTHREAD */
+
+/* With --pass 1, every frame is only analysed (see
+   celt_encoder_frame_stats()) and what was found is written to the stats
+   file: a header with the format of the input followed by one record per
+   frame. With --pass 2, the bits of the whole file are shared between the
+   frames by what each record calls for and each frame gets its share
+   through CELT_SET_FRAME_TARGET(). Whatever the frames so far used over
+   or under their shares is spread over the frames left, so the average
+   comes out at the bitrate. */
+#define STATS_MAGIC "CELTstat"
+#define STATS_VERSION 1
+#define STATS_HEADER_SIZE 20
+#define STATS_RECORD_SIZE 5
+
+typedef struct {
+   int nb_frames;
+   double *weight;           /* Share of each frame */
+   double *remaining;        /* Shares of each frame and of those after it */
+   double budget;            /* Bits of the whole file */
+   double spent;             /* Bits used so far */
+} TwoPassPlan;
+
+static void put_le(unsigned char *buf, celt_uint32 val, int bytes)
+{
+   int i;
+   for (i=0;i<bytes;i++)
+      buf[i] = (val>>(8*i))&0xff;
+}
+
+static celt_uint32 get_le(const unsigned char *buf, int bytes)
+{
+   int i;
+   celt_uint32 val=0;
+   for (i=bytes-1;i>=0;i--)
+      val = (val<<8)|buf[i];
+   return val;
+}
+
+static int write_stats_header(FILE *file, celt_int32 rate, int frame_size, int chan, int bands)
+{
+   unsigned char buf[STATS_HEADER_SIZE];
+   memcpy(buf, STATS_MAGIC, 8);
+   buf[8] = STATS_VERSION;
+   buf[9] = chan;
+   buf[10] = bands;
+   buf[11] = 0;
+   put_le(buf+12, frame_size, 4);
+   put_le(buf+16, rate, 4);
+   return fwrite(buf, 1, STATS_HEADER_SIZE, file)==STATS_HEADER_SIZE ? 0 : -1;
+}
+
+/* Demand and tf sum (16 bits each) and whether it's a transient */
+static int write_stats(FILE *file, const CELTFrameStats *stats)
+{
+   unsigned char buf[STATS_RECORD_SIZE];
+   put_le(buf, IMIN(stats->demand, 65535), 2);
+   put_le(buf+2, (celt_uint32)IMAX(-32768, IMIN(32767, stats->tf_sum)), 2);
+   buf[4] = stats->transient;
+   return fwrite(buf, 1, STATS_RECORD_SIZE, file)==STATS_RECORD_SIZE ? 0 : -1;
+}
+
+/* Share of the bits a frame gets: the boost the VBR gives frames coded
+   with short blocks or in time, on frames whose band energies call for
+   enough bits, and less on quieter ones down to nothing on silence */
+static double frame_weight(int demand, int tf_sum, int transient, int bands, int frame_size, int chan)
+{
+   double weight = 1;
+   double level = (demand-(40*chan+20))/(.8*frame_size*chan);
+   if (transient || tf_sum < -2*bands)
+      weight = 1.75;
+   else if (tf_sum < -bands)
+      weight = 1.5;
+   if (level < 1)
+      weight *= level > 0 ? level : 0;
+   return weight;
+}
+
+/* Reads the stats of the first pass and shares the bits of the file at
+   the bitrate (in bits per second) between the frames */
+static int read_stats(FILE *file, celt_int32 rate, int frame_size, int chan, double bitrate, TwoPassPlan *plan)
+{
+   unsigned char buf[STATS_HEADER_SIZE];
+   int bands, i;
+   if (fread(buf, 1, STATS_HEADER_SIZE, file)!=STATS_HEADER_SIZE
+         || memcmp(buf, STATS_MAGIC, 8)!=0 || buf[8]!=STATS_VERSION)
+   {
+      fprintf (stderr, "Not a stats file from the first pass\n");
+      return -1;
+   }
+   if (buf[9]!=chan || (int)get_le(buf+12, 4)!=frame_size || (celt_int32)get_le(buf+16, 4)!=rate)
+   {
+      fprintf (stderr, "The stats file is for another sampling rate, frame size or number of channels\n");
+      return -1;
+   }
+   bands = buf[10];
+   plan->nb_frames = 0;
+   plan->weight = NULL;
+   while (fread(buf, 1, STATS_RECORD_SIZE, file)==STATS_RECORD_SIZE)
+   {
+      if ((plan->nb_frames&(plan->nb_frames-1))==0)
+      {
+         double *tmp = realloc(plan->weight, 2*(plan->nb_frames+1)*sizeof(double));
+         if (!tmp)
+         {
+            fprintf (stderr, "Not enough memory for the stats\n");
+            return -1;
+         }
+         plan->weight = tmp;
+      }
+      plan->weight[plan->nb_frames++] = frame_weight(get_le(buf, 2),
+            (short)get_le(buf+2, 2), buf[4], bands, frame_size, chan);
+   }
+   plan->remaining = malloc((plan->nb_frames+1)*sizeof(double));
+   if (!plan->remaining)
+   {
+      fprintf (stderr, "Not enough memory for the stats\n");
+      return -1;
+   }
+   plan->remaining[plan->nb_frames] = 0;
+   for (i=plan->nb_frames-1;i>=0;i--)
+      plan->remaining[i] = plan->remaining[i+1] + plan->weight[i];
+   plan->budget = bitrate*plan->nb_frames*frame_size/rate;
+   plan->spent = 0;
+   return 0;
+}
+
+/* Size in bits of frame i: the two bytes every frame takes and its share
+   of the bits left over */
+static int plan_target(const TwoPassPlan *plan, int i)
+{
+   double target = 16;
+   if (i>=plan->nb_frames)
+      return 0;
+   if (plan->remaining[i]>0)
+      target += (plan->budget-plan->spent-16.*(plan->nb_frames-i))*plan->weight[i]/plan->remaining[i];
+   if (target < 16)
+      target = 16;
+   if (target > 8*MAX_FRAME_BYTES)
+      target = 8*MAX_FRAME_BYTES;
+   return (int)(target+.5);
+}
+
 void add_fishead_packet (ogg_stream_state *os) {
 
    fishead_packet fp;
@@ -217,6 +547,14 @@ void usage(void)
    printf (" --cbr              Use constant bitrate encoding\n");
    printf (" --comp n           Encoding complexity (0-10)\n");
    printf (" --framesize n      Frame size (Default: 960)\n");
+   printf (" --threads n        Do the pitch analysis on n worker threads ahead of\n");
+   printf ("                     the encoder (same output as a single thread, only\n");
+   printf ("                     in builds with the post-filter)\n");
+   printf (" --parallel-segments n  Split the input into n segments encoded in parallel\n");
+   printf ("                     (one thread each, or as set by --threads)\n");
+   printf (" --pass n           Two-pass encoding: pass 1 only analyses the input into\n");
+   printf ("                     the stats file, pass 2 encodes it at exactly the bitrate\n");
+   printf (" --stats file       Stats file of two-pass encoding (default: celtenc.stats)\n");
    printf (" --nopf             Do not use the prefilter/postfilter\n");
    printf (" --independent      Encode frames independently (implies nopf)\n");
    printf (" --skeleton         Outputs ogg skeleton metadata (may cause incompatibilities)\n");
@@ -267,6 +605,10 @@ int main(int argc, char **argv)
       {"nopf", no_argument, NULL, 0},
       {"independent", no_argument, NULL, 0},
       {"framesize", required_argument, NULL, 0},
+      {"threads", required_argument, NULL, 0},
+      {"parallel-segments", required_argument, NULL, 0},
+      {"pass", required_argument, NULL, 0},
+      {"stats", required_argument, NULL, 0},
       {"skeleton",no_argument,NULL, 0},
       {"help", no_argument, NULL, 0},
       {"quiet", no_argument, NULL, 0},
@@ -310,6 +652,16 @@ int main(int argc, char **argv)
    int complexity=-127;
    int prediction=2; 
    int bitstream;
+   int threads=1;
+   int hint=0;
+   int segments=1;
+   int pass=0;
+   char *stats_name="celtenc.stats";
+   FILE *fstats;
+   TwoPassPlan plan = {0, NULL, NULL, 0, 0};
+#ifdef HAVE_PTHREAD
+   Lookahead la;
+#endif
 
 
    /*Process command-line options*/
@@ -377,6 +729,38 @@ int main(int argc, char **argv)
          } else if (strcmp(long_options[option_index].name,"framesize")==0)
          {
             frame_size=atoi (optarg);
+         } else if (strcmp(long_options[option_index].name,"threads")==0)
+         {
+            threads=atoi (optarg);
+            if (threads<1)
+            {
+               fprintf (stderr, "Invalid number of threads: %s\n", optarg);
+               exit(1);
+            }
+#ifndef HAVE_PTHREAD
+            if (threads>1)
+               fprintf (stderr, "Warning: this build has no thread support, using a single thread\n");
+            threads=1;
+#endif
+         } else if (strcmp(long_options[option_index].name,"parallel-segments")==0)
+         {
+            segments=atoi (optarg);
+            if (segments<1)
+            {
+               fprintf (stderr, "Invalid number of segments: %s\n", optarg);
+               exit(1);
+            }
+         } else if (strcmp(long_options[option_index].name,"pass")==0)
+         {
+            pass=atoi (optarg);
+            if (pass<1 || pass>2)
+            {
+               fprintf (stderr, "Invalid pass: %s\n", optarg);
+               exit(1);
+            }
+         } else if (strcmp(long_options[option_index].name,"stats")==0)
+         {
+            stats_name=optarg;
          } else if (strcmp(long_options[option_index].name,"nopf")==0)
          {
             if (prediction>1)
@@ -548,6 +932,63 @@ int main(int argc, char **argv)
      }
    }
 
+   if (pass && (with_cbr || segments>1))
+   {
+      fprintf (stderr, "Two-pass encoding needs VBR and a single segment\n");
+      return 1;
+   }
+
+   if (pass==1)
+   {
+      /* Only the stats are written, the output file isn't */
+      CELTFrameStats stats;
+      fstats = fopen(stats_name, "wb");
+      if (!fstats)
+      {
+         perror(stats_name);
+         exit(1);
+      }
+      nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input,
+            wave_input ? NULL : first_bytes, wave_input ? &size : NULL);
+      while (nb_samples>0)
+      {
+         if (celt_encoder_frame_stats(st, input, frame_size, &stats) != CELT_OK)
+         {
+            fprintf (stderr, "Frame analysis failed\n");
+            return 1;
+         }
+         if ((++id==0 && write_stats_header(fstats, rate, frame_size, chan, stats.bands))
+               || write_stats(fstats, &stats))
+         {
+            fprintf (stderr, "Error: failed writing the stats file\n");
+            exit(1);
+         }
+         nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input,
+               NULL, wave_input ? &size : NULL);
+      }
+      if (!quiet)
+         fprintf (stderr, "First pass: %d frames analysed into %s\n", id+1, stats_name);
+      fclose(fstats);
+      free(comments);
+      celt_encoder_destroy(st);
+      celt_mode_destroy(mode);
+      if (close_in)
+         fclose(fin);
+      return 0;
+   }
+   if (pass==2)
+   {
+      fstats = fopen(stats_name, "rb");
+      if (!fstats)
+      {
+         perror(stats_name);
+         exit(1);
+      }
+      if (read_stats(fstats, rate, frame_size, chan, bitrate*1000, &plan))
+         exit(1);
+      fclose(fstats);
+   }
+
    if (strcmp(outFile,"-")==0)
    {
 #if defined WIN32 || defined _WIN32
@@ -651,74 +1092,195 @@ int main(int argc, char **argv)
    }
 
 
-   if (!wave_input)
+   if (segments>1)
    {
-      nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, first_bytes, NULL);
+      /* The whole input is read first, then split into segments that are
+         encoded in parallel, and their packets are written in order */
+      SegmentConfig config;
+      SegmentPackets *packets;
+      short *pcm = NULL;
+      int nb_frames = 0;
+      int s, p, err;
+      nb_encoded = -lookahead;
+      do {
+         /* The buffer doubles, as in read_stats() */
+         if ((nb_frames&(nb_frames-1))==0)
+         {
+            short *tmp = realloc(pcm, 2*(nb_frames+1)*frame_size*chan*sizeof(short));
+            if (!tmp)
+            {
+               fprintf (stderr, "Not enough memory for the whole input\n");
+               exit(1);
+            }
+            pcm = tmp;
+         }
+         nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,pcm+nb_frames*frame_size*chan,
+               nb_frames==0 && !wave_input ? first_bytes : NULL, wave_input ? &size : NULL);
+         if (nb_samples>0)
+            nb_frames++;
+         total_samples += nb_samples;
+      } while (nb_samples>0);
+      if (segments>nb_frames)
+         segments = IMAX(nb_frames, 1);
+      config.frame_size = frame_size;
+      config.channels = chan;
+      config.bitrate = (celt_int32)(bitrate*1000);
+      config.vbr = !with_cbr;
+      config.constrained_vbr = with_cvbr;
+      config.prediction = prediction;
+      config.complexity = complexity!=-127 ? complexity : -1;
+      config.warmup = -1;
+      packets = malloc(segments*sizeof(SegmentPackets));
+      err = nb_frames>0 ? segments_encode(mode, &config, pcm, nb_frames, segments,
+            threads>1 ? threads : segments, packets) : CELT_OK;
+      if (err != CELT_OK)
+      {
+         fprintf(stderr, "Got error %d while encoding. Aborting.\n", err);
+         exit(1);
+      }
+      for (s=0;s<segments && nb_frames>0;s++)
+      {
+         for (p=0;p<packets[s].nb_packets;p++)
+         {
+            id++;
+            nbBytes = packets[s].bytes[p];
+            nb_encoded += frame_size;
+            total_bytes += nbBytes;
+            peak_bytes=IMAX(nbBytes,peak_bytes);
+
+            op.packet = packets[s].data+packets[s].offset[p];
+            op.bytes = nbBytes;
+            op.b_o_s = 0;
+            op.e_o_s = id==nb_frames-1;
+            op.granulepos = (id+1)*frame_size-lookahead;
+            if (op.granulepos>total_samples)
+               op.granulepos = total_samples;
+            op.packetno = 2+id;
+            ogg_stream_packetin(&os, &op);
+
+            while (ogg_stream_pageout(&os,&og))
+            {
+               ret = oe_write_page(&og, fout);
+               if(ret != og.header_len + og.body_len)
+               {
+                  fprintf (stderr,"Error: failed writing header to output stream\n");
+                  exit(1);
+               }
+               else
+                  bytes_written += ret;
+            }
+         }
+         segment_packets_clear(&packets[s]);
+      }
+      free(packets);
+      free(pcm);
    } else {
-      nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, NULL, &size);
-   }
-   if (nb_samples==0)
-      eos=1;
-   total_samples += nb_samples;
-   nb_encoded = -lookahead;
-   /*Main encoding loop (one frame per iteration)*/
-   while (!eos || total_samples>nb_encoded)
-   {
-      id++;
-      /*Encode current frame*/
-
-      nbBytes = celt_encode(st, input, frame_size, bits, bytes_per_packet);
-      if (nbBytes<0)
+#ifdef HAVE_PTHREAD
+      if (threads>1)
       {
-         fprintf(stderr, "Got error %d while encoding. Aborting.\n", nbBytes);
-         break;
+         /* The pitch search is part of the post-filter, without which the
+            workers would have nothing to do */
+         CELTEncoder *probe = celt_encoder_create_custom(mode, chan, NULL);
+         memset(input, 0, frame_size*chan*sizeof(short));
+         if (probe==NULL || celt_encoder_pitch_analysis(probe, input, frame_size, 1)==CELT_UNIMPLEMENTED)
+         {
+            fprintf (stderr, "Warning: this build has no pitch pre-filter to analyse ahead, using a single thread\n");
+            threads=1;
+         }
+         if (probe!=NULL)
+            celt_encoder_destroy(probe);
       }
-      nb_encoded += frame_size;
-      total_bytes += nbBytes;
-      peak_bytes=IMAX(nbBytes,peak_bytes);
-
-      if (wave_input)
+      if (threads>1)
       {
-         nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, NULL, &size);
+         if (lookahead_init(&la, threads, mode, frame_size, chan, fin, fmt, lsb,
+               wave_input ? NULL : first_bytes, wave_input ? &size : NULL))
+         {
+            fprintf (stderr, "Failed to create the analysis encoders\n");
+            return 1;
+         }
+         nb_samples = lookahead_read(&la, input, &hint);
+      } else
+#endif
+      if (!wave_input)
+      {
+         nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, first_bytes, NULL);
       } else {
-         nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, NULL, NULL);
+         nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, NULL, &size);
       }
       if (nb_samples==0)
-      {
          eos=1;
-      }
-      if (eos && total_samples<=nb_encoded)
-         op.e_o_s = 1;
-      else
-         op.e_o_s = 0;
       total_samples += nb_samples;
-
-      op.packet = (unsigned char *)bits;
-      op.bytes = nbBytes;
-      op.b_o_s = 0;
-      /*Is this redundent?*/
-      if (eos && total_samples<=nb_encoded)
-         op.e_o_s = 1;
-      else
-         op.e_o_s = 0;
-      op.granulepos = (id+1)*frame_size-lookahead;
-      if (op.granulepos>total_samples)
-         op.granulepos = total_samples;
-      /*printf ("granulepos: %d %d %d %d %d %d\n", (int)op.granulepos, id, nframes, lookahead, 5, 6);*/
-      op.packetno = 2+id;
-      ogg_stream_packetin(&os, &op);
-
-      /*Write all new pages (most likely 0 or 1)*/
-      while (ogg_stream_pageout(&os,&og))
+      nb_encoded = -lookahead;
+      /*Main encoding loop (one frame per iteration)*/
+      while (!eos || total_samples>nb_encoded)
       {
-         ret = oe_write_page(&og, fout);
-         if(ret != og.header_len + og.body_len)
+         id++;
+         /*Encode current frame*/
+
+         if (threads>1)
+            celt_encoder_ctl(st, CELT_SET_PITCH_HINT(hint));
+         if (pass==2)
+            celt_encoder_ctl(st, CELT_SET_FRAME_TARGET(plan_target(&plan, id)));
+         nbBytes = celt_encode(st, input, frame_size, bits, bytes_per_packet);
+         if (nbBytes<0)
          {
-            fprintf (stderr,"Error: failed writing header to output stream\n");
-            exit(1);
+            fprintf(stderr, "Got error %d while encoding. Aborting.\n", nbBytes);
+            break;
          }
+         if (pass==2)
+            plan.spent += 8*nbBytes;
+         nb_encoded += frame_size;
+         total_bytes += nbBytes;
+         peak_bytes=IMAX(nbBytes,peak_bytes);
+
+#ifdef HAVE_PTHREAD
+         if (threads>1)
+            nb_samples = lookahead_read(&la, input, &hint);
          else
-            bytes_written += ret;
+#endif
+         if (wave_input)
+         {
+            nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, NULL, &size);
+         } else {
+            nb_samples = read_samples(fin,frame_size,fmt,chan,lsb,input, NULL, NULL);
+         }
+         if (nb_samples==0)
+         {
+            eos=1;
+         }
+         if (eos && total_samples<=nb_encoded)
+            op.e_o_s = 1;
+         else
+            op.e_o_s = 0;
+         total_samples += nb_samples;
+
+         op.packet = (unsigned char *)bits;
+         op.bytes = nbBytes;
+         op.b_o_s = 0;
+         /*Is this redundent?*/
+         if (eos && total_samples<=nb_encoded)
+            op.e_o_s = 1;
+         else
+            op.e_o_s = 0;
+         op.granulepos = (id+1)*frame_size-lookahead;
+         if (op.granulepos>total_samples)
+            op.granulepos = total_samples;
+         /*printf ("granulepos: %d %d %d %d %d %d\n", (int)op.granulepos, id, nframes, lookahead, 5, 6);*/
+         op.packetno = 2+id;
+         ogg_stream_packetin(&os, &op);
+
+         /*Write all new pages (most likely 0 or 1)*/
+         while (ogg_stream_pageout(&os,&og))
+         {
+            ret = oe_write_page(&og, fout);
+            if(ret != og.header_len + og.body_len)
+            {
+               fprintf (stderr,"Error: failed writing header to output stream\n");
+               exit(1);
+            }
+            else
+               bytes_written += ret;
+         }
       }
    }
    /*Flush all pages left to be written*/
@@ -737,6 +1299,17 @@ int main(int argc, char **argv)
    if (!with_cbr && !quiet)
      fprintf (stderr, "Average rate %0.3fkbit/sec, %d peak bytes per packet\n", (total_bytes*8.0/((float)nb_encoded/header.sample_rate))/1000.0, peak_bytes);
 
+   if (pass==2)
+   {
+      if (id+1 != plan.nb_frames)
+         fprintf (stderr, "Warning: the stats file has %d frames and the input %d\n", plan.nb_frames, id+1);
+      free(plan.weight);
+      free(plan.remaining);
+   }
+#ifdef HAVE_PTHREAD
+   if (threads>1)
+      lookahead_destroy(&la);
+#endif
    celt_encoder_destroy(st);
    celt_mode_destroy(mode);
    ogg_stream_clear(&os);
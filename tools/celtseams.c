@@ -0,0 +1,211 @@
+/* Copyright (c) 2011 Xiph.Org Foundation
+   File: celtseams.c
+
+   Measures what encoding a signal as independent segments (as done by
+   celtenc --parallel-segments) costs around the segment boundaries. The
+   input is encoded once as a single segment and once split into segments,
+   both are decoded, and the difference between the two decoded signals is
+   reported in a window around every seam, along with the SNR of each one
+   against the input.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "celt.h"
+#include "segments.h"
+
+/* Frames after each seam that are included in its window */
+#define SEAM_FRAMES 4
+
+static double snr(const celt_int16 *ref, const celt_int16 *x, int len)
+{
+   int i;
+   double sig=1e-3, err=1e-3;
+   for (i=0;i<len;i++)
+   {
+      sig += ref[i]*(double)ref[i];
+      err += (ref[i]-x[i])*(double)(ref[i]-x[i]);
+   }
+   return 10*log10(sig/err);
+}
+
+static celt_int16 *decode_all(const CELTMode *mode, int channels, int frame_size,
+      const SegmentPackets *packets, int nb_segments, int nb_frames)
+{
+   int s, p, f=0, err;
+   CELTDecoder *dec;
+   celt_int16 *out;
+   dec = celt_decoder_create_custom(mode, channels, &err);
+   if (dec == NULL)
+   {
+      fprintf(stderr, "Failed to create the decoder: %s\n", celt_strerror(err));
+      exit(1);
+   }
+   out = calloc(nb_frames*frame_size*channels, sizeof(celt_int16));
+   for (s=0;s<nb_segments;s++)
+   {
+      for (p=0;p<packets[s].nb_packets;p++)
+      {
+         err = celt_decode(dec, packets[s].data+packets[s].offset[p], packets[s].bytes[p],
+               out+f*frame_size*channels, frame_size);
+         if (err < 0)
+         {
+            fprintf(stderr, "celt_decode() failed: %s\n", celt_strerror(err));
+            exit(1);
+         }
+         f++;
+      }
+   }
+   celt_decoder_destroy(dec);
+   return out;
+}
+
+int main(int argc, char *argv[])
+{
+   int i, s, err;
+   FILE *fin;
+   CELTMode *mode;
+   SegmentConfig config;
+   SegmentPackets *serial, *split;
+   celt_int16 *in, *out_serial, *out_split;
+   celt_int32 skip;
+   int rate, nb_frames, nb_segments, nb_samples, frame_len;
+   long serial_bytes=0, split_bytes=0;
+   double worst=1e9;
+
+   if (argc != 7 && argc != 8 && argc != 9)
+   {
+      fprintf (stderr, "Usage: celtseams <rate> <channels> <frame size> <kbit/s> "
+               "<segments> [<warm-up frames> [<complexity>]] <input>\n");
+      return 1;
+   }
+   rate = atoi(argv[1]);
+   config.channels = atoi(argv[2]);
+   config.frame_size = atoi(argv[3]);
+   config.bitrate = (celt_int32)(1000*atof(argv[4]));
+   config.vbr = 1;
+   config.constrained_vbr = 0;
+   config.prediction = 2;
+   nb_segments = atoi(argv[5]);
+   config.warmup = argc>7 ? atoi(argv[6]) : -1;
+   config.complexity = argc>8 ? atoi(argv[7]) : -1;
+   if (config.channels < 1 || config.channels > 2 || nb_segments < 2)
+   {
+      fprintf (stderr, "channels must be 1 or 2 and there must be at least 2 segments\n");
+      return 1;
+   }
+
+   mode = celt_mode_create(rate, config.frame_size, &err);
+   if (mode == NULL)
+   {
+      fprintf(stderr, "failed to create a mode: %s\n", celt_strerror(err));
+      return 1;
+   }
+   celt_mode_info(mode, CELT_GET_LOOKAHEAD, &skip);
+
+   fin = fopen(argv[argc-1], "rb");
+   if (!fin)
+   {
+      fprintf (stderr, "Could not open input file %s\n", argv[argc-1]);
+      return 1;
+   }
+   fseek(fin, 0, SEEK_END);
+   frame_len = config.frame_size*config.channels;
+   nb_samples = ftell(fin)/(sizeof(celt_int16)*config.channels);
+   fseek(fin, 0, SEEK_SET);
+   nb_frames = (nb_samples+config.frame_size-1)/config.frame_size;
+   if (nb_frames < nb_segments)
+   {
+      fprintf (stderr, "The input is too short for %d segments\n", nb_segments);
+      return 1;
+   }
+   in = calloc(nb_frames*frame_len, sizeof(celt_int16));
+   if (fread(in, sizeof(celt_int16)*config.channels, nb_samples, fin) != (size_t)nb_samples)
+   {
+      fprintf (stderr, "Could not read %s\n", argv[argc-1]);
+      return 1;
+   }
+   fclose(fin);
+
+   serial = malloc(sizeof(SegmentPackets));
+   split = malloc(nb_segments*sizeof(SegmentPackets));
+   err = segments_encode(mode, &config, in, nb_frames, 1, 1, serial);
+   if (err == CELT_OK)
+      err = segments_encode(mode, &config, in, nb_frames, nb_segments, nb_segments, split);
+   if (err != CELT_OK)
+   {
+      fprintf(stderr, "Encoding failed: %s\n", celt_strerror(err));
+      return 1;
+   }
+   out_serial = decode_all(mode, config.channels, config.frame_size, serial, 1, nb_frames);
+   out_split = decode_all(mode, config.channels, config.frame_size, split, nb_segments, nb_frames);
+
+   /* The decoded signals are delayed by the lookahead */
+   printf("%d frames in %d segments, %d frames of warm-up\n", nb_frames, nb_segments,
+         config.warmup >= 0 ? config.warmup : segments_default_warmup(config.frame_size));
+   for (s=1;s<nb_segments;s++)
+   {
+      int start, end;
+      double serial_snr, split_snr, diff;
+      start = (segments_start(nb_frames, nb_segments, s)-1)*config.frame_size;
+      end = start + (SEAM_FRAMES+1)*config.frame_size;
+      if (end > nb_frames*config.frame_size-skip)
+         end = nb_frames*config.frame_size-skip;
+      start *= config.channels;
+      end *= config.channels;
+      serial_snr = snr(in+start, out_serial+start+skip*config.channels, end-start);
+      split_snr = snr(in+start, out_split+start+skip*config.channels, end-start);
+      diff = snr(out_serial+start+skip*config.channels, out_split+start+skip*config.channels, end-start);
+      printf("seam %2d at %8.3f s: SNR %6.2f dB single, %6.2f dB split, split vs single %6.2f dB\n",
+            s, start/(double)(config.channels*rate), serial_snr, split_snr, diff);
+      if (split_snr-serial_snr < worst)
+         worst = split_snr-serial_snr;
+   }
+   for (s=0;s<nb_segments;s++)
+      split_bytes += split[s].size;
+   serial_bytes = serial[0].size;
+   i = (nb_frames*config.frame_size-skip)*config.channels;
+   printf("overall: SNR %.2f dB single, %.2f dB split, worst seam %+.2f dB, %+.2f%% bytes\n",
+         snr(in, out_serial+skip*config.channels, i), snr(in, out_split+skip*config.channels, i),
+         worst, 100.*(split_bytes-serial_bytes)/serial_bytes);
+
+   segment_packets_clear(serial);
+   for (s=0;s<nb_segments;s++)
+      segment_packets_clear(&split[s]);
+   free(serial);
+   free(split);
+   free(in);
+   free(out_serial);
+   free(out_split);
+   celt_mode_destroy(mode);
+   return 0;
+}
@@ -0,0 +1,240 @@
+/* Copyright (c) 2011 Xiph.Org Foundation
+   File: segments.c
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "segments.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define MAX_PACKET 1275
+
+int segments_default_warmup(int frame_size)
+{
+   /* About 200 ms at 48 kHz. Much less than that and the prefilter and
+      spreading decisions have not settled yet (see celtseams) */
+   int warmup = (9600+frame_size-1)/frame_size;
+   return warmup < 2 ? 2 : warmup;
+}
+
+int segments_start(int nb_frames, int nb_segments, int segment)
+{
+   return (int)((long long)nb_frames*segment/nb_segments);
+}
+
+void segment_packets_clear(SegmentPackets *packets)
+{
+   free(packets->bytes);
+   free(packets->offset);
+   free(packets->data);
+   memset(packets, 0, sizeof(*packets));
+}
+
+static int configure(CELTEncoder *st, const SegmentConfig *config)
+{
+   int err;
+   err = celt_encoder_ctl(st, CELT_SET_BITRATE(config->bitrate));
+   if (err == CELT_OK)
+      err = celt_encoder_ctl(st, CELT_SET_VBR(config->vbr));
+   if (err == CELT_OK && config->vbr)
+      err = celt_encoder_ctl(st, CELT_SET_VBR_CONSTRAINT(config->constrained_vbr));
+   if (err == CELT_OK)
+      err = celt_encoder_ctl(st, CELT_SET_PREDICTION(config->prediction));
+   if (err == CELT_OK && config->complexity >= 0)
+      err = celt_encoder_ctl(st, CELT_SET_COMPLEXITY(config->complexity));
+   return err;
+}
+
+/* Encodes frames [start,end) of the signal into packets, after warming up
+   on the frames before start */
+static int encode_segment(CELTEncoder *st, const SegmentConfig *config,
+      const celt_int16 *pcm, int start, int end, SegmentPackets *packets)
+{
+   int f, err;
+   int warmup = config->warmup >= 0 ? config->warmup : segments_default_warmup(config->frame_size);
+   int frame_len = config->frame_size*config->channels;
+   unsigned char scratch[MAX_PACKET];
+
+   celt_encoder_ctl(st, CELT_RESET_STATE);
+   if (start > 0)
+   {
+      f = start-warmup < 0 ? 0 : start-warmup;
+      for (;f<start;f++)
+      {
+         err = celt_encode(st, pcm+f*frame_len, config->frame_size, scratch, MAX_PACKET);
+         if (err < 0)
+            return err;
+      }
+      /* No inter-frame prediction for the first real frame */
+      err = celt_encoder_ctl(st, CELT_SET_PREDICTION(0));
+      if (err != CELT_OK)
+         return err;
+   }
+
+   packets->nb_packets = 0;
+   packets->size = 0;
+   packets->bytes = malloc((end-start)*sizeof(int));
+   packets->offset = malloc((end-start)*sizeof(int));
+   packets->alloc = (end-start)*64;
+   packets->data = malloc(packets->alloc);
+   if (!packets->bytes || !packets->offset || !packets->data)
+      return CELT_ALLOC_FAIL;
+   for (f=start;f<end;f++)
+   {
+      int nbBytes;
+      if (packets->size+MAX_PACKET > packets->alloc)
+      {
+         unsigned char *data;
+         packets->alloc = 2*packets->alloc+MAX_PACKET;
+         data = realloc(packets->data, packets->alloc);
+         if (!data)
+            return CELT_ALLOC_FAIL;
+         packets->data = data;
+      }
+      nbBytes = celt_encode(st, pcm+f*frame_len, config->frame_size,
+            packets->data+packets->size, MAX_PACKET);
+      if (nbBytes < 0)
+         return nbBytes;
+      if (f==start && start > 0)
+      {
+         err = celt_encoder_ctl(st, CELT_SET_PREDICTION(config->prediction));
+         if (err != CELT_OK)
+            return err;
+      }
+      packets->bytes[packets->nb_packets] = nbBytes;
+      packets->offset[packets->nb_packets] = packets->size;
+      packets->nb_packets++;
+      packets->size += nbBytes;
+   }
+   return CELT_OK;
+}
+
+typedef struct {
+   const CELTMode *mode;
+   const SegmentConfig *config;
+   const celt_int16 *pcm;
+   int nb_frames;
+   int nb_segments;
+   SegmentPackets *packets;
+   int next;                /* Next segment nobody has started on */
+   int error;
+#ifdef HAVE_PTHREAD
+   pthread_mutex_t lock;
+#endif
+} SegmentJob;
+
+/* Takes segments off the job until there are none left, reusing the same
+   encoder (and thus the same memory) for all of them */
+static void *segment_worker(void *arg)
+{
+   SegmentJob *job = (SegmentJob*)arg;
+   CELTEncoder *st;
+   int err;
+
+   st = malloc(celt_encoder_get_size_custom(job->mode, job->config->channels));
+   if (celt_encoder_init_custom(st, job->mode, job->config->channels, &err) == NULL)
+      goto done;
+   err = configure(st, job->config);
+   while (err == CELT_OK)
+   {
+      int s;
+#ifdef HAVE_PTHREAD
+      pthread_mutex_lock(&job->lock);
+#endif
+      s = job->error == CELT_OK ? job->next++ : job->nb_segments;
+#ifdef HAVE_PTHREAD
+      pthread_mutex_unlock(&job->lock);
+#endif
+      if (s >= job->nb_segments)
+         break;
+      err = encode_segment(st, job->config, job->pcm,
+            segments_start(job->nb_frames, job->nb_segments, s),
+            segments_start(job->nb_frames, job->nb_segments, s+1),
+            &job->packets[s]);
+   }
+done:
+#ifdef HAVE_PTHREAD
+   pthread_mutex_lock(&job->lock);
+#endif
+   if (job->error == CELT_OK)
+      job->error = err;
+#ifdef HAVE_PTHREAD
+   pthread_mutex_unlock(&job->lock);
+#endif
+   free(st);
+   return NULL;
+}
+
+int segments_encode(const CELTMode *mode, const SegmentConfig *config,
+      const celt_int16 *pcm, int nb_frames, int nb_segments, int nb_threads,
+      SegmentPackets *packets)
+{
+   SegmentJob job;
+
+   if (nb_segments < 1 || nb_segments > nb_frames)
+      return CELT_BAD_ARG;
+   memset(packets, 0, nb_segments*sizeof(*packets));
+   job.mode = mode;
+   job.config = config;
+   job.pcm = pcm;
+   job.nb_frames = nb_frames;
+   job.nb_segments = nb_segments;
+   job.packets = packets;
+   job.next = 0;
+   job.error = CELT_OK;
+#ifdef HAVE_PTHREAD
+   pthread_mutex_init(&job.lock, NULL);
+   if (nb_threads > nb_segments)
+      nb_threads = nb_segments;
+   if (nb_threads > 1)
+   {
+      int i, started;
+      pthread_t *threads = malloc(nb_threads*sizeof(pthread_t));
+      for (started=0;started<nb_threads;started++)
+         if (pthread_create(&threads[started], NULL, segment_worker, &job))
+            break;
+      /* If no thread could be started, do it all here */
+      if (started==0)
+         segment_worker(&job);
+      for (i=0;i<started;i++)
+         pthread_join(threads[i], NULL);
+      free(threads);
+   } else
+      segment_worker(&job);
+   pthread_mutex_destroy(&job.lock);
+#else
+   (void)nb_threads;
+   segment_worker(&job);
+#endif
+   return job.error;
+}
@@ -0,0 +1,80 @@
+/* Copyright (c) 2011 Xiph.Org Foundation
+   File: segments.h
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include "celt.h"
+
+/* Encoding of a whole signal as independent segments, one per thread.
+
+   Each segment encoder is reset and then warmed up by encoding (and
+   discarding) the frames just before its segment, so that its pre-emphasis,
+   prefilter and analysis memories have converged when it gets to its first
+   real frame. That frame is coded without inter-frame prediction so that
+   the decoder, which has been following the previous segment, gets the
+   band energies right from there on. */
+
+typedef struct {
+   int frame_size;
+   int channels;
+   celt_int32 bitrate;      /* Bits per second */
+   int vbr;
+   int constrained_vbr;
+   int prediction;          /* As for CELT_SET_PREDICTION() */
+   int complexity;          /* -1 to keep the default */
+   int warmup;              /* Frames encoded before each segment, -1 for the default */
+} SegmentConfig;
+
+typedef struct {
+   int nb_packets;
+   int *bytes;              /* Size of each packet */
+   int *offset;             /* Position of each packet in data */
+   unsigned char *data;
+   int size;
+   int alloc;
+} SegmentPackets;
+
+/** Number of warm-up frames used when SegmentConfig.warmup is -1 */
+int segments_default_warmup(int frame_size);
+
+/** Encodes nb_frames frames of interleaved pcm as nb_segments segments of
+    (almost) equal length on up to nb_threads threads. There must be at
+    least one frame per segment. The packets of each
+    segment are stored in packets[0..nb_segments-1], in order, and do not
+    depend on the number of threads. Returns CELT_OK or the first error
+    returned by the library. */
+int segments_encode(const CELTMode *mode, const SegmentConfig *config,
+      const celt_int16 *pcm, int nb_frames, int nb_segments, int nb_threads,
+      SegmentPackets *packets);
+
+/** First frame of the given segment (segment nb_segments gives nb_frames) */
+int segments_start(int nb_frames, int nb_segments, int segment);
+
+void segment_packets_clear(SegmentPackets *packets);
+
+#endif